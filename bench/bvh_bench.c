@@ -0,0 +1,289 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*BVH benchmark.
+
+  Builds trees over seeded heightfield terrains of about 100K and 1M
+  triangles, then traces two ray sets against the large one: 512x512
+  camera rays in scanline order, so consecutive rays are coherent, and
+  the same number of rays with random origins and directions. Every set
+  is traced by closest hit and any hit, one ray at a time with
+  bvh_intersect() and bvh_occluded() and as packets with
+  bvh_intersect_rays() and bvh_occluded_rays(). A brute force loop over
+  every triangle is timed on a sample of the rays for comparison. Before
+  anything is timed, every method must agree with it on that sample, the
+  closest t and the any hit flag, or the benchmark exits with 1.
+
+  One JSON object per build and per query is written to stdout, a
+  readable table is written to stderr:
+
+    make -C bench bvh && ./bench/bvh_bench > bench_output.txt*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BLIB_IMPLEMENTATION
+#include "../blib_bvh.h"
+
+#define BENCH_IMAGE (512)
+#define BENCH_BRUTE_RAYS (32)
+#define BENCH_MIN_SECONDS (0.3)
+
+static double bench_now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static uint64_t bench_seed = 0x2545F4914F6CDD1Dull;
+
+static uint32_t bench_random_below(uint32_t n) {
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 7;
+	bench_seed ^= bench_seed << 17;
+	return (uint32_t)((bench_seed >> 32) % n);
+}
+
+static float bench_random(float range) {
+	return ((float)bench_random_below(1u << 24) / 16777216.0f - 0.5f) * range;
+}
+
+static float bench_height(float x, float z) {
+	return 0.04f * sinf(x * 23.0f) * cosf(z * 17.0f) + 0.01f * sinf((x + z) * 97.0f) + bench_random(0.002f);
+}
+
+/*A grid of (size - 1)^2 quads over [0, 1] in x and z, two triangles
+  each, as a triangle soup*/
+static list_vector3_t bench_terrain(size_t size) {
+	vector3_t *grid = (vector3_t *)malloc(sizeof(vector3_t) * size * size);
+	for (size_t z = 0; z < size; z++) {
+		for (size_t x = 0; x < size; x++) {
+			float fx = (float)x / (float)(size - 1), fz = (float)z / (float)(size - 1);
+			grid[z * size + x] = (vector3_t){ fx, bench_height(fx, fz), fz };
+		}
+	}
+	list_vector3_t soup = list_vector3_t_alloc();
+	for (size_t z = 0; z + 1 < size; z++) {
+		for (size_t x = 0; x + 1 < size; x++) {
+			vector3_t *q = grid + z * size + x;
+			list_vector3_t_add(&soup, q[0]);
+			list_vector3_t_add(&soup, q[size]);
+			list_vector3_t_add(&soup, q[1]);
+			list_vector3_t_add(&soup, q[1]);
+			list_vector3_t_add(&soup, q[size]);
+			list_vector3_t_add(&soup, q[size + 1]);
+		}
+	}
+	free(grid);
+	return soup;
+}
+
+static list_bvh_ray bench_camera_rays(void) {
+	list_bvh_ray rays = list_bvh_ray_alloc();
+	vector3_t origin = { 0.5f, 0.35f, -0.25f };
+	for (int y = 0; y < BENCH_IMAGE; y++) {
+		for (int x = 0; x < BENCH_IMAGE; x++) {
+			float u = (float)x / BENCH_IMAGE - 0.5f, v = (float)y / BENCH_IMAGE - 0.5f;
+			vector3_t direction = { u, -0.45f + v * 0.8f, 0.9f };
+			list_bvh_ray_add(&rays, (bvh_ray){ origin, direction, INFINITY });
+		}
+	}
+	return rays;
+}
+
+static list_bvh_ray bench_random_rays(void) {
+	list_bvh_ray rays = list_bvh_ray_alloc();
+	for (int i = 0; i < BENCH_IMAGE * BENCH_IMAGE; i++) {
+		vector3_t origin = { 0.5f + bench_random(1.0f), 0.1f + bench_random(0.1f), 0.5f + bench_random(1.0f) };
+		vector3_t direction = { bench_random(2.0f), bench_random(2.0f), bench_random(2.0f) };
+		list_bvh_ray_add(&rays, (bvh_ray){ origin, direction, INFINITY });
+	}
+	return rays;
+}
+
+/*The loop the tree replaces. "t" gets the closest hit, or t_max on a miss.*/
+static bool bench_brute(const list_vector3_t *soup, const bvh_ray *ray, bool any, float *t) {
+	float best = ray->t_max;
+	bool found = false;
+	for (size_t i = 0; i + 2 < soup->length; i += 3) {
+		vector3_t v0 = soup->array[i];
+		vector3_t e1 = vector3_subtract(soup->array[i + 1], v0), e2 = vector3_subtract(soup->array[i + 2], v0);
+		vector3_t p = vector3_cross(ray->direction, e2);
+		float inverse = 1.0f / vector3_dot(e1, p);
+		vector3_t s = vector3_subtract(ray->origin, v0);
+		float u = vector3_dot(s, p) * inverse;
+		vector3_t q = vector3_cross(s, e1);
+		float v = vector3_dot(ray->direction, q) * inverse;
+		float t = vector3_dot(e2, q) * inverse;
+		if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > 0.0f && t < best) {
+			best = t;
+			found = true;
+			if (any)
+				break;
+		}
+	}
+	*t = best;
+	return found;
+}
+
+/*The brute force sample, spread over the whole set*/
+static const bvh_ray *bench_sample(const list_bvh_ray *rays, size_t i) {
+	return &rays->array[i * (rays->length / BENCH_BRUTE_RAYS)];
+}
+
+/*Compares every method against the brute force loop on the sample.
+  Returns false after reporting the first ray that differs.*/
+static bool bench_check(const list_vector3_t *soup, const bvh *b, const list_bvh_ray *rays,
+		const char *set_name, thread_pool *pool) {
+	list_bvh_hit hits = list_bvh_hit_alloc();
+	list_uint8_t occluded = list_uint8_t_alloc();
+	bvh_intersect_rays(b, rays, &hits, pool);
+	bvh_occluded_rays(b, rays, &occluded, pool);
+	bool ok = true;
+	for (size_t i = 0; i < BENCH_BRUTE_RAYS && ok; i++) {
+		const bvh_ray *ray = bench_sample(rays, i);
+		size_t index = (size_t)(ray - rays->array);
+		float t;
+		bool found = bench_brute(soup, ray, false, &t);
+		bvh_hit single = { ray->t_max, 0.0f, 0.0f, BVH_NONE };
+		bool single_found = bvh_intersect(b, *ray, &single);
+		const bvh_hit *packet = &hits.array[index];
+		bool single_any = bvh_occluded(b, *ray), packet_any = occluded.array[index] != 0;
+		ok = single_found == found && single.t == t && (packet->triangle != BVH_NONE) == found &&
+			packet->t == t && single_any == found && packet_any == found;
+		if (!ok)
+			fprintf(stderr, "%s ray %zu: brute force t %g, bvh_intersect t %g, bvh_intersect_rays t %g, "
+					"any hit brute force %d, bvh_occluded %d, bvh_occluded_rays %d\n", set_name, index,
+					(double)t, (double)single.t, (double)packet->t, found, single_any, packet_any);
+	}
+	list_bvh_hit_free(&hits);
+	list_uint8_t_free(&occluded);
+	return ok;
+}
+
+typedef enum { BENCH_BRUTE, BENCH_SINGLE, BENCH_PACKET } bench_method;
+
+/*Returns nanoseconds per ray and the number of rays that hit*/
+static double bench_trace(const list_vector3_t *soup, const bvh *b, const list_bvh_ray *rays,
+		bench_method method, bool any, thread_pool *pool, size_t *hit_count) {
+	list_bvh_hit hits = list_bvh_hit_alloc();
+	list_uint8_t occluded = list_uint8_t_alloc();
+	size_t count = method == BENCH_BRUTE ? BENCH_BRUTE_RAYS : rays->length;
+	size_t iterations = 0;
+	double start = bench_now(), elapsed;
+	do {
+		size_t n = 0;
+		if (method == BENCH_PACKET) {
+			n = any ? bvh_occluded_rays(b, rays, &occluded, pool) : bvh_intersect_rays(b, rays, &hits, pool);
+		} else {
+			for (size_t i = 0; i < count; i++) {
+				const bvh_ray *ray = method == BENCH_BRUTE ? bench_sample(rays, i) : &rays->array[i];
+				bvh_hit hit;
+				float t;
+				if (method == BENCH_BRUTE)
+					n += bench_brute(soup, ray, any, &t);
+				else
+					n += any ? bvh_occluded(b, *ray) : bvh_intersect(b, *ray, &hit);
+			}
+		}
+		*hit_count = n;
+		iterations++;
+		elapsed = bench_now() - start;
+	} while (elapsed < BENCH_MIN_SECONDS);
+	list_bvh_hit_free(&hits);
+	list_uint8_t_free(&occluded);
+	return elapsed * 1e9 / ((double)iterations * (double)count);
+}
+
+int main(void) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	thread_pool *pool = cpus > 1 ? thread_pool_alloc((size_t)cpus - 1) : NULL;
+	size_t threads = thread_pool_thread_count(pool);
+
+	static const size_t sizes[] = { 225, 708 };
+	list_vector3_t soup = list_vector3_t_alloc();
+	bvh b;
+	memset(&b, 0, sizeof(b));
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		list_vector3_t_free(&soup);
+		soup = bench_terrain(sizes[s]);
+		double times[2];
+		for (int parallel = 0; parallel < 2; parallel++) {
+			size_t iterations = 0;
+			double start = bench_now(), elapsed;
+			do {
+				bvh_free(&b);
+				b = bvh_build(&soup, parallel ? pool : NULL);
+				iterations++;
+				elapsed = bench_now() - start;
+			} while (elapsed < BENCH_MIN_SECONDS);
+			times[parallel] = elapsed * 1e3 / (double)iterations;
+		}
+		size_t triangles = soup.length / 3;
+		printf("{\"op\":\"build\",\"triangles\":%zu,\"nodes\":%zu,\"serial_ms\":%.2f,\"parallel_ms\":%.2f,"
+				"\"threads\":%zu,\"mtris_per_s\":%.2f}\n", triangles, b.node_count, times[0], times[1], threads,
+				(double)triangles / (times[1] * 1e3));
+		fprintf(stderr, "build %8zu triangles  %8zu nodes  serial %8.2f ms  %zu threads %8.2f ms\n",
+				triangles, b.node_count, times[0], threads, times[1]);
+	}
+
+	static const char *const set_names[] = { "camera", "random" };
+	static const char *const method_names[] = { "brute", "single", "packet" };
+	list_bvh_ray sets[2] = { bench_camera_rays(), bench_random_rays() };
+	for (int set = 0; set < 2; set++) {
+		if (!bench_check(&soup, &b, &sets[set], set_names[set], pool))
+			return 1;
+		for (int any = 0; any < 2; any++) {
+			double brute_ns = 0.0;
+			for (int method = BENCH_BRUTE; method <= BENCH_PACKET; method++) {
+				size_t hit_count = 0;
+				double ns = bench_trace(&soup, &b, &sets[set], (bench_method)method, any, pool, &hit_count);
+				size_t count = method == BENCH_BRUTE ? BENCH_BRUTE_RAYS : sets[set].length;
+				if (method == BENCH_BRUTE)
+					brute_ns = ns;
+				printf("{\"op\":\"%s\",\"rays\":\"%s\",\"method\":\"%s\",\"triangles\":%zu,\"ns_per_ray\":%.1f,"
+						"\"mrays_per_s\":%.3f,\"hit_share\":%.3f,\"threads\":%zu,\"speedup\":%.1f}\n",
+						any ? "any_hit" : "closest_hit", set_names[set], method_names[method], soup.length / 3, ns,
+						1e3 / ns, (double)hit_count / (double)count, method == BENCH_PACKET ? threads : 1,
+						brute_ns / ns);
+				fprintf(stderr, "%-11s %-6s %-6s %12.1f ns/ray %9.3f Mrays/s  hit %5.1f%%  x%.1f\n",
+						any ? "any hit" : "closest hit", set_names[set], method_names[method], ns, 1e3 / ns,
+						100.0 * (double)hit_count / (double)count, brute_ns / ns);
+			}
+		}
+	}
+
+	list_bvh_ray_free(&sets[0]);
+	list_bvh_ray_free(&sets[1]);
+	thread_pool_free(pool);
+	bvh_free(&b);
+	list_vector3_t_free(&soup);
+	return 0;
+}
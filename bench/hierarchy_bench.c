@@ -0,0 +1,167 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Transform hierarchy benchmark.
+
+  Builds a seeded scene of 100K nodes (1000 roots, random depth up to 8)
+  and times one frame's world transform update two ways: the full
+  recompute of every world matrix4_t with matrix4_multiply() in parent
+  order, and hierarchy_update() after moving a given fraction of the
+  nodes. "recomputed" is the share of world transforms hierarchy_update()
+  actually rebuilt, which includes the descendants of moved nodes.
+
+  One JSON object per dirty fraction is written to stdout, a readable
+  table is written to stderr:
+
+    make -C bench hierarchy && ./bench/hierarchy_bench > bench_output.txt*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BLIB_IMPLEMENTATION
+#include "../blib_hierarchy.h"
+
+#define BENCH_NODES (100000)
+#define BENCH_ROOTS (1000)
+#define BENCH_MIN_SECONDS (0.3)
+
+static double bench_now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static uint64_t bench_seed = 0x2545F4914F6CDD1Dull;
+
+static uint32_t bench_random_below(uint32_t n) {
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 7;
+	bench_seed ^= bench_seed << 17;
+	return (uint32_t)((bench_seed >> 32) % n);
+}
+
+static float bench_random(float range) {
+	return ((float)bench_random_below(1u << 24) / 16777216.0f - 0.5f) * range;
+}
+
+typedef struct {
+	uint32_t *parent;
+	uint32_t *depth;
+	vector3_t *position;
+	quaternion_t *rotation;
+	matrix4_t *world;
+} bench_scene;
+
+/*What a frame costs without the hierarchy: every local matrix rebuilt and
+  every world matrix recomputed, parents first since nodes are created
+  after their parents*/
+static void bench_full(bench_scene *s) {
+	for (size_t i = 0; i < BENCH_NODES; i++) {
+		matrix4_t local = matrix4_multiply(quaternion_to_matrix4(s->rotation[i]),
+			matrix4_translate(s->position[i]));
+		s->world[i] = s->parent[i] == HIERARCHY_NONE ? local : matrix4_multiply(local, s->world[s->parent[i]]);
+	}
+}
+
+static void bench_frame(hierarchy *h, bench_scene *s, double fraction, thread_pool *pool, size_t *recomputed) {
+	size_t moves = (size_t)(fraction * BENCH_NODES);
+	for (size_t k = 0; k < moves; k++) {
+		uint32_t i = bench_random_below(BENCH_NODES);
+		s->position[i].x += 0.01f;
+		hierarchy_set_position(h, i, s->position[i]);
+	}
+	*recomputed += hierarchy_update(h, pool);
+}
+
+int main(void) {
+	bench_scene s;
+	s.parent = (uint32_t *)malloc(sizeof(uint32_t) * BENCH_NODES);
+	s.depth = (uint32_t *)malloc(sizeof(uint32_t) * BENCH_NODES);
+	s.position = (vector3_t *)malloc(sizeof(vector3_t) * BENCH_NODES);
+	s.rotation = (quaternion_t *)malloc(sizeof(quaternion_t) * BENCH_NODES);
+	s.world = (matrix4_t *)malloc(sizeof(matrix4_t) * BENCH_NODES);
+
+	hierarchy h = hierarchy_alloc();
+	for (uint32_t i = 0; i < BENCH_NODES; i++) {
+		uint32_t parent = HIERARCHY_NONE;
+		if (i >= BENCH_ROOTS) {
+			do {
+				parent = bench_random_below(i);
+			} while (s.depth[parent] >= 7);
+		}
+		s.parent[i] = parent;
+		s.depth[i] = parent == HIERARCHY_NONE ? 0 : s.depth[parent] + 1;
+		s.position[i] = (vector3_t){ bench_random(10.0f), bench_random(10.0f), bench_random(10.0f) };
+		s.rotation[i] = quaternion_normalize((quaternion_t){ bench_random(1.0f), bench_random(1.0f),
+			bench_random(1.0f), bench_random(1.0f) });
+		hierarchy_add(&h, parent, s.position[i], s.rotation[i], vector3_one(1.0f));
+	}
+	hierarchy_update(&h, NULL);
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	thread_pool *pool = cpus > 1 ? thread_pool_alloc((size_t)cpus - 1) : NULL;
+
+	size_t iterations = 0;
+	double start = bench_now(), elapsed;
+	do {
+		bench_full(&s);
+		iterations++;
+		elapsed = bench_now() - start;
+	} while (elapsed < BENCH_MIN_SECONDS);
+	double full_ms = elapsed * 1e3 / (double)iterations;
+
+	static const double fractions[] = { 0.0, 0.001, 0.01, 0.1, 1.0 };
+	for (size_t f = 0; f < sizeof(fractions) / sizeof(fractions[0]); f++) {
+		size_t recomputed = 0;
+		iterations = 0;
+		start = bench_now();
+		do {
+			bench_frame(&h, &s, fractions[f], pool, &recomputed);
+			iterations++;
+			elapsed = bench_now() - start;
+		} while (elapsed < BENCH_MIN_SECONDS);
+		double ms = elapsed * 1e3 / (double)iterations;
+		double share = (double)recomputed / ((double)iterations * BENCH_NODES);
+		printf("{\"nodes\":%d,\"moved\":%.3f,\"recomputed\":%.4f,\"full_ms\":%.4f,\"hierarchy_ms\":%.4f,"
+				"\"threads\":%zu,\"speedup\":%.2f}\n", BENCH_NODES, fractions[f], share, full_ms, ms,
+				thread_pool_thread_count(pool), full_ms / ms);
+		fprintf(stderr, "moved %6.1f%%  recomputed %6.2f%%  full %8.3f ms  hierarchy %8.3f ms  x%7.2f\n",
+				fractions[f] * 100.0, share * 100.0, full_ms, ms, full_ms / ms);
+	}
+
+	thread_pool_free(pool);
+	hierarchy_free(&h);
+	free(s.parent);
+	free(s.depth);
+	free(s.position);
+	free(s.rotation);
+	free(s.world);
+	return 0;
+}
@@ -0,0 +1,368 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*JSON throughput benchmark.
+
+  Generates a fixed corpus (the generator is seeded, so every run and every
+  release sees byte identical documents) and times json_parse, json_read,
+  json_free, json_parse_views and json_parse_ndjson over it.
+
+  One JSON object per measurement is written to stdout, a readable table is
+  written to stderr:
+
+    make -C bench json && ./bench/json_bench > bench_output.txt
+
+  Allocation counts come from routing the library's malloc/realloc calls
+  through counting wrappers. Every operation on every shape runs in its
+  own child process, so its peak RSS from getrusage() covers that shape
+  and operation only.*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/*Pool workers allocate while json_parse_ndjson() runs, so the count is
+  atomic*/
+static size_t bench_allocations = 0;
+
+static size_t bench_allocation_count(void) {
+	return __atomic_load_n(&bench_allocations, __ATOMIC_RELAXED);
+}
+
+static void *bench_malloc(size_t size) {
+	__atomic_fetch_add(&bench_allocations, 1, __ATOMIC_RELAXED);
+	return malloc(size);
+}
+
+static void *bench_realloc(void *p, size_t size) {
+	__atomic_fetch_add(&bench_allocations, 1, __ATOMIC_RELAXED);
+	return realloc(p, size);
+}
+
+static void *bench_calloc(size_t count, size_t size) {
+	__atomic_fetch_add(&bench_allocations, 1, __ATOMIC_RELAXED);
+	return calloc(count, size);
+}
+
+#define malloc bench_malloc
+#define realloc bench_realloc
+#define calloc bench_calloc
+#define BLIB_IMPLEMENTATION
+#include "../blib_json.h"
+#undef malloc
+#undef realloc
+#undef calloc
+
+#define BENCH_DOCUMENT_SIZE (4 * 1024 * 1024 /* bytes */)
+#define BENCH_MIN_SECONDS (0.5)
+
+static double bench_now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static long bench_peak_rss_kb(void) {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
+
+static uint64_t bench_seed = 0x2545F4914F6CDD1Dull;
+
+static uint32_t bench_random(void) {
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 7;
+	bench_seed ^= bench_seed << 17;
+	return (uint32_t)(bench_seed >> 16);
+}
+
+static void bench_append(list_char *text, const char *s) {
+	while (*s)
+		list_char_add(text, *s++);
+}
+
+static void bench_number(list_char *text) {
+	char number[48];
+	switch (bench_random() % 3) {
+		case 0: sprintf(number, "%u", bench_random()); break;
+		case 1: sprintf(number, "-%u.%03u", bench_random() % 100000, bench_random() % 1000); break;
+		default: sprintf(number, "%.6e", (double)bench_random() * 1e-3); break;
+	}
+	bench_append(text, number);
+}
+
+static void bench_string(list_char *text, size_t length) {
+	static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+	list_char_add(text, '\"');
+	for (size_t i = 0; i < length; i++) {
+		uint32_t r = bench_random();
+		if (r % 64 == 0)
+			bench_append(text, r & 64 ? "\\n" : "\\\"");
+		else
+			list_char_add(text, alphabet[r % (sizeof(alphabet) - 1)]);
+	}
+	list_char_add(text, '\"');
+}
+
+static void bench_corpus_numbers(list_char *text) {
+	list_char_add(text, '[');
+	while (text->length < BENCH_DOCUMENT_SIZE) {
+		bench_number(text);
+		list_char_add(text, ',');
+	}
+	bench_append(text, "0]");
+}
+
+static void bench_corpus_strings(list_char *text) {
+	list_char_add(text, '[');
+	while (text->length < BENCH_DOCUMENT_SIZE) {
+		bench_append(text, "{\"name\":");
+		bench_string(text, 8 + bench_random() % 24);
+		bench_append(text, ",\"description\":");
+		bench_string(text, 64 + bench_random() % 192);
+		bench_append(text, "},");
+	}
+	bench_append(text, "{}]");
+}
+
+static void bench_corpus_nested(list_char *text) {
+	list_char_add(text, '[');
+	while (text->length < BENCH_DOCUMENT_SIZE) {
+		size_t depth = 16 + bench_random() % 240;
+		for (size_t i = 0; i < depth; i++)
+			bench_append(text, i & 1 ? "[" : "{\"child\":");
+		bench_number(text);
+		for (size_t i = depth; i-- > 0;)
+			bench_append(text, i & 1 ? "]" : "}");
+		list_char_add(text, ',');
+	}
+	bench_append(text, "null]");
+}
+
+static void bench_corpus_wide(list_char *text) {
+	char key[32];
+	size_t i = 0;
+	list_char_add(text, '{');
+	while (text->length < BENCH_DOCUMENT_SIZE) {
+		sprintf(key, "\"key_%zu\":", i++);
+		bench_append(text, key);
+		switch (bench_random() % 4) {
+			case 0: bench_number(text); break;
+			case 1: bench_string(text, 4 + bench_random() % 12); break;
+			case 2: bench_append(text, bench_random() & 1 ? "true" : "false"); break;
+			default: bench_append(text, "null"); break;
+		}
+		list_char_add(text, ',');
+	}
+	bench_append(text, "\"end\":0}");
+}
+
+static void bench_corpus_ndjson(list_char *text) {
+	size_t id = 0;
+	char number[32];
+	while (text->length < BENCH_DOCUMENT_SIZE) {
+		sprintf(number, "%zu", id++);
+		bench_append(text, "{\"id\":");
+		bench_append(text, number);
+		bench_append(text, ",\"user\":");
+		bench_string(text, 6 + bench_random() % 10);
+		bench_append(text, ",\"score\":");
+		bench_number(text);
+		bench_append(text, ",\"tags\":[\"a\",\"b\",\"c\"],\"active\":true}\n");
+	}
+}
+
+typedef struct {
+	const char *name;
+	void (*generate)(list_char *text);
+} bench_shape;
+
+static void bench_report(const char *shape, const char *op, size_t bytes,
+		size_t iterations, double seconds, size_t allocations) {
+	double mb_per_s = (double)bytes * (double)iterations / seconds / (1024.0 * 1024.0);
+	double allocations_per_document = (double)allocations / (double)iterations;
+	long peak_rss_kb = bench_peak_rss_kb();
+	printf("{\"shape\":\"%s\",\"op\":\"%s\",\"bytes\":%zu,\"iterations\":%zu,"
+			"\"seconds\":%.6f,\"mb_per_s\":%.2f,\"allocations_per_document\":%.1f,"
+			"\"peak_rss_kb\":%ld}\n",
+			shape, op, bytes, iterations, seconds, mb_per_s, allocations_per_document, peak_rss_kb);
+	fprintf(stderr, "%-8s %-12s %10.2f MB/s %14.1f allocs/doc %10ld KB peak rss\n",
+			shape, op, mb_per_s, allocations_per_document, peak_rss_kb);
+	fflush(stdout);
+}
+
+static void bench_parse(const char *shape, list_char *text) {
+	size_t bytes = text->length - 1; // the generators leave a NUL in the list
+	size_t iterations = 0;
+	double parse_seconds = 0.0, free_seconds = 0.0;
+	size_t parse_allocations = 0;
+
+	while (parse_seconds < BENCH_MIN_SECONDS) {
+		size_t before = bench_allocation_count();
+		double t0 = bench_now();
+		json_value *json = json_parse(text->array, bytes);
+		double t1 = bench_now();
+		parse_allocations += bench_allocation_count() - before;
+		json_free(json);
+		double t2 = bench_now();
+		parse_seconds += t1 - t0;
+		free_seconds += t2 - t1;
+		iterations++;
+	}
+	bench_report(shape, "json_parse", bytes, iterations, parse_seconds, parse_allocations);
+	bench_report(shape, "json_free", bytes, iterations, free_seconds, 0);
+}
+
+static void bench_views(const char *shape, list_char *text) {
+	size_t bytes = text->length - 1;
+	memory_arena arena = memory_arena_alloc(0);
+	double views_seconds = 0.0;
+	size_t views_allocations = 0;
+	size_t iterations = 0;
+	while (views_seconds < BENCH_MIN_SECONDS) {
+		size_t before = bench_allocation_count();
+		double t0 = bench_now();
+		json_parse_views(text->array, bytes, &arena);
+		views_seconds += bench_now() - t0;
+		views_allocations += bench_allocation_count() - before;
+		memory_arena_reset(&arena);
+		iterations++;
+	}
+	memory_arena_free(&arena);
+	bench_report(shape, "parse_views", bytes, iterations, views_seconds, views_allocations);
+}
+
+static void bench_read(const char *shape, list_char *text, const char *path) {
+	size_t bytes = text->length - 1;
+	FILE *file = fopen(path, "wb");
+	if (file == NULL || fwrite(text->array, 1, bytes, file) != bytes) {
+		fprintf(stderr, "failed to write %s\n", path);
+		if (file)
+			fclose(file);
+		return;
+	}
+	fclose(file);
+	double read_seconds = 0.0;
+	size_t read_allocations = 0;
+	size_t iterations = 0;
+	while (read_seconds < BENCH_MIN_SECONDS) {
+		size_t before = bench_allocation_count();
+		double t0 = bench_now();
+		json_value *json = json_read(path);
+		read_seconds += bench_now() - t0;
+		read_allocations += bench_allocation_count() - before;
+		json_free(json);
+		iterations++;
+	}
+	remove(path);
+	bench_report(shape, "json_read", bytes, iterations, read_seconds, read_allocations);
+}
+
+static void bench_ndjson(const char *shape, list_char *text, thread_pool *pool, const char *op) {
+	size_t bytes = text->length - 1;
+	double seconds = 0.0;
+	size_t allocations = 0;
+	size_t iterations = 0;
+	while (seconds < BENCH_MIN_SECONDS) {
+		size_t before = bench_allocation_count();
+		double t0 = bench_now();
+		json_batch batch = json_parse_ndjson(text->array, bytes, pool);
+		seconds += bench_now() - t0;
+		allocations += bench_allocation_count() - before;
+		json_batch_free(&batch);
+		iterations++;
+	}
+	bench_report(shape, op, bytes, iterations, seconds, allocations);
+}
+
+/*Generates the corpus of "shape" and runs "op" over it in a child
+  process. The parent never holds a corpus, so the child starts from a
+  small RSS.*/
+static void bench_run(const bench_shape *shape, const char *op, const char *path) {
+	fflush(stdout);
+	fflush(stderr);
+	pid_t child = fork();
+	if (child < 0) {
+		fprintf(stderr, "fork failed, skipping %s %s\n", shape->name, op);
+		return;
+	}
+	if (child > 0) {
+		int status;
+		if (waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			fprintf(stderr, "%s %s failed\n", shape->name, op);
+		return;
+	}
+
+	list_char text;
+	memset(&text, 0, sizeof(list_char));
+	shape->generate(&text);
+	list_char_add(&text, '\0');
+	if (strcmp(op, "json_parse") == 0) {
+		bench_parse(shape->name, &text);
+	} else if (strcmp(op, "parse_views") == 0) {
+		bench_views(shape->name, &text);
+	} else if (strcmp(op, "json_read") == 0) {
+		bench_read(shape->name, &text, path);
+	} else if (strcmp(op, "ndjson_1t") == 0) {
+		bench_ndjson(shape->name, &text, NULL, op);
+	} else {
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		thread_pool *pool = thread_pool_alloc(cores > 1 ? (size_t)cores - 1 : 0);
+		bench_ndjson(shape->name, &text, pool, op);
+		thread_pool_free(pool);
+	}
+	list_char_free(&text);
+	exit(0);
+}
+
+int main(int argc, char **argv) {
+	const char *path = argc > 1 ? argv[1] : "json_bench.tmp";
+	const bench_shape shapes[] = {
+		{ "numbers", bench_corpus_numbers },
+		{ "strings", bench_corpus_strings },
+		{ "nested", bench_corpus_nested },
+		{ "wide", bench_corpus_wide },
+		{ "ndjson", bench_corpus_ndjson },
+	};
+	for (size_t i = 0; i < sizeof(shapes) / sizeof(shapes[0]); i++) {
+		bench_run(&shapes[i], "json_parse", path);
+		bench_run(&shapes[i], "parse_views", path);
+		bench_run(&shapes[i], "json_read", path);
+		if (strcmp(shapes[i].name, "ndjson") == 0) {
+			bench_run(&shapes[i], "ndjson_1t", path);
+			bench_run(&shapes[i], "ndjson_mt", path);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,281 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Array kernel check.
+
+  Compares blib_math_array.h with the scalar helpers in blib_math.h element
+  by element. Every kernel runs through the public function, which picks
+  the best level the CPU has, and through each level directly: plain C,
+  SSE4.1 and AVX2 as far as the CPU has them.
+
+  The input mixes seeded values with NaN, infinities, signed zeros,
+  subnormals and values that overflow. Each call runs for every length from
+  0 to CHECK_MAX_LENGTH and once for a long array. It runs at every input and
+  output offset from 0 to 8 floats past a 32 byte boundary, out of place and
+  in place. Results must match bit for bit, except that any NaN matches any
+  NaN. The floats around the output must not change.
+
+  Prints one line per kernel and level and exits with 1 on any mismatch:
+
+    make -C bench math_array && ./bench/math_array_check*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// sigmoid() only matches sigmoid_array() bit for bit with fast_powf().
+#define BLIB_FAST_MATH
+#define BLIB_IMPLEMENTATION
+#include "../blib_math_array.h"
+
+#define CHECK_MAX_LENGTH (67)
+#define CHECK_LONG_LENGTH (1000)
+#define CHECK_MAX_OFFSET (8)
+#define CHECK_GUARD (16)
+#define CHECK_POOL (CHECK_LONG_LENGTH + 2 * CHECK_GUARD + CHECK_MAX_OFFSET + 8)
+
+/*clamp01_array() has no job of its own, it runs MATH_ARRAY_CLAMP*/
+#define CHECK_CLAMP01 (MATH_ARRAY_SIGMOID + 1)
+
+typedef struct {
+	const char *name;
+	int op;
+	float p[4];
+} check_case;
+
+static const check_case check_cases[] = {
+	{ "lerp", MATH_ARRAY_LERP, { 0.25f, 0.0f, 0.0f, 0.0f } },
+	{ "lerp", MATH_ARRAY_LERP, { -3.0f, 0.0f, 0.0f, 0.0f } },
+	{ "clamp", MATH_ARRAY_CLAMP, { -10.0f, 25.0f, 0.0f, 0.0f } },
+	{ "clamp", MATH_ARRAY_CLAMP, { 5.0f, -5.0f, 0.0f, 0.0f } },
+	{ "clamp01", CHECK_CLAMP01, { 0.0f, 1.0f, 0.0f, 0.0f } },
+	{ "map", MATH_ARRAY_MAP, { -100.0f, 100.0f, 0.0f, 1.0f } },
+	{ "map", MATH_ARRAY_MAP, { 3.0f, 3.0f, -1.0f, 1.0f } },
+	{ "norm", MATH_ARRAY_NORM, { -50.0f, 150.0f, 0.0f, 0.0f } },
+	{ "norm", MATH_ARRAY_NORM, { 7.0f, 7.0f, 0.0f, 0.0f } },
+	{ "loop", MATH_ARRAY_LOOP, { 360.0f, 0.0f, 0.0f, 0.0f } },
+	{ "loop", MATH_ARRAY_LOOP, { 0.1f, 0.0f, 0.0f, 0.0f } },
+	{ "loop", MATH_ARRAY_LOOP, { -2.5f, 0.0f, 0.0f, 0.0f } },
+	{ "pingpong", MATH_ARRAY_PINGPONG, { 1.0f, 0.0f, 0.0f, 0.0f } },
+	{ "pingpong", MATH_ARRAY_PINGPONG, { 90.0f, 0.0f, 0.0f, 0.0f } },
+	{ "sigmoid", MATH_ARRAY_SIGMOID, { 0.0f, 0.0f, 0.0f, 0.0f } },
+};
+
+#define CHECK_CASE_COUNT (sizeof(check_cases) / sizeof(check_cases[0]))
+
+enum { CHECK_PUBLIC = -1, CHECK_SCALAR = 0, CHECK_SSE41 = 1, CHECK_AVX2 = 2, CHECK_LEVEL_COUNT = 3 };
+
+static const char *check_level_names[CHECK_LEVEL_COUNT] = { "scalar", "sse4.1", "avx2" };
+
+static uint64_t check_seed = 0x2545F4914F6CDD1Dull;
+
+static uint32_t check_random(void) {
+	check_seed ^= check_seed << 13;
+	check_seed ^= check_seed >> 7;
+	check_seed ^= check_seed << 17;
+	return (uint32_t)(check_seed >> 32);
+}
+
+/*Seeded values in [-1000, 1000) with the special values mixed in*/
+static void check_fill(float *pool, size_t count) {
+	static const float special[] = {
+		NAN, -NAN, INFINITY, -INFINITY, 0.0f, -0.0f, 1e-40f, -1e-40f, 3e38f, -3e38f,
+		1.0f, -1.0f, 360.0f, -720.0f, 0.1f, 100.0f
+	};
+	for (size_t i = 0; i < count; i++) {
+		uint32_t r = check_random();
+		if (r % 5 == 0)
+			pool[i] = special[(r >> 8) % (sizeof(special) / sizeof(special[0]))];
+		else
+			pool[i] = ((float)(r >> 8) / 16777216.0f - 0.5f) * 2000.0f;
+	}
+}
+
+static float *check_aligned(float *raw) {
+	return (float *)(((uintptr_t)raw + 31) & ~(uintptr_t)31);
+}
+
+static float check_reference(const check_case *c, float a, float b) {
+	const float *p = c->p;
+	switch (c->op) {
+		case MATH_ARRAY_LERP: return lerp(a, b, p[0]);
+		case MATH_ARRAY_CLAMP: return clamp(a, p[0], p[1]);
+		case CHECK_CLAMP01: return clamp01(a);
+		case MATH_ARRAY_MAP: return map(a, p[0], p[1], p[2], p[3]);
+		case MATH_ARRAY_NORM: return norm(a, p[0], p[1]);
+		case MATH_ARRAY_LOOP: return loop(a, p[0]);
+		case MATH_ARRAY_PINGPONG: return pingpong(a, p[0]);
+		case MATH_ARRAY_SIGMOID: return sigmoid(a);
+	}
+	return 0.0f;
+}
+
+static void check_public(const check_case *c, const float *a, const float *b, float *out, size_t count) {
+	const float *p = c->p;
+	switch (c->op) {
+		case MATH_ARRAY_LERP: lerp_array(a, b, p[0], out, count); break;
+		case MATH_ARRAY_CLAMP: clamp_array(a, out, count, p[0], p[1]); break;
+		case CHECK_CLAMP01: clamp01_array(a, out, count); break;
+		case MATH_ARRAY_MAP: map_array(a, out, count, p[0], p[1], p[2], p[3]); break;
+		case MATH_ARRAY_NORM: norm_array(a, out, count, p[0], p[1]); break;
+		case MATH_ARRAY_LOOP: loop_array(a, out, count, p[0]); break;
+		case MATH_ARRAY_PINGPONG: pingpong_array(a, out, count, p[0]); break;
+		case MATH_ARRAY_SIGMOID: sigmoid_array(a, out, count); break;
+	}
+}
+
+/*Same split as math_array_run(), but with the level forced*/
+static void check_level(const check_case *c, int level, float log_e, const float *a, const float *b,
+		float *out, size_t count) {
+	math_array_job job = { c->op == CHECK_CLAMP01 ? MATH_ARRAY_CLAMP : c->op, a, b, out,
+		{ c->p[0], c->p[1], c->p[2], c->p[3] } };
+	if (c->op == MATH_ARRAY_SIGMOID)
+		job.p[0] = log_e;
+	size_t i = 0;
+#ifdef BLIB_MATH_ARRAY_X86
+	if (level != CHECK_SCALAR) {
+		size_t width = level == CHECK_AVX2 ? 8 : 4;
+		size_t misaligned = ((uintptr_t)out / sizeof(float)) & (width - 1);
+		size_t head = misaligned ? width - misaligned : 0;
+		if (head < count) {
+			size_t body = (count - head) & ~(width - 1);
+			math_array_scalar(&job, 0, head);
+			if (level == CHECK_AVX2)
+				math_array_avx2(&job, head, head + body);
+			else
+				math_array_sse(&job, head, head + body);
+			i = head + body;
+		}
+	}
+#else
+	(void)level;
+#endif
+	math_array_scalar(&job, i, count);
+}
+
+static int check_same(float x, float y) {
+	return (isnan(x) && isnan(y)) || memcmp(&x, &y, sizeof(x)) == 0;
+}
+
+typedef struct {
+	float *a;
+	float *b;
+	float *out;
+	float *expected;
+	float *input;
+	size_t checked;
+	size_t failures;
+} check_state;
+
+/*Runs one call and compares it. Returns 0 on a mismatch.*/
+static int check_call(check_state *s, const check_case *c, int level, float log_e, size_t in_offset,
+		size_t out_offset, int in_place, size_t count) {
+	const float guard = -12345.5f;
+	float *a = s->a + CHECK_GUARD + in_offset;
+	float *b = s->b + CHECK_GUARD + in_offset;
+	float *out = in_place ? a : s->out + CHECK_GUARD + out_offset;
+	for (size_t i = 0; i < count; i++)
+		s->expected[i] = check_reference(c, a[i], b[i]);
+	memcpy(s->input, a, count * sizeof(float));
+	if (!in_place)
+		for (size_t i = 0; i < count + 2 * CHECK_GUARD; i++)
+			s->out[out_offset + i] = guard;
+	float guard_before = out[-1], guard_after = out[count];
+
+	if (level == CHECK_PUBLIC)
+		check_public(c, a, b, out, count);
+	else
+		check_level(c, level, log_e, a, b, out, count);
+
+	int ok = check_same(out[-1], guard_before) && check_same(out[count], guard_after);
+	size_t bad = count;
+	for (size_t i = 0; i < count && ok; i++)
+		if (!check_same(out[i], s->expected[i])) {
+			ok = 0;
+			bad = i;
+		}
+	s->checked += count;
+	if (!ok && s->failures++ < 10) {
+		fprintf(stderr, "%s(%g, %g, %g, %g) %s: count %zu, offsets %zu/%zu%s",
+				c->name, c->p[0], c->p[1], c->p[2], c->p[3],
+				level == CHECK_PUBLIC ? "public" : check_level_names[level],
+				count, in_offset, out_offset, in_place ? ", in place" : "");
+		if (bad < count)
+			fprintf(stderr, ": f(%.9g) = %.9g, expected %.9g\n", s->input[bad], out[bad], s->expected[bad]);
+		else
+			fprintf(stderr, ": wrote outside the output\n");
+	}
+	// In place calls overwrote the input.
+	if (in_place)
+		memcpy(a, s->input, count * sizeof(float));
+	return ok;
+}
+
+static size_t check_kernel(check_state *s, const check_case *c, int level, float log_e) {
+	size_t failures = s->failures;
+	s->checked = 0;
+	for (size_t length = 0; length <= CHECK_MAX_LENGTH + 1; length++) {
+		size_t count = length > CHECK_MAX_LENGTH ? CHECK_LONG_LENGTH : length;
+		for (size_t in_offset = 0; in_offset <= CHECK_MAX_OFFSET; in_offset++) {
+			for (size_t out_offset = 0; out_offset <= CHECK_MAX_OFFSET; out_offset++)
+				check_call(s, c, level, log_e, in_offset, out_offset, 0, count);
+			check_call(s, c, level, log_e, in_offset, in_offset, 1, count);
+		}
+	}
+	char name[64];
+	snprintf(name, sizeof(name), "%s(%g, %g, %g, %g)", c->name, c->p[0], c->p[1], c->p[2], c->p[3]);
+	printf("%-28s %-7s %8zu elements %s\n", name, level == CHECK_PUBLIC ? "public" : check_level_names[level],
+			s->checked, s->failures == failures ? "ok" : "FAILED");
+	return s->failures - failures;
+}
+
+int main(void) {
+	float *raw[5];
+	for (int i = 0; i < 5; i++)
+		raw[i] = (float *)malloc((CHECK_POOL + 8) * sizeof(float));
+	check_state s = { check_aligned(raw[0]), check_aligned(raw[1]), check_aligned(raw[2]), raw[3], raw[4], 0, 0 };
+	check_fill(s.a, CHECK_POOL);
+	check_fill(s.b, CHECK_POOL);
+
+	int levels = CHECK_SCALAR + 1;
+#ifdef BLIB_MATH_ARRAY_X86
+	int simd = math_array_simd_level();
+	levels = simd == MATH_ARRAY_SIMD_AVX2 ? CHECK_AVX2 + 1 : simd == MATH_ARRAY_SIMD_SSE41 ? CHECK_SSE41 + 1 : levels;
+#endif
+	float log_e = fast_logf((float)2.71828182846);
+	for (size_t i = 0; i < CHECK_CASE_COUNT; i++) {
+		check_kernel(&s, &check_cases[i], CHECK_PUBLIC, log_e);
+		for (int level = CHECK_SCALAR; level < levels; level++)
+			check_kernel(&s, &check_cases[i], level, log_e);
+	}
+	for (int i = 0; i < 5; i++)
+		free(raw[i]);
+	if (s.failures)
+		fprintf(stderr, "%zu calls did not match the scalar helpers\n", s.failures);
+	return s.failures ? 1 : 0;
+}
@@ -0,0 +1,250 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Noise throughput and quality benchmark.
+
+  Times every noise function in blib_math.h and blib_noise.h over the same
+  seeded sample positions and reports samples per second. For each function
+  it also measures simple statistics over those samples:
+  - mean, standard deviation, min and max
+  - correlation between samples one lattice unit apart, which should be
+    close to 0 for a good hash
+
+  The last two rows compare an fbm value plus gradient from four fbm
+  evaluations (finite differences) with noise3_fbm_derivative().
+
+  It then checks the lattice hashes themselves. It runs a chi-square test
+  against a uniform distribution over BENCH_BINS bins, near the origin and
+  far from it. That shows how the sinf() hash behind noise3() breaks down
+  for large coordinates.
+
+  One JSON object per function is written to stdout, a readable table is
+  written to stderr:
+
+    make -C bench noise && ./bench/noise_bench > bench_output.txt*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BLIB_IMPLEMENTATION
+#include "../blib_noise.h"
+
+#define BENCH_SAMPLES (1 << 18)
+#define BENCH_MIN_SECONDS (0.5)
+#define BENCH_BINS (256)
+#define BENCH_HASH_SAMPLES (1 << 20)
+
+static double bench_now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static uint64_t bench_seed = 0x2545F4914F6CDD1Dull;
+
+static float bench_random(float range) {
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 7;
+	bench_seed ^= bench_seed << 17;
+	return ((float)(bench_seed >> 40) / 16777216.0f - 0.5f) * range;
+}
+
+typedef enum {
+	BENCH_NOISE3_FBM,
+	BENCH_NOISE3_FBM_REFERENCE,
+	BENCH_NOISE3_FBM_POINTS,
+	BENCH_NOISE3_FBM_PERLIN,
+	BENCH_NOISE3_FBM_SIMPLEX,
+	BENCH_NOISE3_INTERPOLATED,
+	BENCH_NOISE2_VALUE,
+	BENCH_NOISE3_VALUE,
+	BENCH_NOISE4_VALUE,
+	BENCH_NOISE2_PERLIN,
+	BENCH_NOISE3_PERLIN,
+	BENCH_NOISE4_PERLIN,
+	BENCH_NOISE2_SIMPLEX,
+	BENCH_NOISE3_SIMPLEX,
+	BENCH_NOISE4_SIMPLEX,
+	BENCH_FBM_GRADIENT_DIFFERENCES,
+	BENCH_FBM_GRADIENT_ANALYTIC,
+	BENCH_FUNCTION_COUNT
+} bench_function;
+
+static const char *bench_names[BENCH_FUNCTION_COUNT] = {
+	"noise3_fbm", "noise3_fbm_reference", "noise3_fbm_points", "fbm_of(perlin3)", "fbm_of(simplex3)",
+	"noise3_interpolated", "noise2_value", "noise3_value", "noise4_value",
+	"noise2_perlin", "noise3_perlin", "noise4_perlin",
+	"noise2_simplex", "noise3_simplex", "noise4_simplex",
+	"fbm+gradient(4 calls)", "fbm_derivative",
+};
+
+/*8 octaves of Perlin noise, the gradient either from finite differences
+  or from noise3_fbm_derivative()*/
+static noise_fbm_params bench_fbm;
+static volatile float bench_gradient_sink;
+
+static float bench_fbm_gradient(int analytic, float x, float y, float z) {
+	vector3_t g;
+	float n;
+	if (analytic) {
+		n = noise3_fbm_derivative(&bench_fbm, noise3_perlin_derivative, x, y, z, &g);
+	} else {
+		const float h = 1e-3f;
+		n = noise3_fbm_params(&bench_fbm, noise3_perlin, x, y, z);
+		g.x = (noise3_fbm_params(&bench_fbm, noise3_perlin, x + h, y, z) - n) / h;
+		g.y = (noise3_fbm_params(&bench_fbm, noise3_perlin, x, y + h, z) - n) / h;
+		g.z = (noise3_fbm_params(&bench_fbm, noise3_perlin, x, y, z + h) - n) / h;
+	}
+	bench_gradient_sink = g.x + g.y + g.z;
+	return n;
+}
+
+static float bench_sample(bench_function f, float x, float y, float z, float w) {
+	switch (f) {
+		case BENCH_NOISE3_FBM: return noise3_fbm(x, y, z);
+		case BENCH_NOISE3_FBM_REFERENCE: return noise3_fbm_reference(x, y, z);
+		case BENCH_NOISE3_FBM_POINTS: return noise3_fbm_reference(x, y, z);
+		case BENCH_NOISE3_FBM_PERLIN: return noise3_fbm_of(noise3_perlin, x, y, z);
+		case BENCH_NOISE3_FBM_SIMPLEX: return noise3_fbm_of(noise3_simplex, x, y, z);
+		case BENCH_NOISE3_INTERPOLATED: return noise3_interpolated(x, y, z);
+		case BENCH_NOISE2_VALUE: return noise2_value(x, y);
+		case BENCH_NOISE3_VALUE: return noise3_value(x, y, z);
+		case BENCH_NOISE4_VALUE: return noise4_value(x, y, z, w);
+		case BENCH_NOISE2_PERLIN: return noise2_perlin(x, y);
+		case BENCH_NOISE3_PERLIN: return noise3_perlin(x, y, z);
+		case BENCH_NOISE4_PERLIN: return noise4_perlin(x, y, z, w);
+		case BENCH_NOISE2_SIMPLEX: return noise2_simplex(x, y);
+		case BENCH_NOISE3_SIMPLEX: return noise3_simplex(x, y, z);
+		case BENCH_NOISE4_SIMPLEX: return noise4_simplex(x, y, z, w);
+		case BENCH_FBM_GRADIENT_DIFFERENCES: return bench_fbm_gradient(0, x, y, z);
+		case BENCH_FBM_GRADIENT_ANALYTIC: return bench_fbm_gradient(1, x, y, z);
+		default: return 0.0f;
+	}
+}
+
+/*Fills "out" with one sample per point, the way the timed loop does*/
+static void bench_run(bench_function f, const list_vector3_t *points, const float *w, float *out) {
+	if (f == BENCH_NOISE3_FBM_POINTS) {
+		noise3_fbm_points(points, out);
+		return;
+	}
+	for (size_t i = 0; i < points->length; i++) {
+		const vector3_t p = points->array[i];
+		out[i] = bench_sample(f, p.x, p.y, p.z, w[i]);
+	}
+}
+
+static void bench_function_report(bench_function f, const list_vector3_t *points, const float *w,
+		float *out) {
+	size_t iterations = 0;
+	double seconds = 0.0;
+	while (seconds < BENCH_MIN_SECONDS) {
+		double t0 = bench_now();
+		bench_run(f, points, w, out);
+		seconds += bench_now() - t0;
+		iterations++;
+	}
+	double samples_per_s = (double)points->length * (double)iterations / seconds;
+
+	double sum = 0.0, sum2 = 0.0, correlation = 0.0;
+	float min = out[0], max = out[0];
+	for (size_t i = 0; i < points->length; i++) {
+		sum += out[i];
+		sum2 += (double)out[i] * out[i];
+		min = out[i] < min ? out[i] : min;
+		max = out[i] > max ? out[i] : max;
+	}
+	double n = (double)points->length;
+	double mean = sum / n;
+	double deviation = sqrt(sum2 / n - mean * mean);
+
+	// Correlation with the sample one lattice unit further along x.
+	for (size_t i = 0; i < points->length; i++) {
+		const vector3_t p = points->array[i];
+		float next = bench_sample(f, p.x + 1.0f, p.y, p.z, w[i]);
+		correlation += ((double)out[i] - mean) * ((double)next - mean);
+	}
+	correlation /= n * deviation * deviation;
+
+	printf("{\"function\":\"%s\",\"samples\":%zu,\"iterations\":%zu,\"seconds\":%.6f,"
+			"\"samples_per_s\":%.0f,\"mean\":%.5f,\"stddev\":%.5f,\"min\":%.5f,\"max\":%.5f,"
+			"\"lag1_correlation\":%.5f}\n",
+			bench_names[f], points->length, iterations, seconds, samples_per_s,
+			mean, deviation, min, max, correlation);
+	fprintf(stderr, "%-22s %10.2f Msamples/s  mean %8.4f  sd %7.4f  [%7.3f, %7.3f]  lag1 %7.4f\n",
+			bench_names[f], samples_per_s * 1e-6, mean, deviation, min, max, correlation);
+	fflush(stdout);
+}
+
+/*Chi-square of lattice hash values in [0, 1) over BENCH_BINS bins. With
+  255 degrees of freedom a uniform hash scores about 255, anything above
+  roughly 330 is suspicious at the 1% level.*/
+static void bench_hash_report(const char *hash, int sinf_hash, int32_t origin) {
+	static size_t bins[BENCH_BINS];
+	memset(bins, 0, sizeof(bins));
+	for (int32_t i = 0; i < BENCH_HASH_SAMPLES; i++) {
+		int32_t x = origin + (i & 127), y = origin + ((i >> 7) & 127), z = origin + (i >> 14);
+		float v = sinf_hash ? noise3(x, y, z) : noise3_hash(x, y, z);
+		size_t bin = (size_t)(v * BENCH_BINS);
+		bins[bin < BENCH_BINS ? bin : BENCH_BINS - 1]++;
+	}
+	double expected = (double)BENCH_HASH_SAMPLES / BENCH_BINS, chi_square = 0.0;
+	for (size_t i = 0; i < BENCH_BINS; i++)
+		chi_square += ((double)bins[i] - expected) * ((double)bins[i] - expected) / expected;
+	printf("{\"hash\":\"%s\",\"origin\":%ld,\"samples\":%d,\"bins\":%d,\"chi_square\":%.2f}\n",
+			hash, (long)origin, BENCH_HASH_SAMPLES, BENCH_BINS, chi_square);
+	fprintf(stderr, "%-22s origin %-10ld chi2 %12.2f (uniform ~ %d)\n",
+			hash, (long)origin, chi_square, BENCH_BINS - 1);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+	(void)argc;
+	(void)argv;
+	bench_fbm = noise_fbm_params_make(8, 2.0f, 0.5f, 0.0f);
+	list_vector3_t points = list_vector3_t_alloc();
+	float *w = (float *)malloc(sizeof(float) * BENCH_SAMPLES);
+	float *out = (float *)malloc(sizeof(float) * BENCH_SAMPLES);
+	for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+		vector3_t p = { bench_random(512.0f), bench_random(512.0f), bench_random(512.0f) };
+		list_vector3_t_add(&points, p);
+		w[i] = bench_random(512.0f);
+	}
+	for (int f = 0; f < BENCH_FUNCTION_COUNT; f++)
+		bench_function_report((bench_function)f, &points, w, out);
+	bench_hash_report("noise3", 1, 0);
+	bench_hash_report("noise3", 1, 1000000);
+	bench_hash_report("noise3_hash", 0, 0);
+	bench_hash_report("noise3_hash", 0, 1000000);
+	list_vector3_t_free(&points);
+	free(w);
+	free(out);
+	return 0;
+}
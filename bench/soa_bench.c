@@ -0,0 +1,191 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Structure-of-arrays versus array-of-structs benchmark.
+
+  Runs the same vector3 operations two ways over the same seeded data:
+  the blib_math3d.h per-vector functions in a loop over a list_vector3_t,
+  and the blib_math_soa.h batch kernels over a vector3_soa. Both produce
+  identical results, the benchmark checks that before timing. It runs
+  once with a working set that fits in L1 and once with one that does
+  not.
+
+  One JSON object per operation and size is written to stdout, a readable
+  table is written to stderr:
+
+    make -C bench soa && ./bench/soa_bench > bench_output.txt*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BLIB_IMPLEMENTATION
+#include "../blib_math_soa.h"
+
+#define BENCH_MIN_SECONDS (0.3)
+
+static double bench_now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static uint64_t bench_seed = 0x2545F4914F6CDD1Dull;
+
+static float bench_random(float range) {
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 7;
+	bench_seed ^= bench_seed << 17;
+	return ((float)(bench_seed >> 40) / 16777216.0f - 0.5f) * range;
+}
+
+typedef enum {
+	BENCH_ADD,
+	BENCH_SCALE,
+	BENCH_LERP,
+	BENCH_DOT,
+	BENCH_CROSS,
+	BENCH_NORMALIZE,
+	BENCH_DISTANCE,
+	BENCH_OP_COUNT
+} bench_op;
+
+static const char *bench_names[BENCH_OP_COUNT] = {
+	"add", "scale", "lerp", "dot", "cross", "normalize", "distance"
+};
+
+typedef struct {
+	list_vector3_t a, b, out;
+	vector3_soa sa, sb, sout;
+	float *scalars;
+} bench_data;
+
+static void bench_aos(bench_op op, bench_data *d) {
+	const vector3_t *a = d->a.array, *b = d->b.array;
+	vector3_t *out = d->out.array;
+	size_t n = d->a.length;
+	switch (op) {
+		case BENCH_ADD: for (size_t i = 0; i < n; i++) out[i] = vector3_add(a[i], b[i]); break;
+		case BENCH_SCALE: for (size_t i = 0; i < n; i++) out[i] = vector3_scale(a[i], 1.5f); break;
+		case BENCH_LERP: for (size_t i = 0; i < n; i++) out[i] = vector3_lerp(a[i], b[i], 0.25f); break;
+		case BENCH_DOT: for (size_t i = 0; i < n; i++) d->scalars[i] = vector3_dot(a[i], b[i]); break;
+		case BENCH_CROSS: for (size_t i = 0; i < n; i++) out[i] = vector3_cross(a[i], b[i]); break;
+		case BENCH_NORMALIZE: for (size_t i = 0; i < n; i++) out[i] = vector3_normalize(a[i]); break;
+		case BENCH_DISTANCE: for (size_t i = 0; i < n; i++) d->scalars[i] = vector3_distance(a[i], b[i]); break;
+		default: break;
+	}
+}
+
+static void bench_soa(bench_op op, bench_data *d) {
+	switch (op) {
+		case BENCH_ADD: vector3_soa_add(&d->sa, &d->sb, &d->sout); break;
+		case BENCH_SCALE: vector3_soa_scale(&d->sa, 1.5f, &d->sout); break;
+		case BENCH_LERP: vector3_soa_lerp(&d->sa, &d->sb, 0.25f, &d->sout); break;
+		case BENCH_DOT: vector3_soa_dot(&d->sa, &d->sb, d->scalars); break;
+		case BENCH_CROSS: vector3_soa_cross(&d->sa, &d->sb, &d->sout); break;
+		case BENCH_NORMALIZE: vector3_soa_normalize(&d->sa, &d->sout); break;
+		case BENCH_DISTANCE: vector3_soa_distance(&d->sa, &d->sb, d->scalars); break;
+		default: break;
+	}
+}
+
+/*Returns nanoseconds per vector*/
+static double bench_time(bench_op op, bench_data *d, int soa) {
+	size_t iterations = 0;
+	double start = bench_now(), elapsed;
+	do {
+		if (soa)
+			bench_soa(op, d);
+		else
+			bench_aos(op, d);
+		iterations++;
+		elapsed = bench_now() - start;
+	} while (elapsed < BENCH_MIN_SECONDS);
+	return elapsed * 1e9 / ((double)iterations * (double)d->a.length);
+}
+
+static int bench_matches(bench_op op, bench_data *d) {
+	float *aos_scalars = (float *)malloc(sizeof(float) * d->a.length);
+	bench_aos(op, d);
+	memcpy(aos_scalars, d->scalars, sizeof(float) * d->a.length);
+	bench_soa(op, d);
+	int ok = 1;
+	for (size_t i = 0; i < d->a.length && ok; i++) {
+		if (op == BENCH_DOT || op == BENCH_DISTANCE) {
+			ok = memcmp(&aos_scalars[i], &d->scalars[i], sizeof(float)) == 0;
+		} else {
+			vector3_t v = vector3_soa_get(&d->sout, i);
+			ok = memcmp(&v, &d->out.array[i], sizeof(vector3_t)) == 0;
+		}
+	}
+	free(aos_scalars);
+	return ok;
+}
+
+static void bench_size(size_t count) {
+	bench_data d;
+	d.a = list_vector3_t_alloc();
+	d.b = list_vector3_t_alloc();
+	d.out = list_vector3_t_alloc();
+	for (size_t i = 0; i < count; i++) {
+		list_vector3_t_add(&d.a, (vector3_t){ bench_random(100.0f), bench_random(100.0f), bench_random(100.0f) });
+		list_vector3_t_add(&d.b, (vector3_t){ bench_random(100.0f), bench_random(100.0f), bench_random(100.0f) });
+		list_vector3_t_add(&d.out, vector3_zero());
+	}
+	d.sa = vector3_soa_alloc(count);
+	d.sb = vector3_soa_alloc(count);
+	d.sout = vector3_soa_alloc(count);
+	vector3_soa_from_list(&d.sa, &d.a);
+	vector3_soa_from_list(&d.sb, &d.b);
+	d.scalars = (float *)malloc(sizeof(float) * count);
+
+	for (int op = 0; op < BENCH_OP_COUNT; op++) {
+		int identical = bench_matches((bench_op)op, &d);
+		double aos = bench_time((bench_op)op, &d, 0);
+		double soa = bench_time((bench_op)op, &d, 1);
+		printf("{\"op\":\"%s\",\"vectors\":%zu,\"aos_ns\":%.4f,\"soa_ns\":%.4f,\"speedup\":%.2f,\"identical\":%s}\n",
+				bench_names[op], count, aos, soa, aos / soa, identical ? "true" : "false");
+		fprintf(stderr, "%-10s %9zu vectors  AoS %7.3f ns  SoA %7.3f ns  x%5.2f%s\n",
+				bench_names[op], count, aos, soa, aos / soa, identical ? "" : "  MISMATCH");
+	}
+
+	free(d.scalars);
+	vector3_soa_free(&d.sa);
+	vector3_soa_free(&d.sb);
+	vector3_soa_free(&d.sout);
+	list_vector3_t_free(&d.a);
+	list_vector3_t_free(&d.b);
+	list_vector3_t_free(&d.out);
+}
+
+int main(void) {
+	bench_size(1024);
+	bench_size(4 * 1024 * 1024);
+	return 0;
+}
@@ -0,0 +1,205 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Spatial hash benchmark.
+
+  Fills boxes with about 100K and 1M seeded random particles, seven per
+  unit cell, and builds a grid of unit cells over them, on one thread and
+  on the pool. spatial_hash_update() is timed with the particles at rest
+  and with every particle jittered as in a simulation step. Then every
+  particle is queried at once, for its neighbours within a unit radius
+  with spatial_hash_neighbors() and for its 8 nearest with
+  spatial_hash_nearest_all(), and one particle at a time with
+  spatial_hash_query_radius() and spatial_hash_query_nearest(). A brute
+  force loop over every particle is timed on a sample for comparison.
+  Times are per particle, "ms" is for all of them.
+
+  One JSON object per operation is written to stdout, a readable table is
+  written to stderr:
+
+    make -C bench spatial_hash && ./bench/spatial_hash_bench > bench_output.txt*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BLIB_IMPLEMENTATION
+#include "../blib_spatial_hash.h"
+
+#define BENCH_DENSITY (7.0 /* particles per cell */)
+#define BENCH_RADIUS (1.0f)
+#define BENCH_NEAREST (8)
+#define BENCH_JITTER (0.02f)
+#define BENCH_SINGLE_QUERIES (65536)
+#define BENCH_BRUTE_QUERIES (64)
+#define BENCH_MIN_SECONDS (0.3)
+
+static double bench_now(void) {
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static uint64_t bench_seed = 0x2545F4914F6CDD1Dull;
+
+static uint32_t bench_random_below(uint32_t n) {
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 7;
+	bench_seed ^= bench_seed << 17;
+	return (uint32_t)((bench_seed >> 32) % n);
+}
+
+static float bench_random(float range) {
+	return ((float)bench_random_below(1u << 24) / 16777216.0f) * range;
+}
+
+/*The loop the grid replaces*/
+static size_t bench_brute(const list_vector3_t *points, vector3_t p, float radius) {
+	size_t count = 0;
+	for (size_t i = 0; i < points->length; i++)
+		count += vector3_square_distance(points->array[i], p) <= radius * radius;
+	return count;
+}
+
+static void bench_report(const char *op, size_t particles, double ns, size_t threads, double brute_ns,
+		double per_particle) {
+	printf("{\"op\":\"%s\",\"particles\":%zu,\"ns_per_particle\":%.2f,\"ms\":%.2f,\"threads\":%zu,"
+			"\"speedup\":%.1f,\"results_per_particle\":%.2f}\n", op, particles, ns, ns * (double)particles * 1e-6,
+			threads, brute_ns > 0.0 ? brute_ns / ns : 1.0, per_particle);
+	fprintf(stderr, "%-15s %8zu particles %10.2f ns/particle %9.2f ms  %zu threads", op, particles, ns,
+			ns * (double)particles * 1e-6, threads);
+	if (brute_ns > 0.0)
+		fprintf(stderr, "  x%.1f", brute_ns / ns);
+	fprintf(stderr, "\n");
+}
+
+int main(void) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	thread_pool *pool = cpus > 1 ? thread_pool_alloc((size_t)cpus - 1) : NULL;
+	size_t threads = thread_pool_thread_count(pool);
+
+	static const size_t sizes[] = { 100000, 1000000 };
+	for (size_t size = 0; size < sizeof(sizes) / sizeof(sizes[0]); size++) {
+		size_t n = sizes[size];
+		float side = (float)cbrt((double)n / BENCH_DENSITY);
+		list_vector3_t points = list_vector3_t_alloc(), moved = list_vector3_t_alloc();
+		for (size_t i = 0; i < n; i++) {
+			vector3_t p = { bench_random(side), bench_random(side), bench_random(side) };
+			list_vector3_t_add(&points, p);
+			p.x += bench_random(BENCH_JITTER) - 0.5f * BENCH_JITTER;
+			p.y += bench_random(BENCH_JITTER) - 0.5f * BENCH_JITTER;
+			p.z += bench_random(BENCH_JITTER) - 0.5f * BENCH_JITTER;
+			list_vector3_t_add(&moved, p);
+		}
+		spatial_hash h = spatial_hash_alloc(1.0f);
+
+		for (int parallel = 0; parallel < 2; parallel++) {
+			size_t iterations = 0;
+			double start = bench_now(), elapsed;
+			do {
+				spatial_hash_build(&h, &points, parallel ? pool : NULL);
+				iterations++;
+				elapsed = bench_now() - start;
+			} while (elapsed < BENCH_MIN_SECONDS);
+			bench_report(parallel ? "build_parallel" : "build", n, elapsed * 1e9 / (double)(iterations * n),
+					parallel ? threads : 1, 0.0, 0.0);
+		}
+
+		// At rest every update finds the same cells, moving ones flip
+		// between the two sets.
+		for (int moving = 0; moving < 2; moving++) {
+			size_t iterations = 0, changed = 0;
+			double start = bench_now(), elapsed;
+			do {
+				const list_vector3_t *frame = moving && iterations % 2 == 0 ? &moved : &points;
+				changed += spatial_hash_update(&h, frame, pool);
+				iterations++;
+				elapsed = bench_now() - start;
+			} while (elapsed < BENCH_MIN_SECONDS);
+			bench_report(moving ? "update_moving" : "update_static", n, elapsed * 1e9 / (double)(iterations * n),
+					threads, 0.0, (double)changed / (double)(iterations * n));
+		}
+		spatial_hash_build(&h, &points, pool);
+
+		double brute_ns = 0.0;
+		size_t brute_found = 0, iterations = 0;
+		double start = bench_now(), elapsed;
+		do {
+			for (size_t q = 0; q < BENCH_BRUTE_QUERIES; q++)
+				brute_found += bench_brute(&points, points.array[q * (n / BENCH_BRUTE_QUERIES)], BENCH_RADIUS);
+			iterations++;
+			elapsed = bench_now() - start;
+		} while (elapsed < BENCH_MIN_SECONDS);
+		brute_ns = elapsed * 1e9 / (double)(iterations * BENCH_BRUTE_QUERIES);
+		bench_report("brute_radius", n, brute_ns, 1, 0.0,
+				(double)brute_found / (double)(iterations * BENCH_BRUTE_QUERIES));
+
+		list_uint32_t offsets = list_uint32_t_alloc(), results = list_uint32_t_alloc();
+		for (int nearest = 0; nearest < 2; nearest++) {
+			size_t found = 0;
+			iterations = 0;
+			start = bench_now();
+			do {
+				found = nearest ? spatial_hash_nearest_all(&h, BENCH_NEAREST, INFINITY, &results, pool) :
+					spatial_hash_neighbors(&h, BENCH_RADIUS, &offsets, &results, pool);
+				iterations++;
+				elapsed = bench_now() - start;
+			} while (elapsed < BENCH_MIN_SECONDS);
+			bench_report(nearest ? "nearest_all" : "neighbors", n, elapsed * 1e9 / (double)(iterations * n),
+					threads, brute_ns, (double)found / (double)n);
+		}
+
+		for (int nearest = 0; nearest < 2; nearest++) {
+			size_t found = 0;
+			iterations = 0;
+			start = bench_now();
+			do {
+				for (size_t q = 0; q < BENCH_SINGLE_QUERIES; q++) {
+					vector3_t p = points.array[bench_random_below((uint32_t)n)];
+					found += nearest ? spatial_hash_query_nearest(&h, p, BENCH_NEAREST, INFINITY, &results) :
+						spatial_hash_query_radius(&h, p, BENCH_RADIUS, &results);
+				}
+				iterations++;
+				elapsed = bench_now() - start;
+			} while (elapsed < BENCH_MIN_SECONDS);
+			bench_report(nearest ? "query_nearest" : "query_radius", n,
+					elapsed * 1e9 / (double)(iterations * BENCH_SINGLE_QUERIES), 1, brute_ns,
+					(double)found / (double)(iterations * BENCH_SINGLE_QUERIES));
+		}
+
+		list_uint32_t_free(&offsets);
+		list_uint32_t_free(&results);
+		spatial_hash_free(&h);
+		list_vector3_t_free(&points);
+		list_vector3_t_free(&moved);
+	}
+
+	thread_pool_free(pool);
+	return 0;
+}
@@ -35,6 +35,16 @@ extern "C" {
 #include <stdlib.h>
 #include <string.h>
 
+/*Define BLIB_METRICS in every translation unit to count library internals
+  (bytes read, JSON nodes, list reallocations) in blib_metrics.h. Without
+  it BLIB_METRIC_ADD costs nothing.*/
+#ifdef BLIB_METRICS
+#include "blib_metrics.h"
+#define BLIB_METRIC_ADD(counter, n) metrics_counter_add(&(counter), (n))
+#else
+#define BLIB_METRIC_ADD(counter, n) ((void)0)
+#endif
+
 typedef uint8_t bool;
 enum { false, true };
 
@@ -69,6 +79,7 @@ void list_##type##_remove(list_##type *l);
 		if (l->length >= l->capacity) {\
 			l->capacity = l->length * 2 + 1;\
 			l->array = realloc(l->array, sizeof(type) * l->capacity);\
+			BLIB_METRIC_ADD(metrics_list_reallocs, 1);\
 		}\
 		l->array[l->length] = value;\
 		l->length++;\
@@ -129,6 +140,8 @@ DECLARE_LIST_ALIAS(uint64_t, int64_t)
 #endif // BLIB_H
 
 #ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_IMPLEMENTATION_H
+#define BLIB_IMPLEMENTATION_H
 
 #ifdef __cplusplus
 extern "C" {
@@ -155,5 +168,6 @@ extern "C" {
 } // extern "C" {
 #endif //ifdef __cplusplus
 
+#endif // BLIB_IMPLEMENTATION_H
 #endif // BLIB_IMPLEMENTATION
 
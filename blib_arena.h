@@ -0,0 +1,116 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+#ifndef BLIB_ARENA_H
+#define BLIB_ARENA_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "blib.h"
+
+#define BLIB_ARENA_DEFAULT_BLOCK_SIZE (64 * 1024 /* bytes */)
+#define BLIB_ARENA_ALIGNMENT (16 /* bytes */)
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct memory_arena_block {
+	struct memory_arena_block *next;
+	size_t capacity;
+	size_t used;
+} memory_arena_block;
+
+/*A bump allocator. Allocations are never freed individually, instead the
+  whole arena is reset or freed at once. Blocks are chained so pointers
+  returned by memory_arena_push() stay valid until the arena is reset.*/
+typedef struct {
+	memory_arena_block *head;
+	size_t block_size;
+} memory_arena;
+
+static inline memory_arena memory_arena_alloc(size_t block_size) {
+	memory_arena arena;
+	arena.head = NULL;
+	arena.block_size = block_size ? block_size : BLIB_ARENA_DEFAULT_BLOCK_SIZE;
+	return arena;
+}
+
+/*Returns "size" bytes of uninitialized memory aligned to
+  BLIB_ARENA_ALIGNMENT. Returns NULL only when the system is out of memory.*/
+static inline void *memory_arena_push(memory_arena *arena, size_t size) {
+	size = (size + BLIB_ARENA_ALIGNMENT - 1) & ~(size_t)(BLIB_ARENA_ALIGNMENT - 1);
+	memory_arena_block *block = arena->head;
+	if (block == NULL || block->capacity - block->used < size) {
+		size_t capacity = size > arena->block_size ? size : arena->block_size;
+		size_t header = (sizeof(memory_arena_block) + BLIB_ARENA_ALIGNMENT - 1) &
+			~(size_t)(BLIB_ARENA_ALIGNMENT - 1);
+		block = (memory_arena_block *)malloc(header + capacity);
+		if (block == NULL)
+			return NULL;
+		block->capacity = capacity;
+		block->used = header;
+		block->capacity += header;
+		block->next = arena->head;
+		arena->head = block;
+	}
+	void *ret = (char *)block + block->used;
+	block->used += size;
+	return ret;
+}
+
+/*Releases every allocation but keeps the most recent block around so a
+  reused arena does not go back to malloc.*/
+static inline void memory_arena_reset(memory_arena *arena) {
+	memory_arena_block *block = arena->head;
+	if (block == NULL)
+		return;
+	memory_arena_block *next = block->next;
+	while (next) {
+		memory_arena_block *tmp = next->next;
+		free(next);
+		next = tmp;
+	}
+	block->next = NULL;
+	block->used = (sizeof(memory_arena_block) + BLIB_ARENA_ALIGNMENT - 1) &
+		~(size_t)(BLIB_ARENA_ALIGNMENT - 1);
+}
+
+static inline void memory_arena_free(memory_arena *arena) {
+	memory_arena_block *block = arena->head;
+	while (block) {
+		memory_arena_block *next = block->next;
+		free(block);
+		block = next;
+	}
+	arena->head = NULL;
+}
+
+#ifdef __cplusplus
+} //extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_ARENA_H
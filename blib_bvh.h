@@ -0,0 +1,948 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Bounding volume hierarchy for ray queries against triangle soups.
+
+  bvh_build() takes a list_vector3_t where every three consecutive
+  vertices form a triangle, the same layout a brute force loop would walk.
+  It bins triangle centroids into BLIB_BVH_BINS slabs per axis and splits
+  each node where the surface area heuristic is cheapest. For large meshes
+  the top levels are binned across the thread pool and the subtrees below
+  them are built in parallel, the result does not depend on the thread
+  count.
+
+  The tree is stored flat: nodes are 32 bytes, the two children of a node
+  sit next to each other, and the triangles of every leaf are contiguous
+  and already prepared for the intersection test, so the mesh can be
+  modified or freed once the tree is built.
+
+  Rays are traced one at a time with bvh_intersect() (closest hit) and
+  bvh_occluded() (any hit), or in packets of BVH_PACKET_SIZE which share
+  one traversal, 8 lanes wide with AVX2. Packets pay off when their rays
+  are coherent, such as neighbouring camera pixels or shadow rays towards
+  one light. Every path reports the same hits as a brute force loop over
+  the triangles; when two triangles are hit at exactly the same distance
+  either may be reported.*/
+
+#ifndef BLIB_BVH_H
+#define BLIB_BVH_H
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blib.h"
+#include "blib_math3d.h"
+#include "blib_thread.h"
+
+/*Centroid bins per axis when searching for a split*/
+#define BLIB_BVH_BINS (16 /* bins */)
+
+/*Cost of visiting a node in triangle tests, higher values give fewer and
+  larger leaves*/
+#define BLIB_BVH_TRAVERSAL_COST (1.0f /* triangle tests */)
+
+/*Leaves never hold more triangles than this*/
+#define BLIB_BVH_MAX_LEAF (8 /* triangles */)
+
+/*Nodes with at most this many triangles are built as one task*/
+#define BLIB_BVH_SUBTREE (16384 /* triangles */)
+
+/*Triangles per thread pool task when binning or preparing triangles*/
+#define BLIB_BVH_GRAIN (16384 /* triangles */)
+
+/*Rays per thread pool task, a multiple of BVH_PACKET_SIZE*/
+#define BLIB_BVH_RAY_GRAIN (256 /* rays */)
+
+#define BVH_PACKET_SIZE 8
+
+#define BVH_NONE UINT32_MAX
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct {
+	vector3_t min;
+	uint32_t offset;  // first child for an inner node, first triangle for a leaf
+	vector3_t max;
+	uint32_t count;   // triangles in a leaf, 0 for an inner node
+} bvh_node;
+
+/*A triangle as the intersection test wants it, edge1 = v1 - v0 and
+  edge2 = v2 - v0*/
+typedef struct {
+	vector3_t v0;
+	vector3_t edge1;
+	vector3_t edge2;
+} bvh_triangle;
+
+typedef struct {
+	// nodes[0] is the root, the children of an inner node are
+	// nodes[offset] and nodes[offset + 1].
+	bvh_node *nodes;
+	size_t node_count;
+
+	// In leaf order. triangle_index[i] is the index the triangle had in
+	// the mesh, vertices 3 * triangle_index[i] to 3 * triangle_index[i] + 2.
+	bvh_triangle *triangles;
+	uint32_t *triangle_index;
+	size_t triangle_count;
+} bvh;
+
+/*Hits lie at origin + t * direction for 0 < t < t_max. The direction
+  does not have to be normalized, t is measured in its length. Use
+  INFINITY for an unbounded ray.*/
+typedef struct {
+	vector3_t origin;
+	vector3_t direction;
+	float t_max;
+} bvh_ray;
+DECLARE_LIST(bvh_ray)
+
+/*"u" and "v" are the barycentric weights of v1 and v2. A miss has
+  triangle BVH_NONE and t equal to the ray's t_max.*/
+typedef struct {
+	float t;
+	float u;
+	float v;
+	uint32_t triangle;
+} bvh_hit;
+DECLARE_LIST(bvh_hit)
+
+/*The vertex count must be a multiple of three. "pool" may be NULL.*/
+bvh bvh_build(const list_vector3_t *vertices, thread_pool *pool);
+void bvh_free(bvh *b);
+
+/*Closest hit. Returns false and leaves "hit" untouched on a miss.*/
+bool bvh_intersect(const bvh *b, bvh_ray ray, bvh_hit *hit);
+
+/*Whether anything is hit, stops at the first triangle found*/
+bool bvh_occluded(const bvh *b, bvh_ray ray);
+
+/*Trace "count" <= BVH_PACKET_SIZE rays together and fill "count" hits or
+  flags. Both return how many rays hit.*/
+size_t bvh_intersect_packet(const bvh *b, const bvh_ray *rays, size_t count, bvh_hit *hits);
+size_t bvh_occluded_packet(const bvh *b, const bvh_ray *rays, size_t count, bool *occluded);
+
+/*Packets of consecutive rays, split across the thread pool. Replace the
+  contents of the output list, which gets one entry per ray, and return
+  how many rays hit. "pool" may be NULL. Scattered rays are faster traced
+  one at a time.*/
+size_t bvh_intersect_rays(const bvh *b, const list_bvh_ray *rays, list_bvh_hit *hits, thread_pool *pool);
+size_t bvh_occluded_rays(const bvh *b, const list_bvh_ray *rays, list_uint8_t *occluded,
+		thread_pool *pool);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_BVH_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_BVH_IMPLEMENTATION_H
+#define BLIB_BVH_IMPLEMENTATION_H
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BLIB_BVH_X86 1
+#include <immintrin.h>
+#endif
+
+/*Below this depth splits follow the surface area heuristic, deeper nodes
+  are halved, which bounds the depth of any tree and with it the
+  traversal stack*/
+#define BVH_SAH_DEPTH 32
+#define BVH_STACK_SIZE 64
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+DEFINE_LIST(bvh_ray)
+DEFINE_LIST(bvh_hit)
+
+/*-------------------------------- build ----------------------------------*/
+
+typedef struct {
+	aabb_t bounds;
+	uint32_t count;
+} bvh_bin;
+
+/*What the build needs of a triangle. Partitioning moves these rather
+  than indices so that every pass over a node reads memory in order.*/
+typedef struct {
+	aabb_t bounds;
+	vector3_t centroid;
+	uint32_t triangle;
+} bvh_ref;
+
+/*Triangles refs[begin, end) of a node, their bounds and the bounds of
+  their centroids*/
+typedef struct {
+	uint32_t begin;
+	uint32_t end;
+	aabb_t bounds;
+	aabb_t centroids;
+} bvh_range;
+
+typedef struct {
+	bvh_node *array;
+	size_t length;
+	size_t capacity;
+} bvh_nodes;
+
+/*A node of the top levels whose subtree is built as one task. Its nodes
+  other than the root go to final[base, base + count - 1).*/
+typedef struct {
+	uint32_t node;
+	uint32_t depth;
+	bvh_range range;
+	size_t count;
+	size_t base;
+} bvh_subtree;
+
+typedef struct {
+	const vector3_t *vertices;
+	bvh_ref *refs;
+
+	// Per thread partial results of bvh_prepare_task() and bvh_bin_task().
+	aabb_t *thread_bounds;
+	bvh_bin *thread_bins;
+
+	// The node bvh_bin_task() is binning.
+	uint32_t bin_begin;
+	float bin_min[3];
+	float bin_scale[3];
+
+	bvh_nodes top;
+	bvh_subtree *subtrees;
+	size_t subtree_count;
+	size_t subtree_capacity;
+	bvh_node *scratch;
+	bvh *out;
+} bvh_builder;
+
+static void *bvh_grow(void *array, size_t size, size_t capacity) {
+	array = realloc(array, size * capacity);
+	BLIB_METRIC_ADD(metrics_list_reallocs, 1);
+	return array;
+}
+
+static inline aabb_t bvh_aabb_empty(void) {
+	return (aabb_t){ { INFINITY, INFINITY, INFINITY }, { -INFINITY, -INFINITY, -INFINITY } };
+}
+
+static inline void bvh_aabb_union(aabb_t *a, aabb_t b) {
+	a->min = vector3_min(a->min, b.min);
+	a->max = vector3_max(a->max, b.max);
+}
+
+static inline void bvh_aabb_grow(aabb_t *a, vector3_t p) {
+	a->min = vector3_min(a->min, p);
+	a->max = vector3_max(a->max, p);
+}
+
+/*Half the surface area*/
+static inline float bvh_aabb_area(aabb_t a) {
+	float x = a.max.x - a.min.x, y = a.max.y - a.min.y, z = a.max.z - a.min.z;
+	return x * y + y * z + z * x;
+}
+
+static inline float bvh_axis(vector3_t v, int axis) {
+	return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+static inline uint32_t bvh_bin_index(float c, float min, float scale, uint32_t last) {
+	uint32_t bin = (uint32_t)((c - min) * scale);
+	return bin < last ? bin : last;
+}
+
+/*Bins are stored BLIB_BVH_BINS apart per axis, small nodes use fewer*/
+static void bvh_bins_clear(bvh_bin *bins, uint32_t count) {
+	for (int a = 0; a < 3; a++) {
+		for (uint32_t i = 0; i < count; i++)
+			bins[a * BLIB_BVH_BINS + i] = (bvh_bin){ bvh_aabb_empty(), 0 };
+	}
+}
+
+/*All three axes in one pass, their updates are independent. An axis with
+  scale 0 collects everything in its first bin and is ignored.*/
+static void bvh_bin_refs(const bvh_builder *b, uint32_t begin, uint32_t end, const float *min,
+		const float *scale, uint32_t count, bvh_bin *bins) {
+	for (uint32_t i = begin; i < end; i++) {
+		const bvh_ref *ref = &b->refs[i];
+		bvh_bin *x = &bins[bvh_bin_index(ref->centroid.x, min[0], scale[0], count - 1)];
+		bvh_bin *y = &bins[BLIB_BVH_BINS + bvh_bin_index(ref->centroid.y, min[1], scale[1], count - 1)];
+		bvh_bin *z = &bins[2 * BLIB_BVH_BINS + bvh_bin_index(ref->centroid.z, min[2], scale[2], count - 1)];
+		x->count++;
+		y->count++;
+		z->count++;
+		bvh_aabb_union(&x->bounds, ref->bounds);
+		bvh_aabb_union(&y->bounds, ref->bounds);
+		bvh_aabb_union(&z->bounds, ref->bounds);
+	}
+}
+
+static void bvh_bin_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	bvh_builder *b = (bvh_builder *)context;
+	bvh_bin_refs(b, b->bin_begin + (uint32_t)begin, b->bin_begin + (uint32_t)end, b->bin_min,
+		b->bin_scale, BLIB_BVH_BINS, b->thread_bins + thread_index * 3 * BLIB_BVH_BINS);
+}
+
+static void bvh_range_bounds(const bvh_builder *b, bvh_range *r) {
+	r->bounds = bvh_aabb_empty();
+	r->centroids = bvh_aabb_empty();
+	for (uint32_t i = r->begin; i < r->end; i++) {
+		bvh_aabb_union(&r->bounds, b->refs[i].bounds);
+		bvh_aabb_grow(&r->centroids, b->refs[i].centroid);
+	}
+}
+
+/*Returns false when the node should be a leaf, otherwise partitions its
+  triangles into "left" and "right"*/
+static bool bvh_split(bvh_builder *b, const bvh_range *r, uint32_t depth, bvh_range *left,
+		bvh_range *right, thread_pool *pool) {
+	uint32_t n = r->end - r->begin;
+	if (n <= 1)
+		return false;
+
+	uint32_t bin_count = n < BLIB_BVH_BINS ? n : BLIB_BVH_BINS;
+	float min[3], scale[3];
+	bool binned = false;
+	for (int a = 0; a < 3; a++) {
+		min[a] = bvh_axis(r->centroids.min, a);
+		float extent = bvh_axis(r->centroids.max, a) - min[a];
+		scale[a] = extent > 0.0f ? (float)bin_count / extent : 0.0f;
+		if (!isfinite(scale[a]) || depth >= BVH_SAH_DEPTH)
+			scale[a] = 0.0f;
+		binned |= scale[a] != 0.0f;
+	}
+
+	float best = INFINITY;
+	int best_axis = -1;
+	uint32_t best_bin = 0;
+	bvh_bin bins[3 * BLIB_BVH_BINS];
+	if (binned) {
+		bvh_bins_clear(bins, bin_count);
+		if (pool && n >= 2 * BLIB_BVH_GRAIN) {
+			size_t threads = thread_pool_thread_count(pool);
+			for (size_t t = 0; t < threads; t++)
+				bvh_bins_clear(b->thread_bins + t * 3 * BLIB_BVH_BINS, bin_count);
+			b->bin_begin = r->begin;
+			memcpy(b->bin_min, min, sizeof(min));
+			memcpy(b->bin_scale, scale, sizeof(scale));
+			thread_pool_run(pool, n, BLIB_BVH_GRAIN, bvh_bin_task, b);
+			for (size_t t = 0; t < threads; t++) {
+				const bvh_bin *partial = b->thread_bins + t * 3 * BLIB_BVH_BINS;
+				for (int i = 0; i < 3 * BLIB_BVH_BINS; i++) {
+					bins[i].count += partial[i].count;
+					bvh_aabb_union(&bins[i].bounds, partial[i].bounds);
+				}
+			}
+		} else {
+			bvh_bin_refs(b, r->begin, r->end, min, scale, bin_count, bins);
+		}
+
+		// Sweep from the right for the area and count after every bin,
+		// then from the left for the cost of splitting after it.
+		for (int a = 0; a < 3; a++) {
+			if (scale[a] == 0.0f)
+				continue;
+			const bvh_bin *axis_bins = bins + a * BLIB_BVH_BINS;
+			float right_area[BLIB_BVH_BINS];
+			uint32_t right_count[BLIB_BVH_BINS];
+			aabb_t box = bvh_aabb_empty();
+			uint32_t count = 0;
+			for (uint32_t i = bin_count - 1; i > 0; i--) {
+				bvh_aabb_union(&box, axis_bins[i].bounds);
+				count += axis_bins[i].count;
+				right_area[i - 1] = bvh_aabb_area(box);
+				right_count[i - 1] = count;
+			}
+			box = bvh_aabb_empty();
+			count = 0;
+			for (uint32_t i = 0; i < bin_count - 1; i++) {
+				bvh_aabb_union(&box, axis_bins[i].bounds);
+				count += axis_bins[i].count;
+				if (count == 0 || right_count[i] == 0)
+					continue;
+				float cost = bvh_aabb_area(box) * (float)count + right_area[i] * (float)right_count[i];
+				if (cost < best) {
+					best = cost;
+					best_axis = a;
+					best_bin = i;
+				}
+			}
+		}
+	}
+
+	if (best_axis < 0) {
+		// All centroids coincide or the tree is too deep, halve the range.
+		if (n <= BLIB_BVH_MAX_LEAF)
+			return false;
+		*left = (bvh_range){ .begin = r->begin, .end = r->begin + n / 2 };
+		*right = (bvh_range){ .begin = r->begin + n / 2, .end = r->end };
+		bvh_range_bounds(b, left);
+		bvh_range_bounds(b, right);
+		return true;
+	}
+
+	// Relative to the parent's area a leaf costs n * area and a split
+	// BLIB_BVH_TRAVERSAL_COST * area + best.
+	float area = bvh_aabb_area(r->bounds);
+	if (n <= BLIB_BVH_MAX_LEAF && (float)n * area <= BLIB_BVH_TRAVERSAL_COST * area + best)
+		return false;
+
+	// The bins give the children's bounds, their centroid bounds are
+	// gathered while partitioning.
+	const bvh_bin *axis_bins = bins + best_axis * BLIB_BVH_BINS;
+	*left = (bvh_range){ .bounds = bvh_aabb_empty(), .centroids = bvh_aabb_empty() };
+	*right = *left;
+	for (uint32_t i = 0; i < bin_count; i++)
+		bvh_aabb_union(i <= best_bin ? &left->bounds : &right->bounds, axis_bins[i].bounds);
+
+	uint32_t i = r->begin, j = r->end;
+	while (i < j) {
+		vector3_t c = b->refs[i].centroid;
+		if (bvh_bin_index(bvh_axis(c, best_axis), min[best_axis], scale[best_axis], bin_count - 1) <= best_bin) {
+			bvh_aabb_grow(&left->centroids, c);
+			i++;
+		} else {
+			bvh_aabb_grow(&right->centroids, c);
+			bvh_ref swap = b->refs[i];
+			b->refs[i] = b->refs[--j];
+			b->refs[j] = swap;
+		}
+	}
+	left->begin = r->begin;
+	left->end = i;
+	right->begin = i;
+	right->end = r->end;
+	return true;
+}
+
+/*Depth first. With "top" set, nodes small enough become subtree tasks
+  instead of being built.*/
+static void bvh_build_node(bvh_builder *b, bvh_nodes *nodes, uint32_t node, const bvh_range *r,
+		uint32_t depth, thread_pool *pool, bool top) {
+	nodes->array[node].min = r->bounds.min;
+	nodes->array[node].max = r->bounds.max;
+	if (top && r->end - r->begin <= BLIB_BVH_SUBTREE) {
+		if (b->subtree_count == b->subtree_capacity) {
+			b->subtree_capacity = b->subtree_capacity * 2 + 16;
+			b->subtrees = bvh_grow(b->subtrees, sizeof(bvh_subtree), b->subtree_capacity);
+		}
+		b->subtrees[b->subtree_count++] = (bvh_subtree){ .node = node, .depth = depth, .range = *r };
+		return;
+	}
+
+	bvh_range left, right;
+	if (!bvh_split(b, r, depth, &left, &right, pool)) {
+		nodes->array[node].offset = r->begin;
+		nodes->array[node].count = r->end - r->begin;
+		return;
+	}
+	if (nodes->length + 2 > nodes->capacity) {
+		nodes->capacity = nodes->capacity * 2 + 2;
+		nodes->array = bvh_grow(nodes->array, sizeof(bvh_node), nodes->capacity);
+	}
+	uint32_t pair = (uint32_t)nodes->length;
+	nodes->length += 2;
+	nodes->array[node].offset = pair;
+	nodes->array[node].count = 0;
+	bvh_build_node(b, nodes, pair, &left, depth + 1, pool, top);
+	bvh_build_node(b, nodes, pair + 1, &right, depth + 1, pool, top);
+}
+
+/*Per triangle bounds and centroids, plus the bounds of everything per
+  thread*/
+static void bvh_prepare_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	bvh_builder *b = (bvh_builder *)context;
+	aabb_t *bounds = b->thread_bounds + 2 * thread_index;
+	for (size_t i = begin; i < end; i++) {
+		const vector3_t *v = b->vertices + 3 * i;
+		aabb_t box = { vector3_min(vector3_min(v[0], v[1]), v[2]), vector3_max(vector3_max(v[0], v[1]), v[2]) };
+		vector3_t c = {
+			(box.min.x + box.max.x) * 0.5f,
+			(box.min.y + box.max.y) * 0.5f,
+			(box.min.z + box.max.z) * 0.5f,
+		};
+		b->refs[i] = (bvh_ref){ box, c, (uint32_t)i };
+		bvh_aabb_union(&bounds[0], box);
+		bvh_aabb_grow(&bounds[1], c);
+	}
+}
+
+/*Each subtree is built into the scratch nodes at twice its first
+  triangle, room for the 2 * n - 1 nodes n triangles can need*/
+static void bvh_subtree_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	(void)thread_index;
+	bvh_builder *b = (bvh_builder *)context;
+	for (size_t k = begin; k < end; k++) {
+		bvh_subtree *s = &b->subtrees[k];
+		size_t n = s->range.end - s->range.begin;
+		bvh_nodes nodes = { b->scratch + 2 * (size_t)s->range.begin, 1, 2 * n };
+		bvh_build_node(b, &nodes, 0, &s->range, s->depth, NULL, false);
+		s->count = nodes.length;
+	}
+}
+
+static inline bvh_node bvh_relocate(bvh_node node, size_t base) {
+	if (node.count == 0)
+		node.offset = (uint32_t)(base + node.offset - 1);
+	return node;
+}
+
+static void bvh_place_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	(void)thread_index;
+	bvh_builder *b = (bvh_builder *)context;
+	for (size_t k = begin; k < end; k++) {
+		const bvh_subtree *s = &b->subtrees[k];
+		const bvh_node *nodes = b->scratch + 2 * (size_t)s->range.begin;
+		b->out->nodes[s->node] = bvh_relocate(nodes[0], s->base);
+		for (size_t i = 1; i < s->count; i++)
+			b->out->nodes[s->base + i - 1] = bvh_relocate(nodes[i], s->base);
+	}
+}
+
+static void bvh_triangle_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	(void)thread_index;
+	bvh_builder *b = (bvh_builder *)context;
+	for (size_t i = begin; i < end; i++) {
+		uint32_t t = b->refs[i].triangle;
+		const vector3_t *v = b->vertices + 3 * (size_t)t;
+		b->out->triangles[i] = (bvh_triangle){ v[0], vector3_subtract(v[1], v[0]), vector3_subtract(v[2], v[0]) };
+		b->out->triangle_index[i] = t;
+	}
+}
+
+bvh bvh_build(const list_vector3_t *vertices, thread_pool *pool) {
+	assert(vertices->length % 3 == 0);
+	bvh out;
+	memset(&out, 0, sizeof(out));
+	size_t count = vertices->length / 3;
+	if (count == 0)
+		return out;
+	assert(count < (size_t)1 << 31);
+
+	size_t threads = thread_pool_thread_count(pool);
+	bvh_builder b;
+	memset(&b, 0, sizeof(b));
+	b.vertices = vertices->array;
+	b.refs = (bvh_ref *)malloc(sizeof(bvh_ref) * count);
+	b.thread_bounds = (aabb_t *)malloc(sizeof(aabb_t) * 2 * threads);
+	b.thread_bins = (bvh_bin *)malloc(sizeof(bvh_bin) * 3 * BLIB_BVH_BINS * threads);
+	b.out = &out;
+	for (size_t t = 0; t < 2 * threads; t++)
+		b.thread_bounds[t] = bvh_aabb_empty();
+	thread_pool_run(pool, count, BLIB_BVH_GRAIN, bvh_prepare_task, &b);
+
+	bvh_range root = { 0, (uint32_t)count, bvh_aabb_empty(), bvh_aabb_empty() };
+	for (size_t t = 0; t < threads; t++) {
+		bvh_aabb_union(&root.bounds, b.thread_bounds[2 * t]);
+		bvh_aabb_union(&root.centroids, b.thread_bounds[2 * t + 1]);
+	}
+
+	// The top levels on this thread with parallel binning, then the
+	// subtrees below them in parallel.
+	b.top = (bvh_nodes){ (bvh_node *)malloc(sizeof(bvh_node) * 16), 1, 16 };
+	bvh_build_node(&b, &b.top, 0, &root, 0, pool, true);
+	b.scratch = (bvh_node *)malloc(sizeof(bvh_node) * 2 * count);
+	thread_pool_run(pool, b.subtree_count, 1, bvh_subtree_task, &b);
+
+	size_t node_count = b.top.length;
+	for (size_t k = 0; k < b.subtree_count; k++) {
+		b.subtrees[k].base = node_count;
+		node_count += b.subtrees[k].count - 1;
+	}
+	out.nodes = (bvh_node *)malloc(sizeof(bvh_node) * node_count);
+	out.node_count = node_count;
+	memcpy(out.nodes, b.top.array, sizeof(bvh_node) * b.top.length);
+	thread_pool_run(pool, b.subtree_count, 1, bvh_place_task, &b);
+
+	out.triangles = (bvh_triangle *)malloc(sizeof(bvh_triangle) * count);
+	out.triangle_index = (uint32_t *)malloc(sizeof(uint32_t) * count);
+	out.triangle_count = count;
+	thread_pool_run(pool, count, BLIB_BVH_GRAIN, bvh_triangle_task, &b);
+
+	free(b.refs);
+	free(b.thread_bounds);
+	free(b.thread_bins);
+	free(b.top.array);
+	free(b.subtrees);
+	free(b.scratch);
+	return out;
+}
+
+void bvh_free(bvh *b) {
+	free(b->nodes);
+	free(b->triangles);
+	free(b->triangle_index);
+	memset(b, 0, sizeof(*b));
+}
+
+/*------------------------------ traversal --------------------------------*/
+
+/*Same results as _mm256_min_ps() and _mm256_max_ps(), including for NaN,
+  so that single rays and packets prune the same nodes*/
+static inline float bvh_min(float a, float b) {
+	return a < b ? a : b;
+}
+
+static inline float bvh_max(float a, float b) {
+	return a > b ? a : b;
+}
+
+/*Distance at which the ray enters the box, INFINITY if it misses it or
+  enters beyond t_max*/
+static inline float bvh_ray_box(const bvh_node *n, vector3_t origin, vector3_t inverse, float t_max) {
+	float x0 = (n->min.x - origin.x) * inverse.x, x1 = (n->max.x - origin.x) * inverse.x;
+	float y0 = (n->min.y - origin.y) * inverse.y, y1 = (n->max.y - origin.y) * inverse.y;
+	float z0 = (n->min.z - origin.z) * inverse.z, z1 = (n->max.z - origin.z) * inverse.z;
+	float enter = bvh_max(bvh_max(bvh_max(bvh_min(x0, x1), bvh_min(y0, y1)), bvh_min(z0, z1)), 0.0f);
+	float exit = bvh_min(bvh_min(bvh_min(bvh_max(x0, x1), bvh_max(y0, y1)), bvh_max(z0, z1)), t_max);
+	return enter <= exit ? enter : INFINITY;
+}
+
+/*Moller-Trumbore, both sides. Updates "hit" when the triangle is closer
+  than hit->t.*/
+static inline bool bvh_ray_triangle(const bvh_triangle *tri, const bvh_ray *ray, bvh_hit *hit) {
+	vector3_t d = ray->direction, e1 = tri->edge1, e2 = tri->edge2;
+	float px = d.y * e2.z - d.z * e2.y;
+	float py = d.z * e2.x - d.x * e2.z;
+	float pz = d.x * e2.y - d.y * e2.x;
+	float inverse = 1.0f / (e1.x * px + e1.y * py + e1.z * pz);
+	float sx = ray->origin.x - tri->v0.x;
+	float sy = ray->origin.y - tri->v0.y;
+	float sz = ray->origin.z - tri->v0.z;
+	float u = (sx * px + sy * py + sz * pz) * inverse;
+	float qx = sy * e1.z - sz * e1.y;
+	float qy = sz * e1.x - sx * e1.z;
+	float qz = sx * e1.y - sy * e1.x;
+	float v = (d.x * qx + d.y * qy + d.z * qz) * inverse;
+	float t = (e2.x * qx + e2.y * qy + e2.z * qz) * inverse;
+	// Written so that a NaN from a degenerate triangle fails every test.
+	if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > 0.0f && t < hit->t) {
+		hit->t = t;
+		hit->u = u;
+		hit->v = v;
+		return true;
+	}
+	return false;
+}
+
+/*Visits the nearer child first and skips nodes entered beyond the
+  closest hit so far*/
+static bool bvh_traverse(const bvh *b, const bvh_ray *ray, bvh_hit *hit, bool any) {
+	if (b->node_count == 0)
+		return false;
+	vector3_t inverse = { 1.0f / ray->direction.x, 1.0f / ray->direction.y, 1.0f / ray->direction.z };
+	if (bvh_ray_box(&b->nodes[0], ray->origin, inverse, ray->t_max) == INFINITY)
+		return false;
+
+	bvh_hit best = { ray->t_max, 0.0f, 0.0f, BVH_NONE };
+	uint32_t stack[BVH_STACK_SIZE];
+	float enter[BVH_STACK_SIZE];
+	size_t top = 0;
+	uint32_t node = 0;
+	for (;;) {
+		const bvh_node *n = &b->nodes[node];
+		if (n->count) {
+			for (uint32_t i = n->offset; i < n->offset + n->count; i++) {
+				if (bvh_ray_triangle(&b->triangles[i], ray, &best)) {
+					best.triangle = i;
+					if (any)
+						goto done;
+				}
+			}
+		} else {
+			uint32_t near = n->offset, far = n->offset + 1;
+			float near_t = bvh_ray_box(&b->nodes[near], ray->origin, inverse, best.t);
+			float far_t = bvh_ray_box(&b->nodes[far], ray->origin, inverse, best.t);
+			if (far_t < near_t) {
+				uint32_t swap = near;
+				near = far;
+				far = swap;
+				float swap_t = near_t;
+				near_t = far_t;
+				far_t = swap_t;
+			}
+			if (far_t != INFINITY) {
+				stack[top] = far;
+				enter[top++] = far_t;
+			}
+			if (near_t != INFINITY) {
+				node = near;
+				continue;
+			}
+		}
+		do {
+			if (top == 0)
+				goto done;
+			top--;
+		} while (enter[top] > best.t);
+		node = stack[top];
+	}
+
+done:
+	if (best.triangle == BVH_NONE)
+		return false;
+	best.triangle = b->triangle_index[best.triangle];
+	*hit = best;
+	return true;
+}
+
+bool bvh_intersect(const bvh *b, bvh_ray ray, bvh_hit *hit) {
+	return bvh_traverse(b, &ray, hit, false);
+}
+
+bool bvh_occluded(const bvh *b, bvh_ray ray) {
+	bvh_hit hit;
+	return bvh_traverse(b, &ray, &hit, true);
+}
+
+#ifdef BLIB_BVH_X86
+
+/*One traversal for up to eight rays. A node is entered when any ray
+  reaches it before its closest hit, children are ordered along the first
+  ray. Any hit rays drop out by setting their t_max below zero. Padding
+  lanes repeat the first ray with t_max -1.*/
+__attribute__((target("avx2")))
+static size_t bvh_packet_avx2(const bvh *b, const bvh_ray *rays, size_t count, bvh_hit *hits, bool *occluded) {
+	float lanes[7][8];
+	for (size_t i = 0; i < 8; i++) {
+		const bvh_ray *r = &rays[i < count ? i : 0];
+		lanes[0][i] = r->origin.x;
+		lanes[1][i] = r->origin.y;
+		lanes[2][i] = r->origin.z;
+		lanes[3][i] = r->direction.x;
+		lanes[4][i] = r->direction.y;
+		lanes[5][i] = r->direction.z;
+		lanes[6][i] = i < count ? r->t_max : -1.0f;
+	}
+	const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+	const __m256 ox = _mm256_loadu_ps(lanes[0]), oy = _mm256_loadu_ps(lanes[1]), oz = _mm256_loadu_ps(lanes[2]);
+	const __m256 dx = _mm256_loadu_ps(lanes[3]), dy = _mm256_loadu_ps(lanes[4]), dz = _mm256_loadu_ps(lanes[5]);
+	const __m256 ix = _mm256_div_ps(one, dx), iy = _mm256_div_ps(one, dy), iz = _mm256_div_ps(one, dz);
+	__m256 best = _mm256_loadu_ps(lanes[6]), best_u = zero, best_v = zero;
+	__m256i best_triangle = _mm256_set1_epi32(-1);
+	__m256 found = zero;
+	const float first_x = rays[0].direction.x, first_y = rays[0].direction.y, first_z = rays[0].direction.z;
+
+	uint32_t stack[BVH_STACK_SIZE];
+	size_t top = 0;
+	uint32_t node = 0;
+	for (;;) {
+		const bvh_node *n = &b->nodes[node];
+		__m256 x0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(n->min.x), ox), ix);
+		__m256 x1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(n->max.x), ox), ix);
+		__m256 y0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(n->min.y), oy), iy);
+		__m256 y1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(n->max.y), oy), iy);
+		__m256 z0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(n->min.z), oz), iz);
+		__m256 z1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(n->max.z), oz), iz);
+		__m256 enter = _mm256_max_ps(_mm256_max_ps(_mm256_max_ps(_mm256_min_ps(x0, x1), _mm256_min_ps(y0, y1)),
+			_mm256_min_ps(z0, z1)), zero);
+		__m256 exit = _mm256_min_ps(_mm256_min_ps(_mm256_min_ps(_mm256_max_ps(x0, x1), _mm256_max_ps(y0, y1)),
+			_mm256_max_ps(z0, z1)), best);
+		if (_mm256_movemask_ps(_mm256_cmp_ps(enter, exit, _CMP_LE_OQ))) {
+			if (n->count) {
+				for (uint32_t i = n->offset; i < n->offset + n->count; i++) {
+					const bvh_triangle *tri = &b->triangles[i];
+					__m256 e1x = _mm256_set1_ps(tri->edge1.x), e1y = _mm256_set1_ps(tri->edge1.y);
+					__m256 e1z = _mm256_set1_ps(tri->edge1.z), e2x = _mm256_set1_ps(tri->edge2.x);
+					__m256 e2y = _mm256_set1_ps(tri->edge2.y), e2z = _mm256_set1_ps(tri->edge2.z);
+					__m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+					__m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+					__m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+					__m256 inverse = _mm256_div_ps(one, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px),
+						_mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz)));
+					__m256 sx = _mm256_sub_ps(ox, _mm256_set1_ps(tri->v0.x));
+					__m256 sy = _mm256_sub_ps(oy, _mm256_set1_ps(tri->v0.y));
+					__m256 sz = _mm256_sub_ps(oz, _mm256_set1_ps(tri->v0.z));
+					__m256 u = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)),
+						_mm256_mul_ps(sz, pz)), inverse);
+					__m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+					__m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+					__m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+					__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)),
+						_mm256_mul_ps(dz, qz)), inverse);
+					__m256 t = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)),
+						_mm256_mul_ps(e2z, qz)), inverse);
+					__m256 hit = _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+					hit = _mm256_and_ps(hit, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+					hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, zero, _CMP_GT_OQ));
+					hit = _mm256_and_ps(hit, _mm256_cmp_ps(t, best, _CMP_LT_OQ));
+					if (!_mm256_movemask_ps(hit))
+						continue;
+					best = _mm256_blendv_ps(best, t, hit);
+					best_u = _mm256_blendv_ps(best_u, u, hit);
+					best_v = _mm256_blendv_ps(best_v, v, hit);
+					best_triangle = _mm256_blendv_epi8(best_triangle, _mm256_set1_epi32((int32_t)i),
+						_mm256_castps_si256(hit));
+					found = _mm256_or_ps(found, hit);
+				}
+				if (occluded) {
+					best = _mm256_blendv_ps(best, _mm256_set1_ps(-1.0f), found);
+					if (_mm256_movemask_ps(_mm256_cmp_ps(best, zero, _CMP_LE_OQ)) == 0xff)
+						break;
+				}
+			} else {
+				const bvh_node *c = &b->nodes[n->offset];
+				float side = (c[0].min.x + c[0].max.x - c[1].min.x - c[1].max.x) * first_x +
+					(c[0].min.y + c[0].max.y - c[1].min.y - c[1].max.y) * first_y +
+					(c[0].min.z + c[0].max.z - c[1].min.z - c[1].max.z) * first_z;
+				uint32_t near = n->offset + (side > 0.0f);
+				stack[top++] = 2 * n->offset + 1 - near;
+				node = near;
+				continue;
+			}
+		}
+		if (top == 0)
+			break;
+		node = stack[--top];
+	}
+
+	int found_mask = _mm256_movemask_ps(found) & ((1 << count) - 1);
+	if (occluded) {
+		for (size_t i = 0; i < count; i++)
+			occluded[i] = (found_mask >> i) & 1;
+	} else {
+		float t[8], u[8], v[8];
+		uint32_t triangle[8];
+		_mm256_storeu_ps(t, best);
+		_mm256_storeu_ps(u, best_u);
+		_mm256_storeu_ps(v, best_v);
+		_mm256_storeu_si256((__m256i *)triangle, best_triangle);
+		for (size_t i = 0; i < count; i++) {
+			hits[i] = (bvh_hit){ t[i], u[i], v[i], BVH_NONE };
+			if ((found_mask >> i) & 1)
+				hits[i].triangle = b->triangle_index[triangle[i]];
+		}
+	}
+	return (size_t)__builtin_popcount((unsigned)found_mask);
+}
+
+static int bvh_has_avx2(void) {
+	static int level = -1;
+	int l = __atomic_load_n(&level, __ATOMIC_RELAXED);
+	if (l < 0) {
+		__builtin_cpu_init();
+		l = __builtin_cpu_supports("avx2") ? 1 : 0;
+		__atomic_store_n(&level, l, __ATOMIC_RELAXED);
+	}
+	return l;
+}
+
+#endif // BLIB_BVH_X86
+
+size_t bvh_intersect_packet(const bvh *b, const bvh_ray *rays, size_t count, bvh_hit *hits) {
+	assert(count <= BVH_PACKET_SIZE);
+#ifdef BLIB_BVH_X86
+	if (count && b->node_count && bvh_has_avx2())
+		return bvh_packet_avx2(b, rays, count, hits, NULL);
+#endif
+	size_t n = 0;
+	for (size_t i = 0; i < count; i++) {
+		hits[i] = (bvh_hit){ rays[i].t_max, 0.0f, 0.0f, BVH_NONE };
+		n += bvh_traverse(b, &rays[i], &hits[i], false);
+	}
+	return n;
+}
+
+size_t bvh_occluded_packet(const bvh *b, const bvh_ray *rays, size_t count, bool *occluded) {
+	assert(count <= BVH_PACKET_SIZE);
+#ifdef BLIB_BVH_X86
+	if (count && b->node_count && bvh_has_avx2())
+		return bvh_packet_avx2(b, rays, count, NULL, occluded);
+#endif
+	size_t n = 0;
+	for (size_t i = 0; i < count; i++) {
+		bvh_hit hit;
+		occluded[i] = bvh_traverse(b, &rays[i], &hit, true);
+		n += occluded[i];
+	}
+	return n;
+}
+
+typedef struct {
+	const bvh *b;
+	const bvh_ray *rays;
+	bvh_hit *hits;
+	bool *occluded;
+} bvh_rays_job;
+
+static void bvh_rays_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	(void)thread_index;
+	const bvh_rays_job *job = (const bvh_rays_job *)context;
+	for (size_t i = begin; i < end; i += BVH_PACKET_SIZE) {
+		size_t count = end - i < BVH_PACKET_SIZE ? end - i : BVH_PACKET_SIZE;
+		if (job->occluded)
+			bvh_occluded_packet(job->b, job->rays + i, count, job->occluded + i);
+		else
+			bvh_intersect_packet(job->b, job->rays + i, count, job->hits + i);
+	}
+}
+
+size_t bvh_intersect_rays(const bvh *b, const list_bvh_ray *rays, list_bvh_hit *hits, thread_pool *pool) {
+	size_t count = rays->length;
+	if (hits->capacity < count) {
+		hits->array = realloc(hits->array, sizeof(bvh_hit) * count);
+		hits->capacity = count;
+		BLIB_METRIC_ADD(metrics_list_reallocs, 1);
+	}
+	hits->length = count;
+	bvh_rays_job job = { b, rays->array, hits->array, NULL };
+	thread_pool_run(pool, count, BLIB_BVH_RAY_GRAIN, bvh_rays_task, &job);
+	size_t n = 0;
+	for (size_t i = 0; i < count; i++)
+		n += hits->array[i].triangle != BVH_NONE;
+	return n;
+}
+
+size_t bvh_occluded_rays(const bvh *b, const list_bvh_ray *rays, list_uint8_t *occluded,
+		thread_pool *pool) {
+	size_t count = rays->length;
+	if (occluded->capacity < count) {
+		occluded->array = realloc(occluded->array, sizeof(uint8_t) * count);
+		occluded->capacity = count;
+		BLIB_METRIC_ADD(metrics_list_reallocs, 1);
+	}
+	occluded->length = count;
+	bvh_rays_job job = { b, rays->array, NULL, occluded->array };
+	thread_pool_run(pool, count, BLIB_BVH_RAY_GRAIN, bvh_rays_task, &job);
+	size_t n = 0;
+	for (size_t i = 0; i < count; i++)
+		n += occluded->array[i];
+	return n;
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_BVH_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
@@ -0,0 +1,539 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Fast single precision transcendental functions.
+
+  Each function below is a float-only polynomial approximation with the
+  maximum error given next to it, in ULP (units in the last place) against
+  the correctly rounded result, measured over the stated range. Outside
+  those ranges the error is not bounded unless a function says otherwise.
+
+  The _array forms process 8 floats at a time with AVX2 when the CPU has it
+  and give bit for bit the same results as the scalar functions, as long
+  as the compiler does not contract a * b + c into fused multiply-adds
+  (-std=c99 turns contraction off). fast_rsqrtf() is the exception: it
+  starts from the hardware estimate, which differs between CPU vendors.
+
+  Define BLIB_FAST_MATH to make blib_math.h and blib_math3d.h use these
+  functions instead of libm.*/
+
+#ifndef BLIB_FAST_MATH_H
+#define BLIB_FAST_MATH_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <xmmintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+static inline uint32_t fast_float_bits(float f) {
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+static inline float fast_bits_float(uint32_t u) {
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+/*Same NaN behaviour as the SSE min/max instructions: the second operand
+  wins when either is NaN*/
+static inline float fast_minf(float a, float b) { return a < b ? a : b; }
+static inline float fast_maxf(float a, float b) { return a > b ? a : b; }
+
+/*Rounds to the nearest integer, ties to even, for |x| < 2^22*/
+static inline float fast_roundf(float x) {
+	const float magic = 12582912.0f; // 1.5 * 2^23
+	return (x + magic) - magic;
+}
+
+/*sin(x + quadrant * pi / 2) after reducing x to [-pi/4, pi/4]*/
+static inline float fast_sin_quadrant(float x, uint32_t quadrant) {
+	// Same rounding as fast_roundf(), the low mantissa bits of the shifted
+	// value hold the quadrant.
+	float shifted = x * 0.636619772367581f + 12582912.0f;
+	float q = shifted - 12582912.0f;
+	// pi/2 split into three parts so q * part is exact (Cody-Waite).
+	float r = ((x - q * 1.5703125f) - q * 4.837512969970703125e-4f) - q * 7.54978995489188216e-8f;
+	quadrant += fast_float_bits(shifted);
+	float z = r * r;
+	float s = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * r + r;
+	float c = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z -
+		0.5f * z + 1.0f;
+	float v = quadrant & 1 ? c : s;
+	return fast_bits_float(fast_float_bits(v) ^ ((quadrant & 2) << 30));
+}
+
+/*Above this the three part reduction in fast_sin_quadrant() is no longer
+  exact and larger arguments go to libm*/
+#define FAST_SIN_MAX_REDUCED (8192.0f)
+
+/*Max error 2 ULP for |x| <= pi. Up to |x| = 8192 the absolute error stays
+  below 1e-7, which close to a zero of the function is many ULP. Larger
+  arguments return sinf(x).*/
+static inline float fast_sinf(float x) {
+	if (fabsf(x) > FAST_SIN_MAX_REDUCED)
+		return sinf(x);
+	return fast_sin_quadrant(x, 0);
+}
+
+/*Same error bounds as fast_sinf(), larger arguments return cosf(x)*/
+static inline float fast_cosf(float x) {
+	if (fabsf(x) > FAST_SIN_MAX_REDUCED)
+		return cosf(x);
+	return fast_sin_quadrant(x, 1);
+}
+
+/*Max error 1 ULP over the whole float range, subnormal results included.
+  Results too small for a subnormal are 0, too large for FLT_MAX infinity,
+  NaN returns NaN.*/
+static inline float fast_expf(float x) {
+	float clamped = fast_minf(fast_maxf(x, -104.0f), 88.72283935546875f);
+	float n = fast_roundf(clamped * 1.44269504088896341f);
+	float r = (clamped - n * 0.693359375f) - n * -2.12194440e-4f;
+	float z = r * r;
+	float p = (((((1.9875691500e-4f * r + 1.3981999507e-3f) * r + 8.3334519073e-3f) * r +
+				4.1665795894e-2f) * r + 1.6666665459e-1f) * r + 5.0000001201e-1f) * z + r + 1.0f;
+	// Scale by 2^n in two steps so neither factor leaves the normal range.
+	int32_t e = (int32_t)n;
+	int32_t half = e >> 1;
+	p = p * fast_bits_float((uint32_t)(half + 127) << 23);
+	p = p * fast_bits_float((uint32_t)(e - half + 127) << 23);
+	p = x > 88.72283935546875f ? fast_bits_float(0x7f800000u) : p;
+	// The clamp turned NaN into -104 so the conversion above stays defined.
+	p = x < -104.0f ? 0.0f : p;
+	return x != x ? x : p;
+}
+
+/*x - trunc(x / y) * y, like fmodf() but computed with a division so it
+  loses precision once x / y no longer fits a float mantissa.*/
+static inline float fast_fmodf(float x, float y) {
+	float t = x / y;
+	// Truncate toward zero, exact below 2^23 where every float is already
+	// an integer.
+	float magnitude = fast_bits_float(fast_float_bits(t) & 0x7fffffffu);
+	float whole = fast_roundf(magnitude);
+	whole = whole > magnitude ? whole - 1.0f : whole;
+	whole = magnitude >= 8388608.0f ? magnitude : whole;
+	whole = fast_bits_float(fast_float_bits(whole) | (fast_float_bits(t) & 0x80000000u));
+	return x - whole * y;
+}
+
+/*Natural logarithm of a positive normal float, max error 1 ULP. 0 gives
+  -infinity, negative inputs and NaN give NaN.*/
+static inline float fast_logf(float x) {
+	uint32_t bits = fast_float_bits(x);
+	float e = (float)((int32_t)(bits >> 23) - 127);
+	float m = fast_bits_float((bits & 0x007fffffu) | 0x3f800000u);
+	int big = m > 1.41421356237309505f;
+	m = big ? m * 0.5f : m;
+	e = big ? e + 1.0f : e;
+	float f = m - 1.0f;
+	float z = f * f;
+	float y = ((((((((7.0376836292e-2f * f - 1.1514610310e-1f) * f + 1.1676998740e-1f) * f -
+							1.2420140846e-1f) * f + 1.4249322787e-1f) * f - 1.6668057665e-1f) * f +
+					2.0000714765e-1f) * f - 2.4999993993e-1f) * f + 3.3333331174e-1f) * f * z;
+	y = y + -2.12194440e-4f * e;
+	y = y + -0.5f * z;
+	float result = (f + y) + 0.693359375f * e;
+	result = x == 0.0f ? fast_bits_float(0xff800000u) : result;
+	return !(x >= 0.0f) ? fast_bits_float(0x7fc00000u) : result;
+}
+
+/*x^y for x >= 0 as exp(y * log(x)). The error grows with the size of
+  y * log(x): at most 3 + 2 * |y * log(x)| ULP, so under 200 ULP for
+  results near the ends of the float range and under 10 ULP for results
+  within a factor of 10 of 1. Negative x gives NaN.*/
+static inline float fast_powf(float x, float y) {
+	float p = fast_expf(y * fast_logf(x));
+	return y == 0.0f ? 1.0f : p;
+}
+
+/*1 / sqrt(x) for positive normal x. On x86 the 12 bit hardware estimate
+  refined by one Newton step, max error 5 ULP. Elsewhere a bit-trick
+  estimate refined by three Newton steps, max error 4 ULP.*/
+static inline float fast_rsqrtf(float x) {
+	float h = 0.5f * x;
+#if defined(__GNUC__) && defined(__x86_64__)
+	float y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+#else
+	float y = fast_bits_float(0x5f375a86u - (fast_float_bits(x) >> 1));
+	y = y * (1.5f - h * y * y);
+	y = y * (1.5f - h * y * y);
+#endif
+	return y * (1.5f - h * y * y);
+}
+
+/*atan(t) for t in [0, 1]*/
+static inline float fast_atan_unit(float t) {
+	int big = t > 0.414213562373095f; // tan(pi / 8)
+	float u = big ? (t - 1.0f) / (t + 1.0f) : t;
+	float offset = big ? 0.785398163397448f : 0.0f;
+	float z = u * u;
+	return offset + ((((8.05374449538e-2f * z - 1.38776856032e-1f) * z + 1.99777106478e-1f) * z -
+				3.33329491539e-1f) * z * u + u);
+}
+
+/*Max error 4 ULP for finite inputs. atan2(0, 0) is 0 or pi depending on
+  the sign of x, infinite inputs are not handled.*/
+static inline float fast_atan2f(float y, float x) {
+	float ax = fast_bits_float(fast_float_bits(x) & 0x7fffffffu);
+	float ay = fast_bits_float(fast_float_bits(y) & 0x7fffffffu);
+	float hi = fast_maxf(ax, ay), lo = fast_minf(ax, ay);
+	float t = hi == 0.0f ? 0.0f : lo / hi;
+	float a = fast_atan_unit(t);
+	a = ay > ax ? 1.57079632679489662f - a : a;
+	a = (fast_float_bits(x) >> 31) ? 3.14159265358979324f - a : a;
+	return fast_bits_float(fast_float_bits(a) | (fast_float_bits(y) & 0x80000000u));
+}
+
+/*Batch forms, "in" and "out" may be the same array*/
+void fast_sinf_array(const float *in, float *out, size_t count);
+void fast_cosf_array(const float *in, float *out, size_t count);
+void fast_expf_array(const float *in, float *out, size_t count);
+void fast_logf_array(const float *in, float *out, size_t count);
+void fast_powf_array(const float *x, const float *y, float *out, size_t count);
+void fast_rsqrtf_array(const float *in, float *out, size_t count);
+void fast_atan2f_array(const float *y, const float *x, float *out, size_t count);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_FAST_MATH_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_FAST_MATH_IMPLEMENTATION_H
+#define BLIB_FAST_MATH_IMPLEMENTATION_H
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BLIB_FAST_MATH_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#ifdef BLIB_FAST_MATH_X86
+
+/*The kernels below are the scalar functions above written with
+  intrinsics, one lane per element. Keep the order of operations identical
+  or the batch forms stop matching the scalar ones.*/
+
+__attribute__((target("avx2")))
+static inline __m256 fast_select8(__m256 mask, __m256 if_true, __m256 if_false) {
+	return _mm256_blendv_ps(if_false, if_true, mask);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 fast_sin_quadrant8(__m256 x, uint32_t offset) {
+	const __m256 magic = _mm256_set1_ps(12582912.0f);
+	__m256 shifted = _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(0.636619772367581f)), magic);
+	__m256 q = _mm256_sub_ps(shifted, magic);
+	__m256 r = _mm256_sub_ps(x, _mm256_mul_ps(q, _mm256_set1_ps(1.5703125f)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(q, _mm256_set1_ps(4.837512969970703125e-4f)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(q, _mm256_set1_ps(7.54978995489188216e-8f)));
+	__m256i quadrant = _mm256_add_epi32(_mm256_castps_si256(shifted), _mm256_set1_epi32((int32_t)offset));
+	__m256 z = _mm256_mul_ps(r, r);
+
+	__m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-1.9515295891e-4f), z), _mm256_set1_ps(8.3321608736e-3f));
+	s = _mm256_sub_ps(_mm256_mul_ps(s, z), _mm256_set1_ps(1.6666654611e-1f));
+	s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(s, z), r), r);
+
+	__m256 c = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(2.443315711809948e-5f), z),
+			_mm256_set1_ps(1.388731625493765e-3f));
+	c = _mm256_add_ps(_mm256_mul_ps(c, z), _mm256_set1_ps(4.166664568298827e-2f));
+	c = _mm256_mul_ps(_mm256_mul_ps(c, z), z);
+	c = _mm256_add_ps(_mm256_sub_ps(c, _mm256_mul_ps(_mm256_set1_ps(0.5f), z)), _mm256_set1_ps(1.0f));
+
+	__m256i one = _mm256_set1_epi32(1);
+	__m256 odd = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+	__m256 v = fast_select8(odd, c, s);
+	__m256i sign = _mm256_slli_epi32(_mm256_and_si256(quadrant, _mm256_set1_epi32(2)), 30);
+	return _mm256_xor_ps(v, _mm256_castsi256_ps(sign));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 fast_exp8(__m256 x) {
+	const __m256 low = _mm256_set1_ps(-104.0f), high = _mm256_set1_ps(88.72283935546875f);
+	__m256 clamped = _mm256_min_ps(_mm256_max_ps(x, low), high);
+	const __m256 magic = _mm256_set1_ps(12582912.0f);
+	__m256 n = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(clamped, _mm256_set1_ps(1.44269504088896341f)), magic), magic);
+	__m256 r = _mm256_sub_ps(clamped, _mm256_mul_ps(n, _mm256_set1_ps(0.693359375f)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(n, _mm256_set1_ps(-2.12194440e-4f)));
+	__m256 z = _mm256_mul_ps(r, r);
+
+	__m256 p = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(1.9875691500e-4f), r), _mm256_set1_ps(1.3981999507e-3f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(8.3334519073e-3f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(4.1665795894e-2f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(1.6666665459e-1f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(5.0000001201e-1f));
+	p = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p, z), r), _mm256_set1_ps(1.0f));
+
+	__m256i e = _mm256_cvttps_epi32(n);
+	__m256i half = _mm256_srai_epi32(e, 1);
+	__m256i bias = _mm256_set1_epi32(127);
+	p = _mm256_mul_ps(p, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(half, bias), 23)));
+	p = _mm256_mul_ps(p, _mm256_castsi256_ps(_mm256_slli_epi32(
+					_mm256_add_epi32(_mm256_sub_epi32(e, half), bias), 23)));
+	p = fast_select8(_mm256_cmp_ps(x, high, _CMP_GT_OQ), _mm256_castsi256_ps(_mm256_set1_epi32(0x7f800000)), p);
+	p = fast_select8(_mm256_cmp_ps(x, low, _CMP_LT_OQ), _mm256_setzero_ps(), p);
+	// max/min returned "low" for NaN lanes, put the NaN back.
+	return fast_select8(_mm256_cmp_ps(x, x, _CMP_UNORD_Q), x, p);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 fast_log8(__m256 x) {
+	__m256i bits = _mm256_castps_si256(x);
+	__m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+	__m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)),
+				_mm256_set1_epi32(0x3f800000)));
+	__m256 big = _mm256_cmp_ps(m, _mm256_set1_ps(1.41421356237309505f), _CMP_GT_OQ);
+	m = fast_select8(big, _mm256_mul_ps(m, _mm256_set1_ps(0.5f)), m);
+	e = fast_select8(big, _mm256_add_ps(e, _mm256_set1_ps(1.0f)), e);
+	__m256 f = _mm256_sub_ps(m, _mm256_set1_ps(1.0f));
+	__m256 z = _mm256_mul_ps(f, f);
+
+	__m256 y = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(7.0376836292e-2f), f), _mm256_set1_ps(1.1514610310e-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(1.1676998740e-1f));
+	y = _mm256_sub_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(1.2420140846e-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(1.4249322787e-1f));
+	y = _mm256_sub_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(1.6668057665e-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(2.0000714765e-1f));
+	y = _mm256_sub_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(2.4999993993e-1f));
+	y = _mm256_add_ps(_mm256_mul_ps(y, f), _mm256_set1_ps(3.3333331174e-1f));
+	y = _mm256_mul_ps(_mm256_mul_ps(y, f), z);
+	y = _mm256_add_ps(y, _mm256_mul_ps(_mm256_set1_ps(-2.12194440e-4f), e));
+	y = _mm256_add_ps(y, _mm256_mul_ps(_mm256_set1_ps(-0.5f), z));
+	__m256 result = _mm256_add_ps(_mm256_add_ps(f, y), _mm256_mul_ps(_mm256_set1_ps(0.693359375f), e));
+
+	__m256 zero = _mm256_setzero_ps();
+	result = fast_select8(_mm256_cmp_ps(x, zero, _CMP_EQ_OQ),
+			_mm256_castsi256_ps(_mm256_set1_epi32((int32_t)0xff800000u)), result);
+	return fast_select8(_mm256_cmp_ps(x, zero, _CMP_NGE_UQ),
+			_mm256_castsi256_ps(_mm256_set1_epi32(0x7fc00000)), result);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 fast_rsqrt8(__m256 x) {
+	__m256 h = _mm256_mul_ps(_mm256_set1_ps(0.5f), x);
+	__m256 y = _mm256_rsqrt_ps(x);
+	__m256 k = _mm256_sub_ps(_mm256_set1_ps(1.5f), _mm256_mul_ps(_mm256_mul_ps(h, y), y));
+	return _mm256_mul_ps(y, k);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 fast_atan2_8(__m256 y, __m256 x) {
+	const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	const __m256 sign_mask = _mm256_castsi256_ps(_mm256_set1_epi32((int32_t)0x80000000u));
+	__m256 ax = _mm256_and_ps(x, abs_mask), ay = _mm256_and_ps(y, abs_mask);
+	__m256 hi = _mm256_max_ps(ax, ay), lo = _mm256_min_ps(ax, ay);
+	__m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+	__m256 t = fast_select8(_mm256_cmp_ps(hi, zero, _CMP_EQ_OQ), zero, _mm256_div_ps(lo, hi));
+
+	__m256 big = _mm256_cmp_ps(t, _mm256_set1_ps(0.414213562373095f), _CMP_GT_OQ);
+	__m256 u = fast_select8(big, _mm256_div_ps(_mm256_sub_ps(t, one), _mm256_add_ps(t, one)), t);
+	__m256 offset = fast_select8(big, _mm256_set1_ps(0.785398163397448f), zero);
+	__m256 z = _mm256_mul_ps(u, u);
+	__m256 p = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(8.05374449538e-2f), z), _mm256_set1_ps(1.38776856032e-1f));
+	p = _mm256_add_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(1.99777106478e-1f));
+	p = _mm256_sub_ps(_mm256_mul_ps(p, z), _mm256_set1_ps(3.33329491539e-1f));
+	__m256 a = _mm256_add_ps(offset, _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(p, z), u), u));
+
+	a = fast_select8(_mm256_cmp_ps(ay, ax, _CMP_GT_OQ), _mm256_sub_ps(_mm256_set1_ps(1.57079632679489662f), a), a);
+	__m256 negative_x = _mm256_castsi256_ps(_mm256_srai_epi32(_mm256_castps_si256(x), 31));
+	a = fast_select8(negative_x, _mm256_sub_ps(_mm256_set1_ps(3.14159265358979324f), a), a);
+	return _mm256_or_ps(a, _mm256_and_ps(y, sign_mask));
+}
+
+/*Each returns how many elements it handled, a multiple of 8*/
+
+/*Lanes above FAST_SIN_MAX_REDUCED are redone with libm, like the scalar
+  functions do*/
+__attribute__((target("avx2")))
+static size_t fast_sin_array_avx2(const float *in, float *out, size_t count, uint32_t quadrant) {
+	const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	const __m256 limit = _mm256_set1_ps(FAST_SIN_MAX_REDUCED);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 x = _mm256_loadu_ps(in + i);
+		_mm256_storeu_ps(out + i, fast_sin_quadrant8(x, quadrant));
+		int large = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_and_ps(x, abs_mask), limit, _CMP_GT_OQ));
+		if (large) {
+			// "in" may be "out", so take the inputs from the register.
+			float lanes[8];
+			_mm256_storeu_ps(lanes, x);
+			for (int j = 0; j < 8; j++)
+				if (large & (1 << j))
+					out[i + j] = quadrant ? cosf(lanes[j]) : sinf(lanes[j]);
+		}
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t fast_expf_array_avx2(const float *in, float *out, size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(out + i, fast_exp8(_mm256_loadu_ps(in + i)));
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t fast_logf_array_avx2(const float *in, float *out, size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(out + i, fast_log8(_mm256_loadu_ps(in + i)));
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t fast_powf_array_avx2(const float *x, const float *y, float *out, size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 e = _mm256_loadu_ps(y + i);
+		__m256 p = fast_exp8(_mm256_mul_ps(e, fast_log8(_mm256_loadu_ps(x + i))));
+		p = fast_select8(_mm256_cmp_ps(e, _mm256_setzero_ps(), _CMP_EQ_OQ), _mm256_set1_ps(1.0f), p);
+		_mm256_storeu_ps(out + i, p);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t fast_rsqrtf_array_avx2(const float *in, float *out, size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(out + i, fast_rsqrt8(_mm256_loadu_ps(in + i)));
+	return i;
+}
+
+__attribute__((target("avx2")))
+static size_t fast_atan2f_array_avx2(const float *y, const float *x, float *out, size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps(out + i, fast_atan2_8(_mm256_loadu_ps(y + i), _mm256_loadu_ps(x + i)));
+	return i;
+}
+
+static int fast_math_has_avx2(void) {
+	static int level = -1;
+	int l = __atomic_load_n(&level, __ATOMIC_RELAXED);
+	if (l < 0) {
+		__builtin_cpu_init();
+		l = __builtin_cpu_supports("avx2") ? 1 : 0;
+		__atomic_store_n(&level, l, __ATOMIC_RELAXED);
+	}
+	return l;
+}
+
+#endif // BLIB_FAST_MATH_X86
+
+void fast_sinf_array(const float *in, float *out, size_t count) {
+	size_t i = 0;
+#ifdef BLIB_FAST_MATH_X86
+	if (fast_math_has_avx2())
+		i = fast_sin_array_avx2(in, out, count, 0);
+#endif
+	for (; i < count; i++)
+		out[i] = fast_sinf(in[i]);
+}
+
+void fast_cosf_array(const float *in, float *out, size_t count) {
+	size_t i = 0;
+#ifdef BLIB_FAST_MATH_X86
+	if (fast_math_has_avx2())
+		i = fast_sin_array_avx2(in, out, count, 1);
+#endif
+	for (; i < count; i++)
+		out[i] = fast_cosf(in[i]);
+}
+
+void fast_expf_array(const float *in, float *out, size_t count) {
+	size_t i = 0;
+#ifdef BLIB_FAST_MATH_X86
+	if (fast_math_has_avx2())
+		i = fast_expf_array_avx2(in, out, count);
+#endif
+	for (; i < count; i++)
+		out[i] = fast_expf(in[i]);
+}
+
+void fast_logf_array(const float *in, float *out, size_t count) {
+	size_t i = 0;
+#ifdef BLIB_FAST_MATH_X86
+	if (fast_math_has_avx2())
+		i = fast_logf_array_avx2(in, out, count);
+#endif
+	for (; i < count; i++)
+		out[i] = fast_logf(in[i]);
+}
+
+void fast_powf_array(const float *x, const float *y, float *out, size_t count) {
+	size_t i = 0;
+#ifdef BLIB_FAST_MATH_X86
+	if (fast_math_has_avx2())
+		i = fast_powf_array_avx2(x, y, out, count);
+#endif
+	for (; i < count; i++)
+		out[i] = fast_powf(x[i], y[i]);
+}
+
+void fast_rsqrtf_array(const float *in, float *out, size_t count) {
+	size_t i = 0;
+#ifdef BLIB_FAST_MATH_X86
+	if (fast_math_has_avx2())
+		i = fast_rsqrtf_array_avx2(in, out, count);
+#endif
+	for (; i < count; i++)
+		out[i] = fast_rsqrtf(in[i]);
+}
+
+void fast_atan2f_array(const float *y, const float *x, float *out, size_t count) {
+	size_t i = 0;
+#ifdef BLIB_FAST_MATH_X86
+	if (fast_math_has_avx2())
+		i = fast_atan2f_array_avx2(y, x, out, count);
+#endif
+	for (; i < count; i++)
+		out[i] = fast_atan2f(y[i], x[i]);
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_FAST_MATH_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
@@ -29,6 +29,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "blib.h"
 
 #define BLIB_FILE_BUFFER_CHUNK_SIZE (64 /* chars */)
@@ -68,6 +72,7 @@ static inline file_buffer file_buffer_alloc(const char *filename) {
 	}
 	buf[length] = '\0';
 	fclose(file);
+	BLIB_METRIC_ADD(metrics_file_bytes_read, length);
 	file_buffer ret;
 	ret.text = buf;
 	ret.length = length;
@@ -77,6 +82,47 @@ static inline file_buffer file_buffer_alloc(const char *filename) {
 
 static inline void file_buffer_free(const file_buffer file) { free(file.text); }
 
+/*A read only memory mapping of a whole file. Unlike file_buffer nothing is
+  copied up front, pages are loaded by the OS as they are touched. The data
+  is NOT NUL terminated.*/
+typedef struct {
+	size_t length;
+	const char *data;
+	bool error : 1;
+} file_view;
+
+static inline file_view file_view_map(const char *filename) {
+	file_view ret;
+	ret.length = 0;
+	ret.data = "";
+	ret.error = true;
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return ret;
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		return ret;
+	}
+	ret.error = false;
+	if (info.st_size > 0) {
+		void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			ret.error = true;
+		} else {
+			ret.data = (const char *)data;
+			ret.length = (size_t)info.st_size;
+		}
+	}
+	close(fd);
+	return ret;
+}
+
+static inline void file_view_unmap(const file_view view) {
+	if (view.length)
+		munmap((void *)view.data, view.length);
+}
+
 #ifdef __cplusplus
 } //extern "C" {
 #endif // __cplusplus
@@ -0,0 +1,306 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*View frustum culling.
+
+  frustum_from_matrix4() pulls the six clip planes out of a
+  view-projection matrix. The batch functions test bounds stored as a
+  structure of arrays, eight at a time with AVX2, and write the indices
+  of the ones that may be visible, in ascending order, to a list. Above
+  BLIB_FRUSTUM_PARALLEL_COUNT objects the work is split across a thread
+  pool. Every path gives the same list as the scalar frustum_test_aabb()
+  and frustum_test_sphere().
+
+  The tests are conservative: a box near a frustum corner can pass
+  although it is outside, nothing visible is ever culled.*/
+
+#ifndef BLIB_FRUSTUM_H
+#define BLIB_FRUSTUM_H
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blib.h"
+#include "blib_math3d.h"
+#include "blib_math_soa.h"
+#include "blib_thread.h"
+
+/*Object counts from which the batch functions use the thread pool*/
+#define BLIB_FRUSTUM_PARALLEL_COUNT (100000 /* objects */)
+
+/*Objects per thread pool task*/
+#define BLIB_FRUSTUM_GRAIN (16384 /* objects */)
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+enum {
+	FRUSTUM_LEFT,
+	FRUSTUM_RIGHT,
+	FRUSTUM_BOTTOM,
+	FRUSTUM_TOP,
+	FRUSTUM_NEAR,
+	FRUSTUM_FAR,
+	FRUSTUM_PLANE_COUNT
+};
+
+/*Each plane is a unit normal in x, y, z pointing into the frustum and an
+  offset in w, a point p is inside when dot(normal, p) + w >= 0*/
+typedef struct {
+	vector4_t planes[FRUSTUM_PLANE_COUNT];
+} frustum_t;
+
+/*"view_projection" is matrix4_multiply(view, projection), for example
+  with matrix4_lookAt() and matrix4_perspective(), so that
+  matrix4_transform_vector4() takes a world point to clip space with the
+  visible volume at -w <= x, y, z <= w.*/
+static inline frustum_t 
+frustum_from_matrix4(const matrix4_t view_projection) {
+	const float *e = view_projection.elements;
+	frustum_t f;
+	for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+		// Row r of the clip transform is elements r, 4 + r, 8 + r, 12 + r.
+		int r = i / 2;
+		float sign = i % 2 ? -1.0f : 1.0f;
+		vector4_t p = {
+			.x = e[3] + sign * e[r],
+			.y = e[7] + sign * e[4 + r],
+			.z = e[11] + sign * e[8 + r],
+			.w = e[15] + sign * e[12 + r],
+		};
+		float length = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+		f.planes[i] = (vector4_t){ p.x / length, p.y / length, p.z / length, p.w / length };
+	}
+	return f;
+}
+
+/*Tests the corner furthest along each plane normal*/
+static inline bool 
+frustum_test_aabb(const frustum_t *f, aabb_t box) {
+	for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+		vector4_t p = f->planes[i];
+		float d = p.x * (p.x > 0.0f ? box.max.x : box.min.x) + p.y * (p.y > 0.0f ? box.max.y : box.min.y) +
+			p.z * (p.z > 0.0f ? box.max.z : box.min.z) + p.w;
+		if (d < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+static inline bool 
+frustum_test_sphere(const frustum_t *f, sphere_t sphere) {
+	for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++) {
+		vector4_t p = f->planes[i];
+		float d = p.x * sphere.center.x + p.y * sphere.center.y + p.z * sphere.center.z + p.w;
+		if (d < -sphere.radius)
+			return false;
+	}
+	return true;
+}
+
+/*Boxes i = (min[i], max[i]), both containers of equal length. Replaces
+  the contents of "visible" and returns its length. "pool" may be NULL.*/
+size_t frustum_cull_aabbs(const frustum_t *f, const vector3_soa *min, const vector3_soa *max,
+		list_uint32_t *visible, thread_pool *pool);
+
+/*Spheres with the center in x, y, z and the radius in w*/
+size_t frustum_cull_spheres(const frustum_t *f, const vector4_soa *spheres, list_uint32_t *visible,
+		thread_pool *pool);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_FRUSTUM_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_FRUSTUM_IMPLEMENTATION_H
+#define BLIB_FRUSTUM_IMPLEMENTATION_H
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BLIB_FRUSTUM_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/*For boxes "near" holds, per plane, the component arrays of the corner
+  that plane tests and "radius" is NULL. For spheres every plane gets the
+  centers and "radius" holds the radii.*/
+typedef struct {
+	const frustum_t *f;
+	const float *near[FRUSTUM_PLANE_COUNT][3];
+	const float *radius;
+	uint32_t *out;
+	size_t *counts;
+} frustum_job;
+
+static size_t frustum_cull_scalar(const frustum_job *job, size_t begin, size_t end, uint32_t *out) {
+	size_t n = 0;
+	for (size_t i = begin; i < end; i++) {
+		bool inside = true;
+		for (int k = 0; k < FRUSTUM_PLANE_COUNT && inside; k++) {
+			vector4_t p = job->f->planes[k];
+			const float *const *c = job->near[k];
+			float d = p.x * c[0][i] + p.y * c[1][i] + p.z * c[2][i] + p.w;
+			inside = job->radius ? !(d < -job->radius[i]) : !(d < 0.0f);
+		}
+		out[n] = (uint32_t)i;
+		n += inside;
+	}
+	return n;
+}
+
+#ifdef BLIB_FRUSTUM_X86
+
+/*Eight objects per step, all six planes, then the surviving lanes are
+  appended in order. Never writes past out + (end - begin).*/
+__attribute__((target("avx2")))
+static size_t frustum_cull_avx2(const frustum_job *job, size_t begin, size_t end, uint32_t *out) {
+	__m256 px[FRUSTUM_PLANE_COUNT], py[FRUSTUM_PLANE_COUNT], pz[FRUSTUM_PLANE_COUNT], pw[FRUSTUM_PLANE_COUNT];
+	for (int k = 0; k < FRUSTUM_PLANE_COUNT; k++) {
+		px[k] = _mm256_set1_ps(job->f->planes[k].x);
+		py[k] = _mm256_set1_ps(job->f->planes[k].y);
+		pz[k] = _mm256_set1_ps(job->f->planes[k].z);
+		pw[k] = _mm256_set1_ps(job->f->planes[k].w);
+	}
+	const __m256 sign_mask = _mm256_castsi256_ps(_mm256_set1_epi32((int32_t)0x80000000u));
+	size_t n = 0, i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 limit = job->radius ? _mm256_xor_ps(_mm256_loadu_ps(job->radius + i), sign_mask)
+			: _mm256_setzero_ps();
+		__m256 outside = _mm256_setzero_ps();
+		for (int k = 0; k < FRUSTUM_PLANE_COUNT; k++) {
+			const float *const *c = job->near[k];
+			__m256 d = _mm256_add_ps(_mm256_mul_ps(px[k], _mm256_loadu_ps(c[0] + i)),
+				_mm256_mul_ps(py[k], _mm256_loadu_ps(c[1] + i)));
+			d = _mm256_add_ps(d, _mm256_mul_ps(pz[k], _mm256_loadu_ps(c[2] + i)));
+			d = _mm256_add_ps(d, pw[k]);
+			outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, limit, _CMP_LT_OQ));
+		}
+		unsigned mask = ~(unsigned)_mm256_movemask_ps(outside) & 0xffu;
+		while (mask) {
+			out[n++] = (uint32_t)(i + (size_t)__builtin_ctz(mask));
+			mask &= mask - 1;
+		}
+	}
+	return n + frustum_cull_scalar(job, i, end, out + n);
+}
+
+static int frustum_has_avx2(void) {
+	static int level = -1;
+	int l = __atomic_load_n(&level, __ATOMIC_RELAXED);
+	if (l < 0) {
+		__builtin_cpu_init();
+		l = __builtin_cpu_supports("avx2") ? 1 : 0;
+		__atomic_store_n(&level, l, __ATOMIC_RELAXED);
+	}
+	return l;
+}
+
+#endif // BLIB_FRUSTUM_X86
+
+static size_t frustum_cull_range(const frustum_job *job, size_t begin, size_t end, uint32_t *out) {
+#ifdef BLIB_FRUSTUM_X86
+	if (frustum_has_avx2())
+		return frustum_cull_avx2(job, begin, end, out);
+#endif
+	return frustum_cull_scalar(job, begin, end, out);
+}
+
+/*Each chunk writes its survivors at its own offset, they are moved
+  together afterwards*/
+static void frustum_cull_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	(void)thread_index;
+	frustum_job *job = (frustum_job *)context;
+	job->counts[begin / BLIB_FRUSTUM_GRAIN] = frustum_cull_range(job, begin, end, job->out + begin);
+}
+
+static size_t frustum_cull(frustum_job *job, size_t count, list_uint32_t *visible, thread_pool *pool) {
+	if (visible->capacity < count) {
+		visible->array = realloc(visible->array, sizeof(uint32_t) * count);
+		visible->capacity = count;
+		BLIB_METRIC_ADD(metrics_list_reallocs, 1);
+	}
+	job->out = visible->array;
+	size_t n = 0;
+	if (pool && count >= BLIB_FRUSTUM_PARALLEL_COUNT) {
+		size_t chunks = (count + BLIB_FRUSTUM_GRAIN - 1) / BLIB_FRUSTUM_GRAIN;
+		job->counts = malloc(sizeof(size_t) * chunks);
+		thread_pool_run(pool, count, BLIB_FRUSTUM_GRAIN, frustum_cull_task, job);
+		for (size_t c = 0; c < chunks; c++) {
+			memmove(visible->array + n, visible->array + c * BLIB_FRUSTUM_GRAIN, sizeof(uint32_t) * job->counts[c]);
+			n += job->counts[c];
+		}
+		free(job->counts);
+	} else {
+		n = frustum_cull_range(job, 0, count, visible->array);
+	}
+	visible->length = n;
+	return n;
+}
+
+size_t frustum_cull_aabbs(const frustum_t *f, const vector3_soa *min, const vector3_soa *max,
+		list_uint32_t *visible, thread_pool *pool) {
+	assert(min->length == max->length);
+	frustum_job job;
+	memset(&job, 0, sizeof(job));
+	job.f = f;
+	for (int k = 0; k < FRUSTUM_PLANE_COUNT; k++) {
+		// The corner furthest along the normal, picked once per plane.
+		vector4_t p = f->planes[k];
+		job.near[k][0] = p.x > 0.0f ? max->x : min->x;
+		job.near[k][1] = p.y > 0.0f ? max->y : min->y;
+		job.near[k][2] = p.z > 0.0f ? max->z : min->z;
+	}
+	return frustum_cull(&job, min->length, visible, pool);
+}
+
+size_t frustum_cull_spheres(const frustum_t *f, const vector4_soa *spheres, list_uint32_t *visible,
+		thread_pool *pool) {
+	frustum_job job;
+	memset(&job, 0, sizeof(job));
+	job.f = f;
+	for (int k = 0; k < FRUSTUM_PLANE_COUNT; k++) {
+		job.near[k][0] = spheres->x;
+		job.near[k][1] = spheres->y;
+		job.near[k][2] = spheres->z;
+	}
+	job.radius = spheres->w;
+	return frustum_cull(&job, spheres->length, visible, pool);
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_FRUSTUM_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
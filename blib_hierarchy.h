@@ -0,0 +1,451 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Transform hierarchy with lazy world transform updates.
+
+  Nodes are stored as a structure of arrays in breadth-first order, so
+  every parent comes before its children and the nodes of one depth are
+  contiguous. hierarchy_update() walks the arrays once, front to back, and
+  recomputes a world transform only when the node's own transform was
+  set or its parent's world transform changed in the same pass. A static
+  scene costs nothing, a mostly static one about one flag test per node.
+
+  The nodes of one depth never depend on each other, so deep levels are
+  split across a thread pool; they are the siblings and cousins of
+  independent subtrees.
+
+  Nodes are referred to by hierarchy_node handles, which stay valid until
+  the node is removed. Adding, removing or reparenting nodes only marks
+  the order stale, the next hierarchy_update() restores it.*/
+
+#ifndef BLIB_HIERARCHY_H
+#define BLIB_HIERARCHY_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blib.h"
+#include "blib_math3d.h"
+#include "blib_thread.h"
+
+/*Depth levels with at least twice this many nodes are split into chunks
+  of this size across the thread pool, smaller ones run on the calling
+  thread*/
+#define BLIB_HIERARCHY_GRAIN (2048 /* nodes */)
+
+#define HIERARCHY_NONE UINT32_MAX
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef uint32_t hierarchy_node;
+
+enum {
+	HIERARCHY_LOCAL_DIRTY = 1,   // rebuild the local transform from position, rotation and scale
+	HIERARCHY_WORLD_DIRTY = 2,   // recompute the world transform
+	HIERARCHY_WORLD_CHANGED = 4, // the world transform changed in the last update
+	HIERARCHY_REMOVED = 8
+};
+
+typedef struct {
+	// Per node, indexed in breadth-first order.
+	size_t length;
+	size_t capacity;
+	uint32_t *parent;          // index of the parent, HIERARCHY_NONE for roots
+	uint32_t *first_child;     // children of i are [first_child[i], first_child[i + 1]) once sorted
+	hierarchy_node *handle;
+	vector3_t *position;
+	quaternion_t *rotation;
+	vector3_t *scale;
+	affine3_t *local;
+	affine3_t *world;
+	uint8_t *flags;
+
+	// Per handle.
+	size_t handle_count;
+	size_t handle_capacity;
+	uint32_t *index;           // node index, HIERARCHY_NONE for a free handle
+	hierarchy_node *free_handles;
+	size_t free_count;
+
+	// levels[d] is the index of the first node at depth d, and
+	// levels[level_count] is the length.
+	size_t *levels;
+	size_t level_count;
+	size_t level_capacity;
+
+	bool sorted;
+	bool dirty;
+	bool changed;
+} hierarchy;
+
+hierarchy hierarchy_alloc(void);
+void hierarchy_free(hierarchy *h);
+
+/*Adds a node under "parent", or a root for HIERARCHY_NONE*/
+hierarchy_node hierarchy_add(hierarchy *h, hierarchy_node parent, vector3_t position,
+		quaternion_t rotation, vector3_t scale);
+
+/*Removes the node and everything below it. Their handles are reused.*/
+void hierarchy_remove(hierarchy *h, hierarchy_node node);
+
+/*Moves the node and its subtree under "parent", or makes it a root for
+  HIERARCHY_NONE. "parent" must not be inside the subtree.*/
+void hierarchy_set_parent(hierarchy *h, hierarchy_node node, hierarchy_node parent);
+
+/*Brings the order and every stale world transform up to date. Returns
+  how many world transforms were recomputed. "pool" may be NULL.*/
+size_t hierarchy_update(hierarchy *h, thread_pool *pool);
+
+static inline uint32_t hierarchy_index(const hierarchy *h, hierarchy_node node) {
+	assert(node < h->handle_count && h->index[node] != HIERARCHY_NONE);
+	return h->index[node];
+}
+
+static inline void hierarchy_mark(hierarchy *h, uint32_t i, uint8_t flags) {
+	h->flags[i] |= flags;
+	h->dirty = true;
+}
+
+static inline void hierarchy_set_position(hierarchy *h, hierarchy_node node, vector3_t position) {
+	uint32_t i = hierarchy_index(h, node);
+	h->position[i] = position;
+	hierarchy_mark(h, i, HIERARCHY_LOCAL_DIRTY | HIERARCHY_WORLD_DIRTY);
+}
+
+static inline void hierarchy_set_rotation(hierarchy *h, hierarchy_node node, quaternion_t rotation) {
+	uint32_t i = hierarchy_index(h, node);
+	h->rotation[i] = rotation;
+	hierarchy_mark(h, i, HIERARCHY_LOCAL_DIRTY | HIERARCHY_WORLD_DIRTY);
+}
+
+static inline void hierarchy_set_scale(hierarchy *h, hierarchy_node node, vector3_t scale) {
+	uint32_t i = hierarchy_index(h, node);
+	h->scale[i] = scale;
+	hierarchy_mark(h, i, HIERARCHY_LOCAL_DIRTY | HIERARCHY_WORLD_DIRTY);
+}
+
+/*Overrides the local transform until the next position, rotation or
+  scale change. Use affine3_from_matrix4() for matrix4_t locals.*/
+static inline void hierarchy_set_local(hierarchy *h, hierarchy_node node, affine3_t local) {
+	uint32_t i = hierarchy_index(h, node);
+	h->local[i] = local;
+	h->flags[i] &= (uint8_t)~HIERARCHY_LOCAL_DIRTY;
+	hierarchy_mark(h, i, HIERARCHY_WORLD_DIRTY);
+}
+
+static inline affine3_t hierarchy_local(const hierarchy *h, hierarchy_node node) {
+	return h->local[hierarchy_index(h, node)];
+}
+
+/*As of the last hierarchy_update()*/
+static inline affine3_t hierarchy_world(const hierarchy *h, hierarchy_node node) {
+	return h->world[hierarchy_index(h, node)];
+}
+
+static inline matrix4_t hierarchy_world_matrix4(const hierarchy *h, hierarchy_node node) {
+	return matrix4_from_affine3(hierarchy_world(h, node));
+}
+
+/*Whether the last hierarchy_update() recomputed the node's world
+  transform, for refitting bounds or uploading only what moved*/
+static inline bool hierarchy_world_changed(const hierarchy *h, hierarchy_node node) {
+	return (h->flags[hierarchy_index(h, node)] & HIERARCHY_WORLD_CHANGED) != 0;
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_HIERARCHY_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_HIERARCHY_IMPLEMENTATION_H
+#define BLIB_HIERARCHY_IMPLEMENTATION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+static void *hierarchy_grow(void *array, size_t size, size_t capacity) {
+	array = realloc(array, size * capacity);
+	BLIB_METRIC_ADD(metrics_list_reallocs, 1);
+	return array;
+}
+
+hierarchy hierarchy_alloc(void) {
+	hierarchy h;
+	memset(&h, 0, sizeof(h));
+	h.sorted = true;
+	return h;
+}
+
+void hierarchy_free(hierarchy *h) {
+	free(h->parent);
+	free(h->first_child);
+	free(h->handle);
+	free(h->position);
+	free(h->rotation);
+	free(h->scale);
+	free(h->local);
+	free(h->world);
+	free(h->flags);
+	free(h->index);
+	free(h->free_handles);
+	free(h->levels);
+	memset(h, 0, sizeof(*h));
+}
+
+hierarchy_node hierarchy_add(hierarchy *h, hierarchy_node parent, vector3_t position,
+		quaternion_t rotation, vector3_t scale) {
+	uint32_t parent_index = parent == HIERARCHY_NONE ? HIERARCHY_NONE : hierarchy_index(h, parent);
+	if (h->length == h->capacity) {
+		size_t capacity = h->capacity ? h->capacity * 2 : 64;
+		h->parent = hierarchy_grow(h->parent, sizeof(*h->parent), capacity);
+		h->first_child = hierarchy_grow(h->first_child, sizeof(*h->first_child), capacity + 1);
+		h->handle = hierarchy_grow(h->handle, sizeof(*h->handle), capacity);
+		h->position = hierarchy_grow(h->position, sizeof(*h->position), capacity);
+		h->rotation = hierarchy_grow(h->rotation, sizeof(*h->rotation), capacity);
+		h->scale = hierarchy_grow(h->scale, sizeof(*h->scale), capacity);
+		h->local = hierarchy_grow(h->local, sizeof(*h->local), capacity);
+		h->world = hierarchy_grow(h->world, sizeof(*h->world), capacity);
+		h->flags = hierarchy_grow(h->flags, sizeof(*h->flags), capacity);
+		h->capacity = capacity;
+	}
+	hierarchy_node node;
+	if (h->free_count) {
+		node = h->free_handles[--h->free_count];
+	} else {
+		if (h->handle_count == h->handle_capacity) {
+			size_t capacity = h->handle_capacity ? h->handle_capacity * 2 : 64;
+			h->index = hierarchy_grow(h->index, sizeof(*h->index), capacity);
+			h->free_handles = hierarchy_grow(h->free_handles, sizeof(*h->free_handles), capacity);
+			h->handle_capacity = capacity;
+		}
+		node = (hierarchy_node)h->handle_count++;
+	}
+
+	// Appending keeps parents in front of their children, but the new node
+	// may belong to an earlier depth.
+	size_t i = h->length++;
+	h->index[node] = (uint32_t)i;
+	h->parent[i] = parent_index;
+	h->handle[i] = node;
+	h->position[i] = position;
+	h->rotation[i] = rotation;
+	h->scale[i] = scale;
+	h->flags[i] = HIERARCHY_LOCAL_DIRTY | HIERARCHY_WORLD_DIRTY;
+	h->sorted = false;
+	h->dirty = true;
+	return node;
+}
+
+void hierarchy_remove(hierarchy *h, hierarchy_node node) {
+	// The subtree is dropped when hierarchy_update() restores the order.
+	h->flags[hierarchy_index(h, node)] |= HIERARCHY_REMOVED;
+	h->sorted = false;
+	h->dirty = true;
+}
+
+void hierarchy_set_parent(hierarchy *h, hierarchy_node node, hierarchy_node parent) {
+	uint32_t i = hierarchy_index(h, node);
+	uint32_t p = parent == HIERARCHY_NONE ? HIERARCHY_NONE : hierarchy_index(h, parent);
+	for (uint32_t a = p; a != HIERARCHY_NONE; a = h->parent[a])
+		assert(a != i);
+	h->parent[i] = p;
+	h->sorted = false;
+	hierarchy_mark(h, i, HIERARCHY_WORLD_DIRTY);
+}
+
+/*Reorders "array" so that element k is the old element order[k]*/
+static void hierarchy_permute(void *array, size_t size, const uint32_t *order, size_t count, void *scratch) {
+	char *from = (char *)array, *to = (char *)scratch;
+	for (size_t k = 0; k < count; k++)
+		memcpy(to + k * size, from + (size_t)order[k] * size, size);
+	memcpy(array, scratch, count * size);
+}
+
+/*Breadth-first order from the roots, which also drops removed subtrees
+  and records where each depth starts. The children of a node end up next
+  to each other.*/
+static void hierarchy_sort(hierarchy *h) {
+	size_t n = h->length;
+	uint32_t *first = calloc(n + 1, sizeof(uint32_t));
+	uint32_t *children = malloc(sizeof(uint32_t) * (n ? n : 1));
+	uint32_t *order = malloc(sizeof(uint32_t) * (n ? n : 1));
+	uint32_t *moved = malloc(sizeof(uint32_t) * (n ? n : 1));
+
+	// Children of every node, contiguous and in index order.
+	for (size_t i = 0; i < n; i++)
+		if (h->parent[i] != HIERARCHY_NONE)
+			first[h->parent[i] + 1]++;
+	for (size_t i = 0; i < n; i++)
+		first[i + 1] += first[i];
+	memcpy(moved, first, sizeof(uint32_t) * n);
+	for (size_t i = 0; i < n; i++)
+		if (h->parent[i] != HIERARCHY_NONE)
+			children[moved[h->parent[i]]++] = (uint32_t)i;
+
+	size_t count = 0;
+	for (size_t i = 0; i < n; i++)
+		if (h->parent[i] == HIERARCHY_NONE && !(h->flags[i] & HIERARCHY_REMOVED))
+			order[count++] = (uint32_t)i;
+	h->level_count = 0;
+	if (!h->level_capacity) {
+		h->level_capacity = 16;
+		h->levels = hierarchy_grow(h->levels, sizeof(*h->levels), h->level_capacity);
+	}
+	size_t level_end = 0;
+	for (size_t head = 0; head < count; head++) {
+		if (head == level_end) {
+			if (h->level_count + 2 > h->level_capacity) {
+				h->level_capacity = h->level_capacity ? h->level_capacity * 2 : 16;
+				h->levels = hierarchy_grow(h->levels, sizeof(*h->levels), h->level_capacity);
+			}
+			h->levels[h->level_count++] = head;
+			level_end = count;
+		}
+		uint32_t i = order[head];
+		h->first_child[head] = (uint32_t)count;
+		for (uint32_t c = first[i]; c < first[i + 1]; c++)
+			if (!(h->flags[children[c]] & HIERARCHY_REMOVED))
+				order[count++] = children[c];
+	}
+	h->levels[h->level_count] = count;
+	h->first_child[count] = (uint32_t)count;
+
+	// Free the handles of everything not reached, then renumber parents.
+	for (size_t i = 0; i < n; i++)
+		moved[i] = HIERARCHY_NONE;
+	for (size_t k = 0; k < count; k++)
+		moved[order[k]] = (uint32_t)k;
+	for (size_t i = 0; i < n; i++) {
+		if (moved[i] == HIERARCHY_NONE) {
+			h->index[h->handle[i]] = HIERARCHY_NONE;
+			h->free_handles[h->free_count++] = h->handle[i];
+		}
+	}
+	for (size_t i = 0; i < n; i++)
+		if (h->parent[i] != HIERARCHY_NONE)
+			h->parent[i] = moved[h->parent[i]];
+
+	void *scratch = malloc(sizeof(affine3_t) * (n ? n : 1));
+	hierarchy_permute(h->parent, sizeof(*h->parent), order, count, scratch);
+	hierarchy_permute(h->handle, sizeof(*h->handle), order, count, scratch);
+	hierarchy_permute(h->position, sizeof(*h->position), order, count, scratch);
+	hierarchy_permute(h->rotation, sizeof(*h->rotation), order, count, scratch);
+	hierarchy_permute(h->scale, sizeof(*h->scale), order, count, scratch);
+	hierarchy_permute(h->local, sizeof(*h->local), order, count, scratch);
+	hierarchy_permute(h->world, sizeof(*h->world), order, count, scratch);
+	hierarchy_permute(h->flags, sizeof(*h->flags), order, count, scratch);
+	for (size_t k = 0; k < count; k++)
+		h->index[h->handle[k]] = (uint32_t)k;
+	h->length = count;
+	h->sorted = true;
+
+	free(scratch);
+	free(first);
+	free(children);
+	free(order);
+	free(moved);
+}
+
+typedef struct {
+	hierarchy *h;
+	size_t offset;
+	size_t changed;
+} hierarchy_update_job;
+
+/*A recomputed node marks its children, which sit together at the next
+  depth, so clean nodes are skipped eight flags at a time and the parent
+  is only read for nodes that need it*/
+static size_t hierarchy_update_range(hierarchy *h, size_t begin, size_t end) {
+	uint8_t *flags = h->flags;
+	const uint32_t *parent = h->parent, *first_child = h->first_child;
+	size_t changed = 0;
+	for (size_t i = begin; i < end; i++) {
+		uint64_t word;
+		while (i + 8 <= end && (memcpy(&word, flags + i, 8), word == 0))
+			i += 8;
+		if (i == end)
+			break;
+		uint8_t f = flags[i];
+		if (!(f & HIERARCHY_WORLD_DIRTY)) {
+			flags[i] = 0;
+			continue;
+		}
+		uint32_t p = parent[i];
+		if (f & HIERARCHY_LOCAL_DIRTY)
+			h->local[i] = affine3_from_trs(h->position[i], h->rotation[i], h->scale[i]);
+		h->world[i] = p == HIERARCHY_NONE ? h->local[i] : affine3_multiply(h->local[i], h->world[p]);
+		flags[i] = HIERARCHY_WORLD_CHANGED;
+		for (uint32_t c = first_child[i]; c < first_child[i + 1]; c++)
+			flags[c] |= HIERARCHY_WORLD_DIRTY;
+		changed++;
+	}
+	return changed;
+}
+
+static void hierarchy_update_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	(void)thread_index;
+	hierarchy_update_job *job = (hierarchy_update_job *)context;
+	size_t changed = hierarchy_update_range(job->h, job->offset + begin, job->offset + end);
+	__atomic_fetch_add(&job->changed, changed, __ATOMIC_RELAXED);
+}
+
+size_t hierarchy_update(hierarchy *h, thread_pool *pool) {
+	if (!h->sorted)
+		hierarchy_sort(h);
+	if (!h->dirty) {
+		// Nothing was marked, only last update's change flags need clearing.
+		if (h->changed)
+			memset(h->flags, 0, h->length);
+		h->changed = false;
+		return 0;
+	}
+	hierarchy_update_job job = { h, 0, 0 };
+	for (size_t d = 0; d < h->level_count; d++) {
+		size_t begin = h->levels[d], end = h->levels[d + 1];
+		if (pool && end - begin >= 2 * BLIB_HIERARCHY_GRAIN) {
+			job.offset = begin;
+			thread_pool_run(pool, end - begin, BLIB_HIERARCHY_GRAIN, hierarchy_update_task, &job);
+		} else {
+			job.changed += hierarchy_update_range(h, begin, end);
+		}
+	}
+	h->dirty = false;
+	h->changed = job.changed != 0;
+	return job.changed;
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_HIERARCHY_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
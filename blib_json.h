@@ -11,6 +11,17 @@ extern "C" {
 #include <ctype.h>
 
 #include "blib_file.h"
+#include "blib_arena.h"
+#include "blib_thread.h"
+
+/*Number of NDJSON lines a worker claims at a time in json_parse_ndjson()*/
+#define BLIB_JSON_NDJSON_GRAIN (256 /* lines */)
+
+/*Objects and arrays nested deeper than this fail the parse, the parser
+  recurses once per level*/
+#ifndef BLIB_JSON_MAX_DEPTH
+#define BLIB_JSON_MAX_DEPTH (512 /* levels */)
+#endif
 
 enum {
 	JSON_VALUE_STRING,
@@ -21,15 +32,46 @@ enum {
 	JSON_VALUE_NULL,
 }; typedef uint8_t json_value_type;
 
+/*A string as it appears in the source text, without the quotes. When
+  "escaped" is set the bytes still contain backslash escapes and must be run
+  through json_string_unescape() before use. The data is not NUL terminated.*/
+typedef struct {
+	const char *data;
+	size_t length;
+	bool escaped;
+} json_string_view;
+
 typedef struct json_value {
 	json_value_type type;
 	list_char string;
+	json_string_view view;
 	double number;
 	uint8_t boolean;
 	uint8_t is_null;
 	list_void_ptr children;
 } json_value;
 
+/*The result of json_parse_ndjson(). "records" holds one root json_value per
+  non-empty input line, in input order, or NULL where the arena ran out of
+  memory or the line nests deeper than BLIB_JSON_MAX_DEPTH. Every node lives in one of the per-thread "arenas" so the whole
+  batch is released by json_batch_free().*/
+typedef struct {
+	list_void_ptr records;
+	memory_arena *arenas;
+	size_t arena_count;
+} json_batch;
+
+void json_free(json_value *json);
+void json_print(json_value *json);
+json_value *json_parse(char* c, const size_t string_length);
+json_value *json_parse_arena(const char *c, const size_t string_length, memory_arena *arena);
+json_value *json_parse_views(const char *c, const size_t string_length, memory_arena *arena);
+size_t json_string_unescape(const json_string_view view, char *out);
+bool json_string_equal(const json_string_view view, const char *string);
+json_value *json_read(const char *path_to_file);
+json_batch json_parse_ndjson(const char *text, const size_t length, thread_pool *pool);
+void json_batch_free(json_batch *batch);
+
 #ifdef __cplusplus
 } // extern "C" {
 #endif //ifdef __cplusplus
@@ -37,6 +79,8 @@ typedef struct json_value {
 #endif // BLIB_JSON_H
 
 #ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_JSON_IMPLEMENTATION_H
+#define BLIB_JSON_IMPLEMENTATION_H
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,7 +89,7 @@ extern "C" {
 void json_free(json_value *json) {
 	if (json->type == JSON_VALUE_STRING)
 		list_char_free(&json->string);
-	if (json->type == JSON_VALUE_OBJECT) {
+	if (json->type == JSON_VALUE_OBJECT || json->type == JSON_VALUE_ARRAY) {
 		for(size_t i = 0; i < json->children.length; i++) {
 			json_value *child = json->children.array[i];
 			json_free(child);
@@ -69,11 +113,12 @@ void json_print(json_value *json) {
 		indent(depth);
 		printf("child of type %d at %p ", child->type, (void*)child);
 		switch(child->type) {
-			case JSON_VALUE_OBJECT: {
+			case JSON_VALUE_OBJECT:
+			case JSON_VALUE_ARRAY: {
 				json_print(child);
 			} break;
 			case JSON_VALUE_STRING: {
-				printf("string \"%s\"", child->string.array);
+				printf("string \"%.*s\"", (int)child->view.length, child->view.data);
 			} break;
 			case JSON_VALUE_NUMBER: {
 				printf("number %lf", child->number);
@@ -88,96 +133,457 @@ void json_print(json_value *json) {
 		putchar('\n');
 	}
 	indent(depth); puts("END");
-	depth=0;
+	depth--;
 }
 
-#define is_number(character) (character <= '9' && character >= '0')
+/*Parser state shared by the recursive json_parse_* helpers. When "arena" is
+  NULL every node, string and child list comes from malloc and the tree is
+  released with json_free(). Otherwise everything comes from the arena.
+  With "string_views" set strings are not copied at all, they only get a
+  json_string_view into the source text. "failed" is set once an
+  allocation fails or containers nest deeper than BLIB_JSON_MAX_DEPTH, the
+  parse then unwinds and returns NULL.*/
+typedef struct {
+	const char *cursor;
+	const char *end;
+	memory_arena *arena;
+	bool string_views;
+	bool failed;
+	size_t node_count;
+	size_t depth;
+} json_parser;
 
-json_value *json_parse(char* c, const size_t string_length) {
-	json_value *json = malloc(sizeof(json_value));
-	json->children = list_void_ptr_alloc();
-	json->type = JSON_VALUE_OBJECT;
-	while(c < c+string_length) {
-		if (*c == '\0')
-			break;
-		if (is_number(*c)) {
-			double n;
-			sscanf(c, "%lf", &n);
-			while(is_number(*(++c)) || *(++c)=='.'){}
-			json_value *child = malloc(sizeof(json_value));
-			child->type = JSON_VALUE_NUMBER;
-			child->number = n;
-			list_void_ptr_add(&json->children, child);
+static void *json_parser_alloc(json_parser *p, size_t size) {
+	void *memory = p->arena ? memory_arena_push(p->arena, size) : malloc(size);
+	if (memory == NULL)
+		p->failed = true;
+	return memory;
+}
+
+static json_value *json_parser_node(json_parser *p, json_value_type type) {
+	json_value *node = (json_value *)json_parser_alloc(p, sizeof(json_value));
+	if (node == NULL)
+		return NULL;
+	memset(node, 0, sizeof(json_value));
+	node->type = type;
+	p->node_count++;
+	return node;
+}
+
+static void json_parser_add_child(json_parser *p, json_value *parent, json_value *child) {
+	if (p->arena == NULL) {
+		list_void_ptr_add(&parent->children, child);
+		return;
+	}
+	list_void_ptr *l = &parent->children;
+	if (l->length >= l->capacity) {
+		size_t capacity = l->capacity * 2 + 4;
+		void_ptr *array = (void_ptr *)json_parser_alloc(p, sizeof(void_ptr) * capacity);
+		if (array == NULL)
+			return;
+		if (l->length)
+			memcpy(array, l->array, sizeof(void_ptr) * l->length);
+		l->array = array;
+		l->capacity = capacity;
+	}
+	l->array[l->length++] = child;
+}
+
+static void json_skip_whitespace(json_parser *p) {
+	while (p->cursor < p->end && isspace((unsigned char)*p->cursor))
+		p->cursor++;
+}
+
+static bool json_match(json_parser *p, const char *literal, size_t length) {
+	if ((size_t)(p->end - p->cursor) < length || memcmp(p->cursor, literal, length))
+		return false;
+	p->cursor += length;
+	return true;
+}
+
+static unsigned json_hex4(const char *c) {
+	unsigned n = 0;
+	for (int i = 0; i < 4; i++) {
+		char h = c[i];
+		n <<= 4;
+		if (h >= '0' && h <= '9') n |= (unsigned)(h - '0');
+		else if (h >= 'a' && h <= 'f') n |= (unsigned)(h - 'a' + 10);
+		else if (h >= 'A' && h <= 'F') n |= (unsigned)(h - 'A' + 10);
+	}
+	return n;
+}
+
+/*Decodes the escaped string body [c, end) into "out" and returns the number
+  of bytes written. "out" needs at most (end - c) bytes.*/
+static size_t json_unescape(const char *c, const char *end, char *out) {
+	char *o = out;
+	while (c < end) {
+		if (*c != '\\' || c + 1 >= end) {
+			*o++ = *c++;
+			continue;
 		}
-		switch (*c) {
-			case '{': {
-				++c;
-				json_value* child = json_parse(c, string_length);
-				list_void_ptr_add(&json->children, (void*)child);
-			} break;
-			case '}': {
-				++c;
-				return json;
-			} break;
-			case '\"': {
-				list_char string = list_char_alloc();
-				while(*(++c)!='\"'){
-					list_char_add(&string, *c);
-				}
-				list_char_add(&string, '\0');
-				json_value *child = malloc(sizeof(json_value));
-				child->type = JSON_VALUE_STRING;
-				child->string = string;
-				list_void_ptr_add(&json->children, child);
-			} break;
-			case 't': {
-				if( *(++c)=='r' &&
-					*(++c)=='u' &&
-					*(++c)=='e') {
-					json_value *child = malloc(sizeof(json_value));
-					child->type = JSON_VALUE_BOOLEAN;
-					child->boolean = true;
-					list_void_ptr_add(&json->children, child);
-				}
-			} break;
-			case 'f': {
-				if( *(++c)=='a' &&
-					*(++c)=='l' &&
-					*(++c)=='s' &&
-					*(++c)=='e') {
-					json_value *child = malloc(sizeof(json_value));
-					child->type = JSON_VALUE_BOOLEAN;
-					child->boolean = false;
-					list_void_ptr_add(&json->children, child);
+		c++;
+		switch (*c++) {
+			case 'b': *o++ = '\b'; break;
+			case 'f': *o++ = '\f'; break;
+			case 'n': *o++ = '\n'; break;
+			case 'r': *o++ = '\r'; break;
+			case 't': *o++ = '\t'; break;
+			case 'u': {
+				if (end - c < 4)
+					break;
+				unsigned code = json_hex4(c);
+				c += 4;
+				if (code >= 0xD800 && code < 0xDC00 && end - c >= 6 && c[0] == '\\' && c[1] == 'u') {
+					unsigned low = json_hex4(c + 2);
+					if (low >= 0xDC00 && low < 0xE000) {
+						code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+						c += 6;
+					}
 				}
-			} break;
-			case 'n': {
-				if( *(++c)=='u' &&
-					*(++c)=='l' &&
-					*(++c)=='l') {
-					json_value *child = malloc(sizeof(json_value));
-					child->type = JSON_VALUE_NULL;
-					child->is_null = true;
-					list_void_ptr_add(&json->children, child);
+				if (code < 0x80) {
+					*o++ = (char)code;
+				} else if (code < 0x800) {
+					*o++ = (char)(0xC0 | (code >> 6));
+					*o++ = (char)(0x80 | (code & 0x3F));
+				} else if (code < 0x10000) {
+					*o++ = (char)(0xE0 | (code >> 12));
+					*o++ = (char)(0x80 | ((code >> 6) & 0x3F));
+					*o++ = (char)(0x80 | (code & 0x3F));
+				} else {
+					*o++ = (char)(0xF0 | (code >> 18));
+					*o++ = (char)(0x80 | ((code >> 12) & 0x3F));
+					*o++ = (char)(0x80 | ((code >> 6) & 0x3F));
+					*o++ = (char)(0x80 | (code & 0x3F));
 				}
 			} break;
+			default: *o++ = c[-1]; break; /* \" \\ \/ */
 		}
-		c++;
 	}
+	return (size_t)(o - out);
+}
+
+/*Moves the cursor past the string starting at the cursor and returns its
+  raw body without copying anything.*/
+static json_string_view json_scan_string(json_parser *p) {
+	json_string_view view;
+	const char *begin = ++p->cursor;
+	view.escaped = false;
+	while (p->cursor < p->end && *p->cursor != '\"') {
+		if (*p->cursor == '\\') {
+			view.escaped = true;
+			p->cursor++;
+		}
+		p->cursor++;
+	}
+	const char *end = p->cursor < p->end ? p->cursor : p->end;
+	p->cursor = end + (end < p->end);
+	view.data = begin;
+	view.length = (size_t)(end - begin);
+	return view;
+}
+
+/*strtod() reads a NUL terminated copy of the token so it stops where the
+  token does. Tokens longer than the buffer, such as long decimal
+  expansions, are copied to the heap rather than cut in two.*/
+static double json_scan_number(json_parser *p) {
+	const char *begin = p->cursor;
+	while (p->cursor < p->end) {
+		char c = *p->cursor;
+		if (!((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'))
+			break;
+		p->cursor++;
+	}
+	size_t length = (size_t)(p->cursor - begin);
+	char buffer[64];
+	char *token = length < sizeof(buffer) ? buffer : (char *)malloc(length + 1);
+	if (token == NULL) {
+		p->failed = true;
+		return 0.0;
+	}
+	memcpy(token, begin, length);
+	token[length] = '\0';
+	double number = strtod(token, NULL);
+	if (token != buffer)
+		free(token);
+	return number;
+}
+
+static json_value *json_parse_string(json_parser *p) {
+	json_string_view view = json_scan_string(p);
+	size_t raw = view.length;
+	json_value *node = json_parser_node(p, JSON_VALUE_STRING);
+	if (node == NULL)
+		return NULL;
+	if (p->string_views) {
+		node->view = view;
+		return node;
+	}
+	char *array = (char *)json_parser_alloc(p, raw + 1);
+	if (array == NULL) {
+		if (p->arena == NULL)
+			free(node);
+		return NULL;
+	}
+	size_t length = json_string_unescape(view, array);
+	array[length] = '\0';
+	node->string.array = array;
+	node->string.length = length + 1;
+	node->string.capacity = raw + 1;
+	node->view.data = array;
+	node->view.length = length;
+	return node;
+}
+
+static json_value *json_parse_number(json_parser *p) {
+	json_value *node = json_parser_node(p, JSON_VALUE_NUMBER);
+	if (node == NULL)
+		return NULL;
+	node->number = json_scan_number(p);
+	return node;
+}
+
+static json_value *json_parse_value(json_parser *p);
+
+/*Objects and arrays share one loop. Object children alternate between a key
+  string and its value, exactly as they appear in the text.*/
+static json_value *json_parse_container(json_parser *p, json_value_type type, char close) {
+	if (p->depth == BLIB_JSON_MAX_DEPTH) {
+		p->failed = true;
+		return NULL;
+	}
+	p->cursor++;
+	json_value *node = json_parser_node(p, type);
+	if (node == NULL)
+		return NULL;
+	p->depth++;
+	for (;;) {
+		json_skip_whitespace(p);
+		if (p->cursor >= p->end || *p->cursor == '\0')
+			break;
+		if (*p->cursor == close) {
+			p->cursor++;
+			break;
+		}
+		if (*p->cursor == ',' || *p->cursor == ':') {
+			p->cursor++;
+			continue;
+		}
+		json_value *child = json_parse_value(p);
+		if (child == NULL) {
+			if (p->failed)
+				break;
+			p->cursor++;
+			continue;
+		}
+		json_parser_add_child(p, node, child);
+		if (p->failed)
+			break;
+	}
+	p->depth--;
+	return node;
+}
+
+/*Returns NULL (without consuming anything) when the cursor is not at the
+  start of a value.*/
+static json_value *json_parse_value(json_parser *p) {
+	switch (*p->cursor) {
+		case '{': return json_parse_container(p, JSON_VALUE_OBJECT, '}');
+		case '[': return json_parse_container(p, JSON_VALUE_ARRAY, ']');
+		case '\"': return json_parse_string(p);
+		case 't': {
+			if (!json_match(p, "true", 4))
+				return NULL;
+			json_value *node = json_parser_node(p, JSON_VALUE_BOOLEAN);
+			if (node == NULL)
+				return NULL;
+			node->boolean = true;
+			return node;
+		}
+		case 'f': {
+			if (!json_match(p, "false", 5))
+				return NULL;
+			json_value *node = json_parser_node(p, JSON_VALUE_BOOLEAN);
+			if (node == NULL)
+				return NULL;
+			node->boolean = false;
+			return node;
+		}
+		case 'n': {
+			if (!json_match(p, "null", 4))
+				return NULL;
+			json_value *node = json_parser_node(p, JSON_VALUE_NULL);
+			if (node == NULL)
+				return NULL;
+			node->is_null = true;
+			return node;
+		}
+		default: {
+			if (*p->cursor == '-' || (*p->cursor >= '0' && *p->cursor <= '9'))
+				return json_parse_number(p);
+			return NULL;
+		}
+	}
+}
+
+/*Every top level value in the text becomes a child of the returned root
+  object. Returns NULL when an allocation fails.*/
+static json_value *json_parse_root(json_parser *p) {
+	json_value *json = json_parser_node(p, JSON_VALUE_OBJECT);
+	if (json == NULL)
+		return NULL;
+	for (;;) {
+		json_skip_whitespace(p);
+		if (p->cursor >= p->end || *p->cursor == '\0')
+			break;
+		json_value *child = json_parse_value(p);
+		if (child == NULL) {
+			if (p->failed)
+				break;
+			p->cursor++;
+			continue;
+		}
+		json_parser_add_child(p, json, child);
+		if (p->failed)
+			break;
+	}
+	if (p->failed) {
+		if (p->arena == NULL)
+			json_free(json);
+		return NULL;
+	}
+	BLIB_METRIC_ADD(metrics_json_nodes, p->node_count);
 	return json;
 }
 
+json_value *json_parse(char* c, const size_t string_length) {
+	json_parser p = { c, c + string_length, NULL, false, false, 0, 0 };
+	return json_parse_root(&p);
+}
+
+/*Same as json_parse() but every allocation is made from "arena". The
+  returned tree must not be passed to json_free(), reset or free the arena
+  instead. Returns NULL when the arena runs out of memory or the text nests
+  deeper than BLIB_JSON_MAX_DEPTH.*/
+json_value *json_parse_arena(const char *c, const size_t string_length, memory_arena *arena) {
+	json_parser p = { c, c + string_length, arena, false, false, 0, 0 };
+	return json_parse_root(&p);
+}
+
+/*Like json_parse_arena() but string values and keys are views into "c"
+  instead of copies, so the source text must outlive the returned tree.
+  "arena" may be NULL, in which case the tree is released with json_free().
+  Escapes are left in place and only decoded on demand.*/
+json_value *json_parse_views(const char *c, const size_t string_length, memory_arena *arena) {
+	json_parser p = { c, c + string_length, arena, true, false, 0, 0 };
+	return json_parse_root(&p);
+}
+
+/*Writes the decoded bytes of "view" to "out", which must have room for
+  view.length bytes, and returns the decoded length. No terminator is
+  written.*/
+size_t json_string_unescape(const json_string_view view, char *out) {
+	if (!view.escaped) {
+		memcpy(out, view.data, view.length);
+		return view.length;
+	}
+	return json_unescape(view.data, view.data + view.length, out);
+}
+
+/*Compares a string value against a NUL terminated C string without
+  allocating, decoding escapes only when the view has any.*/
+bool json_string_equal(const json_string_view view, const char *string) {
+	size_t length = strlen(string);
+	if (!view.escaped)
+		return view.length == length && memcmp(view.data, string, length) == 0;
+	if (length > view.length)
+		return false;
+	char stack[256];
+	char *decoded = view.length <= sizeof(stack) ? stack : (char *)malloc(view.length);
+	size_t decoded_length = json_unescape(view.data, view.data + view.length, decoded);
+	bool equal = decoded_length == length && memcmp(decoded, string, length) == 0;
+	if (decoded != stack)
+		free(decoded);
+	return equal;
+}
+
 json_value *json_read(const char *path_to_file) {
 	file_buffer fb = file_buffer_alloc(path_to_file);
-	if (fb.error)
+	if (fb.error) {
 		fprintf(stderr, "failed to load file %s\n", path_to_file);
+		return NULL;
+	}
 	json_value *json = json_parse(fb.text, fb.length);
 	file_buffer_free(fb);
 	return json;
 }
 
+typedef struct {
+	const char *text;
+	const size_t *offsets; // line i spans [offsets[2i], offsets[2i+1])
+	json_batch *batch;
+} json_ndjson_job;
+
+static void json_ndjson_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	json_ndjson_job *job = (json_ndjson_job *)context;
+	memory_arena *arena = &job->batch->arenas[thread_index];
+	for (size_t i = begin; i < end; i++) {
+		const char *line = job->text + job->offsets[i * 2];
+		size_t length = job->offsets[i * 2 + 1] - job->offsets[i * 2];
+		job->batch->records.array[i] = json_parse_arena(line, length, arena);
+	}
+}
+
+/*Parses newline delimited JSON. Lines are split on the calling thread and
+  then parsed in parallel on "pool" (which may be NULL). Each thread
+  allocates from its own arena so workers never contend on malloc.*/
+json_batch json_parse_ndjson(const char *text, const size_t length, thread_pool *pool) {
+	json_batch batch;
+	memset(&batch, 0, sizeof(json_batch));
+
+	list_size_t offsets;
+	memset(&offsets, 0, sizeof(list_size_t));
+	const char *c = text;
+	const char *end = text + length;
+	while (c < end) {
+		const char *newline = (const char *)memchr(c, '\n', (size_t)(end - c));
+		const char *line_end = newline ? newline : end;
+		const char *trimmed = line_end;
+		if (trimmed > c && trimmed[-1] == '\r')
+			trimmed--;
+		if (trimmed > c) {
+			list_size_t_add(&offsets, (size_t)(c - text));
+			list_size_t_add(&offsets, (size_t)(trimmed - text));
+		}
+		c = line_end + 1;
+	}
+
+	size_t count = offsets.length / 2;
+	batch.arena_count = thread_pool_thread_count(pool);
+	batch.arenas = (memory_arena *)malloc(sizeof(memory_arena) * batch.arena_count);
+	for (size_t i = 0; i < batch.arena_count; i++)
+		batch.arenas[i] = memory_arena_alloc(0);
+	batch.records.array = (void_ptr *)malloc(sizeof(void_ptr) * (count ? count : 1));
+	batch.records.length = count;
+	batch.records.capacity = count;
+
+	json_ndjson_job job = { text, offsets.array, &batch };
+	thread_pool_run(pool, count, BLIB_JSON_NDJSON_GRAIN, json_ndjson_task, &job);
+	list_size_t_free(&offsets);
+	return batch;
+}
+
+void json_batch_free(json_batch *batch) {
+	for (size_t i = 0; i < batch->arena_count; i++)
+		memory_arena_free(&batch->arenas[i]);
+	free(batch->arenas);
+	list_void_ptr_free(&batch->records);
+	memset(batch, 0, sizeof(json_batch));
+}
+
 #ifdef __cplusplus
 } // extern "C" {
 #endif //ifdef __cplusplus
 
+#endif // BLIB_JSON_IMPLEMENTATION_H
 #endif //#ifdef BLIB_IMPLEMENTATION
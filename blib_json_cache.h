@@ -0,0 +1,419 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*A compact binary encoding of a json_value tree that can be memory mapped and
+  navigated in place.
+
+  Every integer is little endian. The file starts with a 32 byte header:
+
+    char     magic[4]            "BJSN"
+    uint32_t version             BLIB_JSON_CACHE_VERSION
+    uint32_t node_count
+    uint32_t string_count
+    uint32_t nodes_offset        node_count 16 byte node records
+    uint32_t strings_offset      string_count {uint32_t offset, length} pairs
+    uint32_t string_data_offset  interned string bytes, each NUL terminated
+    uint32_t string_data_size
+
+  A node record is:
+
+    uint8_t  type                a json_value_type
+    uint8_t  boolean
+    uint16_t reserved
+    uint32_t a                   child count, or string index for strings
+    uint64_t b                   index of the first child, or the IEEE 754
+                                 bits of a number
+
+  Nodes are written breadth first, so the children of a container are always
+  the contiguous range [b, b + a). Node 0 is the root. Equal strings (keys in
+  particular) are stored once.*/
+
+#ifndef BLIB_JSON_CACHE_H
+#define BLIB_JSON_CACHE_H
+
+#include "blib_json.h"
+
+#define BLIB_JSON_CACHE_VERSION (1)
+#define BLIB_JSON_CACHE_HEADER_SIZE (32 /* bytes */)
+#define BLIB_JSON_CACHE_NODE_SIZE (16 /* bytes */)
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef uint32_t json_cache_node;
+
+typedef struct {
+	file_view file;
+	const uint8_t *nodes;
+	const uint8_t *strings;
+	const uint8_t *string_data;
+	uint32_t node_count;
+	uint32_t string_count;
+	bool error : 1;
+} json_cache;
+
+static inline uint32_t json_cache_u32(const uint8_t *p) {
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t json_cache_u64(const uint8_t *p) {
+	return (uint64_t)json_cache_u32(p) | (uint64_t)json_cache_u32(p + 4) << 32;
+}
+
+static inline const uint8_t *json_cache_record(const json_cache *cache, json_cache_node node) {
+	return cache->nodes + (size_t)node * BLIB_JSON_CACHE_NODE_SIZE;
+}
+
+static inline json_cache_node json_cache_root(const json_cache *cache) {
+	(void)cache;
+	return 0;
+}
+
+static inline json_value_type json_cache_type(const json_cache *cache, json_cache_node node) {
+	return json_cache_record(cache, node)[0];
+}
+
+static inline bool json_cache_boolean(const json_cache *cache, json_cache_node node) {
+	return json_cache_record(cache, node)[1];
+}
+
+static inline double json_cache_number(const json_cache *cache, json_cache_node node) {
+	uint64_t bits = json_cache_u64(json_cache_record(cache, node) + 8);
+	double n;
+	memcpy(&n, &bits, sizeof(double));
+	return n;
+}
+
+/*Number of children of an object or array. Object children alternate
+  between keys and values just like json_value.*/
+static inline uint32_t json_cache_length(const json_cache *cache, json_cache_node node) {
+	json_value_type type = json_cache_type(cache, node);
+	if (type != JSON_VALUE_OBJECT && type != JSON_VALUE_ARRAY)
+		return 0;
+	return json_cache_u32(json_cache_record(cache, node) + 4);
+}
+
+static inline json_cache_node json_cache_child(const json_cache *cache, json_cache_node node, uint32_t index) {
+	return (json_cache_node)json_cache_u64(json_cache_record(cache, node) + 8) + index;
+}
+
+/*Returns the interned string of a string node. The view points into the
+  mapping and is NUL terminated.*/
+static inline json_string_view json_cache_string(const json_cache *cache, json_cache_node node) {
+	json_string_view view;
+	const uint8_t *entry = cache->strings + (size_t)json_cache_u32(json_cache_record(cache, node) + 4) * 8;
+	view.data = (const char *)cache->string_data + json_cache_u32(entry);
+	view.length = json_cache_u32(entry + 4);
+	view.escaped = false;
+	return view;
+}
+
+/*Finds the value stored under "key" in an object node. Returns false if
+  the node is not an object or has no such key.*/
+static inline bool json_cache_find(const json_cache *cache, json_cache_node object,
+		const char *key, json_cache_node *value) {
+	if (json_cache_type(cache, object) != JSON_VALUE_OBJECT)
+		return false;
+	uint32_t length = json_cache_length(cache, object);
+	for (uint32_t i = 0; i + 1 < length; i += 2) {
+		json_cache_node k = json_cache_child(cache, object, i);
+		if (json_cache_type(cache, k) == JSON_VALUE_STRING &&
+				json_string_equal(json_cache_string(cache, k), key)) {
+			*value = json_cache_child(cache, object, i + 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool json_cache_write(json_value *json, const char *path);
+json_cache json_cache_load(const char *path);
+void json_cache_free(json_cache *cache);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_JSON_CACHE_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_JSON_CACHE_IMPLEMENTATION_H
+#define BLIB_JSON_CACHE_IMPLEMENTATION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+static void json_cache_put_u32(uint8_t *p, uint32_t n) {
+	p[0] = (uint8_t)n;
+	p[1] = (uint8_t)(n >> 8);
+	p[2] = (uint8_t)(n >> 16);
+	p[3] = (uint8_t)(n >> 24);
+}
+
+static void json_cache_put_u64(uint8_t *p, uint64_t n) {
+	json_cache_put_u32(p, (uint32_t)n);
+	json_cache_put_u32(p + 4, (uint32_t)(n >> 32));
+}
+
+/*Open addressing table mapping string contents to their index in the
+  string table. Slots hold index + 1 so zero means empty.*/
+typedef struct {
+	list_char data;
+	list_uint32_t entries; // {offset, length} pairs
+	uint32_t *slots;
+	size_t slot_count;
+} json_cache_strings;
+
+static uint32_t json_cache_hash(const char *s, size_t length) {
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < length; i++)
+		hash = (hash ^ (uint8_t)s[i]) * 16777619u;
+	return hash;
+}
+
+static void json_cache_strings_grow(json_cache_strings *table) {
+	size_t slot_count = table->slot_count ? table->slot_count * 2 : 256;
+	uint32_t *slots = (uint32_t *)calloc(slot_count, sizeof(uint32_t));
+	for (size_t i = 0; i < table->slot_count; i++) {
+		uint32_t index = table->slots[i];
+		if (index == 0)
+			continue;
+		const uint32_t *entry = &table->entries.array[(index - 1) * 2];
+		size_t slot = json_cache_hash(&table->data.array[entry[0]], entry[1]) & (slot_count - 1);
+		while (slots[slot])
+			slot = (slot + 1) & (slot_count - 1);
+		slots[slot] = index;
+	}
+	free(table->slots);
+	table->slots = slots;
+	table->slot_count = slot_count;
+}
+
+static uint32_t json_cache_intern(json_cache_strings *table, const char *s, size_t length) {
+	if ((table->entries.length / 2 + 1) * 2 > table->slot_count)
+		json_cache_strings_grow(table);
+	size_t slot = json_cache_hash(s, length) & (table->slot_count - 1);
+	while (table->slots[slot]) {
+		const uint32_t *entry = &table->entries.array[(table->slots[slot] - 1) * 2];
+		if (entry[1] == length && memcmp(&table->data.array[entry[0]], s, length) == 0)
+			return table->slots[slot] - 1;
+		slot = (slot + 1) & (table->slot_count - 1);
+	}
+	uint32_t index = (uint32_t)(table->entries.length / 2);
+	list_uint32_t_add(&table->entries, (uint32_t)table->data.length);
+	list_uint32_t_add(&table->entries, (uint32_t)length);
+	for (size_t i = 0; i < length; i++)
+		list_char_add(&table->data, s[i]);
+	list_char_add(&table->data, '\0');
+	table->slots[slot] = index + 1;
+	return index;
+}
+
+static uint32_t json_cache_intern_value(json_cache_strings *table, const json_value *json) {
+	json_string_view view = json->view;
+	if (!view.escaped)
+		return json_cache_intern(table, view.data, view.length);
+	char *decoded = (char *)malloc(view.length ? view.length : 1);
+	size_t length = json_string_unescape(view, decoded);
+	uint32_t index = json_cache_intern(table, decoded, length);
+	free(decoded);
+	return index;
+}
+
+/*Encodes "json" (usually the root returned by json_parse()) and writes it to
+  "path". Returns false if the file could not be written.*/
+bool json_cache_write(json_value *json, const char *path) {
+	list_void_ptr queue;
+	memset(&queue, 0, sizeof(list_void_ptr));
+	json_cache_strings strings;
+	memset(&strings, 0, sizeof(json_cache_strings));
+
+	// Breadth first, so a node's index is its position in the queue and the
+	// children of every container end up next to each other.
+	list_void_ptr_add(&queue, json);
+	for (size_t i = 0; i < queue.length; i++) {
+		json_value *node = queue.array[i];
+		if (node->type != JSON_VALUE_OBJECT && node->type != JSON_VALUE_ARRAY)
+			continue;
+		for (size_t c = 0; c < node->children.length; c++)
+			list_void_ptr_add(&queue, node->children.array[c]);
+	}
+
+	size_t node_count = queue.length;
+	uint8_t *nodes = (uint8_t *)calloc(node_count, BLIB_JSON_CACHE_NODE_SIZE);
+	size_t next_child = 1;
+	for (size_t i = 0; i < node_count; i++) {
+		json_value *node = queue.array[i];
+		uint8_t *record = nodes + i * BLIB_JSON_CACHE_NODE_SIZE;
+		record[0] = node->type;
+		switch (node->type) {
+			case JSON_VALUE_OBJECT:
+			case JSON_VALUE_ARRAY: {
+				json_cache_put_u32(record + 4, (uint32_t)node->children.length);
+				json_cache_put_u64(record + 8, next_child);
+				next_child += node->children.length;
+			} break;
+			case JSON_VALUE_STRING: {
+				json_cache_put_u32(record + 4, json_cache_intern_value(&strings, node));
+			} break;
+			case JSON_VALUE_NUMBER: {
+				uint64_t bits;
+				memcpy(&bits, &node->number, sizeof(double));
+				json_cache_put_u64(record + 8, bits);
+			} break;
+			case JSON_VALUE_BOOLEAN: {
+				record[1] = node->boolean;
+			} break;
+		}
+	}
+
+	uint32_t string_count = (uint32_t)(strings.entries.length / 2);
+	uint8_t header[BLIB_JSON_CACHE_HEADER_SIZE];
+	uint32_t nodes_offset = BLIB_JSON_CACHE_HEADER_SIZE;
+	uint32_t strings_offset = nodes_offset + (uint32_t)(node_count * BLIB_JSON_CACHE_NODE_SIZE);
+	uint32_t string_data_offset = strings_offset + string_count * 8;
+	memcpy(header, "BJSN", 4);
+	json_cache_put_u32(header + 4, BLIB_JSON_CACHE_VERSION);
+	json_cache_put_u32(header + 8, (uint32_t)node_count);
+	json_cache_put_u32(header + 12, string_count);
+	json_cache_put_u32(header + 16, nodes_offset);
+	json_cache_put_u32(header + 20, strings_offset);
+	json_cache_put_u32(header + 24, string_data_offset);
+	json_cache_put_u32(header + 28, (uint32_t)strings.data.length);
+	for (size_t i = 0; i < strings.entries.length; i++) {
+		uint8_t *p = (uint8_t *)&strings.entries.array[i];
+		json_cache_put_u32(p, strings.entries.array[i]);
+	}
+
+	bool ok = false;
+	FILE *file = fopen(path, "wb");
+	if (file) {
+		ok = fwrite(header, 1, sizeof(header), file) == sizeof(header) &&
+			fwrite(nodes, BLIB_JSON_CACHE_NODE_SIZE, node_count, file) == node_count &&
+			fwrite(strings.entries.array, sizeof(uint32_t), strings.entries.length, file) == strings.entries.length &&
+			fwrite(strings.data.array, 1, strings.data.length, file) == strings.data.length;
+		ok = (fclose(file) == 0) && ok;
+	}
+
+	free(nodes);
+	free(strings.slots);
+	list_uint32_t_free(&strings.entries);
+	list_char_free(&strings.data);
+	list_void_ptr_free(&queue);
+	return ok;
+}
+
+/*Checks every record against the tables it indexes, so the accessors can
+  trust the mapping. Children must come after their parent, as the writer
+  puts them, which also rules out cycles.*/
+static bool json_cache_validate(const json_cache *cache, uint32_t string_data_size) {
+	for (uint32_t i = 0; i < cache->string_count; i++) {
+		const uint8_t *entry = cache->strings + (size_t)i * 8;
+		uint64_t offset = json_cache_u32(entry), length = json_cache_u32(entry + 4);
+		if (offset + length >= string_data_size || cache->string_data[offset + length] != '\0')
+			return false;
+	}
+	for (uint32_t i = 0; i < cache->node_count; i++) {
+		const uint8_t *record = json_cache_record(cache, i);
+		uint32_t a = json_cache_u32(record + 4);
+		uint64_t b = json_cache_u64(record + 8);
+		switch (record[0]) {
+			case JSON_VALUE_OBJECT:
+			case JSON_VALUE_ARRAY: {
+				if (a && (b <= i || b > cache->node_count || a > cache->node_count - b))
+					return false;
+			} break;
+			case JSON_VALUE_STRING: {
+				if (a >= cache->string_count)
+					return false;
+			} break;
+			case JSON_VALUE_NUMBER:
+			case JSON_VALUE_BOOLEAN:
+			case JSON_VALUE_NULL:
+				break;
+			default:
+				return false;
+		}
+	}
+	return true;
+}
+
+/*Points "cache" into its mapped file, false if the header or any record
+  is out of bounds*/
+static bool json_cache_open(json_cache *cache) {
+	const uint8_t *base = (const uint8_t *)cache->file.data;
+	size_t size = cache->file.length;
+	if (size < BLIB_JSON_CACHE_HEADER_SIZE || memcmp(base, "BJSN", 4) ||
+			json_cache_u32(base + 4) != BLIB_JSON_CACHE_VERSION)
+		return false;
+	uint64_t node_count = json_cache_u32(base + 8);
+	uint64_t string_count = json_cache_u32(base + 12);
+	uint64_t nodes_offset = json_cache_u32(base + 16);
+	uint64_t strings_offset = json_cache_u32(base + 20);
+	uint64_t string_data_offset = json_cache_u32(base + 24);
+	uint64_t string_data_size = json_cache_u32(base + 28);
+	if (node_count == 0 ||
+			nodes_offset + node_count * BLIB_JSON_CACHE_NODE_SIZE > size ||
+			strings_offset + string_count * 8 > size ||
+			string_data_offset + string_data_size > size)
+		return false;
+	cache->nodes = base + nodes_offset;
+	cache->strings = base + strings_offset;
+	cache->string_data = base + string_data_offset;
+	cache->node_count = (uint32_t)node_count;
+	cache->string_count = (uint32_t)string_count;
+	return json_cache_validate(cache, (uint32_t)string_data_size);
+}
+
+/*Maps a file written by json_cache_write(). Nothing is decoded up front, the
+  accessors read the mapping directly, but every record is bounds checked
+  once here. Check "error" before use, a missing, truncated or corrupt file
+  sets it and leaves nothing mapped, so json_cache_free() is then optional.*/
+json_cache json_cache_load(const char *path) {
+	json_cache cache;
+	memset(&cache, 0, sizeof(json_cache));
+	cache.file = file_view_map(path);
+	if (cache.file.error || !json_cache_open(&cache)) {
+		file_view_unmap(cache.file);
+		memset(&cache, 0, sizeof(json_cache));
+		cache.error = true;
+	}
+	return cache;
+}
+
+void json_cache_free(json_cache *cache) {
+	file_view_unmap(cache->file);
+	memset(cache, 0, sizeof(json_cache));
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_JSON_CACHE_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
@@ -0,0 +1,483 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Decodes JSON text straight into C structs described by a field table, and
+  encodes them back, without building a json_value tree.
+
+  typedef struct { vector3_t position; list_vector3_t path; float speed; } unit;
+
+  static const json_field vector3_fields[] = {
+  	JSON_FIELD(vector3_t, x, JSON_FIELD_FLOAT),
+  	JSON_FIELD(vector3_t, y, JSON_FIELD_FLOAT),
+  	JSON_FIELD(vector3_t, z, JSON_FIELD_FLOAT),
+  };
+  static const json_descriptor vector3_descriptor = JSON_DESCRIPTOR(vector3_t, vector3_fields);
+
+  static const json_field unit_fields[] = {
+  	JSON_FIELD_STRUCT(unit, position, &vector3_descriptor),
+  	JSON_FIELD_LIST(unit, path, JSON_FIELD_STRUCT, vector3_t, &vector3_descriptor),
+  	JSON_FIELD(unit, speed, JSON_FIELD_FLOAT),
+  };
+  static const json_descriptor unit_descriptor = JSON_DESCRIPTOR(unit, unit_fields);
+
+  A struct may be written as an object ({"x": 1, "y": 2, "z": 3}) or as an
+  array, in which case the values are assigned to the fields in table order
+  ([1, 2, 3]). Keys that have no field are skipped and fields that have no
+  key are left untouched. Lists are any list_##type from blib.h and are
+  grown with realloc, so they are released with the matching _free().
+
+  The struct decoded into must be zeroed or hold lists made by their
+  _alloc(): strings are written over reusing their buffer and lists are
+  appended to. Integer fields reject numbers with a fraction or out of
+  their range. Floats that are not finite encode as null, which decodes
+  back to NaN. A list of lists cannot be described, element_type must not
+  be JSON_FIELD_LIST.*/
+
+#ifndef BLIB_JSON_STRUCT_H
+#define BLIB_JSON_STRUCT_H
+
+#include <assert.h>
+#include <math.h>
+#include <stddef.h>
+#include "blib_json.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+enum {
+	JSON_FIELD_FLOAT,
+	JSON_FIELD_DOUBLE,
+	JSON_FIELD_INT32,
+	JSON_FIELD_UINT32,
+	JSON_FIELD_INT64,
+	JSON_FIELD_BOOLEAN, // bool from blib.h
+	JSON_FIELD_STRING,  // list_char, NUL terminated like json_value strings
+	JSON_FIELD_STRUCT,  // nested struct described by "descriptor"
+	JSON_FIELD_LIST,    // list_##type of "element_type"
+}; typedef uint8_t json_field_type;
+
+struct json_descriptor;
+
+typedef struct {
+	const char *name;
+	size_t offset;
+	json_field_type type;
+	json_field_type element_type;
+	size_t element_size;
+	const struct json_descriptor *descriptor;
+} json_field;
+
+typedef struct json_descriptor {
+	const json_field *fields;
+	size_t field_count;
+	size_t size;
+} json_descriptor;
+
+#define JSON_FIELD(type, member, field_type)\
+	{ #member, offsetof(type, member), field_type, 0, 0, NULL }
+
+#define JSON_FIELD_STRUCT(type, member, descriptor)\
+	{ #member, offsetof(type, member), JSON_FIELD_STRUCT, 0, 0, descriptor }
+
+#define JSON_FIELD_LIST(type, member, element_field_type, element_type, descriptor)\
+	{ #member, offsetof(type, member), JSON_FIELD_LIST, element_field_type, sizeof(element_type), descriptor }
+
+#define JSON_DESCRIPTOR(type, fields)\
+	{ fields, sizeof(fields) / sizeof(fields[0]), sizeof(type) }
+
+bool json_decode(const char *text, const size_t length, const json_descriptor *descriptor, void *out);
+bool json_decode_list(const char *text, const size_t length, const json_field_type element_type,
+		const size_t element_size, const json_descriptor *descriptor, void *list);
+void json_encode(const json_descriptor *descriptor, const void *in, list_char *out);
+void json_encode_list(const json_field_type element_type, const size_t element_size,
+		const json_descriptor *descriptor, const void *list, list_char *out);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_JSON_STRUCT_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_JSON_STRUCT_IMPLEMENTATION_H
+#define BLIB_JSON_STRUCT_IMPLEMENTATION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/*Every list_##type has this layout.*/
+typedef struct {
+	size_t capacity;
+	size_t length;
+	void *array;
+} json_list_layout;
+
+static bool json_decode_value(json_parser *p, json_field_type type, json_field_type element_type,
+		size_t element_size, const json_descriptor *descriptor, void *out);
+
+/*Skips over one value of any kind without allocating.*/
+static bool json_skip_value(json_parser *p) {
+	json_skip_whitespace(p);
+	if (p->cursor >= p->end)
+		return false;
+	switch (*p->cursor) {
+		case '\"': json_scan_string(p); return true;
+		case 't': return json_match(p, "true", 4);
+		case 'f': return json_match(p, "false", 5);
+		case 'n': return json_match(p, "null", 4);
+		case '{':
+		case '[': {
+			size_t depth = 0;
+			while (p->cursor < p->end) {
+				char c = *p->cursor;
+				if (c == '\"') {
+					json_scan_string(p);
+					continue;
+				}
+				p->cursor++;
+				if (c == '{' || c == '[')
+					depth++;
+				else if ((c == '}' || c == ']') && --depth == 0)
+					return true;
+			}
+			return false;
+		}
+		default: {
+			if (*p->cursor != '-' && (*p->cursor < '0' || *p->cursor > '9'))
+				return false;
+			json_scan_number(p);
+			return true;
+		}
+	}
+}
+
+/*Consumes whitespace and at most one separator, returns the next character
+  or '\0' at the end of the input.*/
+static char json_decode_next(json_parser *p) {
+	json_skip_whitespace(p);
+	if (p->cursor < p->end && *p->cursor == ',') {
+		p->cursor++;
+		json_skip_whitespace(p);
+	}
+	return p->cursor < p->end ? *p->cursor : '\0';
+}
+
+static const json_field *json_descriptor_find(const json_descriptor *descriptor, json_string_view key) {
+	for (size_t i = 0; i < descriptor->field_count; i++) {
+		if (json_string_equal(key, descriptor->fields[i].name))
+			return &descriptor->fields[i];
+	}
+	return NULL;
+}
+
+static bool json_decode_struct(json_parser *p, const json_descriptor *descriptor, uint8_t *out) {
+	if (*p->cursor == '[') {
+		p->cursor++;
+		size_t index = 0;
+		for (;;) {
+			char c = json_decode_next(p);
+			if (c == ']') {
+				p->cursor++;
+				return true;
+			}
+			if (c == '\0')
+				return false;
+			if (index < descriptor->field_count) {
+				const json_field *field = &descriptor->fields[index++];
+				if (!json_decode_value(p, field->type, field->element_type, field->element_size,
+							field->descriptor, out + field->offset))
+					return false;
+			} else if (!json_skip_value(p)) {
+				return false;
+			}
+		}
+	}
+	if (*p->cursor != '{')
+		return false;
+	p->cursor++;
+	for (;;) {
+		char c = json_decode_next(p);
+		if (c == '}') {
+			p->cursor++;
+			return true;
+		}
+		if (c != '\"')
+			return false;
+		json_string_view key = json_scan_string(p);
+		json_skip_whitespace(p);
+		if (p->cursor >= p->end || *p->cursor != ':')
+			return false;
+		p->cursor++;
+		const json_field *field = json_descriptor_find(descriptor, key);
+		if (field == NULL) {
+			if (!json_skip_value(p))
+				return false;
+			continue;
+		}
+		if (!json_decode_value(p, field->type, field->element_type, field->element_size,
+					field->descriptor, out + field->offset))
+			return false;
+	}
+}
+
+static bool json_decode_array(json_parser *p, json_field_type element_type, size_t element_size,
+		const json_descriptor *descriptor, json_list_layout *list) {
+	// The field table has no room for the element type of a nested list.
+	assert(element_type != JSON_FIELD_LIST);
+	if (*p->cursor != '[')
+		return false;
+	p->cursor++;
+	for (;;) {
+		char c = json_decode_next(p);
+		if (c == ']') {
+			p->cursor++;
+			return true;
+		}
+		if (c == '\0')
+			return false;
+		if (list->length >= list->capacity) {
+			list->capacity = list->length * 2 + 1;
+			list->array = realloc(list->array, element_size * list->capacity);
+		}
+		uint8_t *element = (uint8_t *)list->array + element_size * list->length;
+		memset(element, 0, element_size);
+		if (!json_decode_value(p, element_type, 0, 0, descriptor, element))
+			return false;
+		list->length++;
+	}
+}
+
+/*Reads an integral number in [min, max), anything else would make the
+  conversion from double undefined*/
+static bool json_decode_integer(json_parser *p, double min, double max, int64_t *out) {
+	double value = json_scan_number(p);
+	if (p->failed || !(value >= min && value < max))
+		return false;
+	*out = (int64_t)value;
+	return (double)*out == value;
+}
+
+/*A number, or null for a float that was not finite when encoded*/
+static bool json_decode_real(json_parser *p, bool is_number, double *out) {
+	if (is_number) {
+		*out = json_scan_number(p);
+		return !p->failed;
+	}
+	if (!json_match(p, "null", 4))
+		return false;
+	*out = NAN;
+	return true;
+}
+
+static bool json_decode_value(json_parser *p, json_field_type type, json_field_type element_type,
+		size_t element_size, const json_descriptor *descriptor, void *out) {
+	json_skip_whitespace(p);
+	if (p->cursor >= p->end)
+		return false;
+	char c = *p->cursor;
+	bool is_number = c == '-' || (c >= '0' && c <= '9');
+	switch (type) {
+		case JSON_FIELD_FLOAT: {
+			double value;
+			if (!json_decode_real(p, is_number, &value)) return false;
+			*(float *)out = (float)value;
+		} return true;
+		case JSON_FIELD_DOUBLE: {
+			return json_decode_real(p, is_number, (double *)out);
+		}
+		case JSON_FIELD_INT32: {
+			int64_t value;
+			if (!is_number || !json_decode_integer(p, -2147483648.0, 2147483648.0, &value)) return false;
+			*(int32_t *)out = (int32_t)value;
+		} return true;
+		case JSON_FIELD_UINT32: {
+			int64_t value;
+			if (!is_number || !json_decode_integer(p, 0.0, 4294967296.0, &value)) return false;
+			*(uint32_t *)out = (uint32_t)value;
+		} return true;
+		case JSON_FIELD_INT64: {
+			int64_t value;
+			if (!is_number || !json_decode_integer(p, -9223372036854775808.0, 9223372036854775808.0, &value))
+				return false;
+			*(int64_t *)out = value;
+		} return true;
+		case JSON_FIELD_BOOLEAN: {
+			if (json_match(p, "true", 4))
+				*(bool *)out = true;
+			else if (json_match(p, "false", 5))
+				*(bool *)out = false;
+			else
+				return false;
+		} return true;
+		case JSON_FIELD_STRING: {
+			if (c != '\"') return false;
+			json_string_view view = json_scan_string(p);
+			list_char *string = (list_char *)out;
+			// Unescaping never makes a string longer.
+			if (string->capacity < view.length + 1) {
+				string->capacity = view.length + 1;
+				string->array = (char *)realloc(string->array, string->capacity);
+			}
+			string->length = json_string_unescape(view, string->array);
+			string->array[string->length++] = '\0';
+		} return true;
+		case JSON_FIELD_STRUCT: {
+			return json_decode_struct(p, descriptor, (uint8_t *)out);
+		}
+		case JSON_FIELD_LIST: {
+			return json_decode_array(p, element_type, element_size, descriptor, (json_list_layout *)out);
+		}
+	}
+	return false;
+}
+
+/*Decodes the first value in "text" into the struct "out". Returns false on
+  malformed input or when a value does not match its field type, in which
+  case "out" may be partially written.*/
+bool json_decode(const char *text, const size_t length, const json_descriptor *descriptor, void *out) {
+	json_parser p = { text, text + length, NULL, false, false, 0, 0 };
+	return json_decode_value(&p, JSON_FIELD_STRUCT, 0, 0, descriptor, out);
+}
+
+/*Appends the elements of a top level JSON array to "list", e.g. a
+  list_vector3_t with element_type JSON_FIELD_STRUCT.*/
+bool json_decode_list(const char *text, const size_t length, const json_field_type element_type,
+		const size_t element_size, const json_descriptor *descriptor, void *list) {
+	json_parser p = { text, text + length, NULL, false, false, 0, 0 };
+	return json_decode_value(&p, JSON_FIELD_LIST, element_type, element_size, descriptor, list);
+}
+
+static void json_encode_text(list_char *out, const char *text, size_t length) {
+	if (out->length + length + 1 > out->capacity) {
+		out->capacity = (out->length + length) * 2 + 1;
+		out->array = (char *)realloc(out->array, out->capacity);
+	}
+	// An empty list_char may have no array yet.
+	if (length)
+		memcpy(out->array + out->length, text, length);
+	out->length += length;
+	out->array[out->length] = '\0';
+}
+
+static void json_encode_string(list_char *out, const char *s, size_t length) {
+	json_encode_text(out, "\"", 1);
+	const char *run = s;
+	for (size_t i = 0; i < length; i++) {
+		unsigned char c = (unsigned char)s[i];
+		if (c != '\"' && c != '\\' && c >= 0x20)
+			continue;
+		json_encode_text(out, run, (size_t)(s + i - run));
+		char escape[8];
+		int n;
+		switch (c) {
+			case '\"': n = sprintf(escape, "\\\""); break;
+			case '\\': n = sprintf(escape, "\\\\"); break;
+			case '\n': n = sprintf(escape, "\\n"); break;
+			case '\r': n = sprintf(escape, "\\r"); break;
+			case '\t': n = sprintf(escape, "\\t"); break;
+			default: n = sprintf(escape, "\\u%04x", c); break;
+		}
+		json_encode_text(out, escape, (size_t)n);
+		run = s + i + 1;
+	}
+	json_encode_text(out, run, (size_t)(s + length - run));
+	json_encode_text(out, "\"", 1);
+}
+
+static void json_encode_value(json_field_type type, json_field_type element_type, size_t element_size,
+		const json_descriptor *descriptor, const void *in, list_char *out) {
+	char number[32];
+	int n = 0;
+	switch (type) {
+		case JSON_FIELD_FLOAT: {
+			float value = *(const float *)in;
+			n = isfinite(value) ? sprintf(number, "%.9g", value) : sprintf(number, "null");
+		} break;
+		case JSON_FIELD_DOUBLE: {
+			double value = *(const double *)in;
+			n = isfinite(value) ? sprintf(number, "%.17g", value) : sprintf(number, "null");
+		} break;
+		case JSON_FIELD_INT32: n = sprintf(number, "%ld", (long)*(const int32_t *)in); break;
+		case JSON_FIELD_UINT32: n = sprintf(number, "%lu", (unsigned long)*(const uint32_t *)in); break;
+		case JSON_FIELD_INT64: n = sprintf(number, "%lld", (long long)*(const int64_t *)in); break;
+		case JSON_FIELD_BOOLEAN: n = sprintf(number, "%s", *(const bool *)in ? "true" : "false"); break;
+		case JSON_FIELD_STRING: {
+			const list_char *string = (const list_char *)in;
+			size_t length = string->length;
+			if (length && string->array[length - 1] == '\0')
+				length--;
+			json_encode_string(out, string->array, length);
+		} return;
+		case JSON_FIELD_STRUCT: {
+			const uint8_t *base = (const uint8_t *)in;
+			json_encode_text(out, "{", 1);
+			for (size_t i = 0; i < descriptor->field_count; i++) {
+				const json_field *field = &descriptor->fields[i];
+				if (i)
+					json_encode_text(out, ",", 1);
+				json_encode_string(out, field->name, strlen(field->name));
+				json_encode_text(out, ":", 1);
+				json_encode_value(field->type, field->element_type, field->element_size,
+						field->descriptor, base + field->offset, out);
+			}
+			json_encode_text(out, "}", 1);
+		} return;
+		case JSON_FIELD_LIST: {
+			const json_list_layout *list = (const json_list_layout *)in;
+			assert(element_type != JSON_FIELD_LIST);
+			json_encode_text(out, "[", 1);
+			for (size_t i = 0; i < list->length; i++) {
+				if (i)
+					json_encode_text(out, ",", 1);
+				json_encode_value(element_type, 0, 0, descriptor,
+						(const uint8_t *)list->array + element_size * i, out);
+			}
+			json_encode_text(out, "]", 1);
+		} return;
+	}
+	json_encode_text(out, number, (size_t)n);
+}
+
+/*Appends the JSON text for the struct "in" to "out". "out" stays NUL
+  terminated but the terminator is not counted in out->length, so repeated
+  calls append.*/
+void json_encode(const json_descriptor *descriptor, const void *in, list_char *out) {
+	json_encode_value(JSON_FIELD_STRUCT, 0, 0, descriptor, in, out);
+}
+
+void json_encode_list(const json_field_type element_type, const size_t element_size,
+		const json_descriptor *descriptor, const void *list, list_char *out) {
+	json_encode_value(JSON_FIELD_LIST, element_type, element_size, descriptor, list, out);
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_JSON_STRUCT_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
@@ -2,6 +2,7 @@
 #define BLIB_LOG_H
 
 #include <stdio.h>
+#include <time.h>
 
 #ifndef BLIB_LOG_STREAM
 #define BLIB_LOG_STREAM stdout
@@ -23,27 +24,418 @@
 #define BLIB_ANSI_COLOR_CYAN	"\x1b[36m"
 #define BLIB_ANSI_COLOR_RESET	"\x1b[0m"
 
-#define debug_log(...) {\
-	fprintf(BLIB_LOG_STREAM, BLIB_ANSI_COLOR_CYAN "[ %s:%d ", __FILE__, __LINE__);\
-	fprintf(BLIB_LOG_STREAM, BLIB_ANSI_COLOR_CYAN "] " BLIB_ANSI_COLOR_RESET __VA_ARGS__);\
-	fprintf(BLIB_LOG_STREAM, "\n" BLIB_ANSI_COLOR_RESET);\
+#define LOG_LEVEL_TRACE	0
+#define LOG_LEVEL_DEBUG	1
+#define LOG_LEVEL_INFO	2
+#define LOG_LEVEL_WARN	3
+#define LOG_LEVEL_ERROR	4
+#define LOG_LEVEL_FATAL	5
+#define LOG_LEVEL_OFF	6
+
+/*Messages below BLIB_LOG_LEVEL are removed at compile time, arguments
+  included. Everything at or above it is also checked against the runtime
+  level "blib_log_level", which starts out equal to BLIB_LOG_LEVEL.
+
+  The runtime level is one variable for the whole program, so exactly one
+  translation unit has to include blib_log.h with BLIB_IMPLEMENTATION
+  defined. Without it every use of the log macros fails to link with an
+  undefined reference to blib_log_level.*/
+#ifndef BLIB_LOG_LEVEL
+#define BLIB_LOG_LEVEL LOG_LEVEL_TRACE
+#endif
+
+#if defined(__GNUC__)
+#define BLIB_LOG_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define BLIB_LOG_UNLIKELY(x) (x)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/*Defined in the BLIB_IMPLEMENTATION unit, see above*/
+extern int blib_log_level;
+
+static inline void log_set_level(int level) { blib_log_level = level; }
+
+/*Returns true for at most "per_second" calls per wall clock second. The
+  state is per call site, see debug_rate_limited().*/
+static inline int log_rate_allow(long *second, unsigned long *count, unsigned long per_second) {
+	long now = (long)time(NULL);
+	if (__atomic_load_n(second, __ATOMIC_RELAXED) != now) {
+		__atomic_store_n(second, now, __ATOMIC_RELAXED);
+		__atomic_store_n(count, 0, __ATOMIC_RELAXED);
+	}
+	return __atomic_fetch_add(count, 1, __ATOMIC_RELAXED) < per_second;
 }
 
-#define debug_warn(...) {\
-	fprintf(BLIB_WARNING_STREAM, BLIB_ANSI_COLOR_YELLOW "[ %s:%d ", __FILE__, __LINE__);\
-	fprintf(BLIB_WARNING_STREAM, BLIB_ANSI_COLOR_YELLOW "] " BLIB_ANSI_COLOR_RESET __VA_ARGS__);\
-	fprintf(BLIB_WARNING_STREAM, "\n" BLIB_ANSI_COLOR_RESET);\
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#define BLIB_LOG_ENABLED(level)\
+	((level) >= BLIB_LOG_LEVEL && BLIB_LOG_UNLIKELY((level) >= blib_log_level))
+
+#define BLIB_LOG_STREAM_FOR(level)\
+	((level) >= LOG_LEVEL_ERROR ? BLIB_ERROR_STREAM :\
+	 (level) == LOG_LEVEL_WARN ? BLIB_WARNING_STREAM : BLIB_LOG_STREAM)
+
+#define BLIB_LOG_COLOR_FOR(level)\
+	((level) == LOG_LEVEL_TRACE ? BLIB_ANSI_COLOR_BLUE :\
+	 (level) == LOG_LEVEL_DEBUG ? BLIB_ANSI_COLOR_CYAN :\
+	 (level) == LOG_LEVEL_INFO ? BLIB_ANSI_COLOR_GREEN :\
+	 (level) == LOG_LEVEL_WARN ? BLIB_ANSI_COLOR_YELLOW :\
+	 (level) == LOG_LEVEL_ERROR ? BLIB_ANSI_COLOR_RED : BLIB_ANSI_COLOR_MAGENTA)
+
+/*Define BLIB_LOG_ASYNC (in every translation unit, including the one with
+  BLIB_IMPLEMENTATION) to move formatting off the stdio lock and writing off
+  the calling thread. Messages are formatted on the caller's stack, pushed
+  through a bounded lock-free queue and written in large batches by a
+  background thread that is started on first use and drained at exit.*/
+#ifdef BLIB_LOG_ASYNC
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/*Longest message kept, longer ones are truncated*/
+#ifndef BLIB_LOG_ASYNC_MESSAGE_SIZE
+#define BLIB_LOG_ASYNC_MESSAGE_SIZE (512 /* bytes */)
+#endif
+
+/*Number of queued messages, must be a power of two*/
+#ifndef BLIB_LOG_ASYNC_QUEUE_SIZE
+#define BLIB_LOG_ASYNC_QUEUE_SIZE (4096 /* messages */)
+#endif
+
+#ifndef BLIB_LOG_ASYNC_BATCH_SIZE
+#define BLIB_LOG_ASYNC_BATCH_SIZE (64 * 1024 /* bytes */)
+#endif
+
+/*What a logging thread does when the queue is full*/
+#ifndef BLIB_LOG_ASYNC_POLICY
+#define BLIB_LOG_ASYNC_POLICY LOG_ASYNC_BLOCK
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+enum {
+	LOG_ASYNC_BLOCK, // wait for the writer to make room
+	LOG_ASYNC_DROP,  // discard the message and count it
+};
+
+void log_async_write(FILE *stream, const char *color, const char *file, int line,
+		const char *format, ...)
+#if defined(__GNUC__)
+	__attribute__((format(printf, 5, 6)))
+#endif
+	;
+void log_async_set_policy(int policy);
+void log_async_flush(void);
+void log_async_shutdown(void);
+size_t log_async_dropped(void);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#define BLIB_LOG_WRITE(level, ...) {\
+	log_async_write(BLIB_LOG_STREAM_FOR(level), BLIB_LOG_COLOR_FOR(level), __FILE__, __LINE__, __VA_ARGS__);\
 }
 
-#define debug_error(...) {\
-	fprintf(BLIB_ERROR_STREAM, BLIB_ANSI_COLOR_RED "[ %s:%d ", __FILE__, __LINE__);\
-	fprintf(BLIB_ERROR_STREAM, BLIB_ANSI_COLOR_RED "] " BLIB_ANSI_COLOR_RESET __VA_ARGS__);\
-	fprintf(BLIB_ERROR_STREAM, "\n" BLIB_ANSI_COLOR_RESET);\
+#else // BLIB_LOG_ASYNC
+
+#define BLIB_LOG_WRITE(level, ...) {\
+	fprintf(BLIB_LOG_STREAM_FOR(level), "%s[ %s:%d %s] " BLIB_ANSI_COLOR_RESET,\
+			BLIB_LOG_COLOR_FOR(level), __FILE__, __LINE__, BLIB_LOG_COLOR_FOR(level));\
+	fprintf(BLIB_LOG_STREAM_FOR(level), __VA_ARGS__);\
+	fprintf(BLIB_LOG_STREAM_FOR(level), "\n" BLIB_ANSI_COLOR_RESET);\
 }
 
+#endif // BLIB_LOG_ASYNC
+
+/*Logs at "level" if it is enabled. The arguments are only evaluated when
+  the message is actually written.*/
+#define debug_log_at(level, ...) do {\
+	if (BLIB_LOG_ENABLED(level))\
+		BLIB_LOG_WRITE(level, __VA_ARGS__)\
+} while (0)
+
+/*Writes only every "n"th message from this call site*/
+#define debug_every_n(level, n, ...) do {\
+	if (BLIB_LOG_ENABLED(level)) {\
+		static unsigned long blib_log_site_count = 0;\
+		if (__atomic_fetch_add(&blib_log_site_count, 1, __ATOMIC_RELAXED) % (n) == 0)\
+			BLIB_LOG_WRITE(level, __VA_ARGS__)\
+	}\
+} while (0)
+
+/*Writes at most "per_second" messages per second from this call site*/
+#define debug_rate_limited(level, per_second, ...) do {\
+	if (BLIB_LOG_ENABLED(level)) {\
+		static long blib_log_site_second = 0;\
+		static unsigned long blib_log_site_count = 0;\
+		if (log_rate_allow(&blib_log_site_second, &blib_log_site_count, (per_second)))\
+			BLIB_LOG_WRITE(level, __VA_ARGS__)\
+	}\
+} while (0)
+
+#define debug_trace(...) debug_log_at(LOG_LEVEL_TRACE, __VA_ARGS__)
+#define debug_log(...) debug_log_at(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define debug_info(...) debug_log_at(LOG_LEVEL_INFO, __VA_ARGS__)
+#define debug_warn(...) debug_log_at(LOG_LEVEL_WARN, __VA_ARGS__)
+#define debug_error(...) debug_log_at(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define debug_fatal(...) debug_log_at(LOG_LEVEL_FATAL, __VA_ARGS__)
+
 #define debug_test()\
 	debug_log("this is a test message");\
 	debug_warn("this is a test warning");\
 	debug_error("this is a test error");
 
 #endif // BLIB_LOG_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_LOG_IMPLEMENTATION_H
+#define BLIB_LOG_IMPLEMENTATION_H
+
+int blib_log_level = BLIB_LOG_LEVEL;
+
+#ifdef BLIB_LOG_ASYNC
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/*One cell of a bounded multi-producer queue (Vyukov). "sequence" tells a
+  producer the cell is free (== position) and the consumer it is full
+  (== position + 1).*/
+typedef struct {
+	size_t sequence;
+	FILE *stream;
+	size_t length;
+	char text[BLIB_LOG_ASYNC_MESSAGE_SIZE];
+} log_async_cell;
+
+/*The writer only takes "mutex" when the queue is empty and it is about to
+  sleep, so producers never touch the lock while the writer is busy.*/
+static struct {
+	log_async_cell *cells;
+	size_t enqueue_position;
+	size_t dequeue_position;
+	size_t written_position;
+	size_t dropped;
+	size_t producers; // log_async_write() calls between the running check and publishing
+	int policy;
+	int running;
+	int stop;
+	int sleeping;
+	pthread_t writer;
+	pthread_once_t once;
+	pthread_mutex_t mutex;
+	pthread_cond_t wake;
+	pthread_cond_t flushed;
+} log_async = {
+	NULL, 0, 0, 0, 0, 0, BLIB_LOG_ASYNC_POLICY, 0, 0, 0, 0, PTHREAD_ONCE_INIT,
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER
+};
+
+static int log_async_ready(size_t position) {
+	log_async_cell *cell = &log_async.cells[position & (BLIB_LOG_ASYNC_QUEUE_SIZE - 1)];
+	return __atomic_load_n(&cell->sequence, __ATOMIC_SEQ_CST) == position + 1;
+}
+
+static void log_async_emit(FILE *stream, char *batch, size_t *length) {
+	if (*length == 0)
+		return;
+	fwrite(batch, 1, *length, stream);
+	fflush(stream);
+	*length = 0;
+}
+
+static void *log_async_writer(void *arg) {
+	(void)arg;
+	char *batch = (char *)malloc(BLIB_LOG_ASYNC_BATCH_SIZE);
+	size_t length = 0;
+	FILE *stream = NULL;
+	size_t reported_drops = 0;
+	for (;;) {
+		size_t position = log_async.dequeue_position;
+		if (!log_async_ready(position)) {
+			// Queue is empty: write what we have, report drops and sleep
+			// until a producer wakes us.
+			if (stream)
+				log_async_emit(stream, batch, &length);
+			size_t dropped = __atomic_load_n(&log_async.dropped, __ATOMIC_RELAXED);
+			if (dropped != reported_drops) {
+				fprintf(stderr, "[ blib_log ] dropped %zu messages\n", dropped - reported_drops);
+				reported_drops = dropped;
+			}
+			pthread_mutex_lock(&log_async.mutex);
+			__atomic_store_n(&log_async.written_position, position, __ATOMIC_RELEASE);
+			pthread_cond_broadcast(&log_async.flushed);
+			__atomic_store_n(&log_async.sleeping, 1, __ATOMIC_SEQ_CST);
+			if (log_async_ready(position) || log_async.stop)
+				__atomic_store_n(&log_async.sleeping, 0, __ATOMIC_SEQ_CST);
+			while (__atomic_load_n(&log_async.sleeping, __ATOMIC_SEQ_CST))
+				pthread_cond_wait(&log_async.wake, &log_async.mutex);
+			int stop = log_async.stop && !log_async_ready(position);
+			pthread_mutex_unlock(&log_async.mutex);
+			if (stop)
+				break;
+			continue;
+		}
+		log_async_cell *cell = &log_async.cells[position & (BLIB_LOG_ASYNC_QUEUE_SIZE - 1)];
+		if (cell->stream != stream || length + cell->length > BLIB_LOG_ASYNC_BATCH_SIZE) {
+			if (stream)
+				log_async_emit(stream, batch, &length);
+			__atomic_store_n(&log_async.written_position, position, __ATOMIC_RELEASE);
+			stream = cell->stream;
+		}
+		memcpy(batch + length, cell->text, cell->length);
+		length += cell->length;
+		__atomic_store_n(&cell->sequence, position + BLIB_LOG_ASYNC_QUEUE_SIZE, __ATOMIC_RELEASE);
+		log_async.dequeue_position = position + 1;
+	}
+	free(batch);
+	return NULL;
+}
+
+static void log_async_start(void) {
+	log_async.cells = (log_async_cell *)malloc(sizeof(log_async_cell) * BLIB_LOG_ASYNC_QUEUE_SIZE);
+	for (size_t i = 0; i < BLIB_LOG_ASYNC_QUEUE_SIZE; i++)
+		log_async.cells[i].sequence = i;
+	if (pthread_create(&log_async.writer, NULL, log_async_writer, NULL) == 0) {
+		__atomic_store_n(&log_async.running, 1, __ATOMIC_RELEASE);
+		atexit(log_async_shutdown);
+	}
+}
+
+// Claims the once control when shutdown runs before the first message, so
+// the writer is never started afterwards.
+static void log_async_never_start(void) {
+}
+
+/*Formats "[ file:line ] message" on the caller's stack and queues it. Falls
+  back to a direct write if the writer could not be started or has already
+  been shut down.*/
+void log_async_write(FILE *stream, const char *color, const char *file, int line,
+		const char *format, ...) {
+	char text[BLIB_LOG_ASYNC_MESSAGE_SIZE];
+	size_t limit = sizeof(text) - sizeof(BLIB_ANSI_COLOR_RESET "\n");
+	int n = snprintf(text, limit, "%s[ %s:%d %s] " BLIB_ANSI_COLOR_RESET, color, file, line, color);
+	size_t length = n < 0 ? 0 : (size_t)n < limit ? (size_t)n : limit - 1;
+	va_list args;
+	va_start(args, format);
+	n = vsnprintf(text + length, limit - length, format, args);
+	va_end(args);
+	length += n < 0 ? 0 : (size_t)n < limit - length ? (size_t)n : limit - length - 1;
+	memcpy(text + length, "\n" BLIB_ANSI_COLOR_RESET, sizeof("\n" BLIB_ANSI_COLOR_RESET) - 1);
+	length += sizeof("\n" BLIB_ANSI_COLOR_RESET) - 1;
+
+	pthread_once(&log_async.once, log_async_start);
+	// Announce the producer before checking "running", shutdown clears
+	// "running" before it waits for the count to drop, so a message is
+	// either queued before the writer stops or written here.
+	__atomic_fetch_add(&log_async.producers, 1, __ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&log_async.running, __ATOMIC_SEQ_CST)) {
+		__atomic_fetch_sub(&log_async.producers, 1, __ATOMIC_SEQ_CST);
+		fwrite(text, 1, length, stream);
+		return;
+	}
+
+	size_t position = __atomic_load_n(&log_async.enqueue_position, __ATOMIC_RELAXED);
+	log_async_cell *cell;
+	for (;;) {
+		cell = &log_async.cells[position & (BLIB_LOG_ASYNC_QUEUE_SIZE - 1)];
+		size_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+		intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+		if (difference == 0) {
+			if (__atomic_compare_exchange_n(&log_async.enqueue_position, &position, position + 1,
+						1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				break;
+		} else if (difference < 0) {
+			if (!__atomic_load_n(&log_async.running, __ATOMIC_ACQUIRE)) {
+				__atomic_fetch_sub(&log_async.producers, 1, __ATOMIC_SEQ_CST);
+				fwrite(text, 1, length, stream);
+				return;
+			}
+			if (__atomic_load_n(&log_async.policy, __ATOMIC_RELAXED) == LOG_ASYNC_DROP) {
+				__atomic_fetch_add(&log_async.dropped, 1, __ATOMIC_RELAXED);
+				__atomic_fetch_sub(&log_async.producers, 1, __ATOMIC_SEQ_CST);
+				return;
+			}
+			sched_yield();
+			position = __atomic_load_n(&log_async.enqueue_position, __ATOMIC_RELAXED);
+		} else {
+			position = __atomic_load_n(&log_async.enqueue_position, __ATOMIC_RELAXED);
+		}
+	}
+	cell->stream = stream;
+	cell->length = length;
+	memcpy(cell->text, text, length);
+	__atomic_store_n(&cell->sequence, position + 1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&log_async.sleeping, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&log_async.mutex);
+		__atomic_store_n(&log_async.sleeping, 0, __ATOMIC_SEQ_CST);
+		pthread_cond_signal(&log_async.wake);
+		pthread_mutex_unlock(&log_async.mutex);
+	}
+	__atomic_fetch_sub(&log_async.producers, 1, __ATOMIC_SEQ_CST);
+}
+
+void log_async_set_policy(int policy) {
+	__atomic_store_n(&log_async.policy, policy, __ATOMIC_RELAXED);
+}
+
+/*Blocks until everything queued before the call has been written.*/
+void log_async_flush(void) {
+	if (!__atomic_load_n(&log_async.running, __ATOMIC_ACQUIRE))
+		return;
+	size_t target = __atomic_load_n(&log_async.enqueue_position, __ATOMIC_ACQUIRE);
+	pthread_mutex_lock(&log_async.mutex);
+	while (__atomic_load_n(&log_async.written_position, __ATOMIC_ACQUIRE) < target &&
+			__atomic_load_n(&log_async.running, __ATOMIC_ACQUIRE))
+		pthread_cond_wait(&log_async.flushed, &log_async.mutex);
+	pthread_mutex_unlock(&log_async.mutex);
+}
+
+/*Drains the queue and stops the writer. Registered with atexit() so queued
+  messages are never lost on a normal exit. Producers that already passed
+  the running check finish queueing first, later messages (including all of
+  them when called before the first one) are written synchronously.*/
+void log_async_shutdown(void) {
+	pthread_once(&log_async.once, log_async_never_start);
+	if (!__atomic_exchange_n(&log_async.running, 0, __ATOMIC_SEQ_CST))
+		return;
+	// The writer still drains, so producers waiting for a free cell finish.
+	while (__atomic_load_n(&log_async.producers, __ATOMIC_SEQ_CST))
+		sched_yield();
+	pthread_mutex_lock(&log_async.mutex);
+	log_async.stop = 1;
+	__atomic_store_n(&log_async.sleeping, 0, __ATOMIC_SEQ_CST);
+	pthread_cond_signal(&log_async.wake);
+	pthread_cond_broadcast(&log_async.flushed);
+	pthread_mutex_unlock(&log_async.mutex);
+	pthread_join(log_async.writer, NULL);
+}
+
+size_t log_async_dropped(void) {
+	return __atomic_load_n(&log_async.dropped, __ATOMIC_RELAXED);
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_LOG_ASYNC
+#endif // BLIB_LOG_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
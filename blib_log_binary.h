@@ -0,0 +1,819 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Binary logging with deferred formatting.
+
+  debug_binary(LOG_LEVEL_INFO, "chunk %d took %f ms", id, ms);
+
+  The first time a call site runs it registers its format string, file and
+  line and gets an id. From then on a call only copies the site id, a
+  timer_ticks() timestamp and the raw argument values into a ring owned by
+  the calling thread. A background thread moves the rings to the file opened
+  with log_binary_open(), and log_binary_decode() (see tools/log_decode.c)
+  turns the file back into text offline.
+
+  Integers, pointers and doubles are stored as 8 bytes, strings as a 16 bit
+  length followed by at most BLIB_LOG_BINARY_MAX_STRING bytes. Records are
+  written in host byte order, so decode on the same architecture. A full
+  ring drops the message and counts it, see log_binary_dropped().*/
+
+#ifndef BLIB_LOG_BINARY_H
+#define BLIB_LOG_BINARY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "blib_log.h"
+#include "blib_timer.h"
+
+/*Per thread ring size, must be a power of two*/
+#ifndef BLIB_LOG_BINARY_RING_SIZE
+#define BLIB_LOG_BINARY_RING_SIZE (1024 * 1024 /* bytes */)
+#endif
+
+#define BLIB_LOG_BINARY_MAX_ARGS (16)
+#define BLIB_LOG_BINARY_MAX_STRING (256 /* bytes */)
+#define BLIB_LOG_BINARY_FLUSH_MS (10 /* milliseconds */)
+#define BLIB_LOG_BINARY_VERSION (1)
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/*One per call site, zero initialized by the debug_binary() macro*/
+typedef struct {
+	uint32_t id;
+	uint8_t level;
+	uint8_t arg_count;
+	uint8_t args[BLIB_LOG_BINARY_MAX_ARGS];
+	int line;
+	const char *file;
+	const char *format;
+} log_binary_site;
+
+int log_binary_open(const char *path);
+void log_binary_close(void);
+size_t log_binary_dropped(void);
+void log_binary_write(log_binary_site *site, int level, const char *file, int line,
+		const char *format, ...);
+int log_binary_decode(const char *path, FILE *out);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#define debug_binary(level, ...) do {\
+	if (BLIB_LOG_ENABLED(level)) {\
+		static log_binary_site blib_log_binary_site;\
+		log_binary_write(&blib_log_binary_site, level, __FILE__, __LINE__, __VA_ARGS__);\
+	}\
+} while (0)
+
+#endif // BLIB_LOG_BINARY_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_LOG_BINARY_IMPLEMENTATION_H
+#define BLIB_LOG_BINARY_IMPLEMENTATION_H
+
+#include <ctype.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+enum {
+	LOG_BINARY_ARG_NONE,
+	LOG_BINARY_ARG_INT,
+	LOG_BINARY_ARG_LONG,
+	LOG_BINARY_ARG_LLONG,
+	LOG_BINARY_ARG_SIZE,
+	LOG_BINARY_ARG_INTMAX,
+	LOG_BINARY_ARG_PTRDIFF,
+	LOG_BINARY_ARG_DOUBLE,
+	LOG_BINARY_ARG_LDOUBLE,
+	LOG_BINARY_ARG_STRING,
+	LOG_BINARY_ARG_POINTER,
+};
+
+enum {
+	LOG_BINARY_RECORD_SITE = 1,
+	LOG_BINARY_RECORD_CHUNK = 2,
+};
+
+typedef struct log_binary_ring {
+	uint8_t *data;
+	size_t head; // advanced by the owning thread
+	size_t tail; // advanced by the flusher
+	uint32_t thread;
+	int retired; // set when the owning thread exits
+	struct log_binary_ring *next;
+} log_binary_ring;
+
+static struct {
+	FILE *file;
+	int open;
+	int stop;
+	int atexit_registered;
+	int flushing; // the flusher thread is running
+	size_t dropped;
+	uint32_t thread_count;
+	log_binary_site **sites;
+	size_t site_count;
+	size_t site_capacity;
+	size_t sites_written;
+	log_binary_ring *rings;
+	pthread_t flusher;
+	pthread_mutex_t mutex;
+	pthread_cond_t wake;
+} log_binary = {
+	NULL, 0, 0, 0, 0, 0, 0, NULL, 0, 0, 0, NULL, 0,
+	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER
+};
+
+static __thread log_binary_ring *log_binary_thread_ring = NULL;
+
+/*Its destructor hands the ring of an exiting thread back, see
+  log_binary_ring_retire()*/
+static pthread_once_t log_binary_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t log_binary_key;
+
+/*Parses one conversion after its '%'. Returns the position after it and
+  reports how many '*' arguments it consumes and the kind of its value.*/
+static const char *log_binary_spec(const char *f, int *stars, int *kind) {
+	*stars = 0;
+	while (*f && strchr("-+ #0", *f))
+		f++;
+	if (*f == '*') {
+		(*stars)++;
+		f++;
+	}
+	while (isdigit((unsigned char)*f))
+		f++;
+	if (*f == '.') {
+		f++;
+		if (*f == '*') {
+			(*stars)++;
+			f++;
+		}
+		while (isdigit((unsigned char)*f))
+			f++;
+	}
+	char length = 0;
+	if (*f == 'h') {
+		f += f[1] == 'h' ? 2 : 1;
+	} else if (*f == 'l') {
+		length = f[1] == 'l' ? 'q' : 'l';
+		f += f[1] == 'l' ? 2 : 1;
+	} else if (*f == 'j' || *f == 'z' || *f == 't' || *f == 'L') {
+		length = *f++;
+	}
+	char conversion = *f;
+	if (conversion)
+		f++;
+	switch (conversion) {
+		case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': case 'c': {
+			switch (length) {
+				case 'l': *kind = LOG_BINARY_ARG_LONG; break;
+				case 'q': *kind = LOG_BINARY_ARG_LLONG; break;
+				case 'z': *kind = LOG_BINARY_ARG_SIZE; break;
+				case 'j': *kind = LOG_BINARY_ARG_INTMAX; break;
+				case 't': *kind = LOG_BINARY_ARG_PTRDIFF; break;
+				default: *kind = LOG_BINARY_ARG_INT; break;
+			}
+		} break;
+		case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A': {
+			*kind = length == 'L' ? LOG_BINARY_ARG_LDOUBLE : LOG_BINARY_ARG_DOUBLE;
+		} break;
+		case 's': *kind = length == 'l' ? LOG_BINARY_ARG_POINTER : LOG_BINARY_ARG_STRING; break;
+		case 'p': *kind = LOG_BINARY_ARG_POINTER; break;
+		default: *kind = LOG_BINARY_ARG_NONE; break; // %% and the unsupported %n
+	}
+	return f;
+}
+
+/*Fills "args" with the kind of every argument "format" consumes, in order.
+  Returns the count, capped at BLIB_LOG_BINARY_MAX_ARGS.*/
+static int log_binary_parse(const char *format, uint8_t *args) {
+	int count = 0;
+	for (const char *f = format; *f;) {
+		if (*f++ != '%')
+			continue;
+		int stars, kind;
+		f = log_binary_spec(f, &stars, &kind);
+		while (stars-- > 0 && count < BLIB_LOG_BINARY_MAX_ARGS)
+			args[count++] = LOG_BINARY_ARG_INT;
+		if (kind != LOG_BINARY_ARG_NONE && count < BLIB_LOG_BINARY_MAX_ARGS)
+			args[count++] = (uint8_t)kind;
+	}
+	return count;
+}
+
+static void log_binary_register(log_binary_site *site, int level, const char *file, int line,
+		const char *format) {
+	pthread_mutex_lock(&log_binary.mutex);
+	if (site->id == 0) {
+		site->level = (uint8_t)level;
+		site->file = file;
+		site->line = line;
+		site->format = format;
+		site->arg_count = (uint8_t)log_binary_parse(format, site->args);
+		if (log_binary.site_count == log_binary.site_capacity) {
+			log_binary.site_capacity = log_binary.site_capacity * 2 + 64;
+			log_binary.sites = (log_binary_site **)realloc(log_binary.sites,
+					sizeof(log_binary_site *) * log_binary.site_capacity);
+		}
+		log_binary.sites[log_binary.site_count++] = site;
+		__atomic_store_n(&site->id, (uint32_t)log_binary.site_count, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&log_binary.mutex);
+}
+
+/*Removes "ring" from the list and frees it. Called with the mutex held,
+  by the flusher or while no flusher runs.*/
+static void log_binary_ring_free(log_binary_ring *ring) {
+	log_binary_ring **link = &log_binary.rings;
+	while (*link != ring)
+		link = &(*link)->next;
+	__atomic_store_n(link, ring->next, __ATOMIC_RELEASE);
+	free(ring->data);
+	free(ring);
+}
+
+/*Runs when a thread that logged exits. While the log is open the flusher
+  writes what is left and frees the ring, otherwise it is freed here.*/
+static void log_binary_ring_retire(void *value) {
+	log_binary_ring *ring = (log_binary_ring *)value;
+	log_binary_thread_ring = NULL;
+	pthread_mutex_lock(&log_binary.mutex);
+	if (log_binary.flushing)
+		__atomic_store_n(&ring->retired, 1, __ATOMIC_RELEASE);
+	else
+		log_binary_ring_free(ring);
+	pthread_mutex_unlock(&log_binary.mutex);
+}
+
+/*Frees the rings of threads that exited while the flusher ran. Called with
+  the mutex held once the flusher is gone.*/
+static void log_binary_free_retired(void) {
+	log_binary_ring *next = NULL;
+	for (log_binary_ring *ring = log_binary.rings; ring; ring = next) {
+		next = ring->next;
+		if (ring->retired)
+			log_binary_ring_free(ring);
+	}
+}
+
+static void log_binary_key_create(void) {
+	pthread_key_create(&log_binary_key, log_binary_ring_retire);
+}
+
+static log_binary_ring *log_binary_ring_create(void) {
+	pthread_once(&log_binary_key_once, log_binary_key_create);
+	log_binary_ring *ring = (log_binary_ring *)calloc(1, sizeof(log_binary_ring));
+	ring->data = (uint8_t *)malloc(BLIB_LOG_BINARY_RING_SIZE);
+	pthread_mutex_lock(&log_binary.mutex);
+	ring->thread = ++log_binary.thread_count;
+	ring->next = log_binary.rings;
+	__atomic_store_n(&log_binary.rings, ring, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&log_binary.mutex);
+	pthread_setspecific(log_binary_key, ring);
+	return ring;
+}
+
+static void log_binary_put(uint8_t **p, const void *value, size_t size) {
+	memcpy(*p, value, size);
+	*p += size;
+}
+
+void log_binary_write(log_binary_site *site, int level, const char *file, int line,
+		const char *format, ...) {
+	if (!__atomic_load_n(&log_binary.open, __ATOMIC_RELAXED))
+		return;
+	uint64_t ticks = timer_ticks();
+	uint32_t id = __atomic_load_n(&site->id, __ATOMIC_ACQUIRE);
+	if (BLIB_LOG_UNLIKELY(id == 0)) {
+		log_binary_register(site, level, file, line, format);
+		id = site->id;
+	}
+	log_binary_ring *ring = log_binary_thread_ring;
+	if (BLIB_LOG_UNLIKELY(ring == NULL))
+		ring = log_binary_thread_ring = log_binary_ring_create();
+
+	uint8_t record[12 + BLIB_LOG_BINARY_MAX_ARGS * (2 + BLIB_LOG_BINARY_MAX_STRING)];
+	uint8_t *p = record;
+	log_binary_put(&p, &id, 4);
+	log_binary_put(&p, &ticks, 8);
+	va_list args;
+	va_start(args, format);
+	for (int i = 0; i < site->arg_count; i++) {
+		int64_t n = 0;
+		double d = 0.0;
+		switch (site->args[i]) {
+			case LOG_BINARY_ARG_INT: n = va_arg(args, int); break;
+			case LOG_BINARY_ARG_LONG: n = va_arg(args, long); break;
+			case LOG_BINARY_ARG_LLONG: n = va_arg(args, long long); break;
+			case LOG_BINARY_ARG_SIZE: n = (int64_t)va_arg(args, size_t); break;
+			case LOG_BINARY_ARG_INTMAX: n = va_arg(args, intmax_t); break;
+			case LOG_BINARY_ARG_PTRDIFF: n = va_arg(args, ptrdiff_t); break;
+			case LOG_BINARY_ARG_POINTER: n = (int64_t)(uintptr_t)va_arg(args, void *); break;
+			case LOG_BINARY_ARG_DOUBLE: d = va_arg(args, double); break;
+			case LOG_BINARY_ARG_LDOUBLE: d = (double)va_arg(args, long double); break;
+			case LOG_BINARY_ARG_STRING: {
+				const char *s = va_arg(args, const char *);
+				s = s ? s : "(null)";
+				uint16_t length = 0;
+				while (length < BLIB_LOG_BINARY_MAX_STRING && s[length])
+					length++;
+				log_binary_put(&p, &length, 2);
+				log_binary_put(&p, s, length);
+			} continue;
+		}
+		if (site->args[i] == LOG_BINARY_ARG_DOUBLE || site->args[i] == LOG_BINARY_ARG_LDOUBLE)
+			log_binary_put(&p, &d, 8);
+		else
+			log_binary_put(&p, &n, 8);
+	}
+	va_end(args);
+
+	size_t size = (size_t)(p - record);
+	size_t head = ring->head;
+	size_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	if (BLIB_LOG_BINARY_RING_SIZE - (head - tail) < size) {
+		__atomic_fetch_add(&log_binary.dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	size_t offset = head & (BLIB_LOG_BINARY_RING_SIZE - 1);
+	size_t first = BLIB_LOG_BINARY_RING_SIZE - offset < size ? BLIB_LOG_BINARY_RING_SIZE - offset : size;
+	memcpy(ring->data + offset, record, first);
+	memcpy(ring->data, record + first, size - first);
+	__atomic_store_n(&ring->head, head + size, __ATOMIC_RELEASE);
+}
+
+static void log_binary_write_sites(void) {
+	pthread_mutex_lock(&log_binary.mutex);
+	for (; log_binary.sites_written < log_binary.site_count; log_binary.sites_written++) {
+		log_binary_site *site = log_binary.sites[log_binary.sites_written];
+		uint8_t tag = LOG_BINARY_RECORD_SITE;
+		uint32_t line = (uint32_t)site->line;
+		uint16_t file_length = (uint16_t)strlen(site->file);
+		uint16_t format_length = (uint16_t)strlen(site->format);
+		fwrite(&tag, 1, 1, log_binary.file);
+		fwrite(&site->id, 4, 1, log_binary.file);
+		fwrite(&line, 4, 1, log_binary.file);
+		fwrite(&site->level, 1, 1, log_binary.file);
+		fwrite(&file_length, 2, 1, log_binary.file);
+		fwrite(site->file, 1, file_length, log_binary.file);
+		fwrite(&format_length, 2, 1, log_binary.file);
+		fwrite(site->format, 1, format_length, log_binary.file);
+	}
+	pthread_mutex_unlock(&log_binary.mutex);
+}
+
+static void log_binary_write_chunk(log_binary_ring *ring, size_t head, size_t tail) {
+	uint8_t tag = LOG_BINARY_RECORD_CHUNK;
+	uint32_t length = (uint32_t)(head - tail);
+	size_t offset = tail & (BLIB_LOG_BINARY_RING_SIZE - 1);
+	size_t first = BLIB_LOG_BINARY_RING_SIZE - offset < length ? BLIB_LOG_BINARY_RING_SIZE - offset : length;
+	fwrite(&tag, 1, 1, log_binary.file);
+	fwrite(&ring->thread, 4, 1, log_binary.file);
+	fwrite(&length, 4, 1, log_binary.file);
+	fwrite(ring->data + offset, 1, first, log_binary.file);
+	fwrite(ring->data, 1, length - first, log_binary.file);
+	__atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+}
+
+/*Only the flusher drains, so it may free retired rings once they are
+  written out*/
+static void log_binary_drain(void) {
+	log_binary_write_sites();
+	log_binary_ring *next = NULL;
+	for (log_binary_ring *ring = __atomic_load_n(&log_binary.rings, __ATOMIC_ACQUIRE); ring; ring = next) {
+		next = ring->next;
+		// Read before head, the owner's last records are then visible.
+		int retired = __atomic_load_n(&ring->retired, __ATOMIC_ACQUIRE);
+		size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		size_t tail = ring->tail;
+		if (head != tail)
+			log_binary_write_chunk(ring, head, tail);
+		if (retired) {
+			pthread_mutex_lock(&log_binary.mutex);
+			log_binary_ring_free(ring);
+			pthread_mutex_unlock(&log_binary.mutex);
+		}
+	}
+	fflush(log_binary.file);
+}
+
+static void *log_binary_flusher(void *arg) {
+	(void)arg;
+	pthread_mutex_lock(&log_binary.mutex);
+	while (!log_binary.stop) {
+		struct timeval now;
+		struct timespec until;
+		gettimeofday(&now, NULL);
+		long ns = (long)now.tv_usec * 1000 + BLIB_LOG_BINARY_FLUSH_MS * 1000000L;
+		until.tv_sec = now.tv_sec + ns / 1000000000L;
+		until.tv_nsec = ns % 1000000000L;
+		pthread_cond_timedwait(&log_binary.wake, &log_binary.mutex, &until);
+		pthread_mutex_unlock(&log_binary.mutex);
+		log_binary_drain();
+		pthread_mutex_lock(&log_binary.mutex);
+	}
+	pthread_mutex_unlock(&log_binary.mutex);
+	log_binary_drain();
+	return NULL;
+}
+
+/*Starts writing binary records to "path". Returns 0 if the file could not
+  be opened. A thread's ring is freed when the thread exits and is reused if
+  the log is closed and opened again while the thread lives.*/
+int log_binary_open(const char *path) {
+	if (__atomic_load_n(&log_binary.open, __ATOMIC_ACQUIRE))
+		log_binary_close();
+	FILE *file = fopen(path, "wb");
+	if (file == NULL)
+		return 0;
+	uint32_t version = BLIB_LOG_BINARY_VERSION;
+	uint64_t ticks_per_second = timer_ticks_per_second();
+	fwrite("BLOG", 1, 4, file);
+	fwrite(&version, 4, 1, file);
+	fwrite(&ticks_per_second, 8, 1, file);
+
+	pthread_mutex_lock(&log_binary.mutex);
+	log_binary.file = file;
+	log_binary.stop = 0;
+	log_binary.sites_written = 0;
+	log_binary.flushing = 1;
+	for (log_binary_ring *ring = log_binary.rings; ring; ring = ring->next)
+		ring->tail = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	pthread_mutex_unlock(&log_binary.mutex);
+	if (pthread_create(&log_binary.flusher, NULL, log_binary_flusher, NULL)) {
+		pthread_mutex_lock(&log_binary.mutex);
+		log_binary.flushing = 0;
+		log_binary_free_retired();
+		pthread_mutex_unlock(&log_binary.mutex);
+		fclose(file);
+		return 0;
+	}
+	if (!log_binary.atexit_registered) {
+		log_binary.atexit_registered = 1;
+		atexit(log_binary_close);
+	}
+	__atomic_store_n(&log_binary.open, 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+/*Writes everything still in the rings and closes the file. Frees the rings
+  of exited threads and the ring of the calling thread, the other threads
+  keep theirs until they exit. Registered with atexit() by log_binary_open().*/
+void log_binary_close(void) {
+	if (!__atomic_exchange_n(&log_binary.open, 0, __ATOMIC_ACQ_REL))
+		return;
+	pthread_mutex_lock(&log_binary.mutex);
+	log_binary.stop = 1;
+	pthread_cond_signal(&log_binary.wake);
+	pthread_mutex_unlock(&log_binary.mutex);
+	pthread_join(log_binary.flusher, NULL);
+	fclose(log_binary.file);
+	log_binary.file = NULL;
+
+	pthread_mutex_lock(&log_binary.mutex);
+	log_binary.flushing = 0;
+	log_binary_free_retired();
+	if (log_binary_thread_ring) {
+		log_binary_ring_free(log_binary_thread_ring);
+		log_binary_thread_ring = NULL;
+		pthread_setspecific(log_binary_key, NULL);
+	}
+	pthread_mutex_unlock(&log_binary.mutex);
+}
+
+size_t log_binary_dropped(void) {
+	return __atomic_load_n(&log_binary.dropped, __ATOMIC_RELAXED);
+}
+
+typedef struct {
+	uint64_t ticks;
+	uint32_t thread;
+	size_t offset;
+	size_t length;
+} log_binary_event;
+
+static int log_binary_event_compare(const void *a, const void *b) {
+	const log_binary_event *x = (const log_binary_event *)a;
+	const log_binary_event *y = (const log_binary_event *)b;
+	if (x->ticks != y->ticks)
+		return x->ticks < y->ticks ? -1 : 1;
+	return x->offset < y->offset ? -1 : x->offset > y->offset;
+}
+
+typedef struct {
+	char *text;
+	size_t length;
+	size_t capacity;
+} log_binary_text;
+
+static void log_binary_append(log_binary_text *t, const char *s, size_t length) {
+	if (t->length + length + 1 > t->capacity) {
+		t->capacity = (t->length + length + 1) * 2;
+		t->text = (char *)realloc(t->text, t->capacity);
+	}
+	memcpy(t->text + t->length, s, length);
+	t->length += length;
+}
+
+/*Renders one event's arguments through its site's format string. Returns
+  the number of payload bytes consumed.*/
+static size_t log_binary_render(const log_binary_site *site, const uint8_t *p, const uint8_t *end,
+		log_binary_text *out) {
+	const uint8_t *start = p;
+	int arg = 0;
+	const char *f = site->format;
+	while (*f) {
+		const char *literal = f;
+		while (*f && *f != '%')
+			f++;
+		log_binary_append(out, literal, (size_t)(f - literal));
+		if (!*f)
+			break;
+		const char *spec_start = f++;
+		int stars, kind;
+		f = log_binary_spec(f, &stars, &kind);
+		if (kind == LOG_BINARY_ARG_NONE) {
+			if (f[-1] == '%')
+				log_binary_append(out, "%", 1);
+			continue;
+		}
+		// Rebuild the conversion with any '*' replaced by its recorded value.
+		char spec[64];
+		size_t spec_length = 0;
+		int ok = 1;
+		for (const char *s = spec_start; s < f && spec_length < sizeof(spec) - 24; s++) {
+			if (*s != '*') {
+				spec[spec_length++] = *s;
+				continue;
+			}
+			int64_t star = 0;
+			if (arg >= site->arg_count || end - p < 8) {
+				ok = 0;
+				break;
+			}
+			memcpy(&star, p, 8);
+			p += 8;
+			arg++;
+			spec_length += (size_t)sprintf(spec + spec_length, "%d", (int)star);
+		}
+		spec[spec_length] = '\0';
+		if (!ok || arg >= site->arg_count) {
+			log_binary_append(out, spec_start, (size_t)(f - spec_start));
+			continue;
+		}
+		char buffer[BLIB_LOG_BINARY_MAX_STRING + 128];
+		int n = 0;
+		int64_t v = 0;
+		double d = 0.0;
+		char conversion = f[-1];
+		int is_signed = conversion == 'd' || conversion == 'i';
+		if (kind == LOG_BINARY_ARG_STRING) {
+			uint16_t length = 0;
+			if (end - p < 2)
+				break;
+			memcpy(&length, p, 2);
+			p += 2;
+			if ((size_t)(end - p) < length)
+				break;
+			char string[BLIB_LOG_BINARY_MAX_STRING + 1];
+			memcpy(string, p, length);
+			string[length] = '\0';
+			p += length;
+			n = snprintf(buffer, sizeof(buffer), spec, string);
+		} else {
+			if (end - p < 8)
+				break;
+			memcpy(kind == LOG_BINARY_ARG_DOUBLE || kind == LOG_BINARY_ARG_LDOUBLE ? (void *)&d : (void *)&v, p, 8);
+			p += 8;
+			switch (kind) {
+				case LOG_BINARY_ARG_INT: n = is_signed || conversion == 'c' ?
+					snprintf(buffer, sizeof(buffer), spec, (int)v) :
+					snprintf(buffer, sizeof(buffer), spec, (unsigned)v); break;
+				case LOG_BINARY_ARG_LONG: n = is_signed ?
+					snprintf(buffer, sizeof(buffer), spec, (long)v) :
+					snprintf(buffer, sizeof(buffer), spec, (unsigned long)v); break;
+				case LOG_BINARY_ARG_LLONG: n = is_signed ?
+					snprintf(buffer, sizeof(buffer), spec, (long long)v) :
+					snprintf(buffer, sizeof(buffer), spec, (unsigned long long)v); break;
+				case LOG_BINARY_ARG_SIZE: n = snprintf(buffer, sizeof(buffer), spec, (size_t)v); break;
+				case LOG_BINARY_ARG_INTMAX: n = is_signed ?
+					snprintf(buffer, sizeof(buffer), spec, (intmax_t)v) :
+					snprintf(buffer, sizeof(buffer), spec, (uintmax_t)v); break;
+				case LOG_BINARY_ARG_PTRDIFF: n = snprintf(buffer, sizeof(buffer), spec, (ptrdiff_t)v); break;
+				case LOG_BINARY_ARG_POINTER: n = snprintf(buffer, sizeof(buffer), spec, (void *)(uintptr_t)v); break;
+				case LOG_BINARY_ARG_DOUBLE: n = snprintf(buffer, sizeof(buffer), spec, d); break;
+				case LOG_BINARY_ARG_LDOUBLE: n = snprintf(buffer, sizeof(buffer), spec, (long double)d); break;
+			}
+		}
+		arg++;
+		if (n > 0)
+			log_binary_append(out, buffer, (size_t)n < sizeof(buffer) ? (size_t)n : sizeof(buffer) - 1);
+	}
+	// Skip arguments the format did not get to, so the next event lines up.
+	for (; arg < site->arg_count && p < end; arg++) {
+		if (site->args[arg] == LOG_BINARY_ARG_STRING) {
+			uint16_t length = 0;
+			memcpy(&length, p, 2);
+			p += 2 + length;
+		} else {
+			p += 8;
+		}
+	}
+	return (size_t)(p - start);
+}
+
+/*Decodes a file written through log_binary_open() and prints one line per
+  message to "out", ordered by timestamp across all threads. Returns 0 if
+  the file is missing or malformed.*/
+int log_binary_decode(const char *path, FILE *out) {
+	static const char *level_names[] = { "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL" };
+	FILE *file = fopen(path, "rb");
+	if (file == NULL)
+		return 0;
+	size_t size = 0, capacity = 1 << 16;
+	uint8_t *data = (uint8_t *)malloc(capacity);
+	size_t got;
+	while ((got = fread(data + size, 1, capacity - size, file)) > 0) {
+		size += got;
+		if (size == capacity) {
+			capacity *= 2;
+			data = (uint8_t *)realloc(data, capacity);
+		}
+	}
+	fclose(file);
+
+	uint64_t ticks_per_second = 0;
+	if (size < 16 || memcmp(data, "BLOG", 4) || data[4] != BLIB_LOG_BINARY_VERSION) {
+		free(data);
+		return 0;
+	}
+	memcpy(&ticks_per_second, data + 8, 8);
+
+	// First pass: collect every call site, they can appear after their events.
+	log_binary_site *sites = NULL;
+	size_t site_count = 0;
+	int ok = 1;
+	for (size_t at = 16; at < size && ok;) {
+		uint8_t tag = data[at++];
+		if (tag == LOG_BINARY_RECORD_SITE) {
+			uint32_t id, line;
+			uint16_t file_length, format_length;
+			if (size - at < 11) { ok = 0; break; }
+			memcpy(&id, data + at, 4);
+			memcpy(&line, data + at + 4, 4);
+			uint8_t level = data[at + 8];
+			memcpy(&file_length, data + at + 9, 2);
+			at += 11;
+			if (size - at < (size_t)file_length + 2) { ok = 0; break; }
+			char *site_file = (char *)malloc(file_length + 1u);
+			memcpy(site_file, data + at, file_length);
+			site_file[file_length] = '\0';
+			at += file_length;
+			memcpy(&format_length, data + at, 2);
+			at += 2;
+			if (size - at < format_length) { free(site_file); ok = 0; break; }
+			char *format = (char *)malloc(format_length + 1u);
+			memcpy(format, data + at, format_length);
+			format[format_length] = '\0';
+			at += format_length;
+			if (id > site_count) {
+				sites = (log_binary_site *)realloc(sites, sizeof(log_binary_site) * id);
+				memset(sites + site_count, 0, sizeof(log_binary_site) * (id - site_count));
+				site_count = id;
+			}
+			log_binary_site *site = &sites[id - 1];
+			free((void *)site->file);
+			free((void *)site->format);
+			site->id = id;
+			site->line = (int)line;
+			site->level = level;
+			site->file = site_file;
+			site->format = format;
+			site->arg_count = (uint8_t)log_binary_parse(format, site->args);
+		} else if (tag == LOG_BINARY_RECORD_CHUNK) {
+			uint32_t length;
+			if (size - at < 8) { ok = 0; break; }
+			memcpy(&length, data + at + 4, 4);
+			at += 8 + length;
+		} else {
+			ok = 0;
+		}
+	}
+
+	// Second pass: render every event, then sort them by time.
+	log_binary_text text = { NULL, 0, 0 };
+	log_binary_event *events = NULL;
+	size_t event_count = 0, event_capacity = 0;
+	uint64_t first_ticks = UINT64_MAX;
+	for (size_t at = 16; at < size && ok;) {
+		uint8_t tag = data[at++];
+		if (tag == LOG_BINARY_RECORD_SITE) {
+			uint16_t file_length, format_length;
+			memcpy(&file_length, data + at + 9, 2);
+			at += 11 + file_length;
+			memcpy(&format_length, data + at, 2);
+			at += 2 + format_length;
+			continue;
+		}
+		uint32_t thread, length;
+		memcpy(&thread, data + at, 4);
+		memcpy(&length, data + at + 4, 4);
+		at += 8;
+		const uint8_t *p = data + at;
+		const uint8_t *end = p + (length <= size - at ? length : size - at);
+		at += length;
+		while (end - p >= 12) {
+			uint32_t id;
+			uint64_t ticks;
+			memcpy(&id, p, 4);
+			memcpy(&ticks, p + 4, 8);
+			p += 12;
+			if (id == 0 || id > site_count || sites[id - 1].format == NULL) {
+				ok = 0;
+				break;
+			}
+			const log_binary_site *site = &sites[id - 1];
+			if (event_count == event_capacity) {
+				event_capacity = event_capacity * 2 + 1024;
+				events = (log_binary_event *)realloc(events, sizeof(log_binary_event) * event_capacity);
+			}
+			log_binary_event *event = &events[event_count++];
+			event->ticks = ticks;
+			event->thread = thread;
+			event->offset = text.length;
+			const char *level = level_names[site->level < 6 ? site->level : 5];
+			char prefix[64];
+			log_binary_append(&text, "[ ", 2);
+			log_binary_append(&text, level, strlen(level));
+			int n = snprintf(prefix, sizeof(prefix), " T%u ", thread);
+			log_binary_append(&text, prefix, (size_t)n);
+			log_binary_append(&text, site->file, strlen(site->file));
+			n = snprintf(prefix, sizeof(prefix), ":%d ] ", site->line);
+			log_binary_append(&text, prefix, (size_t)n);
+			p += log_binary_render(site, p, end, &text);
+			event->length = text.length - event->offset;
+			first_ticks = ticks < first_ticks ? ticks : first_ticks;
+		}
+	}
+
+	if (ok) {
+		qsort(events, event_count, sizeof(log_binary_event), log_binary_event_compare);
+		double scale = ticks_per_second ? 1e3 / (double)ticks_per_second : 1e-6;
+		for (size_t i = 0; i < event_count; i++) {
+			fprintf(out, "%12.6f ms %.*s\n", (double)(events[i].ticks - first_ticks) * scale,
+					(int)events[i].length, text.text + events[i].offset);
+		}
+	}
+
+	for (size_t i = 0; i < site_count; i++) {
+		free((void *)sites[i].file);
+		free((void *)sites[i].format);
+	}
+	free(sites);
+	free(events);
+	free(text.text);
+	free(data);
+	return ok;
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_LOG_BINARY_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
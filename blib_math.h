@@ -37,6 +37,24 @@ SOFTWARE.
 #define FLOAT_EPSILON (1e-4)
 #define PI 3.14159265358
 
+/*Define BLIB_FAST_MATH to route the trigonometry and powers in this header
+  and blib_math3d.h through the approximations in blib_fast_math.h. The
+  pseudo-random noise1/2/3 functions return different values in that mode.*/
+#ifdef BLIB_FAST_MATH
+#include "blib_fast_math.h"
+#define BLIB_SINF fast_sinf
+#define BLIB_COSF fast_cosf
+#define BLIB_COS fast_cosf
+#define BLIB_POW fast_powf
+#define BLIB_FMOD fast_fmodf
+#else
+#define BLIB_SINF sinf
+#define BLIB_COSF cosf
+#define BLIB_COS cos
+#define BLIB_POW pow
+#define BLIB_FMOD fmod
+#endif // BLIB_FAST_MATH
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
@@ -46,7 +64,7 @@ static inline float rad2deg(const float n) { return n * (180.0f / PI); }
 static inline float deg2rad(const float n) { return n * (PI / 180.0f); }
 
 static inline float wrapAngle(float a) {
-  a = fmod(a, 2 * PI);
+  a = BLIB_FMOD(a, 2 * PI);
   if (a < 0) {
     a += 2 * PI;
   }
@@ -81,11 +99,11 @@ static inline int aproxequal(float a, float b, float tolerance) {
 }
 
 static inline float cosInterpolate(float a, float b, float t) {
-  float f = (1.0f - cos(t * PI)) * 0.5f;
+  float f = (1.0f - BLIB_COS(t * PI)) * 0.5f;
   return a * (1.0 - f) + b * f;
 }
 
-static inline float sigmoid(float n) { return (1 / (1 + pow(2.71828182846, -n))); }
+static inline float sigmoid(float n) { return (1 / (1 + BLIB_POW(2.71828182846, -n))); }
 
 static inline float loop(float n, const float length) {
   return clamp(n - floor(n / length) * length, 0.0f, length);
@@ -110,19 +128,19 @@ static inline float fraction(float x) {
 
 // Single dimensional pseudo-random noise
 static inline float noise1(int x) {
-  float wave = sinf(x*53)*6151;
+  float wave = BLIB_SINF(x*53)*6151;
   return fraction(wave);
 }
 
 // Two dimensional pseudo-random noise
 static inline float noise2(int x, int y) {
-  float wave = sinf(x*53+y*97)*6151;
+  float wave = BLIB_SINF(x*53+y*97)*6151;
   return fraction(wave);
 }
 
 // Three dimensional pseudo-random noise
 static inline float noise3(int x, int y, int z) {
-  float wave = sinf(x*53+y*97+z*193)*6151;
+  float wave = BLIB_SINF(x*53+y*97+z*193)*6151;
   return fraction(wave);
 }
 
@@ -26,9 +26,13 @@ SOFTWARE.
 #ifndef BLIB_MATH3D_H
 #define BLIB_MATH3D_H
 
-#include "blib/blib.h"
+#include "blib.h"
 #include "blib_math.h"
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif // __cplusplus
@@ -59,6 +63,14 @@ typedef struct {
 } matrix4_t;
 DECLARE_LIST(matrix4_t)
 
+/*The top three rows of an affine matrix4_t, stored the same way column
+  by column: elements[c * 3 + r] is matrix4 element [c * 4 + r], so 9 to 11
+  hold the translation and the bottom row is always 0 0 0 1.*/
+typedef struct {
+	float elements[12];
+} affine3_t;
+DECLARE_LIST(affine3_t)
+
 typedef struct {
 	float w;
 	float x;
@@ -67,6 +79,19 @@ typedef struct {
 } quaternion_t;
 DECLARE_LIST(quaternion_t)
 
+/*Axis-aligned bounding box*/
+typedef struct {
+	vector3_t min;
+	vector3_t max;
+} aabb_t;
+DECLARE_LIST(aabb_t)
+
+typedef struct {
+	vector3_t center;
+	float radius;
+} sphere_t;
+DECLARE_LIST(sphere_t)
+
 static inline vector2_t vector2_zero     (void)    { return (vector2_t){ 0.0f,  0.0f }; }
 static inline vector2_t vector2_one      (float s) { return (vector2_t){ s,     s    }; }
 static inline vector2_t vector2_up       (float s) { return (vector2_t){ 0.0f,  s    }; }
@@ -630,60 +655,93 @@ matrix4_perspective(float fov, float aspect, float near, float far) {
 	return result;
 }
 
-/*Multiplies a 4x4 matrix with a 3 dimensional vec*/
+/*Multiplies a 3 dimensional vec with the upper 3x3 of a 4x4 matrix, the
+  same convention as matrix4_transform_direction() declared below*/
 static inline vector3_t 
 matrix4_multiplyvector3(vector3_t Left, matrix4_t Right) {
-	vector3_t result;
-	result.y = Left.y * Right.elements[0];
-	result.x = Left.y * Right.elements[4];
-	result.z = Left.y * Right.elements[8];
+	const float *e = Right.elements;
+	return (vector3_t){
+		.x = Left.x * e[0] + Left.y * e[4] + Left.z * e[8],
+		.y = Left.x * e[1] + Left.y * e[5] + Left.z * e[9],
+		.z = Left.x * e[2] + Left.y * e[6] + Left.z * e[10],
+	};
+}
 
-	result.y += Left.x * Right.elements[1];
-	result.x += Left.x * Right.elements[5];
-	result.z += Left.x * Right.elements[9];
+/*Multiplies a 4 dimensional vec with a 4x4 matrix, the same convention as
+  matrix4_transform_vector4() declared below*/
+static inline vector4_t 
+matrix4_multiplyvector4(vector4_t Left, matrix4_t Right) {
+	const float *e = Right.elements;
+	return (vector4_t){
+		.x = Left.x * e[0] + Left.y * e[4] + Left.z * e[8] + Left.w * e[12],
+		.y = Left.x * e[1] + Left.y * e[5] + Left.z * e[9] + Left.w * e[13],
+		.z = Left.x * e[2] + Left.y * e[6] + Left.z * e[10] + Left.w * e[14],
+		.w = Left.x * e[3] + Left.y * e[7] + Left.z * e[11] + Left.w * e[15],
+	};
+}
 
-	result.y += Left.z * Right.elements[2];
-	result.x += Left.z * Right.elements[6];
-	result.z += Left.z * Right.elements[10];
+/*Transforms the point "p" by "m", x' = x * m[0] + y * m[4] + z * m[8] + m[12]
+  and likewise for y' and z'. The translation lives in elements 12 to 14,
+  where matrix4_translate() puts it, and the projective terms are ignored.
+  The batch forms in blib_math_transform.h give identical results.*/
+static inline vector3_t 
+matrix4_transform_point(const matrix4_t m, vector3_t p) {
+	const float *e = m.elements;
+	return (vector3_t){
+		.x = p.x * e[0] + p.y * e[4] + p.z * e[8] + e[12],
+		.y = p.x * e[1] + p.y * e[5] + p.z * e[9] + e[13],
+		.z = p.x * e[2] + p.y * e[6] + p.z * e[10] + e[14],
+	};
+}
 
-	return result;
+/*Like matrix4_transform_point() without the translation*/
+static inline vector3_t 
+matrix4_transform_direction(const matrix4_t m, vector3_t d) {
+	const float *e = m.elements;
+	return (vector3_t){
+		.x = d.x * e[0] + d.y * e[4] + d.z * e[8],
+		.y = d.x * e[1] + d.y * e[5] + d.z * e[9],
+		.z = d.x * e[2] + d.y * e[6] + d.z * e[10],
+	};
 }
 
-/*Multiplies a 4x4 matrix with a 4 dimensional vec*/
+/*The full 4x4 transform of "v", with no divide by w*/
 static inline vector4_t 
-matrix4_multiplyvector4(vector4_t Left, matrix4_t Right) {
-	vector4_t result;
-	result.y = Left.y * Right.elements[0];
-	result.x = Left.y * Right.elements[4];
-	result.z = Left.y * Right.elements[8];
-	result.w = Left.y * Right.elements[12];
-
-	result.y += Left.x * Right.elements[1];
-	result.x += Left.x * Right.elements[5];
-	result.z += Left.x * Right.elements[9];
-	result.w += Left.x * Right.elements[13];
-
-	result.y += Left.z * Right.elements[2];
-	result.x += Left.z * Right.elements[6];
-	result.z += Left.z * Right.elements[10];
-	result.w += Left.z * Right.elements[13];
-
-	result.y += Left.w * Right.elements[3];
-	result.x += Left.w * Right.elements[7];
-	result.z += Left.w * Right.elements[11];
-	result.w += Left.w * Right.elements[15];
-
-	return result;
+matrix4_transform_vector4(const matrix4_t m, vector4_t v) {
+	const float *e = m.elements;
+	return (vector4_t){
+		.x = v.x * e[0] + v.y * e[4] + v.z * e[8] + v.w * e[12],
+		.y = v.x * e[1] + v.y * e[5] + v.z * e[9] + v.w * e[13],
+		.z = v.x * e[2] + v.y * e[6] + v.z * e[10] + v.w * e[14],
+		.w = v.x * e[3] + v.y * e[7] + v.z * e[11] + v.w * e[15],
+	};
 }
 
-/*Multiplies a 4x4 matrix with another 4x4 matrix*/
+/*Multiplies a 4x4 matrix with another 4x4 matrix. Element [r * 4 + c] of
+  the result is row r of "a" times column c of "b", so transforming by the
+  result applies "a" first and then "b".*/
 static inline matrix4_t 
 matrix4_multiply(const matrix4_t a, const matrix4_t b) {
+#if defined(__SSE__)
+	// Each result row is a weighted sum of the rows of "b", added up in the
+	// same order as the scalar version below.
+	matrix4_t ret;
+	__m128 b0 = _mm_loadu_ps(b.elements), b1 = _mm_loadu_ps(b.elements + 4),
+	       b2 = _mm_loadu_ps(b.elements + 8), b3 = _mm_loadu_ps(b.elements + 12);
+	for (int r = 0; r < 4; r++) {
+		const float *row = a.elements + r * 4;
+		__m128 v = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[0]), b0), _mm_mul_ps(_mm_set1_ps(row[1]), b1));
+		v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(row[2]), b2));
+		v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(row[3]), b3));
+		_mm_storeu_ps(ret.elements + r * 4, v);
+	}
+	return ret;
+#else
 	return (matrix4_t) {
 		.elements = {
 			// column 0
-			a.elements[0] * b.elements[0] + a.elements[4] * b.elements[1] +
-			a.elements[8] * b.elements[2] + a.elements[12] * b.elements[3],
+			a.elements[0] * b.elements[0] + a.elements[1] * b.elements[4] +
+			a.elements[2] * b.elements[8] + a.elements[3] * b.elements[12],
 			a.elements[0] * b.elements[1] + a.elements[1] * b.elements[5] +
 			a.elements[2] * b.elements[9] + a.elements[3] * b.elements[13],
 			a.elements[0] * b.elements[2] + a.elements[1] * b.elements[6] +
@@ -723,6 +781,7 @@ matrix4_multiply(const matrix4_t a, const matrix4_t b) {
 			a.elements[15] * b.elements[15]
 		}
 	};
+#endif
 }
 
 /*Scales (multiplies) a 4x4 matrix by a scalar (number)*/
@@ -791,11 +850,11 @@ quaternion_equal(quaternion_t a, quaternion_t b) {
 static inline quaternion_t 
 quaternion_from_angle_axis(float angle, vector3_t axis) {
 	quaternion_t ret;
-	float s = sinf(angle/2);
+	float s = BLIB_SINF(angle/2);
 	ret.x = axis.x * s;
 	ret.y = axis.y * s;
 	ret.z = axis.z * s;
-	ret.w = cosf(angle/2);
+	ret.w = BLIB_COSF(angle/2);
 	return ret;
 }
 
@@ -871,6 +930,41 @@ quaternion_scale(quaternion_t q, float scalar) {
 	return q;
 }
 
+static inline float 
+quaternion_dot(quaternion_t a, quaternion_t b) {
+	return a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+/*Normalized linear interpolation, the short way around. Cheaper than
+  quaternion_slerp() in blib_math_quaternion.h and close to it when "a" and
+  "b" are close, which is the usual case for animation keys.*/
+static inline quaternion_t 
+quaternion_nlerp(quaternion_t a, quaternion_t b, float t) {
+	float u = 1.0f - t;
+	float v = quaternion_dot(a, b) < 0.0f ? -t : t;
+	return quaternion_normalize((quaternion_t){
+		.w = a.w * u + b.w * v,
+		.x = a.x * u + b.x * v,
+		.y = a.y * u + b.y * v,
+		.z = a.z * u + b.z * v,
+	});
+}
+
+/*Rotates "v" by the unit quaternion "q" as v + 2w(u x v) + 2u x (u x v)
+  with u = (x, y, z): 18 multiplies instead of the 32 of vector3_rotate().
+  Unlike vector3_rotate() the result is not scaled by |q|^2.*/
+static inline vector3_t 
+quaternion_rotate_vector3(quaternion_t q, vector3_t v) {
+	float tx = 2.0f * (q.y * v.z - q.z * v.y);
+	float ty = 2.0f * (q.z * v.x - q.x * v.z);
+	float tz = 2.0f * (q.x * v.y - q.y * v.x);
+	return (vector3_t){
+		.x = v.x + q.w * tx + (q.y * tz - q.z * ty),
+		.y = v.y + q.w * ty + (q.z * tx - q.x * tz),
+		.z = v.z + q.w * tz + (q.x * ty - q.y * tx),
+	};
+}
+
 /*
    Returns the given vec 'v' rotated by the quaternion_t 'rotation'.
    */
@@ -896,12 +990,12 @@ static inline quaternion_t
 quaternion_from_euler(vector3_t eulerAngles) {
 	quaternion_t q;
 
-	float cRoll = cosf(eulerAngles.x * 0.5f);
-	float sRoll = sinf(eulerAngles.x * 0.5f);
-	float cPitch = cosf(eulerAngles.y * 0.5f);
-	float sPitch = sinf(eulerAngles.y * 0.5f);
-	float cYaw = cosf(eulerAngles.z * 0.5f);
-	float sYaw = sinf(eulerAngles.z * 0.5f);
+	float cRoll = BLIB_COSF(eulerAngles.x * 0.5f);
+	float sRoll = BLIB_SINF(eulerAngles.x * 0.5f);
+	float cPitch = BLIB_COSF(eulerAngles.y * 0.5f);
+	float sPitch = BLIB_SINF(eulerAngles.y * 0.5f);
+	float cYaw = BLIB_COSF(eulerAngles.z * 0.5f);
+	float sYaw = BLIB_SINF(eulerAngles.z * 0.5f);
 	q.w = cRoll * cPitch * cYaw + sRoll * sPitch * sYaw;
 	q.x = sRoll * cPitch * cYaw - cRoll * sPitch * sYaw;
 	q.y = cRoll * sPitch * cYaw + sRoll * cPitch * sYaw;
@@ -945,6 +1039,155 @@ quaternion_to_matrix4(quaternion_t q) {
 	return mat;
 }
 
+/*Returns false and leaves "out" alone when "m" is singular*/
+bool matrix4_inverse(const matrix4_t m, matrix4_t *out);
+
+static inline affine3_t 
+affine3_identity(void) {
+	// clang-format off
+	return (affine3_t){
+		.elements = {
+			1.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 1.0f,
+			0.0f, 0.0f, 0.0f
+		}
+	};
+	// clang-format on
+}
+
+/*Drops the bottom row, which must be 0 0 0 1 for the result to mean the
+  same thing. matrix4_translate(), matrix4_scale(), quaternion_to_matrix4()
+  and their products are all affine.*/
+static inline affine3_t 
+affine3_from_matrix4(const matrix4_t m) {
+	affine3_t a;
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 3; r++)
+			a.elements[c * 3 + r] = m.elements[c * 4 + r];
+	return a;
+}
+
+static inline matrix4_t 
+matrix4_from_affine3(const affine3_t a) {
+	matrix4_t m;
+	for (int c = 0; c < 4; c++) {
+		for (int r = 0; r < 3; r++)
+			m.elements[c * 4 + r] = a.elements[c * 3 + r];
+		m.elements[c * 4 + 3] = c == 3 ? 1.0f : 0.0f;
+	}
+	return m;
+}
+
+/*Scales by "scale", then rotates by "rotation", then moves by
+  "translation". The usual way to build a node transform.*/
+static inline affine3_t 
+affine3_from_trs(vector3_t translation, quaternion_t rotation, vector3_t scale) {
+	// The columns of quaternion_to_matrix4(), scaled.
+	float xx = rotation.x * rotation.x, xy = rotation.x * rotation.y;
+	float xz = rotation.x * rotation.z, xw = rotation.x * rotation.w;
+	float yy = rotation.y * rotation.y, yz = rotation.y * rotation.z, yw = rotation.y * rotation.w;
+	float zz = rotation.z * rotation.z, zw = rotation.z * rotation.w;
+	// clang-format off
+	return (affine3_t){
+		.elements = {
+			(1 - 2 * (yy + zz)) * scale.x, (2 * (xy + zw)) * scale.x, (2 * (xz - yw)) * scale.x,
+			(2 * (xy - zw)) * scale.y, (1 - 2 * (xx + zz)) * scale.y, (2 * (yz + xw)) * scale.y,
+			(2 * (xz + yw)) * scale.z, (2 * (yz - xw)) * scale.z, (1 - 2 * (xx + yy)) * scale.z,
+			translation.x, translation.y, translation.z
+		}
+	};
+	// clang-format on
+}
+
+/*Same as matrix4_transform_point() on the matrix4_t form, bit for bit*/
+static inline vector3_t 
+affine3_transform_point(const affine3_t a, vector3_t p) {
+	const float *e = a.elements;
+	return (vector3_t){
+		.x = p.x * e[0] + p.y * e[3] + p.z * e[6] + e[9],
+		.y = p.x * e[1] + p.y * e[4] + p.z * e[7] + e[10],
+		.z = p.x * e[2] + p.y * e[5] + p.z * e[8] + e[11],
+	};
+}
+
+static inline vector3_t 
+affine3_transform_direction(const affine3_t a, vector3_t d) {
+	const float *e = a.elements;
+	return (vector3_t){
+		.x = d.x * e[0] + d.y * e[3] + d.z * e[6],
+		.y = d.x * e[1] + d.y * e[4] + d.z * e[7],
+		.z = d.x * e[2] + d.y * e[5] + d.z * e[8],
+	};
+}
+
+/*Applies "a" and then "b", like matrix4_multiply(a, b), in 48 multiplies
+  and adds instead of 112*/
+static inline affine3_t 
+affine3_multiply(const affine3_t a, const affine3_t b) {
+	const float *x = a.elements, *y = b.elements;
+	// clang-format off
+	return (affine3_t){
+		.elements = {
+			x[0] * y[0] + x[1] * y[3] + x[2] * y[6],
+			x[0] * y[1] + x[1] * y[4] + x[2] * y[7],
+			x[0] * y[2] + x[1] * y[5] + x[2] * y[8],
+			x[3] * y[0] + x[4] * y[3] + x[5] * y[6],
+			x[3] * y[1] + x[4] * y[4] + x[5] * y[7],
+			x[3] * y[2] + x[4] * y[5] + x[5] * y[8],
+			x[6] * y[0] + x[7] * y[3] + x[8] * y[6],
+			x[6] * y[1] + x[7] * y[4] + x[8] * y[7],
+			x[6] * y[2] + x[7] * y[5] + x[8] * y[8],
+			x[9] * y[0] + x[10] * y[3] + x[11] * y[6] + y[9],
+			x[9] * y[1] + x[10] * y[4] + x[11] * y[7] + y[10],
+			x[9] * y[2] + x[10] * y[5] + x[11] * y[8] + y[11]
+		}
+	};
+	// clang-format on
+}
+
+/*The inverse of a rotation and translation, with no scale or shear. The
+  rotation is transposed and the translation rotated back, no divide.*/
+static inline affine3_t 
+affine3_inverse_rigid(const affine3_t a) {
+	const float *e = a.elements;
+	affine3_t ret;
+	for (int c = 0; c < 3; c++)
+		for (int r = 0; r < 3; r++)
+			ret.elements[c * 3 + r] = e[r * 3 + c];
+	for (int r = 0; r < 3; r++)
+		ret.elements[9 + r] = -(e[r * 3] * e[9] + e[r * 3 + 1] * e[10] + e[r * 3 + 2] * e[11]);
+	return ret;
+}
+
+/*The inverse of any affine transform. The rows of the inverted 3x3 part
+  are cross products of its columns over the determinant. Returns false
+  and leaves "out" alone when the determinant is 0.*/
+static inline bool 
+affine3_inverse(const affine3_t a, affine3_t *out) {
+	const float *e = a.elements;
+	vector3_t c0 = { e[0], e[1], e[2] };
+	vector3_t c1 = { e[3], e[4], e[5] };
+	vector3_t c2 = { e[6], e[7], e[8] };
+	vector3_t rows[3] = { vector3_cross(c1, c2), vector3_cross(c2, c0), vector3_cross(c0, c1) };
+	float det = vector3_dot(c0, rows[0]);
+	if (det == 0.0f)
+		return false;
+	float inv = 1.0f / det;
+	affine3_t ret;
+	for (int r = 0; r < 3; r++) {
+		ret.elements[r] = rows[r].x * inv;
+		ret.elements[3 + r] = rows[r].y * inv;
+		ret.elements[6 + r] = rows[r].z * inv;
+	}
+	vector3_t t = affine3_transform_direction(ret, (vector3_t){ e[9], e[10], e[11] });
+	ret.elements[9] = -t.x;
+	ret.elements[10] = -t.y;
+	ret.elements[11] = -t.z;
+	*out = ret;
+	return true;
+}
+
 #ifdef __cplusplus
 } // extern "C" {
 #endif // __cplusplus
@@ -952,6 +1195,8 @@ quaternion_to_matrix4(quaternion_t q) {
 #endif // BLIB_MATH3D_H
 
 #ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_MATH3D_IMPLEMENTATION_H
+#define BLIB_MATH3D_IMPLEMENTATION_H
 
 #ifdef __cplusplus
 extern "C" {
@@ -962,9 +1207,54 @@ DEFINE_LIST(vector3_t)
 DEFINE_LIST(vector2_t)
 DEFINE_LIST(quaternion_t)
 DEFINE_LIST(matrix4_t)
+DEFINE_LIST(affine3_t)
+DEFINE_LIST(aabb_t)
+DEFINE_LIST(sphere_t)
+
+/*Cofactor expansion through the 2x2 determinants of the top and bottom
+  row pairs. The inverse of the transpose is the transpose of the inverse,
+  so the element order does not matter here.*/
+bool matrix4_inverse(const matrix4_t m, matrix4_t *out) {
+	const float *a = m.elements;
+	float s0 = a[0] * a[5] - a[4] * a[1];
+	float s1 = a[0] * a[6] - a[4] * a[2];
+	float s2 = a[0] * a[7] - a[4] * a[3];
+	float s3 = a[1] * a[6] - a[5] * a[2];
+	float s4 = a[1] * a[7] - a[5] * a[3];
+	float s5 = a[2] * a[7] - a[6] * a[3];
+	float c5 = a[10] * a[15] - a[14] * a[11];
+	float c4 = a[9] * a[15] - a[13] * a[11];
+	float c3 = a[9] * a[14] - a[13] * a[10];
+	float c2 = a[8] * a[15] - a[12] * a[11];
+	float c1 = a[8] * a[14] - a[12] * a[10];
+	float c0 = a[8] * a[13] - a[12] * a[9];
+	float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+	if (det == 0.0f)
+		return false;
+	float inv = 1.0f / det;
+	float *b = out->elements;
+	b[0] = (a[5] * c5 - a[6] * c4 + a[7] * c3) * inv;
+	b[1] = (-a[1] * c5 + a[2] * c4 - a[3] * c3) * inv;
+	b[2] = (a[13] * s5 - a[14] * s4 + a[15] * s3) * inv;
+	b[3] = (-a[9] * s5 + a[10] * s4 - a[11] * s3) * inv;
+	b[4] = (-a[4] * c5 + a[6] * c2 - a[7] * c1) * inv;
+	b[5] = (a[0] * c5 - a[2] * c2 + a[3] * c1) * inv;
+	b[6] = (-a[12] * s5 + a[14] * s2 - a[15] * s1) * inv;
+	b[7] = (a[8] * s5 - a[10] * s2 + a[11] * s1) * inv;
+	b[8] = (a[4] * c4 - a[5] * c2 + a[7] * c0) * inv;
+	b[9] = (-a[0] * c4 + a[1] * c2 - a[3] * c0) * inv;
+	b[10] = (a[12] * s4 - a[13] * s2 + a[15] * s0) * inv;
+	b[11] = (-a[8] * s4 + a[9] * s2 - a[11] * s0) * inv;
+	b[12] = (-a[4] * c3 + a[5] * c1 - a[6] * c0) * inv;
+	b[13] = (a[0] * c3 - a[1] * c1 + a[2] * c0) * inv;
+	b[14] = (-a[12] * s3 + a[13] * s1 - a[14] * s0) * inv;
+	b[15] = (a[8] * s3 - a[9] * s1 + a[10] * s0) * inv;
+	return true;
+}
 
 #ifdef __cplusplus
 } // extern "C" {
 #endif // __cplusplus
 
-#endif
+#endif // BLIB_MATH3D_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
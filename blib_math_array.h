@@ -0,0 +1,416 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Array forms of the scalar helpers in blib_math.h, for applying them to
+  long runs of floats. Every function takes an input span and an output
+  span of "count" floats, which may be the same pointer for in-place use,
+  and returns results bit for bit equal to calling the scalar helper on
+  each element. The *_list forms work in place on a list_float.
+
+  sigmoid_array() is the exception: it always uses fast_powf(), so it
+  matches sigmoid() exactly only when BLIB_FAST_MATH is defined and to
+  within the fast_powf() error bound otherwise.
+
+  Kernels are picked at runtime: AVX2, then SSE4.1, then plain C. Each
+  kernel runs scalar code until the output is aligned to the vector width
+  and again for the leftover elements at the end.*/
+
+#ifndef BLIB_MATH_ARRAY_H
+#define BLIB_MATH_ARRAY_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "blib.h"
+#include "blib_math.h"
+#include "blib_fast_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/*out[i] = lerp(a[i], b[i], t)*/
+void lerp_array(const float *a, const float *b, float t, float *out, size_t count);
+void clamp_array(const float *in, float *out, size_t count, float min, float max);
+void clamp01_array(const float *in, float *out, size_t count);
+void map_array(const float *in, float *out, size_t count, float fromMin, float fromMax, float toMin,
+		float toMax);
+void norm_array(const float *in, float *out, size_t count, float min, float max);
+void loop_array(const float *in, float *out, size_t count, float length);
+void pingpong_array(const float *in, float *out, size_t count, float length);
+void sigmoid_array(const float *in, float *out, size_t count);
+
+/*"a" becomes lerp(a, b, t), the lists must have the same length*/
+static inline void lerp_list(list_float *a, const list_float *b, float t) {
+	assert(a->length == b->length);
+	lerp_array(a->array, b->array, t, a->array, a->length);
+}
+
+static inline void clamp_list(list_float *list, float min, float max) {
+	clamp_array(list->array, list->array, list->length, min, max);
+}
+
+static inline void clamp01_list(list_float *list) {
+	clamp01_array(list->array, list->array, list->length);
+}
+
+static inline void map_list(list_float *list, float fromMin, float fromMax, float toMin, float toMax) {
+	map_array(list->array, list->array, list->length, fromMin, fromMax, toMin, toMax);
+}
+
+static inline void norm_list(list_float *list, float min, float max) {
+	norm_array(list->array, list->array, list->length, min, max);
+}
+
+static inline void loop_list(list_float *list, float length) {
+	loop_array(list->array, list->array, list->length, length);
+}
+
+static inline void pingpong_list(list_float *list, float length) {
+	pingpong_array(list->array, list->array, list->length, length);
+}
+
+static inline void sigmoid_list(list_float *list) {
+	sigmoid_array(list->array, list->array, list->length);
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_MATH_ARRAY_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_MATH_ARRAY_IMPLEMENTATION_H
+#define BLIB_MATH_ARRAY_IMPLEMENTATION_H
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BLIB_MATH_ARRAY_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+enum {
+	MATH_ARRAY_LERP,
+	MATH_ARRAY_CLAMP,
+	MATH_ARRAY_MAP,
+	MATH_ARRAY_NORM,
+	MATH_ARRAY_LOOP,
+	MATH_ARRAY_PINGPONG,
+	MATH_ARRAY_SIGMOID
+};
+
+/*One operation over [begin, end). "p" holds the scalar arguments in the
+  order the scalar helper takes them.*/
+typedef struct {
+	int op;
+	const float *a;
+	const float *b;
+	float *out;
+	float p[4];
+} math_array_job;
+
+static inline float math_array_sigmoid(float n, float log_e) {
+	// fast_powf(2.71828182846, -n) with the logarithm hoisted out.
+	float p = fast_expf(-n * log_e);
+	p = -n == 0.0f ? 1.0f : p;
+	return 1 / (1 + p);
+}
+
+static void math_array_scalar(const math_array_job *job, size_t begin, size_t end) {
+	const float *a = job->a, *p = job->p;
+	float *out = job->out;
+	switch (job->op) {
+		case MATH_ARRAY_LERP:
+			for (size_t i = begin; i < end; i++) out[i] = lerp(a[i], job->b[i], p[0]);
+			break;
+		case MATH_ARRAY_CLAMP:
+			for (size_t i = begin; i < end; i++) out[i] = clamp(a[i], p[0], p[1]);
+			break;
+		case MATH_ARRAY_MAP:
+			for (size_t i = begin; i < end; i++) out[i] = map(a[i], p[0], p[1], p[2], p[3]);
+			break;
+		case MATH_ARRAY_NORM:
+			for (size_t i = begin; i < end; i++) out[i] = norm(a[i], p[0], p[1]);
+			break;
+		case MATH_ARRAY_LOOP:
+			for (size_t i = begin; i < end; i++) out[i] = loop(a[i], p[0]);
+			break;
+		case MATH_ARRAY_PINGPONG:
+			for (size_t i = begin; i < end; i++) out[i] = pingpong(a[i], p[0]);
+			break;
+		case MATH_ARRAY_SIGMOID:
+			for (size_t i = begin; i < end; i++) out[i] = math_array_sigmoid(a[i], p[0]);
+			break;
+	}
+}
+
+#ifdef BLIB_MATH_ARRAY_X86
+
+/*The kernels mirror the scalar helpers operation for operation. clamp()
+  maps onto max/min with the bound as the first operand, which keeps NaN
+  inputs flowing through exactly like the ternaries do. loop() subtracts
+  in double precision because the scalar version calls floor().*/
+
+__attribute__((target("avx2")))
+static inline __m256 math_clamp8(__m256 n, __m256 min, __m256 max) {
+	return _mm256_min_ps(max, _mm256_max_ps(min, n));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 math_loop8(__m256 n, float length) {
+	__m256 whole = _mm256_floor_ps(_mm256_div_ps(n, _mm256_set1_ps(length)));
+	__m256d l = _mm256_set1_pd((double)length);
+	__m128 lo = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(n)),
+				_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(whole)), l)));
+	__m128 hi = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(n, 1)),
+				_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(whole, 1)), l)));
+	__m256 r = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+	return math_clamp8(r, _mm256_setzero_ps(), _mm256_set1_ps(length));
+}
+
+__attribute__((target("avx2")))
+static void math_array_avx2(const math_array_job *job, size_t begin, size_t end) {
+	const float *a = job->a, *b = job->b, *p = job->p;
+	float *out = job->out;
+	size_t i = begin;
+	switch (job->op) {
+		case MATH_ARRAY_LERP: {
+			__m256 t = _mm256_set1_ps(p[0]);
+			for (; i < end; i += 8) {
+				__m256 x = _mm256_loadu_ps(a + i);
+				_mm256_store_ps(out + i, _mm256_add_ps(x, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(b + i), x), t)));
+			}
+			break;
+		}
+		case MATH_ARRAY_CLAMP: {
+			__m256 min = _mm256_set1_ps(p[0]), max = _mm256_set1_ps(p[1]);
+			for (; i < end; i += 8)
+				_mm256_store_ps(out + i, math_clamp8(_mm256_loadu_ps(a + i), min, max));
+			break;
+		}
+		case MATH_ARRAY_MAP: {
+			__m256 from = _mm256_set1_ps(p[0]), to = _mm256_set1_ps(p[2]);
+			__m256 to_range = _mm256_set1_ps(p[3] - p[2]), from_range = _mm256_set1_ps(p[1] - p[0]);
+			for (; i < end; i += 8) {
+				__m256 x = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(a + i), from), to_range);
+				_mm256_store_ps(out + i, _mm256_add_ps(_mm256_div_ps(x, from_range), to));
+			}
+			break;
+		}
+		case MATH_ARRAY_NORM: {
+			__m256 min = _mm256_set1_ps(p[0]), range = _mm256_set1_ps(p[1] - p[0]);
+			for (; i < end; i += 8)
+				_mm256_store_ps(out + i, _mm256_div_ps(_mm256_sub_ps(_mm256_loadu_ps(a + i), min), range));
+			break;
+		}
+		case MATH_ARRAY_LOOP:
+			for (; i < end; i += 8)
+				_mm256_store_ps(out + i, math_loop8(_mm256_loadu_ps(a + i), p[0]));
+			break;
+		case MATH_ARRAY_PINGPONG: {
+			__m256 length = _mm256_set1_ps(p[0]);
+			__m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+			for (; i < end; i += 8) {
+				__m256 x = math_loop8(_mm256_loadu_ps(a + i), p[0] * 2.0f);
+				_mm256_store_ps(out + i, _mm256_and_ps(_mm256_sub_ps(x, length), abs_mask));
+			}
+			break;
+		}
+		case MATH_ARRAY_SIGMOID: {
+			__m256 log_e = _mm256_set1_ps(p[0]), one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+			__m256 sign = _mm256_castsi256_ps(_mm256_set1_epi32((int32_t)0x80000000u));
+			for (; i < end; i += 8) {
+				__m256 y = _mm256_xor_ps(_mm256_loadu_ps(a + i), sign);
+				__m256 e = fast_exp8(_mm256_mul_ps(y, log_e));
+				e = fast_select8(_mm256_cmp_ps(y, zero, _CMP_EQ_OQ), one, e);
+				_mm256_store_ps(out + i, _mm256_div_ps(one, _mm256_add_ps(one, e)));
+			}
+			break;
+		}
+	}
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 math_clamp4(__m128 n, __m128 min, __m128 max) {
+	return _mm_min_ps(max, _mm_max_ps(min, n));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 math_loop4(__m128 n, float length) {
+	__m128 whole = _mm_floor_ps(_mm_div_ps(n, _mm_set1_ps(length)));
+	__m128d l = _mm_set1_pd((double)length);
+	__m128 lo = _mm_cvtpd_ps(_mm_sub_pd(_mm_cvtps_pd(n), _mm_mul_pd(_mm_cvtps_pd(whole), l)));
+	__m128 hi = _mm_cvtpd_ps(_mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(n, n)),
+				_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(whole, whole)), l)));
+	return math_clamp4(_mm_movelh_ps(lo, hi), _mm_setzero_ps(), _mm_set1_ps(length));
+}
+
+/*No SSE sigmoid, the fast_math kernels are AVX2 only*/
+__attribute__((target("sse4.1")))
+static void math_array_sse(const math_array_job *job, size_t begin, size_t end) {
+	const float *a = job->a, *b = job->b, *p = job->p;
+	float *out = job->out;
+	size_t i = begin;
+	switch (job->op) {
+		case MATH_ARRAY_LERP: {
+			__m128 t = _mm_set1_ps(p[0]);
+			for (; i < end; i += 4) {
+				__m128 x = _mm_loadu_ps(a + i);
+				_mm_store_ps(out + i, _mm_add_ps(x, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b + i), x), t)));
+			}
+			break;
+		}
+		case MATH_ARRAY_CLAMP: {
+			__m128 min = _mm_set1_ps(p[0]), max = _mm_set1_ps(p[1]);
+			for (; i < end; i += 4)
+				_mm_store_ps(out + i, math_clamp4(_mm_loadu_ps(a + i), min, max));
+			break;
+		}
+		case MATH_ARRAY_MAP: {
+			__m128 from = _mm_set1_ps(p[0]), to = _mm_set1_ps(p[2]);
+			__m128 to_range = _mm_set1_ps(p[3] - p[2]), from_range = _mm_set1_ps(p[1] - p[0]);
+			for (; i < end; i += 4) {
+				__m128 x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(a + i), from), to_range);
+				_mm_store_ps(out + i, _mm_add_ps(_mm_div_ps(x, from_range), to));
+			}
+			break;
+		}
+		case MATH_ARRAY_NORM: {
+			__m128 min = _mm_set1_ps(p[0]), range = _mm_set1_ps(p[1] - p[0]);
+			for (; i < end; i += 4)
+				_mm_store_ps(out + i, _mm_div_ps(_mm_sub_ps(_mm_loadu_ps(a + i), min), range));
+			break;
+		}
+		case MATH_ARRAY_LOOP:
+			for (; i < end; i += 4)
+				_mm_store_ps(out + i, math_loop4(_mm_loadu_ps(a + i), p[0]));
+			break;
+		case MATH_ARRAY_PINGPONG: {
+			__m128 length = _mm_set1_ps(p[0]);
+			__m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+			for (; i < end; i += 4) {
+				__m128 x = math_loop4(_mm_loadu_ps(a + i), p[0] * 2.0f);
+				_mm_store_ps(out + i, _mm_and_ps(_mm_sub_ps(x, length), abs_mask));
+			}
+			break;
+		}
+		default:
+			math_array_scalar(job, begin, end);
+			break;
+	}
+}
+
+enum { MATH_ARRAY_SIMD_NONE, MATH_ARRAY_SIMD_SSE41, MATH_ARRAY_SIMD_AVX2 };
+
+static int math_array_simd_level(void) {
+	static int level = -1;
+	int l = __atomic_load_n(&level, __ATOMIC_RELAXED);
+	if (l < 0) {
+		__builtin_cpu_init();
+		l = __builtin_cpu_supports("avx2") ? MATH_ARRAY_SIMD_AVX2 :
+			__builtin_cpu_supports("sse4.1") ? MATH_ARRAY_SIMD_SSE41 : MATH_ARRAY_SIMD_NONE;
+		__atomic_store_n(&level, l, __ATOMIC_RELAXED);
+	}
+	return l;
+}
+
+#endif // BLIB_MATH_ARRAY_X86
+
+static void math_array_run(const math_array_job *job, size_t count) {
+	size_t i = 0;
+#ifdef BLIB_MATH_ARRAY_X86
+	int level = math_array_simd_level();
+	if (level != MATH_ARRAY_SIMD_NONE) {
+		size_t width = level == MATH_ARRAY_SIMD_AVX2 ? 8 : 4;
+		size_t misaligned = ((uintptr_t)job->out / sizeof(float)) & (width - 1);
+		size_t head = misaligned ? width - misaligned : 0;
+		// Float arrays that are not even 4 byte aligned never reach an
+		// aligned boundary, leave them to the scalar loop.
+		if ((uintptr_t)job->out % sizeof(float) == 0 && head < count) {
+			size_t body = (count - head) & ~(width - 1);
+			math_array_scalar(job, 0, head);
+			if (level == MATH_ARRAY_SIMD_AVX2)
+				math_array_avx2(job, head, head + body);
+			else
+				math_array_sse(job, head, head + body);
+			i = head + body;
+		}
+	}
+#endif
+	math_array_scalar(job, i, count);
+}
+
+void lerp_array(const float *a, const float *b, float t, float *out, size_t count) {
+	math_array_job job = { MATH_ARRAY_LERP, a, b, out, { t, 0.0f, 0.0f, 0.0f } };
+	math_array_run(&job, count);
+}
+
+void clamp_array(const float *in, float *out, size_t count, float min, float max) {
+	math_array_job job = { MATH_ARRAY_CLAMP, in, NULL, out, { min, max, 0.0f, 0.0f } };
+	math_array_run(&job, count);
+}
+
+void clamp01_array(const float *in, float *out, size_t count) {
+	clamp_array(in, out, count, 0.0f, 1.0f);
+}
+
+void map_array(const float *in, float *out, size_t count, float fromMin, float fromMax, float toMin,
+		float toMax) {
+	math_array_job job = { MATH_ARRAY_MAP, in, NULL, out, { fromMin, fromMax, toMin, toMax } };
+	math_array_run(&job, count);
+}
+
+void norm_array(const float *in, float *out, size_t count, float min, float max) {
+	math_array_job job = { MATH_ARRAY_NORM, in, NULL, out, { min, max, 0.0f, 0.0f } };
+	math_array_run(&job, count);
+}
+
+void loop_array(const float *in, float *out, size_t count, float length) {
+	math_array_job job = { MATH_ARRAY_LOOP, in, NULL, out, { length, 0.0f, 0.0f, 0.0f } };
+	math_array_run(&job, count);
+}
+
+void pingpong_array(const float *in, float *out, size_t count, float length) {
+	math_array_job job = { MATH_ARRAY_PINGPONG, in, NULL, out, { length, 0.0f, 0.0f, 0.0f } };
+	math_array_run(&job, count);
+}
+
+void sigmoid_array(const float *in, float *out, size_t count) {
+	math_array_job job = { MATH_ARRAY_SIGMOID, in, NULL, out, { 0.0f, 0.0f, 0.0f, 0.0f } };
+	job.p[0] = fast_logf((float)2.71828182846);
+	math_array_run(&job, count);
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_MATH_ARRAY_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
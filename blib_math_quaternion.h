@@ -0,0 +1,409 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Quaternion slerp and batch quaternion kernels.
+
+  Animation blends thousands of joint rotations per frame, so besides the
+  scalar quaternion_slerp() these work on whole lists: eight quaternions
+  or vectors per AVX2 register, transposed to one component per register
+  and back. Each batch form returns bit for bit what its scalar function
+  returns element by element (quaternion_rotate_vector3(),
+  quaternion_normalize(), quaternion_nlerp(), quaternion_slerp(),
+  quaternion_to_matrix4()).
+
+  Output lists are resized to the input length and may be one of the
+  inputs. Paired inputs must have equal lengths.*/
+
+#ifndef BLIB_MATH_QUATERNION_H
+#define BLIB_MATH_QUATERNION_H
+
+#include <assert.h>
+#include <math.h>
+#include "blib.h"
+#include "blib_math3d.h"
+#include "blib_fast_math.h"
+#include "blib_math_transform.h"
+
+/*Above this |cos| of the angle between the inputs quaternion_slerp()
+  falls back to quaternion_nlerp(), whose error is then below the
+  precision of the trigonometric path*/
+#define BLIB_QUATERNION_SLERP_LINEAR (0.9995f /* cosine */)
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/*Spherical linear interpolation, the short way around, at constant
+  angular speed. Uses fast_atan2f() and fast_sinf() and renormalizes the
+  result, so it stays a unit quaternion to within a few ULP.*/
+static inline quaternion_t 
+quaternion_slerp(quaternion_t a, quaternion_t b, float t) {
+	float d = quaternion_dot(a, b);
+	float ad = fabsf(d);
+	float u = 1.0f - t;
+	float v = t;
+	if (ad < BLIB_QUATERNION_SLERP_LINEAR) {
+		// The 1 / sin(angle) factor cancels in the normalize.
+		float angle = fast_atan2f(sqrtf(1.0f - ad * ad), ad);
+		u = fast_sinf(u * angle);
+		v = fast_sinf(v * angle);
+	}
+	v = d < 0.0f ? -v : v;
+	return quaternion_normalize((quaternion_t){
+		.w = a.w * u + b.w * v,
+		.x = a.x * u + b.x * v,
+		.y = a.y * u + b.y * v,
+		.z = a.z * u + b.z * v,
+	});
+}
+
+/*Rotates every vector of "in" by "q"*/
+void quaternion_rotate_all(const quaternion_t *q, const list_vector3_t *in, list_vector3_t *out);
+
+/*Rotates in[i] by rotations[i]*/
+void quaternion_rotate_each(const list_quaternion_t *rotations, const list_vector3_t *in, list_vector3_t *out);
+
+void quaternion_normalize_all(const list_quaternion_t *in, list_quaternion_t *out);
+void quaternion_nlerp_all(const list_quaternion_t *a, const list_quaternion_t *b, float t, list_quaternion_t *out);
+void quaternion_slerp_all(const list_quaternion_t *a, const list_quaternion_t *b, float t, list_quaternion_t *out);
+void quaternion_to_matrix4_all(const list_quaternion_t *in, list_matrix4_t *out);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_MATH_QUATERNION_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_MATH_QUATERNION_IMPLEMENTATION_H
+#define BLIB_MATH_QUATERNION_IMPLEMENTATION_H
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BLIB_MATH_QUATERNION_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+enum {
+	QUATERNION_NORMALIZE,
+	QUATERNION_NLERP,
+	QUATERNION_SLERP
+};
+
+static quaternion_t quaternion_blend_scalar(int op, quaternion_t a, quaternion_t b, float t) {
+	switch (op) {
+		case QUATERNION_NLERP: return quaternion_nlerp(a, b, t);
+		case QUATERNION_SLERP: return quaternion_slerp(a, b, t);
+		default: return quaternion_normalize(a);
+	}
+}
+
+#ifdef BLIB_MATH_QUATERNION_X86
+
+typedef struct {
+	__m256 w, x, y, z;
+} quaternion8;
+
+/*Eight quaternions to one register per component. Quaternions i and
+  i + 4 share a register so the in-lane 4x4 transpose leaves them in
+  order.*/
+__attribute__((target("avx2"), always_inline))
+static inline quaternion8 quaternion_load8(const quaternion_t *q) {
+	const float *p = (const float *)q;
+	__m256 r0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p)), _mm_loadu_ps(p + 16), 1);
+	__m256 r1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 4)), _mm_loadu_ps(p + 20), 1);
+	__m256 r2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 8)), _mm_loadu_ps(p + 24), 1);
+	__m256 r3 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 12)), _mm_loadu_ps(p + 28), 1);
+	__m256 t0 = _mm256_unpacklo_ps(r0, r1), t1 = _mm256_unpacklo_ps(r2, r3);
+	__m256 t2 = _mm256_unpackhi_ps(r0, r1), t3 = _mm256_unpackhi_ps(r2, r3);
+	quaternion8 ret;
+	ret.w = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+	ret.x = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+	ret.y = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	ret.z = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	return ret;
+}
+
+/*The inverse of quaternion_load8(), the transpose undoes itself*/
+__attribute__((target("avx2"), always_inline))
+static inline void quaternion_store8(quaternion_t *q, quaternion8 v) {
+	float *p = (float *)q;
+	__m256 t0 = _mm256_unpacklo_ps(v.w, v.x), t1 = _mm256_unpacklo_ps(v.y, v.z);
+	__m256 t2 = _mm256_unpackhi_ps(v.w, v.x), t3 = _mm256_unpackhi_ps(v.y, v.z);
+	__m256 r0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 r1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 r2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 r3 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	_mm_storeu_ps(p, _mm256_castps256_ps128(r0));
+	_mm_storeu_ps(p + 4, _mm256_castps256_ps128(r1));
+	_mm_storeu_ps(p + 8, _mm256_castps256_ps128(r2));
+	_mm_storeu_ps(p + 12, _mm256_castps256_ps128(r3));
+	_mm_storeu_ps(p + 16, _mm256_extractf128_ps(r0, 1));
+	_mm_storeu_ps(p + 20, _mm256_extractf128_ps(r1, 1));
+	_mm_storeu_ps(p + 24, _mm256_extractf128_ps(r2, 1));
+	_mm_storeu_ps(p + 28, _mm256_extractf128_ps(r3, 1));
+}
+
+__attribute__((target("avx2"), always_inline))
+static inline __m256 quaternion_dot8(quaternion8 a, quaternion8 b) {
+	__m256 d = _mm256_add_ps(_mm256_mul_ps(a.w, b.w), _mm256_mul_ps(a.x, b.x));
+	d = _mm256_add_ps(d, _mm256_mul_ps(a.y, b.y));
+	return _mm256_add_ps(d, _mm256_mul_ps(a.z, b.z));
+}
+
+/*quaternion_normalize(), including the identity for a zero quaternion*/
+__attribute__((target("avx2"), always_inline))
+static inline quaternion8 quaternion_normalize8(quaternion8 q) {
+	__m256 mag = _mm256_sqrt_ps(quaternion_dot8(q, q));
+	__m256 zero = _mm256_cmp_ps(mag, _mm256_setzero_ps(), _CMP_EQ_OQ);
+	q.w = fast_select8(zero, _mm256_set1_ps(1.0f), _mm256_div_ps(q.w, mag));
+	q.x = fast_select8(zero, _mm256_setzero_ps(), _mm256_div_ps(q.x, mag));
+	q.y = fast_select8(zero, _mm256_setzero_ps(), _mm256_div_ps(q.y, mag));
+	q.z = fast_select8(zero, _mm256_setzero_ps(), _mm256_div_ps(q.z, mag));
+	return q;
+}
+
+/*quaternion_nlerp() and quaternion_slerp(). The slerp lanes under the
+  threshold take the trigonometric weights, the rest the linear ones.*/
+__attribute__((target("avx2"), always_inline))
+static inline quaternion8 quaternion_blend8(quaternion8 a, quaternion8 b, float t, int slerp) {
+	const __m256 sign_mask = _mm256_castsi256_ps(_mm256_set1_epi32((int32_t)0x80000000u));
+	__m256 d = quaternion_dot8(a, b);
+	__m256 u = _mm256_set1_ps(1.0f - t);
+	__m256 v = _mm256_set1_ps(t);
+	if (slerp) {
+		__m256 ad = _mm256_andnot_ps(sign_mask, d);
+		__m256 trig = _mm256_cmp_ps(ad, _mm256_set1_ps(BLIB_QUATERNION_SLERP_LINEAR), _CMP_LT_OQ);
+		__m256 sine = _mm256_sqrt_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(ad, ad)));
+		__m256 angle = fast_atan2_8(sine, ad);
+		u = fast_select8(trig, fast_sin_quadrant8(_mm256_mul_ps(u, angle), 0), u);
+		v = fast_select8(trig, fast_sin_quadrant8(_mm256_mul_ps(v, angle), 0), v);
+	}
+	v = fast_select8(_mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_LT_OQ), _mm256_xor_ps(v, sign_mask), v);
+	quaternion8 r;
+	r.w = _mm256_add_ps(_mm256_mul_ps(a.w, u), _mm256_mul_ps(b.w, v));
+	r.x = _mm256_add_ps(_mm256_mul_ps(a.x, u), _mm256_mul_ps(b.x, v));
+	r.y = _mm256_add_ps(_mm256_mul_ps(a.y, u), _mm256_mul_ps(b.y, v));
+	r.z = _mm256_add_ps(_mm256_mul_ps(a.z, u), _mm256_mul_ps(b.z, v));
+	return quaternion_normalize8(r);
+}
+
+__attribute__((target("avx2")))
+static size_t quaternion_blend_avx2(int op, const quaternion_t *a, const quaternion_t *b, float t,
+		quaternion_t *out, size_t count) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		quaternion8 q = quaternion_load8(a + i);
+		switch (op) {
+			case QUATERNION_NLERP: q = quaternion_blend8(q, quaternion_load8(b + i), t, 0); break;
+			case QUATERNION_SLERP: q = quaternion_blend8(q, quaternion_load8(b + i), t, 1); break;
+			default: q = quaternion_normalize8(q); break;
+		}
+		quaternion_store8(out + i, q);
+	}
+	return i;
+}
+
+/*quaternion_rotate_vector3() for eight vectors, by eight quaternions or
+  one broadcast to every lane*/
+__attribute__((target("avx2"), always_inline))
+static inline void quaternion_rotate8(quaternion8 q, const float *in, float *out) {
+	__m256 vx, vy, vz;
+	transform_load8(in, &vx, &vy, &vz);
+	const __m256 two = _mm256_set1_ps(2.0f);
+	__m256 tx = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(q.y, vz), _mm256_mul_ps(q.z, vy)));
+	__m256 ty = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(q.z, vx), _mm256_mul_ps(q.x, vz)));
+	__m256 tz = _mm256_mul_ps(two, _mm256_sub_ps(_mm256_mul_ps(q.x, vy), _mm256_mul_ps(q.y, vx)));
+	vx = _mm256_add_ps(_mm256_add_ps(vx, _mm256_mul_ps(q.w, tx)),
+		_mm256_sub_ps(_mm256_mul_ps(q.y, tz), _mm256_mul_ps(q.z, ty)));
+	vy = _mm256_add_ps(_mm256_add_ps(vy, _mm256_mul_ps(q.w, ty)),
+		_mm256_sub_ps(_mm256_mul_ps(q.z, tx), _mm256_mul_ps(q.x, tz)));
+	vz = _mm256_add_ps(_mm256_add_ps(vz, _mm256_mul_ps(q.w, tz)),
+		_mm256_sub_ps(_mm256_mul_ps(q.x, ty), _mm256_mul_ps(q.y, tx)));
+	transform_store8(out, vx, vy, vz);
+}
+
+/*"step" is 0 to use rotations[0] for every vector*/
+__attribute__((target("avx2")))
+static size_t quaternion_rotate_avx2(const quaternion_t *rotations, size_t step, const vector3_t *in,
+		vector3_t *out, size_t count) {
+	quaternion8 q;
+	q.w = _mm256_set1_ps(rotations->w);
+	q.x = _mm256_set1_ps(rotations->x);
+	q.y = _mm256_set1_ps(rotations->y);
+	q.z = _mm256_set1_ps(rotations->z);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		if (step)
+			q = quaternion_load8(rotations + i);
+		quaternion_rotate8(q, (const float *)(in + i), (float *)(out + i));
+	}
+	return i;
+}
+
+/*Rows of eight values to eight rows of their i-th values*/
+__attribute__((target("avx2"), always_inline))
+static inline void quaternion_transpose8(__m256 r[8]) {
+	__m256 t[8], s[8];
+	for (int k = 0; k < 8; k += 2) {
+		t[k] = _mm256_unpacklo_ps(r[k], r[k + 1]);
+		t[k + 1] = _mm256_unpackhi_ps(r[k], r[k + 1]);
+	}
+	for (int k = 0; k < 8; k += 4) {
+		s[k] = _mm256_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(1, 0, 1, 0));
+		s[k + 1] = _mm256_shuffle_ps(t[k], t[k + 2], _MM_SHUFFLE(3, 2, 3, 2));
+		s[k + 2] = _mm256_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(1, 0, 1, 0));
+		s[k + 3] = _mm256_shuffle_ps(t[k + 1], t[k + 3], _MM_SHUFFLE(3, 2, 3, 2));
+	}
+	for (int k = 0; k < 4; k++) {
+		r[k] = _mm256_permute2f128_ps(s[k], s[k + 4], 0x20);
+		r[k + 4] = _mm256_permute2f128_ps(s[k], s[k + 4], 0x31);
+	}
+}
+
+/*quaternion_to_matrix4() for eight quaternions. The first and second
+  halves of the eight matrices are each an 8x8 transpose of the element
+  vectors.*/
+__attribute__((target("avx2")))
+static size_t quaternion_to_matrix4_avx2(const quaternion_t *in, matrix4_t *out, size_t count) {
+	const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), zero = _mm256_setzero_ps();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		quaternion8 q = quaternion_load8(in + i);
+		__m256 xx = _mm256_mul_ps(q.x, q.x), xy = _mm256_mul_ps(q.x, q.y);
+		__m256 xz = _mm256_mul_ps(q.x, q.z), xw = _mm256_mul_ps(q.x, q.w);
+		__m256 yy = _mm256_mul_ps(q.y, q.y), yz = _mm256_mul_ps(q.y, q.z), yw = _mm256_mul_ps(q.y, q.w);
+		__m256 zz = _mm256_mul_ps(q.z, q.z), zw = _mm256_mul_ps(q.z, q.w);
+		__m256 low[8] = {
+			_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(yy, zz))),
+			_mm256_mul_ps(two, _mm256_add_ps(xy, zw)),
+			_mm256_mul_ps(two, _mm256_sub_ps(xz, yw)),
+			zero,
+			_mm256_mul_ps(two, _mm256_sub_ps(xy, zw)),
+			_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, zz))),
+			_mm256_mul_ps(two, _mm256_add_ps(yz, xw)),
+			zero,
+		};
+		__m256 high[8] = {
+			_mm256_mul_ps(two, _mm256_add_ps(xz, yw)),
+			_mm256_mul_ps(two, _mm256_sub_ps(yz, xw)),
+			_mm256_sub_ps(one, _mm256_mul_ps(two, _mm256_add_ps(xx, yy))),
+			zero, zero, zero, zero, one,
+		};
+		quaternion_transpose8(low);
+		quaternion_transpose8(high);
+		for (int k = 0; k < 8; k++) {
+			_mm256_storeu_ps(out[i + k].elements, low[k]);
+			_mm256_storeu_ps(out[i + k].elements + 8, high[k]);
+		}
+	}
+	return i;
+}
+
+#endif // BLIB_MATH_QUATERNION_X86
+
+static void quaternion_blend_all(int op, const list_quaternion_t *a, const list_quaternion_t *b, float t,
+		list_quaternion_t *out) {
+	size_t count = a->length;
+	if (b)
+		assert(b->length == count);
+	// An "out" that is also an input is already big enough, so this never
+	// moves an input.
+	out->array = transform_reserve(out->array, &out->capacity, count, sizeof(quaternion_t));
+	const quaternion_t *pa = a->array, *pb = b ? b->array : a->array;
+	quaternion_t *po = out->array;
+	size_t i = 0;
+#ifdef BLIB_MATH_QUATERNION_X86
+	if (fast_math_has_avx2())
+		i = quaternion_blend_avx2(op, pa, pb, t, po, count);
+#endif
+	for (; i < count; i++)
+		po[i] = quaternion_blend_scalar(op, pa[i], pb[i], t);
+	out->length = count;
+}
+
+void quaternion_rotate_all(const quaternion_t *q, const list_vector3_t *in, list_vector3_t *out) {
+	size_t count = in->length;
+	out->array = transform_reserve(out->array, &out->capacity, count, sizeof(vector3_t));
+	size_t i = 0;
+#ifdef BLIB_MATH_QUATERNION_X86
+	if (fast_math_has_avx2())
+		i = quaternion_rotate_avx2(q, 0, in->array, out->array, count);
+#endif
+	for (; i < count; i++)
+		out->array[i] = quaternion_rotate_vector3(*q, in->array[i]);
+	out->length = count;
+}
+
+void quaternion_rotate_each(const list_quaternion_t *rotations, const list_vector3_t *in, list_vector3_t *out) {
+	size_t count = in->length;
+	assert(rotations->length == count);
+	out->array = transform_reserve(out->array, &out->capacity, count, sizeof(vector3_t));
+	size_t i = 0;
+#ifdef BLIB_MATH_QUATERNION_X86
+	// The kernel reads rotations[0] even for fewer than 8 elements.
+	if (fast_math_has_avx2() && count)
+		i = quaternion_rotate_avx2(rotations->array, 1, in->array, out->array, count);
+#endif
+	for (; i < count; i++)
+		out->array[i] = quaternion_rotate_vector3(rotations->array[i], in->array[i]);
+	out->length = count;
+}
+
+void quaternion_normalize_all(const list_quaternion_t *in, list_quaternion_t *out) {
+	quaternion_blend_all(QUATERNION_NORMALIZE, in, NULL, 0.0f, out);
+}
+
+void quaternion_nlerp_all(const list_quaternion_t *a, const list_quaternion_t *b, float t, list_quaternion_t *out) {
+	quaternion_blend_all(QUATERNION_NLERP, a, b, t, out);
+}
+
+void quaternion_slerp_all(const list_quaternion_t *a, const list_quaternion_t *b, float t, list_quaternion_t *out) {
+	quaternion_blend_all(QUATERNION_SLERP, a, b, t, out);
+}
+
+void quaternion_to_matrix4_all(const list_quaternion_t *in, list_matrix4_t *out) {
+	size_t count = in->length;
+	out->array = transform_reserve(out->array, &out->capacity, count, sizeof(matrix4_t));
+	size_t i = 0;
+#ifdef BLIB_MATH_QUATERNION_X86
+	if (fast_math_has_avx2())
+		i = quaternion_to_matrix4_avx2(in->array, out->array, count);
+#endif
+	for (; i < count; i++)
+		out->array[i] = quaternion_to_matrix4(in->array[i]);
+	out->length = count;
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_MATH_QUATERNION_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
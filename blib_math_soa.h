@@ -0,0 +1,707 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Structure-of-arrays vector containers.
+
+  vector3_soa and vector4_soa keep every component in its own array, which
+  is the layout SIMD wants: eight x values load with one instruction
+  instead of being gathered from eight 12 byte structs. The arrays are
+  aligned to BLIB_SOA_ALIGNMENT and their capacity is a multiple of 8.
+
+  The batch kernels take the place of the per-vector functions in
+  blib_math3d.h and return bit for bit the same results. The output may be
+  one of the inputs. Output containers are resized to the input length,
+  inputs must have equal lengths.*/
+
+#ifndef BLIB_MATH_SOA_H
+#define BLIB_MATH_SOA_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blib.h"
+#include "blib_math3d.h"
+
+#define BLIB_SOA_ALIGNMENT (32 /* bytes */)
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct {
+	float *x;
+	float *y;
+	float *z;
+	size_t length;
+	size_t capacity;
+	void *block;
+} vector3_soa;
+
+typedef struct {
+	float *x;
+	float *y;
+	float *z;
+	float *w;
+	size_t length;
+	size_t capacity;
+	void *block;
+} vector4_soa;
+
+/*Points "arrays" at "components" new arrays of "capacity" floats carved
+  from one aligned, zeroed block, after copying the first "length" floats
+  of each old array across. Returns the block to free later.*/
+static inline void *soa_reallocate(float **arrays, int components, size_t capacity, size_t length) {
+	void *block = malloc(capacity * sizeof(float) * (size_t)components + BLIB_SOA_ALIGNMENT - 1);
+	float *base = (float *)(((uintptr_t)block + BLIB_SOA_ALIGNMENT - 1) & ~(uintptr_t)(BLIB_SOA_ALIGNMENT - 1));
+	memset(base, 0, capacity * sizeof(float) * (size_t)components);
+	for (int i = 0; i < components; i++) {
+		if (length)
+			memcpy(base + capacity * (size_t)i, arrays[i], length * sizeof(float));
+		arrays[i] = base + capacity * (size_t)i;
+	}
+	return block;
+}
+
+static inline size_t soa_round_capacity(size_t capacity) {
+	return (capacity + 7) & ~(size_t)7;
+}
+
+static inline vector3_soa vector3_soa_alloc(size_t capacity) {
+	vector3_soa soa;
+	memset(&soa, 0, sizeof(soa));
+	soa.capacity = soa_round_capacity(capacity ? capacity : 8);
+	float *arrays[3] = { NULL, NULL, NULL };
+	soa.block = soa_reallocate(arrays, 3, soa.capacity, 0);
+	soa.x = arrays[0];
+	soa.y = arrays[1];
+	soa.z = arrays[2];
+	return soa;
+}
+
+static inline void vector3_soa_free(vector3_soa *soa) {
+	free(soa->block);
+	memset(soa, 0, sizeof(*soa));
+}
+
+/*Grows the capacity to at least "capacity", keeping the contents*/
+static inline void vector3_soa_reserve(vector3_soa *soa, size_t capacity) {
+	if (capacity <= soa->capacity)
+		return;
+	capacity = soa_round_capacity(capacity > soa->capacity * 2 ? capacity : soa->capacity * 2);
+	float *arrays[3] = { soa->x, soa->y, soa->z };
+	void *block = soa_reallocate(arrays, 3, capacity, soa->length);
+	free(soa->block);
+	soa->block = block;
+	soa->capacity = capacity;
+	soa->x = arrays[0];
+	soa->y = arrays[1];
+	soa->z = arrays[2];
+}
+
+/*New elements are zero*/
+static inline void vector3_soa_resize(vector3_soa *soa, size_t length) {
+	vector3_soa_reserve(soa, length);
+	for (size_t i = soa->length; i < length; i++)
+		soa->x[i] = soa->y[i] = soa->z[i] = 0.0f;
+	soa->length = length;
+}
+
+static inline void vector3_soa_push(vector3_soa *soa, vector3_t v) {
+	vector3_soa_reserve(soa, soa->length + 1);
+	soa->x[soa->length] = v.x;
+	soa->y[soa->length] = v.y;
+	soa->z[soa->length] = v.z;
+	soa->length++;
+}
+
+static inline vector3_t vector3_soa_get(const vector3_soa *soa, size_t i) {
+	return (vector3_t){ soa->x[i], soa->y[i], soa->z[i] };
+}
+
+static inline void vector3_soa_set(vector3_soa *soa, size_t i, vector3_t v) {
+	soa->x[i] = v.x;
+	soa->y[i] = v.y;
+	soa->z[i] = v.z;
+}
+
+static inline vector4_soa vector4_soa_alloc(size_t capacity) {
+	vector4_soa soa;
+	memset(&soa, 0, sizeof(soa));
+	soa.capacity = soa_round_capacity(capacity ? capacity : 8);
+	float *arrays[4] = { NULL, NULL, NULL, NULL };
+	soa.block = soa_reallocate(arrays, 4, soa.capacity, 0);
+	soa.x = arrays[0];
+	soa.y = arrays[1];
+	soa.z = arrays[2];
+	soa.w = arrays[3];
+	return soa;
+}
+
+static inline void vector4_soa_free(vector4_soa *soa) {
+	free(soa->block);
+	memset(soa, 0, sizeof(*soa));
+}
+
+static inline void vector4_soa_reserve(vector4_soa *soa, size_t capacity) {
+	if (capacity <= soa->capacity)
+		return;
+	capacity = soa_round_capacity(capacity > soa->capacity * 2 ? capacity : soa->capacity * 2);
+	float *arrays[4] = { soa->x, soa->y, soa->z, soa->w };
+	void *block = soa_reallocate(arrays, 4, capacity, soa->length);
+	free(soa->block);
+	soa->block = block;
+	soa->capacity = capacity;
+	soa->x = arrays[0];
+	soa->y = arrays[1];
+	soa->z = arrays[2];
+	soa->w = arrays[3];
+}
+
+static inline void vector4_soa_resize(vector4_soa *soa, size_t length) {
+	vector4_soa_reserve(soa, length);
+	for (size_t i = soa->length; i < length; i++)
+		soa->x[i] = soa->y[i] = soa->z[i] = soa->w[i] = 0.0f;
+	soa->length = length;
+}
+
+static inline void vector4_soa_push(vector4_soa *soa, vector4_t v) {
+	vector4_soa_reserve(soa, soa->length + 1);
+	soa->x[soa->length] = v.x;
+	soa->y[soa->length] = v.y;
+	soa->z[soa->length] = v.z;
+	soa->w[soa->length] = v.w;
+	soa->length++;
+}
+
+static inline vector4_t vector4_soa_get(const vector4_soa *soa, size_t i) {
+	return (vector4_t){ soa->x[i], soa->y[i], soa->z[i], soa->w[i] };
+}
+
+static inline void vector4_soa_set(vector4_soa *soa, size_t i, vector4_t v) {
+	soa->x[i] = v.x;
+	soa->y[i] = v.y;
+	soa->z[i] = v.z;
+	soa->w[i] = v.w;
+}
+
+/*Conversions replace the contents of the destination*/
+void vector3_soa_from_list(vector3_soa *soa, const list_vector3_t *list);
+void vector3_soa_to_list(const vector3_soa *soa, list_vector3_t *list);
+void vector4_soa_from_list(vector4_soa *soa, const list_vector4_t *list);
+void vector4_soa_to_list(const vector4_soa *soa, list_vector4_t *list);
+
+/*Element-wise versions of the blib_math3d.h functions of the same name.
+  Kernels producing one float per element write "count" floats to "out".*/
+void vector3_soa_add(const vector3_soa *a, const vector3_soa *b, vector3_soa *out);
+void vector3_soa_subtract(const vector3_soa *minuend, const vector3_soa *subtrahend, vector3_soa *out);
+void vector3_soa_scale(const vector3_soa *v, float scalar, vector3_soa *out);
+void vector3_soa_lerp(const vector3_soa *a, const vector3_soa *b, float t, vector3_soa *out);
+void vector3_soa_cross(const vector3_soa *a, const vector3_soa *b, vector3_soa *out);
+void vector3_soa_normalize(const vector3_soa *v, vector3_soa *out);
+void vector3_soa_dot(const vector3_soa *a, const vector3_soa *b, float *out);
+void vector3_soa_distance(const vector3_soa *a, const vector3_soa *b, float *out);
+
+void vector4_soa_add(const vector4_soa *a, const vector4_soa *b, vector4_soa *out);
+void vector4_soa_subtract(const vector4_soa *minuend, const vector4_soa *subtrahend, vector4_soa *out);
+void vector4_soa_scale(const vector4_soa *v, float scalar, vector4_soa *out);
+void vector4_soa_lerp(const vector4_soa *a, const vector4_soa *b, float t, vector4_soa *out);
+void vector4_soa_normalize(const vector4_soa *v, vector4_soa *out);
+void vector4_soa_dot(const vector4_soa *a, const vector4_soa *b, float *out);
+void vector4_soa_distance(const vector4_soa *a, const vector4_soa *b, float *out);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_MATH_SOA_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_MATH_SOA_IMPLEMENTATION_H
+#define BLIB_MATH_SOA_IMPLEMENTATION_H
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BLIB_MATH_SOA_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+enum {
+	SOA_ADD,
+	SOA_SUBTRACT,
+	SOA_SCALE,
+	SOA_LERP,
+	SOA_CROSS,
+	SOA_NORMALIZE,
+	SOA_DOT,
+	SOA_DISTANCE
+};
+
+/*One kernel call over "dimensions" component arrays, shared by vector3
+  and vector4. "zero" is what normalize returns for a zero vector, since
+  vector4_zero() has w = 1.*/
+typedef struct {
+	int op;
+	int dimensions;
+	const float *a[4];
+	const float *b[4];
+	float *out[4];
+	float *scalars;
+	float s;
+	float zero[4];
+} soa_job;
+
+static void soa_scalar(const soa_job *job, size_t begin, size_t end) {
+	int d = job->dimensions;
+	for (size_t i = begin; i < end; i++) {
+		float r[4];
+		float sum = 0.0f;
+		switch (job->op) {
+			case SOA_ADD:
+				for (int k = 0; k < d; k++) job->out[k][i] = job->a[k][i] + job->b[k][i];
+				break;
+			case SOA_SUBTRACT:
+				for (int k = 0; k < d; k++) job->out[k][i] = job->a[k][i] - job->b[k][i];
+				break;
+			case SOA_SCALE:
+				for (int k = 0; k < d; k++) job->out[k][i] = job->a[k][i] * job->s;
+				break;
+			case SOA_LERP:
+				for (int k = 0; k < d; k++) job->out[k][i] = job->a[k][i] + (job->b[k][i] - job->a[k][i]) * job->s;
+				break;
+			case SOA_CROSS:
+				r[0] = (job->a[1][i] * job->b[2][i]) - (job->a[2][i] * job->b[1][i]);
+				r[1] = -((job->a[0][i] * job->b[2][i]) - (job->a[2][i] * job->b[0][i]));
+				r[2] = (job->a[0][i] * job->b[1][i]) - (job->a[1][i] * job->b[0][i]);
+				for (int k = 0; k < 3; k++) job->out[k][i] = r[k];
+				break;
+			case SOA_NORMALIZE:
+				sum = job->a[0][i] * job->a[0][i];
+				for (int k = 1; k < d; k++) sum = sum + job->a[k][i] * job->a[k][i];
+				sum = sqrtf(sum);
+				for (int k = 0; k < d; k++) r[k] = sum == 0 ? job->zero[k] : job->a[k][i] / sum;
+				for (int k = 0; k < d; k++) job->out[k][i] = r[k];
+				break;
+			case SOA_DOT:
+				sum = job->a[0][i] * job->b[0][i];
+				for (int k = 1; k < d; k++) sum = sum + job->a[k][i] * job->b[k][i];
+				job->scalars[i] = sum;
+				break;
+			case SOA_DISTANCE:
+				r[0] = job->b[0][i] - job->a[0][i];
+				sum = r[0] * r[0];
+				for (int k = 1; k < d; k++) {
+					r[k] = job->b[k][i] - job->a[k][i];
+					sum = sum + r[k] * r[k];
+				}
+				job->scalars[i] = sqrtf(sum);
+				break;
+		}
+	}
+}
+
+#ifdef BLIB_MATH_SOA_X86
+
+/*Same operations, 8 and 4 elements at a time. The component arrays are
+  aligned, the float outputs of dot and distance need not be. Sums run in
+  the same order as the scalar code.*/
+
+__attribute__((target("avx2"), always_inline))
+static inline void soa_avx2_dimensions(const soa_job *job, size_t end, int d) {
+	// Local copies so the compiler knows the stores cannot change them.
+	const float *a[4], *b[4];
+	float *out[4];
+	for (int k = 0; k < d; k++) {
+		a[k] = job->a[k];
+		b[k] = job->b[k];
+		out[k] = job->out[k];
+	}
+	float *scalars = job->scalars;
+	__m256 s = _mm256_set1_ps(job->s), sign = _mm256_set1_ps(-0.0f);
+	switch (job->op) {
+		case SOA_ADD:
+			for (size_t i = 0; i < end; i += 8)
+				for (int k = 0; k < d; k++)
+					_mm256_store_ps(out[k] + i, _mm256_add_ps(_mm256_load_ps(a[k] + i), _mm256_load_ps(b[k] + i)));
+			break;
+		case SOA_SUBTRACT:
+			for (size_t i = 0; i < end; i += 8)
+				for (int k = 0; k < d; k++)
+					_mm256_store_ps(out[k] + i, _mm256_sub_ps(_mm256_load_ps(a[k] + i), _mm256_load_ps(b[k] + i)));
+			break;
+		case SOA_SCALE:
+			for (size_t i = 0; i < end; i += 8)
+				for (int k = 0; k < d; k++)
+					_mm256_store_ps(out[k] + i, _mm256_mul_ps(_mm256_load_ps(a[k] + i), s));
+			break;
+		case SOA_LERP:
+			for (size_t i = 0; i < end; i += 8)
+				for (int k = 0; k < d; k++) {
+					__m256 x = _mm256_load_ps(a[k] + i);
+					_mm256_store_ps(out[k] + i, _mm256_add_ps(x, _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(b[k] + i), x), s)));
+				}
+			break;
+		case SOA_CROSS:
+			for (size_t i = 0; i < end; i += 8) {
+				__m256 ax = _mm256_load_ps(a[0] + i), ay = _mm256_load_ps(a[1] + i), az = _mm256_load_ps(a[2] + i);
+				__m256 bx = _mm256_load_ps(b[0] + i), by = _mm256_load_ps(b[1] + i), bz = _mm256_load_ps(b[2] + i);
+				__m256 x = _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(az, by));
+				__m256 y = _mm256_xor_ps(_mm256_sub_ps(_mm256_mul_ps(ax, bz), _mm256_mul_ps(az, bx)), sign);
+				__m256 z = _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(ay, bx));
+				_mm256_store_ps(out[0] + i, x);
+				_mm256_store_ps(out[1] + i, y);
+				_mm256_store_ps(out[2] + i, z);
+			}
+			break;
+		case SOA_NORMALIZE:
+			for (size_t i = 0; i < end; i += 8) {
+				__m256 v[4];
+				for (int k = 0; k < d; k++)
+					v[k] = _mm256_load_ps(a[k] + i);
+				__m256 sum = _mm256_mul_ps(v[0], v[0]);
+				for (int k = 1; k < d; k++)
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(v[k], v[k]));
+				sum = _mm256_sqrt_ps(sum);
+				__m256 zero = _mm256_cmp_ps(sum, _mm256_setzero_ps(), _CMP_EQ_OQ);
+				for (int k = 0; k < d; k++)
+					_mm256_store_ps(out[k] + i, _mm256_blendv_ps(_mm256_div_ps(v[k], sum), _mm256_set1_ps(job->zero[k]), zero));
+			}
+			break;
+		case SOA_DOT:
+			for (size_t i = 0; i < end; i += 8) {
+				__m256 sum = _mm256_mul_ps(_mm256_load_ps(a[0] + i), _mm256_load_ps(b[0] + i));
+				for (int k = 1; k < d; k++)
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_load_ps(a[k] + i), _mm256_load_ps(b[k] + i)));
+				_mm256_storeu_ps(scalars + i, sum);
+			}
+			break;
+		case SOA_DISTANCE:
+			for (size_t i = 0; i < end; i += 8) {
+				__m256 r = _mm256_sub_ps(_mm256_load_ps(b[0] + i), _mm256_load_ps(a[0] + i));
+				__m256 sum = _mm256_mul_ps(r, r);
+				for (int k = 1; k < d; k++) {
+					r = _mm256_sub_ps(_mm256_load_ps(b[k] + i), _mm256_load_ps(a[k] + i));
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(r, r));
+				}
+				_mm256_storeu_ps(scalars + i, _mm256_sqrt_ps(sum));
+			}
+			break;
+	}
+}
+
+__attribute__((target("sse4.1"), always_inline))
+static inline void soa_sse_dimensions(const soa_job *job, size_t end, int d) {
+	// Local copies so the compiler knows the stores cannot change them.
+	const float *a[4], *b[4];
+	float *out[4];
+	for (int k = 0; k < d; k++) {
+		a[k] = job->a[k];
+		b[k] = job->b[k];
+		out[k] = job->out[k];
+	}
+	float *scalars = job->scalars;
+	__m128 s = _mm_set1_ps(job->s), sign = _mm_set1_ps(-0.0f);
+	switch (job->op) {
+		case SOA_ADD:
+			for (size_t i = 0; i < end; i += 4)
+				for (int k = 0; k < d; k++)
+					_mm_store_ps(out[k] + i, _mm_add_ps(_mm_load_ps(a[k] + i), _mm_load_ps(b[k] + i)));
+			break;
+		case SOA_SUBTRACT:
+			for (size_t i = 0; i < end; i += 4)
+				for (int k = 0; k < d; k++)
+					_mm_store_ps(out[k] + i, _mm_sub_ps(_mm_load_ps(a[k] + i), _mm_load_ps(b[k] + i)));
+			break;
+		case SOA_SCALE:
+			for (size_t i = 0; i < end; i += 4)
+				for (int k = 0; k < d; k++)
+					_mm_store_ps(out[k] + i, _mm_mul_ps(_mm_load_ps(a[k] + i), s));
+			break;
+		case SOA_LERP:
+			for (size_t i = 0; i < end; i += 4)
+				for (int k = 0; k < d; k++) {
+					__m128 x = _mm_load_ps(a[k] + i);
+					_mm_store_ps(out[k] + i, _mm_add_ps(x, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b[k] + i), x), s)));
+				}
+			break;
+		case SOA_CROSS:
+			for (size_t i = 0; i < end; i += 4) {
+				__m128 ax = _mm_load_ps(a[0] + i), ay = _mm_load_ps(a[1] + i), az = _mm_load_ps(a[2] + i);
+				__m128 bx = _mm_load_ps(b[0] + i), by = _mm_load_ps(b[1] + i), bz = _mm_load_ps(b[2] + i);
+				__m128 x = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+				__m128 y = _mm_xor_ps(_mm_sub_ps(_mm_mul_ps(ax, bz), _mm_mul_ps(az, bx)), sign);
+				__m128 z = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+				_mm_store_ps(out[0] + i, x);
+				_mm_store_ps(out[1] + i, y);
+				_mm_store_ps(out[2] + i, z);
+			}
+			break;
+		case SOA_NORMALIZE:
+			for (size_t i = 0; i < end; i += 4) {
+				__m128 v[4];
+				for (int k = 0; k < d; k++)
+					v[k] = _mm_load_ps(a[k] + i);
+				__m128 sum = _mm_mul_ps(v[0], v[0]);
+				for (int k = 1; k < d; k++)
+					sum = _mm_add_ps(sum, _mm_mul_ps(v[k], v[k]));
+				sum = _mm_sqrt_ps(sum);
+				__m128 zero = _mm_cmpeq_ps(sum, _mm_setzero_ps());
+				for (int k = 0; k < d; k++)
+					_mm_store_ps(out[k] + i, _mm_blendv_ps(_mm_div_ps(v[k], sum), _mm_set1_ps(job->zero[k]), zero));
+			}
+			break;
+		case SOA_DOT:
+			for (size_t i = 0; i < end; i += 4) {
+				__m128 sum = _mm_mul_ps(_mm_load_ps(a[0] + i), _mm_load_ps(b[0] + i));
+				for (int k = 1; k < d; k++)
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(a[k] + i), _mm_load_ps(b[k] + i)));
+				_mm_storeu_ps(scalars + i, sum);
+			}
+			break;
+		case SOA_DISTANCE:
+			for (size_t i = 0; i < end; i += 4) {
+				__m128 r = _mm_sub_ps(_mm_load_ps(b[0] + i), _mm_load_ps(a[0] + i));
+				__m128 sum = _mm_mul_ps(r, r);
+				for (int k = 1; k < d; k++) {
+					r = _mm_sub_ps(_mm_load_ps(b[k] + i), _mm_load_ps(a[k] + i));
+					sum = _mm_add_ps(sum, _mm_mul_ps(r, r));
+				}
+				_mm_storeu_ps(scalars + i, _mm_sqrt_ps(sum));
+			}
+			break;
+	}
+}
+
+/*Separate copies for 3 and 4 dimensions so the component loops unroll
+  and the vectors stay in registers*/
+
+__attribute__((target("avx2")))
+static void soa_avx2(const soa_job *job, size_t end) {
+	if (job->dimensions == 3)
+		soa_avx2_dimensions(job, end, 3);
+	else
+		soa_avx2_dimensions(job, end, 4);
+}
+
+__attribute__((target("sse4.1")))
+static void soa_sse(const soa_job *job, size_t end) {
+	if (job->dimensions == 3)
+		soa_sse_dimensions(job, end, 3);
+	else
+		soa_sse_dimensions(job, end, 4);
+}
+
+enum { SOA_SIMD_NONE, SOA_SIMD_SSE41, SOA_SIMD_AVX2 };
+
+static int soa_simd_level(void) {
+	static int level = -1;
+	int l = __atomic_load_n(&level, __ATOMIC_RELAXED);
+	if (l < 0) {
+		__builtin_cpu_init();
+		l = __builtin_cpu_supports("avx2") ? SOA_SIMD_AVX2 :
+			__builtin_cpu_supports("sse4.1") ? SOA_SIMD_SSE41 : SOA_SIMD_NONE;
+		__atomic_store_n(&level, l, __ATOMIC_RELAXED);
+	}
+	return l;
+}
+
+#endif // BLIB_MATH_SOA_X86
+
+static void soa_run(const soa_job *job, size_t count) {
+	size_t i = 0;
+#ifdef BLIB_MATH_SOA_X86
+	switch (soa_simd_level()) {
+		case SOA_SIMD_AVX2: i = count & ~(size_t)7; soa_avx2(job, i); break;
+		case SOA_SIMD_SSE41: i = count & ~(size_t)3; soa_sse(job, i); break;
+	}
+#endif
+	soa_scalar(job, i, count);
+}
+
+static soa_job soa_job3(int op, const vector3_soa *a, const vector3_soa *b, vector3_soa *out) {
+	soa_job job;
+	memset(&job, 0, sizeof(job));
+	job.op = op;
+	job.dimensions = 3;
+	job.a[0] = a->x; job.a[1] = a->y; job.a[2] = a->z;
+	if (b) {
+		assert(a->length == b->length);
+		job.b[0] = b->x; job.b[1] = b->y; job.b[2] = b->z;
+	}
+	if (out) {
+		vector3_soa_resize(out, a->length);
+		job.out[0] = out->x; job.out[1] = out->y; job.out[2] = out->z;
+	}
+	return job;
+}
+
+static soa_job soa_job4(int op, const vector4_soa *a, const vector4_soa *b, vector4_soa *out) {
+	soa_job job;
+	memset(&job, 0, sizeof(job));
+	job.op = op;
+	job.dimensions = 4;
+	job.a[0] = a->x; job.a[1] = a->y; job.a[2] = a->z; job.a[3] = a->w;
+	if (b) {
+		assert(a->length == b->length);
+		job.b[0] = b->x; job.b[1] = b->y; job.b[2] = b->z; job.b[3] = b->w;
+	}
+	if (out) {
+		vector4_soa_resize(out, a->length);
+		job.out[0] = out->x; job.out[1] = out->y; job.out[2] = out->z; job.out[3] = out->w;
+	}
+	vector4_t zero = vector4_zero();
+	job.zero[0] = zero.x; job.zero[1] = zero.y; job.zero[2] = zero.z; job.zero[3] = zero.w;
+	return job;
+}
+
+void vector3_soa_from_list(vector3_soa *soa, const list_vector3_t *list) {
+	soa->length = 0;
+	vector3_soa_resize(soa, list->length);
+	for (size_t i = 0; i < list->length; i++)
+		vector3_soa_set(soa, i, list->array[i]);
+}
+
+void vector3_soa_to_list(const vector3_soa *soa, list_vector3_t *list) {
+	if (list->capacity < soa->length) {
+		list->array = realloc(list->array, sizeof(vector3_t) * soa->length);
+		list->capacity = soa->length;
+		BLIB_METRIC_ADD(metrics_list_reallocs, 1);
+	}
+	for (size_t i = 0; i < soa->length; i++)
+		list->array[i] = vector3_soa_get(soa, i);
+	list->length = soa->length;
+}
+
+void vector4_soa_from_list(vector4_soa *soa, const list_vector4_t *list) {
+	soa->length = 0;
+	vector4_soa_resize(soa, list->length);
+	for (size_t i = 0; i < list->length; i++)
+		vector4_soa_set(soa, i, list->array[i]);
+}
+
+void vector4_soa_to_list(const vector4_soa *soa, list_vector4_t *list) {
+	if (list->capacity < soa->length) {
+		list->array = realloc(list->array, sizeof(vector4_t) * soa->length);
+		list->capacity = soa->length;
+		BLIB_METRIC_ADD(metrics_list_reallocs, 1);
+	}
+	for (size_t i = 0; i < soa->length; i++)
+		list->array[i] = vector4_soa_get(soa, i);
+	list->length = soa->length;
+}
+
+void vector3_soa_add(const vector3_soa *a, const vector3_soa *b, vector3_soa *out) {
+	soa_job job = soa_job3(SOA_ADD, a, b, out);
+	soa_run(&job, a->length);
+}
+
+void vector3_soa_subtract(const vector3_soa *minuend, const vector3_soa *subtrahend, vector3_soa *out) {
+	soa_job job = soa_job3(SOA_SUBTRACT, minuend, subtrahend, out);
+	soa_run(&job, minuend->length);
+}
+
+void vector3_soa_scale(const vector3_soa *v, float scalar, vector3_soa *out) {
+	soa_job job = soa_job3(SOA_SCALE, v, NULL, out);
+	job.s = scalar;
+	soa_run(&job, v->length);
+}
+
+void vector3_soa_lerp(const vector3_soa *a, const vector3_soa *b, float t, vector3_soa *out) {
+	soa_job job = soa_job3(SOA_LERP, a, b, out);
+	job.s = t;
+	soa_run(&job, a->length);
+}
+
+void vector3_soa_cross(const vector3_soa *a, const vector3_soa *b, vector3_soa *out) {
+	soa_job job = soa_job3(SOA_CROSS, a, b, out);
+	soa_run(&job, a->length);
+}
+
+void vector3_soa_normalize(const vector3_soa *v, vector3_soa *out) {
+	soa_job job = soa_job3(SOA_NORMALIZE, v, NULL, out);
+	soa_run(&job, v->length);
+}
+
+void vector3_soa_dot(const vector3_soa *a, const vector3_soa *b, float *out) {
+	soa_job job = soa_job3(SOA_DOT, a, b, NULL);
+	job.scalars = out;
+	soa_run(&job, a->length);
+}
+
+void vector3_soa_distance(const vector3_soa *a, const vector3_soa *b, float *out) {
+	soa_job job = soa_job3(SOA_DISTANCE, a, b, NULL);
+	job.scalars = out;
+	soa_run(&job, a->length);
+}
+
+void vector4_soa_add(const vector4_soa *a, const vector4_soa *b, vector4_soa *out) {
+	soa_job job = soa_job4(SOA_ADD, a, b, out);
+	soa_run(&job, a->length);
+}
+
+void vector4_soa_subtract(const vector4_soa *minuend, const vector4_soa *subtrahend, vector4_soa *out) {
+	soa_job job = soa_job4(SOA_SUBTRACT, minuend, subtrahend, out);
+	soa_run(&job, minuend->length);
+}
+
+void vector4_soa_scale(const vector4_soa *v, float scalar, vector4_soa *out) {
+	soa_job job = soa_job4(SOA_SCALE, v, NULL, out);
+	job.s = scalar;
+	soa_run(&job, v->length);
+}
+
+void vector4_soa_lerp(const vector4_soa *a, const vector4_soa *b, float t, vector4_soa *out) {
+	soa_job job = soa_job4(SOA_LERP, a, b, out);
+	job.s = t;
+	soa_run(&job, a->length);
+}
+
+void vector4_soa_normalize(const vector4_soa *v, vector4_soa *out) {
+	soa_job job = soa_job4(SOA_NORMALIZE, v, NULL, out);
+	soa_run(&job, v->length);
+}
+
+void vector4_soa_dot(const vector4_soa *a, const vector4_soa *b, float *out) {
+	soa_job job = soa_job4(SOA_DOT, a, b, NULL);
+	job.scalars = out;
+	soa_run(&job, a->length);
+}
+
+void vector4_soa_distance(const vector4_soa *a, const vector4_soa *b, float *out) {
+	soa_job job = soa_job4(SOA_DISTANCE, a, b, NULL);
+	job.scalars = out;
+	soa_run(&job, a->length);
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_MATH_SOA_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
@@ -0,0 +1,314 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Batch transforms by one matrix4_t or affine3_t.
+
+  Transforming mesh vertices or a bone palette is the same matrix applied
+  to thousands of values, so these process the whole list at once: eight
+  vector3 at a time with AVX2 (transposed in registers to x, y and z
+  vectors and back), four with SSE4.1, two vector4 or one matrix row pair
+  per AVX2 register. Every result is bit for bit what the scalar
+  matrix4_transform_point(), matrix4_transform_direction(),
+  matrix4_transform_vector4(), matrix4_multiply() and the affine3_t
+  equivalents in blib_math3d.h return, the sums run in the same order and
+  no fused multiply-add is used.
+
+  The output list is resized to the input length and may be the input.*/
+
+#ifndef BLIB_MATH_TRANSFORM_H
+#define BLIB_MATH_TRANSFORM_H
+
+#include <stdlib.h>
+#include "blib.h"
+#include "blib_math3d.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+void matrix4_transform_points(const matrix4_t *m, const list_vector3_t *in, list_vector3_t *out);
+void matrix4_transform_directions(const matrix4_t *m, const list_vector3_t *in, list_vector3_t *out);
+void matrix4_transform_vector4s(const matrix4_t *m, const list_vector4_t *in, list_vector4_t *out);
+void affine3_transform_points(const affine3_t *a, const list_vector3_t *in, list_vector3_t *out);
+void affine3_transform_directions(const affine3_t *a, const list_vector3_t *in, list_vector3_t *out);
+
+/*out[i] = matrix4_multiply(in[i], *m), so every matrix of "in" is applied
+  before "m"*/
+void matrix4_multiply_matrices(const list_matrix4_t *in, const matrix4_t *m, list_matrix4_t *out);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_MATH_TRANSFORM_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_MATH_TRANSFORM_IMPLEMENTATION_H
+#define BLIB_MATH_TRANSFORM_IMPLEMENTATION_H
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BLIB_MATH_TRANSFORM_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/*Makes room for "length" elements of "size" bytes in a list without
+  touching the contents, for when "out" is also the input*/
+static void *transform_reserve(void *array, size_t *capacity, size_t length, size_t size) {
+	if (*capacity < length) {
+		array = realloc(array, size * length);
+		*capacity = length;
+		BLIB_METRIC_ADD(metrics_list_reallocs, 1);
+	}
+	return array;
+}
+
+#ifdef BLIB_MATH_TRANSFORM_X86
+
+/*Eight packed vector3 (24 floats) to x, y and z vectors. The blends pick
+  each component out of the three loads, the permutes put it in order.*/
+__attribute__((target("avx2"), always_inline))
+static inline void transform_load8(const float *p, __m256 *x, __m256 *y, __m256 *z) {
+	__m256 r0 = _mm256_loadu_ps(p), r1 = _mm256_loadu_ps(p + 8), r2 = _mm256_loadu_ps(p + 16);
+	*x = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(r0, r1, 0x92), r2, 0x24),
+		_mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+	*y = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(r0, r1, 0x24), r2, 0x49),
+		_mm256_setr_epi32(1, 4, 7, 2, 5, 0, 3, 6));
+	*z = _mm256_permutevar8x32_ps(_mm256_blend_ps(_mm256_blend_ps(r0, r1, 0x49), r2, 0x92),
+		_mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
+}
+
+/*The inverse of transform_load8()*/
+__attribute__((target("avx2"), always_inline))
+static inline void transform_store8(float *p, __m256 x, __m256 y, __m256 z) {
+	x = _mm256_permutevar8x32_ps(x, _mm256_setr_epi32(0, 3, 6, 1, 4, 7, 2, 5));
+	y = _mm256_permutevar8x32_ps(y, _mm256_setr_epi32(5, 0, 3, 6, 1, 4, 7, 2));
+	z = _mm256_permutevar8x32_ps(z, _mm256_setr_epi32(2, 5, 0, 3, 6, 1, 4, 7));
+	_mm256_storeu_ps(p, _mm256_blend_ps(_mm256_blend_ps(x, y, 0x92), z, 0x24));
+	_mm256_storeu_ps(p + 8, _mm256_blend_ps(_mm256_blend_ps(x, y, 0x24), z, 0x49));
+	_mm256_storeu_ps(p + 16, _mm256_blend_ps(_mm256_blend_ps(x, y, 0x49), z, 0x92));
+}
+
+/*Transforms the first "count" vector3, a multiple of 8, by the affine3_t
+  elements "e". "translate" is 0 for directions.*/
+__attribute__((target("avx2")))
+static void transform_vector3_avx2(const float *e, const float *in, float *out, size_t count, int translate) {
+	__m256 m[12];
+	for (int k = 0; k < 12; k++)
+		m[k] = _mm256_set1_ps(e[k]);
+	for (size_t i = 0; i < count; i += 8) {
+		__m256 x, y, z;
+		transform_load8(in + i * 3, &x, &y, &z);
+		__m256 r[3];
+		for (int c = 0; c < 3; c++) {
+			r[c] = _mm256_add_ps(_mm256_mul_ps(x, m[c]), _mm256_mul_ps(y, m[3 + c]));
+			r[c] = _mm256_add_ps(r[c], _mm256_mul_ps(z, m[6 + c]));
+			if (translate)
+				r[c] = _mm256_add_ps(r[c], m[9 + c]);
+		}
+		transform_store8(out + i * 3, r[0], r[1], r[2]);
+	}
+}
+
+/*Four packed vector3 to x, y and z vectors and back, like
+  transform_load8() and transform_store8()*/
+__attribute__((target("sse4.1")))
+static void transform_vector3_sse(const float *e, const float *in, float *out, size_t count, int translate) {
+	__m128 m[12];
+	for (int k = 0; k < 12; k++)
+		m[k] = _mm_set1_ps(e[k]);
+	for (size_t i = 0; i < count; i += 4) {
+		const float *p = in + i * 3;
+		__m128 r0 = _mm_loadu_ps(p), r1 = _mm_loadu_ps(p + 4), r2 = _mm_loadu_ps(p + 8);
+		__m128 x = _mm_blend_ps(_mm_blend_ps(r0, r1, 0x4), r2, 0x2);
+		__m128 y = _mm_blend_ps(_mm_blend_ps(r0, r1, 0x9), r2, 0x4);
+		__m128 z = _mm_blend_ps(_mm_blend_ps(r0, r1, 0x2), r2, 0x9);
+		x = _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 2, 3, 0));
+		y = _mm_shuffle_ps(y, y, _MM_SHUFFLE(2, 3, 0, 1));
+		z = _mm_shuffle_ps(z, z, _MM_SHUFFLE(3, 0, 1, 2));
+		__m128 r[3];
+		for (int c = 0; c < 3; c++) {
+			r[c] = _mm_add_ps(_mm_mul_ps(x, m[c]), _mm_mul_ps(y, m[3 + c]));
+			r[c] = _mm_add_ps(r[c], _mm_mul_ps(z, m[6 + c]));
+			if (translate)
+				r[c] = _mm_add_ps(r[c], m[9 + c]);
+		}
+		// The shuffles above are their own inverses.
+		x = _mm_shuffle_ps(r[0], r[0], _MM_SHUFFLE(1, 2, 3, 0));
+		y = _mm_shuffle_ps(r[1], r[1], _MM_SHUFFLE(2, 3, 0, 1));
+		z = _mm_shuffle_ps(r[2], r[2], _MM_SHUFFLE(3, 0, 1, 2));
+		float *q = out + i * 3;
+		_mm_storeu_ps(q, _mm_blend_ps(_mm_blend_ps(x, y, 0x2), z, 0x4));
+		_mm_storeu_ps(q + 4, _mm_blend_ps(_mm_blend_ps(x, y, 0x9), z, 0x2));
+		_mm_storeu_ps(q + 8, _mm_blend_ps(_mm_blend_ps(x, y, 0x4), z, 0x9));
+	}
+}
+
+/*"count" row vectors of 4 floats times the matrix, two per register. Each
+  component is broadcast across its half and scales the matching matrix
+  row, which is how the vector4 transform and each row of a matrix product
+  work out.*/
+__attribute__((target("avx2")))
+static void transform_rows_avx2(const float *e, const float *in, float *out, size_t count) {
+	__m256 m0 = _mm256_broadcast_ps((const __m128 *)e);
+	__m256 m1 = _mm256_broadcast_ps((const __m128 *)(e + 4));
+	__m256 m2 = _mm256_broadcast_ps((const __m128 *)(e + 8));
+	__m256 m3 = _mm256_broadcast_ps((const __m128 *)(e + 12));
+	for (size_t i = 0; i < count; i += 2) {
+		__m256 v = _mm256_loadu_ps(in + i * 4);
+		__m256 r = _mm256_add_ps(_mm256_mul_ps(_mm256_permute_ps(v, 0x00), m0),
+			_mm256_mul_ps(_mm256_permute_ps(v, 0x55), m1));
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(v, 0xAA), m2));
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_permute_ps(v, 0xFF), m3));
+		_mm256_storeu_ps(out + i * 4, r);
+	}
+}
+
+__attribute__((target("sse4.1")))
+static void transform_rows_sse(const float *e, const float *in, float *out, size_t count) {
+	__m128 m0 = _mm_loadu_ps(e), m1 = _mm_loadu_ps(e + 4), m2 = _mm_loadu_ps(e + 8), m3 = _mm_loadu_ps(e + 12);
+	for (size_t i = 0; i < count; i++) {
+		__m128 v = _mm_loadu_ps(in + i * 4);
+		__m128 r = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(v, v, 0x00), m0),
+			_mm_mul_ps(_mm_shuffle_ps(v, v, 0x55), m1));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, 0xAA), m2));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(v, v, 0xFF), m3));
+		_mm_storeu_ps(out + i * 4, r);
+	}
+}
+
+enum { TRANSFORM_SIMD_NONE, TRANSFORM_SIMD_SSE41, TRANSFORM_SIMD_AVX2 };
+
+static int transform_simd_level(void) {
+	static int level = -1;
+	int l = __atomic_load_n(&level, __ATOMIC_RELAXED);
+	if (l < 0) {
+		__builtin_cpu_init();
+		l = __builtin_cpu_supports("avx2") ? TRANSFORM_SIMD_AVX2 :
+			__builtin_cpu_supports("sse4.1") ? TRANSFORM_SIMD_SSE41 : TRANSFORM_SIMD_NONE;
+		__atomic_store_n(&level, l, __ATOMIC_RELAXED);
+	}
+	return l;
+}
+
+#endif // BLIB_MATH_TRANSFORM_X86
+
+/*Runs the SIMD kernel over a multiple of its width, returns where the
+  scalar tail starts*/
+static size_t transform_vector3(const affine3_t *a, const vector3_t *in, vector3_t *out, size_t count, int translate) {
+	size_t i = 0;
+#ifdef BLIB_MATH_TRANSFORM_X86
+	switch (transform_simd_level()) {
+		case TRANSFORM_SIMD_AVX2:
+			i = count & ~(size_t)7;
+			transform_vector3_avx2(a->elements, (const float *)in, (float *)out, i, translate);
+			break;
+		case TRANSFORM_SIMD_SSE41:
+			i = count & ~(size_t)3;
+			transform_vector3_sse(a->elements, (const float *)in, (float *)out, i, translate);
+			break;
+	}
+#else
+	(void)a; (void)in; (void)out; (void)count; (void)translate;
+#endif
+	return i;
+}
+
+static size_t transform_rows(const matrix4_t *m, const float *in, float *out, size_t count) {
+	size_t i = 0;
+#ifdef BLIB_MATH_TRANSFORM_X86
+	switch (transform_simd_level()) {
+		case TRANSFORM_SIMD_AVX2:
+			i = count & ~(size_t)1;
+			transform_rows_avx2(m->elements, in, out, i);
+			break;
+		case TRANSFORM_SIMD_SSE41:
+			i = count;
+			transform_rows_sse(m->elements, in, out, i);
+			break;
+	}
+#else
+	(void)m; (void)in; (void)out; (void)count;
+#endif
+	return i;
+}
+
+void affine3_transform_points(const affine3_t *a, const list_vector3_t *in, list_vector3_t *out) {
+	size_t count = in->length;
+	out->array = transform_reserve(out->array, &out->capacity, count, sizeof(vector3_t));
+	for (size_t i = transform_vector3(a, in->array, out->array, count, 1); i < count; i++)
+		out->array[i] = affine3_transform_point(*a, in->array[i]);
+	out->length = count;
+}
+
+void affine3_transform_directions(const affine3_t *a, const list_vector3_t *in, list_vector3_t *out) {
+	size_t count = in->length;
+	out->array = transform_reserve(out->array, &out->capacity, count, sizeof(vector3_t));
+	for (size_t i = transform_vector3(a, in->array, out->array, count, 0); i < count; i++)
+		out->array[i] = affine3_transform_direction(*a, in->array[i]);
+	out->length = count;
+}
+
+/*The point and direction transforms never read the bottom row, so these
+  give the same results through the affine3_t form*/
+
+void matrix4_transform_points(const matrix4_t *m, const list_vector3_t *in, list_vector3_t *out) {
+	affine3_t a = affine3_from_matrix4(*m);
+	affine3_transform_points(&a, in, out);
+}
+
+void matrix4_transform_directions(const matrix4_t *m, const list_vector3_t *in, list_vector3_t *out) {
+	affine3_t a = affine3_from_matrix4(*m);
+	affine3_transform_directions(&a, in, out);
+}
+
+void matrix4_transform_vector4s(const matrix4_t *m, const list_vector4_t *in, list_vector4_t *out) {
+	size_t count = in->length;
+	out->array = transform_reserve(out->array, &out->capacity, count, sizeof(vector4_t));
+	size_t i = transform_rows(m, (const float *)in->array, (float *)out->array, count);
+	for (; i < count; i++)
+		out->array[i] = matrix4_transform_vector4(*m, in->array[i]);
+	out->length = count;
+}
+
+void matrix4_multiply_matrices(const list_matrix4_t *in, const matrix4_t *m, list_matrix4_t *out) {
+	size_t count = in->length;
+	out->array = transform_reserve(out->array, &out->capacity, count, sizeof(matrix4_t));
+	size_t rows = transform_rows(m, (const float *)in->array, (float *)out->array, count * 4);
+	for (size_t i = rows / 4; i < count; i++)
+		out->array[i] = matrix4_multiply(in->array[i], *m);
+	out->length = count;
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_MATH_TRANSFORM_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
@@ -0,0 +1,396 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Runtime statistics: counters, gauges and latency histograms.
+
+  static metrics_counter frames = METRICS_COUNTER_INIT("frames");
+  static metrics_histogram frame_ns = METRICS_HISTOGRAM_INIT("frame_ns");
+
+  metrics_counter_register(&frames);
+  metrics_histogram_register(&frame_ns);
+  ...
+  metrics_counter_add(&frames, 1);
+  metrics_histogram_record(&frame_ns, timer_now_ns() - start);
+  ...
+  metrics_write_text(stdout);
+
+  Counters and histograms are split into BLIB_METRICS_SHARDS cache line
+  sized shards. Each thread records into its own shard with a relaxed atomic
+  add, and readers merge the shards when they ask for a value.
+
+  The library's own metrics are only updated when BLIB_METRICS is defined
+  in every translation unit, see BLIB_METRIC_ADD in blib.h.*/
+
+#ifndef BLIB_METRICS_H
+#define BLIB_METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*Must be a power of two*/
+#ifndef BLIB_METRICS_SHARDS
+#define BLIB_METRICS_SHARDS (8)
+#endif
+
+/*Histogram values below this are exact, larger values are kept with
+  1/BLIB_METRICS_HISTOGRAM_SUB_BUCKETS relative precision.*/
+#define BLIB_METRICS_HISTOGRAM_SUB_BITS (4)
+#define BLIB_METRICS_HISTOGRAM_SUB_BUCKETS (1 << BLIB_METRICS_HISTOGRAM_SUB_BITS)
+#define BLIB_METRICS_HISTOGRAM_BUCKETS\
+	(BLIB_METRICS_HISTOGRAM_SUB_BUCKETS * (65 - BLIB_METRICS_HISTOGRAM_SUB_BITS))
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct {
+	uint64_t value;
+	char padding[64 - sizeof(uint64_t)];
+} metrics_shard;
+
+typedef struct metrics_counter {
+	const char *name;
+	struct metrics_counter *next;
+	metrics_shard shards[BLIB_METRICS_SHARDS];
+} metrics_counter;
+
+typedef struct metrics_gauge {
+	const char *name;
+	struct metrics_gauge *next;
+	int64_t value;
+} metrics_gauge;
+
+typedef struct {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint64_t buckets[BLIB_METRICS_HISTOGRAM_BUCKETS];
+} metrics_histogram_shard;
+
+typedef struct metrics_histogram {
+	const char *name;
+	struct metrics_histogram *next;
+	metrics_histogram_shard *shards; // allocated on registration
+} metrics_histogram;
+
+/*A merged view of a histogram*/
+typedef struct {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+	uint64_t buckets[BLIB_METRICS_HISTOGRAM_BUCKETS];
+} metrics_histogram_snapshot;
+
+#define METRICS_COUNTER_INIT(name) { name, NULL, { { 0, { 0 } } } }
+#define METRICS_GAUGE_INIT(name) { name, NULL, 0 }
+#define METRICS_HISTOGRAM_INIT(name) { name, NULL, NULL }
+
+/*Built in metrics, updated by blib.h, blib_file.h and blib_json.h*/
+extern metrics_counter metrics_file_bytes_read;
+extern metrics_counter metrics_json_nodes;
+extern metrics_counter metrics_list_reallocs;
+
+/*Hands out shards round robin, defined in the BLIB_IMPLEMENTATION unit*/
+extern unsigned metrics_next_shard;
+
+static inline unsigned metrics_shard_index(void) {
+	static __thread unsigned shard = 0;
+	if (shard == 0)
+		shard = __atomic_add_fetch(&metrics_next_shard, 1, __ATOMIC_RELAXED);
+	return shard & (BLIB_METRICS_SHARDS - 1);
+}
+
+static inline void metrics_counter_add(metrics_counter *counter, uint64_t n) {
+	__atomic_fetch_add(&counter->shards[metrics_shard_index()].value, n, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t metrics_counter_value(const metrics_counter *counter) {
+	uint64_t value = 0;
+	for (int i = 0; i < BLIB_METRICS_SHARDS; i++)
+		value += __atomic_load_n(&counter->shards[i].value, __ATOMIC_RELAXED);
+	return value;
+}
+
+static inline void metrics_gauge_set(metrics_gauge *gauge, int64_t value) {
+	__atomic_store_n(&gauge->value, value, __ATOMIC_RELAXED);
+}
+
+static inline void metrics_gauge_add(metrics_gauge *gauge, int64_t n) {
+	__atomic_fetch_add(&gauge->value, n, __ATOMIC_RELAXED);
+}
+
+static inline int64_t metrics_gauge_value(const metrics_gauge *gauge) {
+	return __atomic_load_n(&gauge->value, __ATOMIC_RELAXED);
+}
+
+static inline unsigned metrics_histogram_bucket(uint64_t value) {
+	if (value < BLIB_METRICS_HISTOGRAM_SUB_BUCKETS)
+		return (unsigned)value;
+	unsigned exponent = 63u - (unsigned)__builtin_clzll(value);
+	unsigned shift = exponent - BLIB_METRICS_HISTOGRAM_SUB_BITS;
+	unsigned mantissa = (unsigned)(value >> shift) & (BLIB_METRICS_HISTOGRAM_SUB_BUCKETS - 1);
+	return BLIB_METRICS_HISTOGRAM_SUB_BUCKETS * (shift + 1) + mantissa;
+}
+
+/*Smallest value that lands in "bucket"*/
+static inline uint64_t metrics_histogram_bucket_floor(unsigned bucket) {
+	if (bucket < BLIB_METRICS_HISTOGRAM_SUB_BUCKETS)
+		return bucket;
+	unsigned shift = bucket / BLIB_METRICS_HISTOGRAM_SUB_BUCKETS - 1;
+	uint64_t mantissa = bucket % BLIB_METRICS_HISTOGRAM_SUB_BUCKETS;
+	return (BLIB_METRICS_HISTOGRAM_SUB_BUCKETS + mantissa) << shift;
+}
+
+/*The histogram must have been registered*/
+static inline void metrics_histogram_record(metrics_histogram *histogram, uint64_t value) {
+	metrics_histogram_shard *shard = &histogram->shards[metrics_shard_index()];
+	__atomic_fetch_add(&shard->buckets[metrics_histogram_bucket(value)], 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&shard->count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&shard->sum, value, __ATOMIC_RELAXED);
+	uint64_t min = __atomic_load_n(&shard->min, __ATOMIC_RELAXED);
+	while (value < min && !__atomic_compare_exchange_n(&shard->min, &min, value, 1,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+	uint64_t max = __atomic_load_n(&shard->max, __ATOMIC_RELAXED);
+	while (value > max && !__atomic_compare_exchange_n(&shard->max, &max, value, 1,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED)) {}
+}
+
+/*Adds a metric to the registry that the snapshot functions walk. A metric
+  must be registered once, before it is first used, and stay alive until
+  metrics_free().*/
+void metrics_counter_register(metrics_counter *counter);
+void metrics_gauge_register(metrics_gauge *gauge);
+void metrics_histogram_register(metrics_histogram *histogram);
+
+void metrics_histogram_merge(const metrics_histogram *histogram,
+		metrics_histogram_snapshot *out);
+
+/*Value below which "percentile" (0 to 100) of the recorded values fall,
+  accurate to the bucket precision.*/
+uint64_t metrics_histogram_percentile(const metrics_histogram_snapshot *snapshot,
+		double percentile);
+
+/*Zeroes every registered metric*/
+void metrics_reset(void);
+
+/*Releases histogram shards and empties the registry*/
+void metrics_free(void);
+
+void metrics_write_text(FILE *out);
+void metrics_write_json(FILE *out);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_METRICS_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_METRICS_IMPLEMENTATION_H
+#define BLIB_METRICS_IMPLEMENTATION_H
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+metrics_counter metrics_list_reallocs = METRICS_COUNTER_INIT("blib.list.reallocs");
+metrics_counter metrics_json_nodes = { "blib.json.nodes", &metrics_list_reallocs, { { 0, { 0 } } } };
+metrics_counter metrics_file_bytes_read = { "blib.file.bytes_read", &metrics_json_nodes, { { 0, { 0 } } } };
+unsigned metrics_next_shard = 0;
+
+static struct {
+	pthread_mutex_t mutex;
+	metrics_counter *counters;
+	metrics_gauge *gauges;
+	metrics_histogram *histograms;
+} metrics = { PTHREAD_MUTEX_INITIALIZER, &metrics_file_bytes_read, NULL, NULL };
+
+void metrics_counter_register(metrics_counter *counter) {
+	pthread_mutex_lock(&metrics.mutex);
+	counter->next = metrics.counters;
+	metrics.counters = counter;
+	pthread_mutex_unlock(&metrics.mutex);
+}
+
+void metrics_gauge_register(metrics_gauge *gauge) {
+	pthread_mutex_lock(&metrics.mutex);
+	gauge->next = metrics.gauges;
+	metrics.gauges = gauge;
+	pthread_mutex_unlock(&metrics.mutex);
+}
+
+static void metrics_histogram_clear(metrics_histogram *histogram) {
+	for (int i = 0; i < BLIB_METRICS_SHARDS; i++) {
+		metrics_histogram_shard *shard = &histogram->shards[i];
+		for (int j = 0; j < BLIB_METRICS_HISTOGRAM_BUCKETS; j++)
+			__atomic_store_n(&shard->buckets[j], 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&shard->count, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&shard->sum, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&shard->min, UINT64_MAX, __ATOMIC_RELAXED);
+		__atomic_store_n(&shard->max, 0, __ATOMIC_RELAXED);
+	}
+}
+
+void metrics_histogram_register(metrics_histogram *histogram) {
+	histogram->shards = (metrics_histogram_shard *)malloc(
+			sizeof(metrics_histogram_shard) * BLIB_METRICS_SHARDS);
+	metrics_histogram_clear(histogram);
+	pthread_mutex_lock(&metrics.mutex);
+	histogram->next = metrics.histograms;
+	metrics.histograms = histogram;
+	pthread_mutex_unlock(&metrics.mutex);
+}
+
+void metrics_histogram_merge(const metrics_histogram *histogram,
+		metrics_histogram_snapshot *out) {
+	memset(out, 0, sizeof(metrics_histogram_snapshot));
+	out->min = UINT64_MAX;
+	for (int i = 0; i < BLIB_METRICS_SHARDS; i++) {
+		const metrics_histogram_shard *shard = &histogram->shards[i];
+		for (int j = 0; j < BLIB_METRICS_HISTOGRAM_BUCKETS; j++)
+			out->buckets[j] += __atomic_load_n(&shard->buckets[j], __ATOMIC_RELAXED);
+		out->count += __atomic_load_n(&shard->count, __ATOMIC_RELAXED);
+		out->sum += __atomic_load_n(&shard->sum, __ATOMIC_RELAXED);
+		uint64_t min = __atomic_load_n(&shard->min, __ATOMIC_RELAXED);
+		uint64_t max = __atomic_load_n(&shard->max, __ATOMIC_RELAXED);
+		out->min = min < out->min ? min : out->min;
+		out->max = max > out->max ? max : out->max;
+	}
+	if (out->count == 0)
+		out->min = 0;
+}
+
+uint64_t metrics_histogram_percentile(const metrics_histogram_snapshot *snapshot,
+		double percentile) {
+	if (snapshot->count == 0)
+		return 0;
+	double wanted = percentile / 100.0 * (double)snapshot->count;
+	uint64_t seen = 0;
+	for (unsigned i = 0; i < BLIB_METRICS_HISTOGRAM_BUCKETS; i++) {
+		seen += snapshot->buckets[i];
+		if (seen > 0 && (double)seen >= wanted) {
+			// Report the top of the bucket, clamped to what was really seen.
+			uint64_t top = i + 1 < BLIB_METRICS_HISTOGRAM_BUCKETS ?
+				metrics_histogram_bucket_floor(i + 1) - 1 : UINT64_MAX;
+			top = top > snapshot->max ? snapshot->max : top;
+			return top < snapshot->min ? snapshot->min : top;
+		}
+	}
+	return snapshot->max;
+}
+
+void metrics_reset(void) {
+	pthread_mutex_lock(&metrics.mutex);
+	for (metrics_counter *c = metrics.counters; c; c = c->next)
+		for (int i = 0; i < BLIB_METRICS_SHARDS; i++)
+			__atomic_store_n(&c->shards[i].value, 0, __ATOMIC_RELAXED);
+	for (metrics_gauge *g = metrics.gauges; g; g = g->next)
+		__atomic_store_n(&g->value, 0, __ATOMIC_RELAXED);
+	for (metrics_histogram *h = metrics.histograms; h; h = h->next)
+		metrics_histogram_clear(h);
+	pthread_mutex_unlock(&metrics.mutex);
+}
+
+void metrics_free(void) {
+	pthread_mutex_lock(&metrics.mutex);
+	for (metrics_histogram *h = metrics.histograms; h; h = h->next) {
+		free(h->shards);
+		h->shards = NULL;
+	}
+	metrics.counters = &metrics_file_bytes_read;
+	metrics_list_reallocs.next = NULL;
+	metrics.gauges = NULL;
+	metrics.histograms = NULL;
+	pthread_mutex_unlock(&metrics.mutex);
+}
+
+static const double metrics_percentiles[] = { 50.0, 90.0, 99.0, 99.9 };
+
+void metrics_write_text(FILE *out) {
+	pthread_mutex_lock(&metrics.mutex);
+	for (metrics_counter *c = metrics.counters; c; c = c->next)
+		fprintf(out, "counter   %-32s %llu\n", c->name,
+				(unsigned long long)metrics_counter_value(c));
+	for (metrics_gauge *g = metrics.gauges; g; g = g->next)
+		fprintf(out, "gauge     %-32s %lld\n", g->name, (long long)metrics_gauge_value(g));
+	metrics_histogram_snapshot *s = (metrics_histogram_snapshot *)malloc(sizeof(metrics_histogram_snapshot));
+	for (metrics_histogram *h = metrics.histograms; h; h = h->next) {
+		metrics_histogram_merge(h, s);
+		fprintf(out, "histogram %-32s count=%llu min=%llu mean=%.1f", h->name,
+				(unsigned long long)s->count, (unsigned long long)s->min,
+				s->count ? (double)s->sum / (double)s->count : 0.0);
+		for (size_t i = 0; i < sizeof(metrics_percentiles) / sizeof(double); i++)
+			fprintf(out, " p%g=%llu", metrics_percentiles[i],
+					(unsigned long long)metrics_histogram_percentile(s, metrics_percentiles[i]));
+		fprintf(out, " max=%llu\n", (unsigned long long)s->max);
+	}
+	free(s);
+	pthread_mutex_unlock(&metrics.mutex);
+}
+
+/*Metric names are written as they are, keep them free of quotes and
+  backslashes.*/
+void metrics_write_json(FILE *out) {
+	pthread_mutex_lock(&metrics.mutex);
+	fputs("{\"counters\":{", out);
+	for (metrics_counter *c = metrics.counters; c; c = c->next)
+		fprintf(out, "%s\"%s\":%llu", c == metrics.counters ? "" : ",", c->name,
+				(unsigned long long)metrics_counter_value(c));
+	fputs("},\"gauges\":{", out);
+	for (metrics_gauge *g = metrics.gauges; g; g = g->next)
+		fprintf(out, "%s\"%s\":%lld", g == metrics.gauges ? "" : ",", g->name,
+				(long long)metrics_gauge_value(g));
+	fputs("},\"histograms\":{", out);
+	metrics_histogram_snapshot *s = (metrics_histogram_snapshot *)malloc(sizeof(metrics_histogram_snapshot));
+	for (metrics_histogram *h = metrics.histograms; h; h = h->next) {
+		metrics_histogram_merge(h, s);
+		fprintf(out, "%s\"%s\":{\"count\":%llu,\"sum\":%llu,\"min\":%llu,\"max\":%llu",
+				h == metrics.histograms ? "" : ",", h->name,
+				(unsigned long long)s->count, (unsigned long long)s->sum,
+				(unsigned long long)s->min, (unsigned long long)s->max);
+		for (size_t i = 0; i < sizeof(metrics_percentiles) / sizeof(double); i++)
+			fprintf(out, ",\"p%g\":%llu", metrics_percentiles[i],
+					(unsigned long long)metrics_histogram_percentile(s, metrics_percentiles[i]));
+		fputc('}', out);
+	}
+	free(s);
+	fputs("}}\n", out);
+	pthread_mutex_unlock(&metrics.mutex);
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_METRICS_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
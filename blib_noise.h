@@ -0,0 +1,963 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Batch noise evaluation.
+
+  noise3_fbm_grid() and noise3_fbm_points() evaluate 8 samples at once with
+  AVX2, or 4 with SSE4.1, picked at run time. Their output is bit for bit
+  identical to noise3_fbm_reference(), the scalar definition below, as long
+  as the compiler does not contract a * b + c into fused multiply-adds
+  (-std=c99 turns contraction off, -std=gnu99 with -mfma does not).
+
+  The reference keeps the shape of noise3_fbm() from blib_math.h: value
+  noise on the integer lattice, 16 octaves, persistence 0.5. It swaps the
+  parts that cannot be vectorized exactly. The lattice hash is integer
+  arithmetic instead of sinf(), and cosine interpolation becomes the cubic
+  smoothstep, which stays within 1% of it.*/
+
+#ifndef BLIB_NOISE_H
+#define BLIB_NOISE_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "blib_math3d.h"
+
+#define BLIB_NOISE_FBM_OCTAVES (16)
+
+/*Bring the gradient noise functions to about [-1, 1]*/
+#define BLIB_NOISE2_PERLIN_SCALE (1.0f)
+#define BLIB_NOISE3_PERLIN_SCALE (1.0f)
+#define BLIB_NOISE4_PERLIN_SCALE (0.84f)
+#define BLIB_NOISE2_SIMPLEX_SCALE (70.0f)
+#define BLIB_NOISE3_SIMPLEX_SCALE (76.0f)
+#define BLIB_NOISE4_SIMPLEX_SCALE (62.0f)
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/*Truncates like the x86 SIMD conversion: values outside the int32 range
+  (and NaN) map to INT32_MIN instead of being undefined.*/
+static inline int32_t noise_float_to_int(float f) {
+	if (f >= -2147483648.0f && f < 2147483648.0f)
+		return (int32_t)f;
+	return INT32_MIN;
+}
+
+/*Scrambles the bits of a combined lattice coordinate*/
+static inline uint32_t noise_mix(uint32_t h) {
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return h;
+}
+
+static inline uint32_t noise_hash2(int32_t x, int32_t y) {
+	return noise_mix(((uint32_t)x * 0x8da6b343u) ^ ((uint32_t)y * 0xd8163841u));
+}
+
+static inline uint32_t noise_hash3(int32_t x, int32_t y, int32_t z) {
+	return noise_mix(((uint32_t)x * 0x8da6b343u) ^ ((uint32_t)y * 0xd8163841u) ^
+			((uint32_t)z * 0xcb1ab31fu));
+}
+
+static inline uint32_t noise_hash4(int32_t x, int32_t y, int32_t z, int32_t w) {
+	return noise_mix(((uint32_t)x * 0x8da6b343u) ^ ((uint32_t)y * 0xd8163841u) ^
+			((uint32_t)z * 0xcb1ab31fu) ^ ((uint32_t)w * 0x9e3779b1u));
+}
+
+/*Hashes a lattice point to a value in [0, 1)*/
+static inline float noise3_hash(int32_t x, int32_t y, int32_t z) {
+	return (float)(int32_t)(noise_hash3(x, y, z) >> 8) * (1.0f / 16777216.0f);
+}
+
+static inline float noise_smoothstep(float t) { return t * t * (3.0f - 2.0f * t); }
+
+static inline float noise_lerp(float a, float b, float t) { return a + (b - a) * t; }
+
+/*Trilinear value noise with smoothstep weights, range [0, 1)*/
+static inline float noise3_value_reference(float x, float y, float z) {
+	float floorX = floorf(x), floorY = floorf(y), floorZ = floorf(z);
+	float sx = noise_smoothstep(x - floorX),
+	      sy = noise_smoothstep(y - floorY),
+	      sz = noise_smoothstep(z - floorZ);
+	int32_t x0 = noise_float_to_int(floorX),
+	        y0 = noise_float_to_int(floorY),
+	        z0 = noise_float_to_int(floorZ);
+	int32_t x1 = (int32_t)((uint32_t)x0 + 1u),
+	        y1 = (int32_t)((uint32_t)y0 + 1u),
+	        z1 = (int32_t)((uint32_t)z0 + 1u);
+
+	float e1 = noise_lerp(noise3_hash(x0, y0, z0), noise3_hash(x1, y0, z0), sx),
+	      e2 = noise_lerp(noise3_hash(x0, y1, z0), noise3_hash(x1, y1, z0), sx),
+	      e3 = noise_lerp(noise3_hash(x0, y0, z1), noise3_hash(x1, y0, z1), sx),
+	      e4 = noise_lerp(noise3_hash(x0, y1, z1), noise3_hash(x1, y1, z1), sx),
+	      f1 = noise_lerp(e1, e2, sy),
+	      f2 = noise_lerp(e3, e4, sy);
+	return noise_lerp(f1, f2, sz);
+}
+
+/*The scalar definition of every batch function in this file*/
+static inline float noise3_fbm_reference(float x, float y, float z) {
+	float total = 0.0f;
+	float freq = 1.0f;
+	float amplitude = 1.0f;
+	for (int i = 0; i < BLIB_NOISE_FBM_OCTAVES; i++) {
+		total = total + noise3_value_reference(x * freq, y * freq, z * freq) * amplitude;
+		freq *= 2.0f;
+		amplitude *= 0.5f;
+	}
+	return total;
+}
+
+/*Integer-hash noise family.
+
+  Value noise interpolates random lattice values, Perlin noise
+  interpolates random gradients, and simplex noise sums gradient
+  contributions over the corners of a simplex instead of a cube. That
+  means 3, 4 and 5 corners in 2D, 3D and 4D rather than 4, 8 and 16.
+  All of them:
+  - hash integer lattice coordinates, so there is no sinf() and no loss
+    of precision until the coordinates leave the int32 range
+  - use the quintic fade 6t^5 - 15t^4 + 10t^3, which has continuous
+    second derivatives
+  - return values in about [-1, 1]*/
+
+static inline int32_t noise_floor(float f, float *fraction_out) {
+	float floored = floorf(f);
+	*fraction_out = f - floored;
+	return noise_float_to_int(floored);
+}
+
+static inline float noise_fade(float t) { return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f); }
+
+/*Maps a hash to [-1, 1)*/
+static inline float noise_signed(uint32_t h) {
+	return (float)(int32_t)(h >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+static inline int32_t noise_next(int32_t i) { return (int32_t)((uint32_t)i + 1u); }
+
+/*Gradient tables, picked with the low bits of a hash. Table lookups keep
+  the inner loops free of unpredictable branches.*/
+static const float noise_gradients2[8][2] = {
+	{ 1, 1 }, { -1, 1 }, { 1, -1 }, { -1, -1 }, { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 },
+};
+
+/*The 12 cube edge directions of improved Perlin noise, 4 of them twice*/
+static const float noise_gradients3[16][3] = {
+	{ 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+	{ 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+	{ 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 },
+	{ 1, 1, 0 }, { 0, -1, 1 }, { -1, 1, 0 }, { 0, -1, -1 },
+};
+
+/*The 32 edge directions of a 4D hypercube*/
+static const float noise_gradients4[32][4] = {
+	{ 0, 1, 1, 1 }, { 0, 1, 1, -1 }, { 0, 1, -1, 1 }, { 0, 1, -1, -1 },
+	{ 0, -1, 1, 1 }, { 0, -1, 1, -1 }, { 0, -1, -1, 1 }, { 0, -1, -1, -1 },
+	{ 1, 0, 1, 1 }, { 1, 0, 1, -1 }, { 1, 0, -1, 1 }, { 1, 0, -1, -1 },
+	{ -1, 0, 1, 1 }, { -1, 0, 1, -1 }, { -1, 0, -1, 1 }, { -1, 0, -1, -1 },
+	{ 1, 1, 0, 1 }, { 1, 1, 0, -1 }, { 1, -1, 0, 1 }, { 1, -1, 0, -1 },
+	{ -1, 1, 0, 1 }, { -1, 1, 0, -1 }, { -1, -1, 0, 1 }, { -1, -1, 0, -1 },
+	{ 1, 1, 1, 0 }, { 1, 1, -1, 0 }, { 1, -1, 1, 0 }, { 1, -1, -1, 0 },
+	{ -1, 1, 1, 0 }, { -1, 1, -1, 0 }, { -1, -1, 1, 0 }, { -1, -1, -1, 0 },
+};
+
+static inline float noise_grad2(uint32_t h, float x, float y) {
+	const float *g = noise_gradients2[h & 7];
+	return g[0] * x + g[1] * y;
+}
+
+static inline float noise_grad3(uint32_t h, float x, float y, float z) {
+	const float *g = noise_gradients3[h & 15];
+	return g[0] * x + g[1] * y + g[2] * z;
+}
+
+static inline float noise_grad4(uint32_t h, float x, float y, float z, float w) {
+	const float *g = noise_gradients4[h & 31];
+	return g[0] * x + g[1] * y + g[2] * z + g[3] * w;
+}
+
+static inline float noise2_value(float x, float y) {
+	float fx, fy;
+	int32_t x0 = noise_floor(x, &fx), y0 = noise_floor(y, &fy);
+	int32_t x1 = noise_next(x0), y1 = noise_next(y0);
+	float u = noise_fade(fx), v = noise_fade(fy);
+	return noise_lerp(
+			noise_lerp(noise_signed(noise_hash2(x0, y0)), noise_signed(noise_hash2(x1, y0)), u),
+			noise_lerp(noise_signed(noise_hash2(x0, y1)), noise_signed(noise_hash2(x1, y1)), u), v);
+}
+
+static inline float noise3_value(float x, float y, float z) {
+	float fx, fy, fz;
+	int32_t x0 = noise_floor(x, &fx), y0 = noise_floor(y, &fy), z0 = noise_floor(z, &fz);
+	int32_t x1 = noise_next(x0), y1 = noise_next(y0), z1 = noise_next(z0);
+	float u = noise_fade(fx), v = noise_fade(fy), w = noise_fade(fz);
+	float e1 = noise_lerp(noise_signed(noise_hash3(x0, y0, z0)), noise_signed(noise_hash3(x1, y0, z0)), u),
+	      e2 = noise_lerp(noise_signed(noise_hash3(x0, y1, z0)), noise_signed(noise_hash3(x1, y1, z0)), u),
+	      e3 = noise_lerp(noise_signed(noise_hash3(x0, y0, z1)), noise_signed(noise_hash3(x1, y0, z1)), u),
+	      e4 = noise_lerp(noise_signed(noise_hash3(x0, y1, z1)), noise_signed(noise_hash3(x1, y1, z1)), u);
+	return noise_lerp(noise_lerp(e1, e2, v), noise_lerp(e3, e4, v), w);
+}
+
+static inline float noise4_value(float x, float y, float z, float w) {
+	float fx, fy, fz, fw;
+	int32_t x0 = noise_floor(x, &fx), y0 = noise_floor(y, &fy),
+	        z0 = noise_floor(z, &fz), w0 = noise_floor(w, &fw);
+	float u = noise_fade(fx), v = noise_fade(fy), s = noise_fade(fz), t = noise_fade(fw);
+	float edges[8];
+	for (int i = 0; i < 8; i++) {
+		int32_t yi = i & 1 ? noise_next(y0) : y0;
+		int32_t zi = i & 2 ? noise_next(z0) : z0;
+		int32_t wi = i & 4 ? noise_next(w0) : w0;
+		edges[i] = noise_lerp(noise_signed(noise_hash4(x0, yi, zi, wi)),
+				noise_signed(noise_hash4(noise_next(x0), yi, zi, wi)), u);
+	}
+	float f1 = noise_lerp(noise_lerp(edges[0], edges[1], v), noise_lerp(edges[2], edges[3], v), s);
+	float f2 = noise_lerp(noise_lerp(edges[4], edges[5], v), noise_lerp(edges[6], edges[7], v), s);
+	return noise_lerp(f1, f2, t);
+}
+
+static inline float noise2_perlin(float x, float y) {
+	float fx, fy;
+	int32_t x0 = noise_floor(x, &fx), y0 = noise_floor(y, &fy);
+	int32_t x1 = noise_next(x0), y1 = noise_next(y0);
+	float u = noise_fade(fx), v = noise_fade(fy);
+	float n = noise_lerp(
+			noise_lerp(noise_grad2(noise_hash2(x0, y0), fx, fy),
+				noise_grad2(noise_hash2(x1, y0), fx - 1.0f, fy), u),
+			noise_lerp(noise_grad2(noise_hash2(x0, y1), fx, fy - 1.0f),
+				noise_grad2(noise_hash2(x1, y1), fx - 1.0f, fy - 1.0f), u), v);
+	return n * BLIB_NOISE2_PERLIN_SCALE;
+}
+
+static inline float noise3_perlin(float x, float y, float z) {
+	float fx, fy, fz;
+	int32_t x0 = noise_floor(x, &fx), y0 = noise_floor(y, &fy), z0 = noise_floor(z, &fz);
+	int32_t x1 = noise_next(x0), y1 = noise_next(y0), z1 = noise_next(z0);
+	float u = noise_fade(fx), v = noise_fade(fy), w = noise_fade(fz);
+	float e1 = noise_lerp(noise_grad3(noise_hash3(x0, y0, z0), fx, fy, fz),
+			noise_grad3(noise_hash3(x1, y0, z0), fx - 1.0f, fy, fz), u),
+	      e2 = noise_lerp(noise_grad3(noise_hash3(x0, y1, z0), fx, fy - 1.0f, fz),
+			noise_grad3(noise_hash3(x1, y1, z0), fx - 1.0f, fy - 1.0f, fz), u),
+	      e3 = noise_lerp(noise_grad3(noise_hash3(x0, y0, z1), fx, fy, fz - 1.0f),
+			noise_grad3(noise_hash3(x1, y0, z1), fx - 1.0f, fy, fz - 1.0f), u),
+	      e4 = noise_lerp(noise_grad3(noise_hash3(x0, y1, z1), fx, fy - 1.0f, fz - 1.0f),
+			noise_grad3(noise_hash3(x1, y1, z1), fx - 1.0f, fy - 1.0f, fz - 1.0f), u);
+	return noise_lerp(noise_lerp(e1, e2, v), noise_lerp(e3, e4, v), w) * BLIB_NOISE3_PERLIN_SCALE;
+}
+
+static inline float noise4_perlin(float x, float y, float z, float w) {
+	float fx, fy, fz, fw;
+	int32_t x0 = noise_floor(x, &fx), y0 = noise_floor(y, &fy),
+	        z0 = noise_floor(z, &fz), w0 = noise_floor(w, &fw);
+	float u = noise_fade(fx), v = noise_fade(fy), s = noise_fade(fz), t = noise_fade(fw);
+	float edges[8];
+	for (int i = 0; i < 8; i++) {
+		int32_t yi = i & 1 ? noise_next(y0) : y0;
+		int32_t zi = i & 2 ? noise_next(z0) : z0;
+		int32_t wi = i & 4 ? noise_next(w0) : w0;
+		float dy = i & 1 ? fy - 1.0f : fy;
+		float dz = i & 2 ? fz - 1.0f : fz;
+		float dw = i & 4 ? fw - 1.0f : fw;
+		edges[i] = noise_lerp(noise_grad4(noise_hash4(x0, yi, zi, wi), fx, dy, dz, dw),
+				noise_grad4(noise_hash4(noise_next(x0), yi, zi, wi), fx - 1.0f, dy, dz, dw), u);
+	}
+	float f1 = noise_lerp(noise_lerp(edges[0], edges[1], v), noise_lerp(edges[2], edges[3], v), s);
+	float f2 = noise_lerp(noise_lerp(edges[4], edges[5], v), noise_lerp(edges[6], edges[7], v), s);
+	return noise_lerp(f1, f2, t) * BLIB_NOISE4_PERLIN_SCALE;
+}
+
+/*Weight of a simplex corner at squared distance "d2" from the sample, for
+  a kernel of squared radius "r2"*/
+static inline float noise_simplex_falloff(float r2, float d2) {
+	float t = fmaxf(r2 - d2, 0.0f);
+	t *= t;
+	return t * t;
+}
+
+static inline int32_t noise_offset(int32_t i, int32_t d) { return (int32_t)((uint32_t)i + (uint32_t)d); }
+
+static inline float noise2_simplex(float x, float y) {
+	const float F2 = 0.366025403784f; // (sqrt(3) - 1) / 2
+	const float G2 = 0.211324865405f; // (3 - sqrt(3)) / 6
+	float s = (x + y) * F2;
+	float fi = floorf(x + s), fj = floorf(y + s);
+	int32_t i = noise_float_to_int(fi), j = noise_float_to_int(fj);
+	float t = (fi + fj) * G2;
+	float x0 = x - (fi - t), y0 = y - (fj - t);
+	int32_t i1 = x0 > y0, j1 = !i1;
+	float x1 = x0 - (float)i1 + G2, y1 = y0 - (float)j1 + G2;
+	float x2 = x0 - 1.0f + 2.0f * G2, y2 = y0 - 1.0f + 2.0f * G2;
+	float n =
+		noise_simplex_falloff(0.5f, x0 * x0 + y0 * y0) *
+			noise_grad2(noise_hash2(i, j), x0, y0) +
+		noise_simplex_falloff(0.5f, x1 * x1 + y1 * y1) *
+			noise_grad2(noise_hash2(noise_offset(i, i1), noise_offset(j, j1)), x1, y1) +
+		noise_simplex_falloff(0.5f, x2 * x2 + y2 * y2) *
+			noise_grad2(noise_hash2(noise_next(i), noise_next(j)), x2, y2);
+	return n * BLIB_NOISE2_SIMPLEX_SCALE;
+}
+
+static inline float noise3_simplex(float x, float y, float z) {
+	const float F3 = 1.0f / 3.0f;
+	const float G3 = 1.0f / 6.0f;
+	float s = (x + y + z) * F3;
+	float fi = floorf(x + s), fj = floorf(y + s), fk = floorf(z + s);
+	int32_t i = noise_float_to_int(fi), j = noise_float_to_int(fj), k = noise_float_to_int(fk);
+	float t = (fi + fj + fk) * G3;
+	float x0 = x - (fi - t), y0 = y - (fj - t), z0 = z - (fk - t);
+
+	// Which of the six simplices of the skewed cube holds the sample.
+	int32_t i1, j1, k1, i2, j2, k2;
+	if (x0 >= y0) {
+		if (y0 >= z0)      { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+		else if (x0 >= z0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1; }
+		else               { i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1; }
+	} else {
+		if (y0 < z0)       { i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1; }
+		else if (x0 < z0)  { i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1; }
+		else               { i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+	}
+	float x1 = x0 - (float)i1 + G3, y1 = y0 - (float)j1 + G3, z1 = z0 - (float)k1 + G3;
+	float x2 = x0 - (float)i2 + 2.0f * G3, y2 = y0 - (float)j2 + 2.0f * G3, z2 = z0 - (float)k2 + 2.0f * G3;
+	float x3 = x0 - 1.0f + 3.0f * G3, y3 = y0 - 1.0f + 3.0f * G3, z3 = z0 - 1.0f + 3.0f * G3;
+	float n =
+		noise_simplex_falloff(0.5f, x0 * x0 + y0 * y0 + z0 * z0) *
+			noise_grad3(noise_hash3(i, j, k), x0, y0, z0) +
+		noise_simplex_falloff(0.5f, x1 * x1 + y1 * y1 + z1 * z1) *
+			noise_grad3(noise_hash3(noise_offset(i, i1), noise_offset(j, j1), noise_offset(k, k1)), x1, y1, z1) +
+		noise_simplex_falloff(0.5f, x2 * x2 + y2 * y2 + z2 * z2) *
+			noise_grad3(noise_hash3(noise_offset(i, i2), noise_offset(j, j2), noise_offset(k, k2)), x2, y2, z2) +
+		noise_simplex_falloff(0.5f, x3 * x3 + y3 * y3 + z3 * z3) *
+			noise_grad3(noise_hash3(noise_next(i), noise_next(j), noise_next(k)), x3, y3, z3);
+	return n * BLIB_NOISE3_SIMPLEX_SCALE;
+}
+
+static inline float noise4_simplex(float x, float y, float z, float w) {
+	const float F4 = 0.309016994375f; // (sqrt(5) - 1) / 4
+	const float G4 = 0.138196601125f; // (5 - sqrt(5)) / 20
+	float s = (x + y + z + w) * F4;
+	float fi = floorf(x + s), fj = floorf(y + s), fk = floorf(z + s), fl = floorf(w + s);
+	int32_t cell[4] = {
+		noise_float_to_int(fi), noise_float_to_int(fj),
+		noise_float_to_int(fk), noise_float_to_int(fl)
+	};
+	float t = (fi + fj + fk + fl) * G4;
+	float d[4] = { x - (fi - t), y - (fj - t), z - (fk - t), w - (fl - t) };
+
+	// Rank the offsets, the simplex walks the largest axis first.
+	int rank[4] = { 0, 0, 0, 0 };
+	for (int a = 0; a < 4; a++)
+		for (int b = a + 1; b < 4; b++)
+			rank[d[a] > d[b] ? a : b]++;
+
+	float n = 0.0f;
+	for (int corner = 0; corner < 5; corner++) {
+		int32_t c[4];
+		float o[4];
+		for (int a = 0; a < 4; a++) {
+			int32_t step = rank[a] >= 4 - corner;
+			c[a] = noise_offset(cell[a], step);
+			o[a] = d[a] - (float)step + (float)corner * G4;
+		}
+		float d2 = o[0] * o[0] + o[1] * o[1] + o[2] * o[2] + o[3] * o[3];
+		n += noise_simplex_falloff(0.5f, d2) *
+			noise_grad4(noise_hash4(c[0], c[1], c[2], c[3]), o[0], o[1], o[2], o[3]);
+	}
+	return n * BLIB_NOISE4_SIMPLEX_SCALE;
+}
+
+typedef float (*noise3_function)(float x, float y, float z);
+
+/*noise3_fbm() with any of the 3D functions above as the basis. Each octave
+  is remapped to [0, 1] first, so the result covers the same [0, 2) range
+  as noise3_fbm() and can replace it directly.*/
+static inline float noise3_fbm_of(noise3_function noise, float x, float y, float z) {
+	float total = 0.0f;
+	float freq = 1.0f;
+	float amplitude = 1.0f;
+	for (int i = 0; i < BLIB_NOISE_FBM_OCTAVES; i++) {
+		total += (noise(x * freq, y * freq, z * freq) * 0.5f + 0.5f) * amplitude;
+		freq *= 2.0f;
+		amplitude *= 0.5f;
+	}
+	return total;
+}
+
+/*noise3_fbm_warped() built on noise3_fbm_of()*/
+static inline float noise3_fbm_warped_of(noise3_function noise, float x, float y, float z,
+		float warpFactor) {
+	float fbm1 = noise3_fbm_of(noise, x, y, z);
+	float fbm2 = noise3_fbm_of(noise, x + 5.2f, y + 1.3f * warpFactor, z + 6.4f * warpFactor);
+	float fbm3 = noise3_fbm_of(noise, x + 7.5f, y + 0.3f * warpFactor, z + 3.6f * warpFactor);
+	return noise3_fbm_of(noise, fbm1, fbm2, fbm3);
+}
+
+/*Configurable fbm.
+
+  noise_fbm_params_make() computes the frequency and amplitude of every
+  octave once, so sampling needs no pow() calls. Octaves whose amplitude
+  falls below "min_amplitude" are dropped up front. That is the early exit,
+  decided once instead of per sample.
+
+  These functions sum the signed basis functions, so the result lies in
+  about [-sum, sum] where "sum" is the sum of amplitudes. noise3_fbm_of()
+  equals 0.5 * noise3_fbm_params() + 0.5 * sum for the default parameters
+  (16 octaves, lacunarity 2, persistence 0.5).*/
+
+#define BLIB_NOISE_MAX_OCTAVES (32)
+
+typedef struct {
+	int octaves;
+	float frequencies[BLIB_NOISE_MAX_OCTAVES];
+	float amplitudes[BLIB_NOISE_MAX_OCTAVES];
+	float amplitude_sum;
+} noise_fbm_params;
+
+static inline noise_fbm_params noise_fbm_params_make(int octaves, float lacunarity,
+		float persistence, float min_amplitude) {
+	noise_fbm_params params;
+	octaves = octaves < BLIB_NOISE_MAX_OCTAVES ? octaves : BLIB_NOISE_MAX_OCTAVES;
+	float freq = 1.0f;
+	float amplitude = 1.0f;
+	params.octaves = 0;
+	params.amplitude_sum = 0.0f;
+	for (int i = 0; i < octaves && amplitude >= min_amplitude; i++) {
+		params.frequencies[i] = freq;
+		params.amplitudes[i] = amplitude;
+		params.amplitude_sum += amplitude;
+		params.octaves++;
+		freq *= lacunarity;
+		amplitude *= persistence;
+	}
+	return params;
+}
+
+typedef float (*noise2_function)(float x, float y);
+
+/*A basis function that also writes its gradient*/
+typedef float (*noise2_derivative_function)(float x, float y, vector2_t *gradient);
+typedef float (*noise3_derivative_function)(float x, float y, float z, vector3_t *gradient);
+
+static inline float noise2_fbm_params(const noise_fbm_params *params, noise2_function noise,
+		float x, float y) {
+	float total = 0.0f;
+	for (int i = 0; i < params->octaves; i++) {
+		float freq = params->frequencies[i];
+		total += noise(x * freq, y * freq) * params->amplitudes[i];
+	}
+	return total;
+}
+
+static inline float noise3_fbm_params(const noise_fbm_params *params, noise3_function noise,
+		float x, float y, float z) {
+	float total = 0.0f;
+	for (int i = 0; i < params->octaves; i++) {
+		float freq = params->frequencies[i];
+		total += noise(x * freq, y * freq, z * freq) * params->amplitudes[i];
+	}
+	return total;
+}
+
+/*Bilinear interpolation of corners c[x + 2y], with the partial
+  derivatives by u and v in d*/
+static inline float noise_bilinear(const float c[4], float u, float v, float d[2]) {
+	float k1 = c[1] - c[0], k2 = c[2] - c[0], k3 = c[0] - c[1] - c[2] + c[3];
+	d[0] = k1 + k3 * v;
+	d[1] = k2 + k3 * u;
+	return c[0] + k1 * u + k2 * v + k3 * u * v;
+}
+
+/*Trilinear interpolation of corners c[x + 2y + 4z], with the partial
+  derivatives by u, v and w in d*/
+static inline float noise_trilinear(const float c[8], float u, float v, float w, float d[3]) {
+	float k1 = c[1] - c[0], k2 = c[2] - c[0], k3 = c[4] - c[0];
+	float k4 = c[0] - c[1] - c[2] + c[3];
+	float k5 = c[0] - c[2] - c[4] + c[6];
+	float k6 = c[0] - c[1] - c[4] + c[5];
+	float k7 = -c[0] + c[1] + c[2] - c[3] + c[4] - c[5] - c[6] + c[7];
+	d[0] = k1 + k4 * v + k6 * w + k7 * v * w;
+	d[1] = k2 + k4 * u + k5 * w + k7 * u * w;
+	d[2] = k3 + k5 * v + k6 * u + k7 * u * v;
+	return c[0] + k1 * u + k2 * v + k3 * w + k4 * u * v + k5 * v * w + k6 * w * u + k7 * u * v * w;
+}
+
+/*Derivative of noise_fade()*/
+static inline float noise_fade_derivative(float t) {
+	float s = t * (t - 1.0f);
+	return 30.0f * s * s;
+}
+
+static inline float noise2_value_derivative(float x, float y, vector2_t *gradient) {
+	float fx, fy, c[4], d[2];
+	int32_t x0 = noise_floor(x, &fx), y0 = noise_floor(y, &fy);
+	for (int i = 0; i < 4; i++)
+		c[i] = noise_signed(noise_hash2(i & 1 ? noise_next(x0) : x0, i & 2 ? noise_next(y0) : y0));
+	float n = noise_bilinear(c, noise_fade(fx), noise_fade(fy), d);
+	gradient->x = d[0] * noise_fade_derivative(fx);
+	gradient->y = d[1] * noise_fade_derivative(fy);
+	return n;
+}
+
+static inline float noise3_value_derivative(float x, float y, float z, vector3_t *gradient) {
+	float fx, fy, fz, c[8], d[3];
+	int32_t x0 = noise_floor(x, &fx), y0 = noise_floor(y, &fy), z0 = noise_floor(z, &fz);
+	for (int i = 0; i < 8; i++)
+		c[i] = noise_signed(noise_hash3(i & 1 ? noise_next(x0) : x0,
+					i & 2 ? noise_next(y0) : y0, i & 4 ? noise_next(z0) : z0));
+	float n = noise_trilinear(c, noise_fade(fx), noise_fade(fy), noise_fade(fz), d);
+	gradient->x = d[0] * noise_fade_derivative(fx);
+	gradient->y = d[1] * noise_fade_derivative(fy);
+	gradient->z = d[2] * noise_fade_derivative(fz);
+	return n;
+}
+
+static inline float noise2_perlin_derivative(float x, float y, vector2_t *gradient) {
+	float fx, fy, dots[4], gx[4], gy[4], d[2], unused[2];
+	int32_t x0 = noise_floor(x, &fx), y0 = noise_floor(y, &fy);
+	for (int i = 0; i < 4; i++) {
+		float ox = i & 1 ? fx - 1.0f : fx, oy = i & 2 ? fy - 1.0f : fy;
+		const float *g = noise_gradients2[noise_hash2(i & 1 ? noise_next(x0) : x0,
+				i & 2 ? noise_next(y0) : y0) & 7];
+		gx[i] = g[0];
+		gy[i] = g[1];
+		dots[i] = g[0] * ox + g[1] * oy;
+	}
+	float u = noise_fade(fx), v = noise_fade(fy);
+	float n = noise_bilinear(dots, u, v, d);
+	gradient->x = (noise_bilinear(gx, u, v, unused) + d[0] * noise_fade_derivative(fx)) * BLIB_NOISE2_PERLIN_SCALE;
+	gradient->y = (noise_bilinear(gy, u, v, unused) + d[1] * noise_fade_derivative(fy)) * BLIB_NOISE2_PERLIN_SCALE;
+	return n * BLIB_NOISE2_PERLIN_SCALE;
+}
+
+static inline float noise3_perlin_derivative(float x, float y, float z, vector3_t *gradient) {
+	float fx, fy, fz, dots[8], gx[8], gy[8], gz[8], d[3], unused[3];
+	int32_t x0 = noise_floor(x, &fx), y0 = noise_floor(y, &fy), z0 = noise_floor(z, &fz);
+	for (int i = 0; i < 8; i++) {
+		float ox = i & 1 ? fx - 1.0f : fx, oy = i & 2 ? fy - 1.0f : fy, oz = i & 4 ? fz - 1.0f : fz;
+		const float *g = noise_gradients3[noise_hash3(i & 1 ? noise_next(x0) : x0,
+				i & 2 ? noise_next(y0) : y0, i & 4 ? noise_next(z0) : z0) & 15];
+		gx[i] = g[0];
+		gy[i] = g[1];
+		gz[i] = g[2];
+		dots[i] = g[0] * ox + g[1] * oy + g[2] * oz;
+	}
+	float u = noise_fade(fx), v = noise_fade(fy), w = noise_fade(fz);
+	float n = noise_trilinear(dots, u, v, w, d);
+	gradient->x = (noise_trilinear(gx, u, v, w, unused) + d[0] * noise_fade_derivative(fx)) * BLIB_NOISE3_PERLIN_SCALE;
+	gradient->y = (noise_trilinear(gy, u, v, w, unused) + d[1] * noise_fade_derivative(fy)) * BLIB_NOISE3_PERLIN_SCALE;
+	gradient->z = (noise_trilinear(gz, u, v, w, unused) + d[2] * noise_fade_derivative(fz)) * BLIB_NOISE3_PERLIN_SCALE;
+	return n * BLIB_NOISE3_PERLIN_SCALE;
+}
+
+static inline float noise2_simplex_derivative(float x, float y, vector2_t *gradient) {
+	const float F2 = 0.366025403784f;
+	const float G2 = 0.211324865405f;
+	float s = (x + y) * F2;
+	float fi = floorf(x + s), fj = floorf(y + s);
+	int32_t i = noise_float_to_int(fi), j = noise_float_to_int(fj);
+	float t = (fi + fj) * G2;
+	float x0 = x - (fi - t), y0 = y - (fj - t);
+	int32_t i1 = x0 > y0, j1 = !i1;
+	float ox[3] = { x0, x0 - (float)i1 + G2, x0 - 1.0f + 2.0f * G2 };
+	float oy[3] = { y0, y0 - (float)j1 + G2, y0 - 1.0f + 2.0f * G2 };
+	uint32_t h[3] = {
+		noise_hash2(i, j),
+		noise_hash2(noise_offset(i, i1), noise_offset(j, j1)),
+		noise_hash2(noise_next(i), noise_next(j)),
+	};
+	float n = 0.0f, dx = 0.0f, dy = 0.0f;
+	for (int c = 0; c < 3; c++) {
+		const float *g = noise_gradients2[h[c] & 7];
+		float r = fmaxf(0.5f - ox[c] * ox[c] - oy[c] * oy[c], 0.0f);
+		float r2 = r * r, r4 = r2 * r2;
+		float dot = g[0] * ox[c] + g[1] * oy[c];
+		n += r4 * dot;
+		dx += r4 * g[0] - 8.0f * r2 * r * dot * ox[c];
+		dy += r4 * g[1] - 8.0f * r2 * r * dot * oy[c];
+	}
+	gradient->x = dx * BLIB_NOISE2_SIMPLEX_SCALE;
+	gradient->y = dy * BLIB_NOISE2_SIMPLEX_SCALE;
+	return n * BLIB_NOISE2_SIMPLEX_SCALE;
+}
+
+static inline float noise3_simplex_derivative(float x, float y, float z, vector3_t *gradient) {
+	const float F3 = 1.0f / 3.0f;
+	const float G3 = 1.0f / 6.0f;
+	float s = (x + y + z) * F3;
+	float fi = floorf(x + s), fj = floorf(y + s), fk = floorf(z + s);
+	int32_t i = noise_float_to_int(fi), j = noise_float_to_int(fj), k = noise_float_to_int(fk);
+	float t = (fi + fj + fk) * G3;
+	float x0 = x - (fi - t), y0 = y - (fj - t), z0 = z - (fk - t);
+	int32_t i1, j1, k1, i2, j2, k2;
+	if (x0 >= y0) {
+		if (y0 >= z0)      { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+		else if (x0 >= z0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1; }
+		else               { i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1; }
+	} else {
+		if (y0 < z0)       { i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1; }
+		else if (x0 < z0)  { i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1; }
+		else               { i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+	}
+	float ox[4] = { x0, x0 - (float)i1 + G3, x0 - (float)i2 + 2.0f * G3, x0 - 1.0f + 3.0f * G3 };
+	float oy[4] = { y0, y0 - (float)j1 + G3, y0 - (float)j2 + 2.0f * G3, y0 - 1.0f + 3.0f * G3 };
+	float oz[4] = { z0, z0 - (float)k1 + G3, z0 - (float)k2 + 2.0f * G3, z0 - 1.0f + 3.0f * G3 };
+	uint32_t h[4] = {
+		noise_hash3(i, j, k),
+		noise_hash3(noise_offset(i, i1), noise_offset(j, j1), noise_offset(k, k1)),
+		noise_hash3(noise_offset(i, i2), noise_offset(j, j2), noise_offset(k, k2)),
+		noise_hash3(noise_next(i), noise_next(j), noise_next(k)),
+	};
+	float n = 0.0f, dx = 0.0f, dy = 0.0f, dz = 0.0f;
+	for (int c = 0; c < 4; c++) {
+		const float *g = noise_gradients3[h[c] & 15];
+		float r = fmaxf(0.5f - ox[c] * ox[c] - oy[c] * oy[c] - oz[c] * oz[c], 0.0f);
+		float r2 = r * r, r4 = r2 * r2;
+		float dot = g[0] * ox[c] + g[1] * oy[c] + g[2] * oz[c];
+		n += r4 * dot;
+		dx += r4 * g[0] - 8.0f * r2 * r * dot * ox[c];
+		dy += r4 * g[1] - 8.0f * r2 * r * dot * oy[c];
+		dz += r4 * g[2] - 8.0f * r2 * r * dot * oz[c];
+	}
+	gradient->x = dx * BLIB_NOISE3_SIMPLEX_SCALE;
+	gradient->y = dy * BLIB_NOISE3_SIMPLEX_SCALE;
+	gradient->z = dz * BLIB_NOISE3_SIMPLEX_SCALE;
+	return n * BLIB_NOISE3_SIMPLEX_SCALE;
+}
+
+/*fbm value and gradient in one pass, for normals and erosion without
+  finite differences*/
+static inline float noise2_fbm_derivative(const noise_fbm_params *params,
+		noise2_derivative_function noise, float x, float y, vector2_t *gradient) {
+	float total = 0.0f;
+	vector2_t sum = { 0.0f, 0.0f };
+	for (int i = 0; i < params->octaves; i++) {
+		float freq = params->frequencies[i], amplitude = params->amplitudes[i];
+		vector2_t g;
+		total += noise(x * freq, y * freq, &g) * amplitude;
+		sum.x += g.x * amplitude * freq;
+		sum.y += g.y * amplitude * freq;
+	}
+	*gradient = sum;
+	return total;
+}
+
+static inline float noise3_fbm_derivative(const noise_fbm_params *params,
+		noise3_derivative_function noise, float x, float y, float z, vector3_t *gradient) {
+	float total = 0.0f;
+	vector3_t sum = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < params->octaves; i++) {
+		float freq = params->frequencies[i], amplitude = params->amplitudes[i];
+		vector3_t g;
+		total += noise(x * freq, y * freq, z * freq, &g) * amplitude;
+		sum.x += g.x * amplitude * freq;
+		sum.y += g.y * amplitude * freq;
+		sum.z += g.z * amplitude * freq;
+	}
+	*gradient = sum;
+	return total;
+}
+
+/*Writes noise3_fbm_reference() of every point to "out", which must hold
+  points->length floats.*/
+void noise3_fbm_points(const list_vector3_t *points, float *out);
+
+/*Samples an nx * ny * nz grid whose sample (i, j, k) lies at
+  origin + (i * step.x, j * step.y, k * step.z). "out" is filled x fastest:
+  out[(k * ny + j) * nx + i].*/
+void noise3_fbm_grid(float *out, vector3_t origin, vector3_t step,
+		size_t nx, size_t ny, size_t nz);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_NOISE_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_NOISE_IMPLEMENTATION_H
+#define BLIB_NOISE_IMPLEMENTATION_H
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BLIB_NOISE_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#ifdef BLIB_NOISE_X86
+
+/*Each kernel below is noise3_fbm_reference() written with intrinsics, one
+  lane per sample. Keep the order of operations identical to the scalar
+  code or the results stop matching.*/
+
+__attribute__((target("avx2")))
+static inline __m256 noise3_hash8(__m256i x, __m256i y, __m256i z) {
+	__m256i h = _mm256_xor_si256(_mm256_xor_si256(
+				_mm256_mullo_epi32(x, _mm256_set1_epi32((int32_t)0x8da6b343u)),
+				_mm256_mullo_epi32(y, _mm256_set1_epi32((int32_t)0xd8163841u))),
+			_mm256_mullo_epi32(z, _mm256_set1_epi32((int32_t)0xcb1ab31fu)));
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+	h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x7feb352d));
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+	h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int32_t)0x846ca68bu));
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(h, 8)),
+			_mm256_set1_ps(1.0f / 16777216.0f));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 noise_lerp8(__m256 a, __m256 b, __m256 t) {
+	return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+}
+
+__attribute__((target("avx2")))
+static inline __m256 noise_smoothstep8(__m256 t) {
+	__m256 k = _mm256_sub_ps(_mm256_set1_ps(3.0f), _mm256_mul_ps(_mm256_set1_ps(2.0f), t));
+	return _mm256_mul_ps(_mm256_mul_ps(t, t), k);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 noise3_value8(__m256 x, __m256 y, __m256 z) {
+	__m256 floorX = _mm256_floor_ps(x), floorY = _mm256_floor_ps(y), floorZ = _mm256_floor_ps(z);
+	__m256 sx = noise_smoothstep8(_mm256_sub_ps(x, floorX)),
+	       sy = noise_smoothstep8(_mm256_sub_ps(y, floorY)),
+	       sz = noise_smoothstep8(_mm256_sub_ps(z, floorZ));
+	__m256i one = _mm256_set1_epi32(1);
+	__m256i x0 = _mm256_cvttps_epi32(floorX),
+	        y0 = _mm256_cvttps_epi32(floorY),
+	        z0 = _mm256_cvttps_epi32(floorZ);
+	__m256i x1 = _mm256_add_epi32(x0, one),
+	        y1 = _mm256_add_epi32(y0, one),
+	        z1 = _mm256_add_epi32(z0, one);
+
+	__m256 e1 = noise_lerp8(noise3_hash8(x0, y0, z0), noise3_hash8(x1, y0, z0), sx),
+	       e2 = noise_lerp8(noise3_hash8(x0, y1, z0), noise3_hash8(x1, y1, z0), sx),
+	       e3 = noise_lerp8(noise3_hash8(x0, y0, z1), noise3_hash8(x1, y0, z1), sx),
+	       e4 = noise_lerp8(noise3_hash8(x0, y1, z1), noise3_hash8(x1, y1, z1), sx),
+	       f1 = noise_lerp8(e1, e2, sy),
+	       f2 = noise_lerp8(e3, e4, sy);
+	return noise_lerp8(f1, f2, sz);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 noise3_fbm8(__m256 x, __m256 y, __m256 z) {
+	__m256 total = _mm256_setzero_ps();
+	float freq = 1.0f;
+	float amplitude = 1.0f;
+	for (int i = 0; i < BLIB_NOISE_FBM_OCTAVES; i++) {
+		__m256 f = _mm256_set1_ps(freq);
+		__m256 n = noise3_value8(_mm256_mul_ps(x, f), _mm256_mul_ps(y, f), _mm256_mul_ps(z, f));
+		total = _mm256_add_ps(total, _mm256_mul_ps(n, _mm256_set1_ps(amplitude)));
+		freq *= 2.0f;
+		amplitude *= 0.5f;
+	}
+	return total;
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 noise3_hash4(__m128i x, __m128i y, __m128i z) {
+	__m128i h = _mm_xor_si128(_mm_xor_si128(
+				_mm_mullo_epi32(x, _mm_set1_epi32((int32_t)0x8da6b343u)),
+				_mm_mullo_epi32(y, _mm_set1_epi32((int32_t)0xd8163841u))),
+			_mm_mullo_epi32(z, _mm_set1_epi32((int32_t)0xcb1ab31fu)));
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+	h = _mm_mullo_epi32(h, _mm_set1_epi32(0x7feb352d));
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+	h = _mm_mullo_epi32(h, _mm_set1_epi32((int32_t)0x846ca68bu));
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 noise_lerp4(__m128 a, __m128 b, __m128 t) {
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 noise_smoothstep4(__m128 t) {
+	__m128 k = _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_set1_ps(2.0f), t));
+	return _mm_mul_ps(_mm_mul_ps(t, t), k);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 noise3_value4(__m128 x, __m128 y, __m128 z) {
+	__m128 floorX = _mm_floor_ps(x), floorY = _mm_floor_ps(y), floorZ = _mm_floor_ps(z);
+	__m128 sx = noise_smoothstep4(_mm_sub_ps(x, floorX)),
+	       sy = noise_smoothstep4(_mm_sub_ps(y, floorY)),
+	       sz = noise_smoothstep4(_mm_sub_ps(z, floorZ));
+	__m128i one = _mm_set1_epi32(1);
+	__m128i x0 = _mm_cvttps_epi32(floorX),
+	        y0 = _mm_cvttps_epi32(floorY),
+	        z0 = _mm_cvttps_epi32(floorZ);
+	__m128i x1 = _mm_add_epi32(x0, one),
+	        y1 = _mm_add_epi32(y0, one),
+	        z1 = _mm_add_epi32(z0, one);
+
+	__m128 e1 = noise_lerp4(noise3_hash4(x0, y0, z0), noise3_hash4(x1, y0, z0), sx),
+	       e2 = noise_lerp4(noise3_hash4(x0, y1, z0), noise3_hash4(x1, y1, z0), sx),
+	       e3 = noise_lerp4(noise3_hash4(x0, y0, z1), noise3_hash4(x1, y0, z1), sx),
+	       e4 = noise_lerp4(noise3_hash4(x0, y1, z1), noise3_hash4(x1, y1, z1), sx),
+	       f1 = noise_lerp4(e1, e2, sy),
+	       f2 = noise_lerp4(e3, e4, sy);
+	return noise_lerp4(f1, f2, sz);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128 noise3_fbm4(__m128 x, __m128 y, __m128 z) {
+	__m128 total = _mm_setzero_ps();
+	float freq = 1.0f;
+	float amplitude = 1.0f;
+	for (int i = 0; i < BLIB_NOISE_FBM_OCTAVES; i++) {
+		__m128 f = _mm_set1_ps(freq);
+		__m128 n = noise3_value4(_mm_mul_ps(x, f), _mm_mul_ps(y, f), _mm_mul_ps(z, f));
+		total = _mm_add_ps(total, _mm_mul_ps(n, _mm_set1_ps(amplitude)));
+		freq *= 2.0f;
+		amplitude *= 0.5f;
+	}
+	return total;
+}
+
+__attribute__((target("avx2")))
+static size_t noise3_fbm_points_avx2(const vector3_t *p, size_t count, float *out) {
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256 x = _mm256_setr_ps(p[i].x, p[i + 1].x, p[i + 2].x, p[i + 3].x,
+				p[i + 4].x, p[i + 5].x, p[i + 6].x, p[i + 7].x);
+		__m256 y = _mm256_setr_ps(p[i].y, p[i + 1].y, p[i + 2].y, p[i + 3].y,
+				p[i + 4].y, p[i + 5].y, p[i + 6].y, p[i + 7].y);
+		__m256 z = _mm256_setr_ps(p[i].z, p[i + 1].z, p[i + 2].z, p[i + 3].z,
+				p[i + 4].z, p[i + 5].z, p[i + 6].z, p[i + 7].z);
+		_mm256_storeu_ps(out + i, noise3_fbm8(x, y, z));
+	}
+	return i;
+}
+
+__attribute__((target("sse4.1")))
+static size_t noise3_fbm_points_sse(const vector3_t *p, size_t count, float *out) {
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4) {
+		__m128 x = _mm_setr_ps(p[i].x, p[i + 1].x, p[i + 2].x, p[i + 3].x);
+		__m128 y = _mm_setr_ps(p[i].y, p[i + 1].y, p[i + 2].y, p[i + 3].y);
+		__m128 z = _mm_setr_ps(p[i].z, p[i + 1].z, p[i + 2].z, p[i + 3].z);
+		_mm_storeu_ps(out + i, noise3_fbm4(x, y, z));
+	}
+	return i;
+}
+
+/*One row of a grid, x = origin.x + i * step.x for i in [0, nx)*/
+__attribute__((target("avx2")))
+static size_t noise3_fbm_row_avx2(float *out, float ox, float sx, float y, float z, size_t nx) {
+	__m256 lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	__m256 vy = _mm256_set1_ps(y), vz = _mm256_set1_ps(z);
+	size_t i = 0;
+	for (; i + 8 <= nx; i += 8) {
+		__m256 index = _mm256_add_ps(_mm256_set1_ps((float)i), lane);
+		__m256 x = _mm256_add_ps(_mm256_set1_ps(ox), _mm256_mul_ps(index, _mm256_set1_ps(sx)));
+		_mm256_storeu_ps(out + i, noise3_fbm8(x, vy, vz));
+	}
+	return i;
+}
+
+__attribute__((target("sse4.1")))
+static size_t noise3_fbm_row_sse(float *out, float ox, float sx, float y, float z, size_t nx) {
+	__m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+	__m128 vy = _mm_set1_ps(y), vz = _mm_set1_ps(z);
+	size_t i = 0;
+	for (; i + 4 <= nx; i += 4) {
+		__m128 index = _mm_add_ps(_mm_set1_ps((float)i), lane);
+		__m128 x = _mm_add_ps(_mm_set1_ps(ox), _mm_mul_ps(index, _mm_set1_ps(sx)));
+		_mm_storeu_ps(out + i, noise3_fbm4(x, vy, vz));
+	}
+	return i;
+}
+
+enum { NOISE_SIMD_NONE, NOISE_SIMD_SSE41, NOISE_SIMD_AVX2 };
+
+static int noise_simd_level(void) {
+	static int level = -1;
+	int l = __atomic_load_n(&level, __ATOMIC_RELAXED);
+	if (l < 0) {
+		__builtin_cpu_init();
+		l = __builtin_cpu_supports("avx2") ? NOISE_SIMD_AVX2 :
+			__builtin_cpu_supports("sse4.1") ? NOISE_SIMD_SSE41 : NOISE_SIMD_NONE;
+		__atomic_store_n(&level, l, __ATOMIC_RELAXED);
+	}
+	return l;
+}
+
+#endif // BLIB_NOISE_X86
+
+void noise3_fbm_points(const list_vector3_t *points, float *out) {
+	const vector3_t *p = points->array;
+	size_t count = points->length;
+	size_t i = 0;
+#ifdef BLIB_NOISE_X86
+	switch (noise_simd_level()) {
+		case NOISE_SIMD_AVX2: i = noise3_fbm_points_avx2(p, count, out); break;
+		case NOISE_SIMD_SSE41: i = noise3_fbm_points_sse(p, count, out); break;
+	}
+#endif
+	for (; i < count; i++)
+		out[i] = noise3_fbm_reference(p[i].x, p[i].y, p[i].z);
+}
+
+void noise3_fbm_grid(float *out, vector3_t origin, vector3_t step,
+		size_t nx, size_t ny, size_t nz) {
+#ifdef BLIB_NOISE_X86
+	int level = noise_simd_level();
+#endif
+	for (size_t k = 0; k < nz; k++) {
+		float z = origin.z + (float)k * step.z;
+		for (size_t j = 0; j < ny; j++) {
+			float y = origin.y + (float)j * step.y;
+			float *row = out + (k * ny + j) * nx;
+			size_t i = 0;
+#ifdef BLIB_NOISE_X86
+			switch (level) {
+				case NOISE_SIMD_AVX2: i = noise3_fbm_row_avx2(row, origin.x, step.x, y, z, nx); break;
+				case NOISE_SIMD_SSE41: i = noise3_fbm_row_sse(row, origin.x, step.x, y, z, nx); break;
+			}
+#endif
+			for (; i < nx; i++)
+				row[i] = noise3_fbm_reference(origin.x + (float)i * step.x, y, z);
+		}
+	}
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_NOISE_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
@@ -0,0 +1,358 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Tiled noise fields with a cache.
+
+  A field is an infinite grid of samples. Sample (i, j, k) lies at world
+  position (i, j, k) * spacing. It is generated a tile at a time by a
+  noise_field_generator, with tiles spread over a thread_pool. Generated
+  tiles stay in an LRU cache keyed by tile coordinate and a caller chosen
+  "parameters" value, so overlapping requests (a moving camera, repeated
+  queries) only pay for tiles they have not seen yet.
+
+  noise_field *field = noise_field_alloc(&desc, pool);
+  noise_field_fill(field, x0, y0, z0, nx, ny, nz, out);
+
+  A field is not safe to use from several threads at once, the parallelism
+  happens inside noise_field_fill().*/
+
+#ifndef BLIB_NOISE_FIELD_H
+#define BLIB_NOISE_FIELD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "blib_noise.h"
+#include "blib_thread.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/*Fills an nx * ny * nz block, x fastest, starting at "origin" with
+  "step" between samples. noise3_fbm_grid() has this shape.*/
+typedef void (*noise_field_generator)(void *context, float *out, vector3_t origin,
+		vector3_t step, size_t nx, size_t ny, size_t nz);
+
+typedef struct {
+	noise_field_generator generator;
+	void *context;
+	uint64_t parameters; // part of every cache key, change it when "context" changes
+	float spacing;       // world units between samples
+	size_t tile_size;    // samples along x and y, 0 picks 32
+	size_t tile_depth;   // samples along z, 1 for 2D fields, 0 picks tile_size
+	size_t cache_tiles;  // tiles kept, 0 picks 256
+} noise_field_desc;
+
+typedef struct noise_field noise_field;
+
+noise_field *noise_field_alloc(const noise_field_desc *desc, thread_pool *pool);
+void noise_field_free(noise_field *field);
+
+/*Copies samples [x0, x0 + nx) * [y0, y0 + ny) * [z0, z0 + nz) into "out",
+  x fastest, generating missing tiles in parallel.*/
+void noise_field_fill(noise_field *field, int64_t x0, int64_t y0, int64_t z0,
+		size_t nx, size_t ny, size_t nz, float *out);
+
+/*Switches to a different parameter set. Cached tiles of the old one are
+  kept and age out normally, switching back can still hit them.*/
+void noise_field_set_parameters(noise_field *field, void *context, uint64_t parameters);
+
+/*Drops every cached tile*/
+void noise_field_clear(noise_field *field);
+
+size_t noise_field_hits(const noise_field *field);
+size_t noise_field_misses(const noise_field *field);
+
+/*Generators for the noise functions in blib_math.h and blib_noise.h*/
+void noise_field_fbm(void *context, float *out, vector3_t origin, vector3_t step,
+		size_t nx, size_t ny, size_t nz);
+
+/*"context" points to the float warp factor passed to noise3_fbm_warped()*/
+void noise_field_fbm_warped(void *context, float *out, vector3_t origin, vector3_t step,
+		size_t nx, size_t ny, size_t nz);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_NOISE_FIELD_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_NOISE_FIELD_IMPLEMENTATION_H
+#define BLIB_NOISE_FIELD_IMPLEMENTATION_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define NOISE_FIELD_NONE UINT32_MAX
+
+typedef struct {
+	int32_t x, y, z;
+	uint64_t parameters;
+	uint32_t next_in_bucket;
+	uint32_t newer, older;  // LRU links
+	bool used;
+} noise_field_slot;
+
+struct noise_field {
+	noise_field_desc desc;
+	thread_pool *pool;
+	size_t tile_samples;
+	float *samples;          // cache_tiles * tile_samples
+	noise_field_slot *slots;
+	uint32_t *buckets;
+	size_t bucket_mask;
+	uint32_t newest, oldest;
+	size_t hits, misses;
+
+	// Scratch for one batch of tiles inside noise_field_fill().
+	uint32_t *batch;
+	uint32_t *pending;
+	size_t pending_count;
+};
+
+static uint32_t noise_field_bucket(const noise_field *field, int32_t x, int32_t y, int32_t z,
+		uint64_t parameters) {
+	uint32_t h = noise_hash4(x, y, z, (int32_t)(uint32_t)parameters) ^
+		noise_mix((uint32_t)(parameters >> 32));
+	return h & (uint32_t)field->bucket_mask;
+}
+
+static void noise_field_unlink(noise_field *field, uint32_t index) {
+	noise_field_slot *slot = &field->slots[index];
+	if (slot->newer != NOISE_FIELD_NONE)
+		field->slots[slot->newer].older = slot->older;
+	else
+		field->newest = slot->older;
+	if (slot->older != NOISE_FIELD_NONE)
+		field->slots[slot->older].newer = slot->newer;
+	else
+		field->oldest = slot->newer;
+}
+
+static void noise_field_push_newest(noise_field *field, uint32_t index) {
+	noise_field_slot *slot = &field->slots[index];
+	slot->newer = NOISE_FIELD_NONE;
+	slot->older = field->newest;
+	if (field->newest != NOISE_FIELD_NONE)
+		field->slots[field->newest].newer = index;
+	field->newest = index;
+	if (field->oldest == NOISE_FIELD_NONE)
+		field->oldest = index;
+}
+
+static void noise_field_remove_from_bucket(noise_field *field, uint32_t index) {
+	noise_field_slot *slot = &field->slots[index];
+	uint32_t *link = &field->buckets[noise_field_bucket(field, slot->x, slot->y, slot->z, slot->parameters)];
+	while (*link != index)
+		link = &field->slots[*link].next_in_bucket;
+	*link = slot->next_in_bucket;
+}
+
+void noise_field_clear(noise_field *field) {
+	size_t count = field->desc.cache_tiles;
+	for (size_t i = 0; i <= field->bucket_mask; i++)
+		field->buckets[i] = NOISE_FIELD_NONE;
+	// Every slot starts out unused in the LRU list, oldest first.
+	field->newest = field->oldest = NOISE_FIELD_NONE;
+	for (size_t i = count; i-- > 0;) {
+		field->slots[i].used = false;
+		noise_field_push_newest(field, (uint32_t)i);
+	}
+}
+
+noise_field *noise_field_alloc(const noise_field_desc *desc, thread_pool *pool) {
+	noise_field *field = (noise_field *)calloc(1, sizeof(noise_field));
+	field->desc = *desc;
+	field->pool = pool;
+	if (field->desc.tile_size == 0)
+		field->desc.tile_size = 32;
+	if (field->desc.tile_depth == 0)
+		field->desc.tile_depth = field->desc.tile_size;
+	if (field->desc.cache_tiles == 0)
+		field->desc.cache_tiles = 256;
+	size_t count = field->desc.cache_tiles;
+	field->tile_samples = field->desc.tile_size * field->desc.tile_size * field->desc.tile_depth;
+	field->samples = (float *)malloc(sizeof(float) * field->tile_samples * count);
+	field->slots = (noise_field_slot *)calloc(count, sizeof(noise_field_slot));
+	size_t buckets = 1;
+	while (buckets < count * 2)
+		buckets <<= 1;
+	field->bucket_mask = buckets - 1;
+	field->buckets = (uint32_t *)malloc(sizeof(uint32_t) * buckets);
+	field->batch = (uint32_t *)malloc(sizeof(uint32_t) * count);
+	field->pending = (uint32_t *)malloc(sizeof(uint32_t) * count);
+	noise_field_clear(field);
+	return field;
+}
+
+void noise_field_free(noise_field *field) {
+	if (field == NULL)
+		return;
+	free(field->samples);
+	free(field->slots);
+	free(field->buckets);
+	free(field->batch);
+	free(field->pending);
+	free(field);
+}
+
+void noise_field_set_parameters(noise_field *field, void *context, uint64_t parameters) {
+	field->desc.context = context;
+	field->desc.parameters = parameters;
+}
+
+size_t noise_field_hits(const noise_field *field) { return field->hits; }
+size_t noise_field_misses(const noise_field *field) { return field->misses; }
+
+/*Returns the slot holding tile (x, y, z), claiming the least recently
+  used slot and queueing the tile for generation if it is not cached.*/
+static uint32_t noise_field_acquire(noise_field *field, int32_t x, int32_t y, int32_t z) {
+	uint64_t parameters = field->desc.parameters;
+	uint32_t *bucket = &field->buckets[noise_field_bucket(field, x, y, z, parameters)];
+	for (uint32_t i = *bucket; i != NOISE_FIELD_NONE; i = field->slots[i].next_in_bucket) {
+		noise_field_slot *slot = &field->slots[i];
+		if (slot->x == x && slot->y == y && slot->z == z && slot->parameters == parameters) {
+			noise_field_unlink(field, i);
+			noise_field_push_newest(field, i);
+			field->hits++;
+			return i;
+		}
+	}
+	uint32_t index = field->oldest;
+	noise_field_slot *slot = &field->slots[index];
+	if (slot->used)
+		noise_field_remove_from_bucket(field, index);
+	noise_field_unlink(field, index);
+	noise_field_push_newest(field, index);
+	slot->x = x;
+	slot->y = y;
+	slot->z = z;
+	slot->parameters = parameters;
+	slot->used = true;
+	slot->next_in_bucket = *bucket;
+	*bucket = index;
+	field->pending[field->pending_count++] = index;
+	field->misses++;
+	return index;
+}
+
+static void noise_field_generate_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	noise_field *field = (noise_field *)context;
+	(void)thread_index;
+	float spacing = field->desc.spacing;
+	vector3_t step = { spacing, spacing, spacing };
+	for (size_t i = begin; i < end; i++) {
+		uint32_t index = field->pending[i];
+		const noise_field_slot *slot = &field->slots[index];
+		vector3_t origin = {
+			(float)((int64_t)slot->x * (int64_t)field->desc.tile_size) * spacing,
+			(float)((int64_t)slot->y * (int64_t)field->desc.tile_size) * spacing,
+			(float)((int64_t)slot->z * (int64_t)field->desc.tile_depth) * spacing,
+		};
+		field->desc.generator(field->desc.context, field->samples + index * field->tile_samples,
+				origin, step, field->desc.tile_size, field->desc.tile_size, field->desc.tile_depth);
+	}
+}
+
+static int64_t noise_field_floor_div(int64_t a, int64_t b) {
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+static void noise_field_copy(noise_field *field, uint32_t index, int32_t tx, int32_t ty, int32_t tz,
+		int64_t x0, int64_t y0, int64_t z0, size_t nx, size_t ny, size_t nz, float *out) {
+	int64_t size = (int64_t)field->desc.tile_size, depth = (int64_t)field->desc.tile_depth;
+	int64_t bx = tx * size, by = ty * size, bz = tz * depth;
+	int64_t ix0 = bx > x0 ? bx : x0, ix1 = bx + size < x0 + (int64_t)nx ? bx + size : x0 + (int64_t)nx;
+	int64_t iy0 = by > y0 ? by : y0, iy1 = by + size < y0 + (int64_t)ny ? by + size : y0 + (int64_t)ny;
+	int64_t iz0 = bz > z0 ? bz : z0, iz1 = bz + depth < z0 + (int64_t)nz ? bz + depth : z0 + (int64_t)nz;
+	const float *tile = field->samples + index * field->tile_samples;
+	for (int64_t z = iz0; z < iz1; z++)
+		for (int64_t y = iy0; y < iy1; y++)
+			memcpy(out + ((size_t)(z - z0) * ny + (size_t)(y - y0)) * nx + (size_t)(ix0 - x0),
+					tile + ((size_t)(z - bz) * (size_t)size + (size_t)(y - by)) * (size_t)size + (size_t)(ix0 - bx),
+					sizeof(float) * (size_t)(ix1 - ix0));
+}
+
+void noise_field_fill(noise_field *field, int64_t x0, int64_t y0, int64_t z0,
+		size_t nx, size_t ny, size_t nz, float *out) {
+	if (nx == 0 || ny == 0 || nz == 0)
+		return;
+	int64_t size = (int64_t)field->desc.tile_size, depth = (int64_t)field->desc.tile_depth;
+	int64_t tx0 = noise_field_floor_div(x0, size), tx1 = noise_field_floor_div(x0 + (int64_t)nx - 1, size);
+	int64_t ty0 = noise_field_floor_div(y0, size), ty1 = noise_field_floor_div(y0 + (int64_t)ny - 1, size);
+	int64_t tz0 = noise_field_floor_div(z0, depth), tz1 = noise_field_floor_div(z0 + (int64_t)nz - 1, depth);
+	size_t tiles_x = (size_t)(tx1 - tx0 + 1), tiles_y = (size_t)(ty1 - ty0 + 1);
+	size_t total = tiles_x * tiles_y * (size_t)(tz1 - tz0 + 1);
+
+	// Work in batches no larger than the cache, so no tile of a batch can
+	// be evicted before it has been copied out.
+	size_t capacity = field->desc.cache_tiles;
+	for (size_t first = 0; first < total; first += capacity) {
+		size_t count = total - first < capacity ? total - first : capacity;
+		field->pending_count = 0;
+		for (size_t t = 0; t < count; t++) {
+			size_t n = first + t;
+			int32_t tx = (int32_t)(tx0 + (int64_t)(n % tiles_x));
+			int32_t ty = (int32_t)(ty0 + (int64_t)(n / tiles_x % tiles_y));
+			int32_t tz = (int32_t)(tz0 + (int64_t)(n / (tiles_x * tiles_y)));
+			field->batch[t] = noise_field_acquire(field, tx, ty, tz);
+		}
+		thread_pool_run(field->pool, field->pending_count, 1, noise_field_generate_task, field);
+		for (size_t t = 0; t < count; t++) {
+			const noise_field_slot *slot = &field->slots[field->batch[t]];
+			noise_field_copy(field, field->batch[t], slot->x, slot->y, slot->z,
+					x0, y0, z0, nx, ny, nz, out);
+		}
+	}
+}
+
+void noise_field_fbm(void *context, float *out, vector3_t origin, vector3_t step,
+		size_t nx, size_t ny, size_t nz) {
+	(void)context;
+	noise3_fbm_grid(out, origin, step, nx, ny, nz);
+}
+
+void noise_field_fbm_warped(void *context, float *out, vector3_t origin, vector3_t step,
+		size_t nx, size_t ny, size_t nz) {
+	float warp = context ? *(const float *)context : 1.0f;
+	for (size_t k = 0; k < nz; k++)
+		for (size_t j = 0; j < ny; j++)
+			for (size_t i = 0; i < nx; i++)
+				*out++ = noise3_fbm_warped(origin.x + (float)i * step.x,
+						origin.y + (float)j * step.y, origin.z + (float)k * step.z, warp);
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_NOISE_FIELD_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
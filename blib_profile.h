@@ -0,0 +1,321 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Scoped profiling zones.
+
+  void update(void) {
+  	PROFILE_SCOPE("update");
+  	...
+  }
+
+  Every zone becomes one complete event (name, start, duration) in a buffer
+  owned by the thread that ran it, so recording never takes a lock.
+  profile_write_chrome_trace() writes all threads' events as Chrome
+  trace-event JSON, which chrome://tracing and ui.perfetto.dev open.
+
+  Define BLIB_PROFILE in every translation unit to turn zones on. Without it
+  the macros expand to nothing and the functions are empty stubs.*/
+
+#ifndef BLIB_PROFILE_H
+#define BLIB_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "blib_timer.h"
+
+/*Events kept per thread, later zones are dropped and counted*/
+#ifndef BLIB_PROFILE_MAX_EVENTS
+#define BLIB_PROFILE_MAX_EVENTS (1024 * 1024 /* events */)
+#endif
+
+#define BLIB_PROFILE_BLOCK_EVENTS (4096 /* events */)
+#define BLIB_PROFILE_STACK_DEPTH (64 /* zones */)
+
+#define BLIB_PROFILE_CONCAT_(a, b) a##b
+#define BLIB_PROFILE_CONCAT(a, b) BLIB_PROFILE_CONCAT_(a, b)
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#ifdef BLIB_PROFILE
+
+typedef struct {
+	const char *name;
+	uint64_t begin;
+} profile_zone;
+
+/*"name" must outlive the profile, string literals are the usual choice*/
+static inline profile_zone profile_zone_begin(const char *name) {
+	profile_zone zone;
+	zone.name = name;
+	zone.begin = timer_ticks();
+	return zone;
+}
+
+void profile_zone_end(profile_zone *zone);
+void profile_begin(const char *name);
+void profile_end(void);
+void profile_thread_name(const char *name);
+int profile_write_chrome_trace(const char *path);
+size_t profile_dropped(void);
+void profile_reset(void);
+
+/*Zones opened with PROFILE_SCOPE close when the enclosing block exits. That
+  needs the GNU cleanup attribute, other compilers have to pair
+  PROFILE_BEGIN with PROFILE_END by hand.*/
+#if defined(__GNUC__)
+#define PROFILE_SCOPE(name)\
+	profile_zone BLIB_PROFILE_CONCAT(blib_profile_zone_, __LINE__)\
+	__attribute__((cleanup(profile_zone_end))) = profile_zone_begin(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
+
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#define PROFILE_BEGIN(name) profile_begin(name)
+#define PROFILE_END() profile_end()
+#define PROFILE_THREAD_NAME(name) profile_thread_name(name)
+
+#else
+
+static inline void profile_thread_name(const char *name) { (void)name; }
+static inline int profile_write_chrome_trace(const char *path) { (void)path; return 0; }
+static inline size_t profile_dropped(void) { return 0; }
+static inline void profile_reset(void) {}
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#define PROFILE_BEGIN(name) ((void)0)
+#define PROFILE_END() ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+
+#endif // BLIB_PROFILE
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_PROFILE_H
+
+#if defined(BLIB_IMPLEMENTATION) && defined(BLIB_PROFILE)
+#ifndef BLIB_PROFILE_IMPLEMENTATION_H
+#define BLIB_PROFILE_IMPLEMENTATION_H
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct {
+	const char *name;
+	uint64_t begin;
+	uint64_t end;
+} profile_event;
+
+typedef struct profile_block {
+	profile_event events[BLIB_PROFILE_BLOCK_EVENTS];
+	size_t count; // published with release once an event is complete
+	struct profile_block *next;
+} profile_block;
+
+typedef struct profile_thread {
+	uint32_t id;
+	const char *name;
+	size_t event_count;
+	profile_block *first;
+	profile_block *last;
+	profile_zone stack[BLIB_PROFILE_STACK_DEPTH];
+	size_t depth;
+	struct profile_thread *next;
+} profile_thread;
+
+static struct {
+	pthread_mutex_t mutex;
+	profile_thread *threads;
+	uint32_t thread_count;
+	size_t dropped;
+} profile = { PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0 };
+
+static __thread profile_thread *profile_this_thread = NULL;
+
+static profile_thread *profile_get_thread(void) {
+	profile_thread *thread = profile_this_thread;
+	if (thread)
+		return thread;
+	thread = (profile_thread *)calloc(1, sizeof(profile_thread));
+	pthread_mutex_lock(&profile.mutex);
+	thread->id = ++profile.thread_count;
+	thread->next = profile.threads;
+	__atomic_store_n(&profile.threads, thread, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&profile.mutex);
+	return profile_this_thread = thread;
+}
+
+void profile_zone_end(profile_zone *zone) {
+	uint64_t end = timer_ticks();
+	profile_thread *thread = profile_get_thread();
+	if (thread->event_count >= BLIB_PROFILE_MAX_EVENTS) {
+		__atomic_fetch_add(&profile.dropped, 1, __ATOMIC_RELAXED);
+		return;
+	}
+	profile_block *block = thread->last;
+	if (block == NULL || block->count == BLIB_PROFILE_BLOCK_EVENTS) {
+		profile_block *next = (profile_block *)malloc(sizeof(profile_block));
+		next->count = 0;
+		next->next = NULL;
+		if (block)
+			__atomic_store_n(&block->next, next, __ATOMIC_RELEASE);
+		else
+			__atomic_store_n(&thread->first, next, __ATOMIC_RELEASE);
+		block = thread->last = next;
+	}
+	profile_event *event = &block->events[block->count];
+	event->name = zone->name;
+	event->begin = zone->begin;
+	event->end = end;
+	__atomic_store_n(&block->count, block->count + 1, __ATOMIC_RELEASE);
+	thread->event_count++;
+}
+
+void profile_begin(const char *name) {
+	profile_thread *thread = profile_get_thread();
+	if (thread->depth < BLIB_PROFILE_STACK_DEPTH)
+		thread->stack[thread->depth] = profile_zone_begin(name);
+	thread->depth++;
+}
+
+/*Closes the zone opened by the most recent unmatched profile_begin() on
+  this thread. Zones nested deeper than BLIB_PROFILE_STACK_DEPTH are lost.*/
+void profile_end(void) {
+	profile_thread *thread = profile_get_thread();
+	if (thread->depth == 0)
+		return;
+	thread->depth--;
+	if (thread->depth < BLIB_PROFILE_STACK_DEPTH)
+		profile_zone_end(&thread->stack[thread->depth]);
+	else
+		__atomic_fetch_add(&profile.dropped, 1, __ATOMIC_RELAXED);
+}
+
+/*Names the calling thread's track in the trace*/
+void profile_thread_name(const char *name) {
+	profile_get_thread()->name = name;
+}
+
+size_t profile_dropped(void) {
+	return __atomic_load_n(&profile.dropped, __ATOMIC_RELAXED);
+}
+
+/*Forgets every recorded event. Only call it while no thread is inside a
+  zone, typically between frames.*/
+void profile_reset(void) {
+	pthread_mutex_lock(&profile.mutex);
+	for (profile_thread *thread = profile.threads; thread; thread = thread->next) {
+		profile_block *block = thread->first;
+		while (block) {
+			profile_block *next = block->next;
+			free(block);
+			block = next;
+		}
+		thread->first = thread->last = NULL;
+		thread->event_count = 0;
+	}
+	profile.dropped = 0;
+	pthread_mutex_unlock(&profile.mutex);
+}
+
+static void profile_write_string(FILE *file, const char *s) {
+	fputc('"', file);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fputc('\\', file);
+		if ((unsigned char)*s < 0x20)
+			fprintf(file, "\\u%04x", (unsigned char)*s);
+		else
+			fputc(*s, file);
+	}
+	fputc('"', file);
+}
+
+/*Writes every event completed so far. Safe to call while other threads are
+  still recording, their newer events simply miss this file. Returns 0 if
+  "path" could not be opened.*/
+int profile_write_chrome_trace(const char *path) {
+	FILE *file = fopen(path, "w");
+	if (file == NULL)
+		return 0;
+	double us_per_tick = 1e6 / (double)timer_ticks_per_second();
+	uint64_t origin = UINT64_MAX;
+	profile_thread *threads = __atomic_load_n(&profile.threads, __ATOMIC_ACQUIRE);
+	// Events are stored in the order they end, so look at all of them.
+	for (profile_thread *thread = threads; thread; thread = thread->next) {
+		for (profile_block *block = __atomic_load_n(&thread->first, __ATOMIC_ACQUIRE); block;
+				block = __atomic_load_n(&block->next, __ATOMIC_ACQUIRE)) {
+			size_t count = __atomic_load_n(&block->count, __ATOMIC_ACQUIRE);
+			for (size_t i = 0; i < count; i++)
+				origin = block->events[i].begin < origin ? block->events[i].begin : origin;
+		}
+	}
+
+	fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+	int first = 1;
+	for (profile_thread *thread = threads; thread; thread = thread->next) {
+		if (thread->name) {
+			fprintf(file, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"name\":\"thread_name\",\"args\":{\"name\":",
+					first ? "" : ",\n", thread->id);
+			profile_write_string(file, thread->name);
+			fputs("}}", file);
+			first = 0;
+		}
+		for (profile_block *block = __atomic_load_n(&thread->first, __ATOMIC_ACQUIRE); block;
+				block = __atomic_load_n(&block->next, __ATOMIC_ACQUIRE)) {
+			size_t count = __atomic_load_n(&block->count, __ATOMIC_ACQUIRE);
+			for (size_t i = 0; i < count; i++) {
+				const profile_event *event = &block->events[i];
+				fprintf(file, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+						first ? "" : ",\n", thread->id,
+						(double)(event->begin - origin) * us_per_tick,
+						(double)(event->end - event->begin) * us_per_tick);
+				profile_write_string(file, event->name);
+				fputc('}', file);
+				first = 0;
+			}
+		}
+	}
+	fputs("\n]}\n", file);
+	return fclose(file) == 0;
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_PROFILE_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION && BLIB_PROFILE
@@ -0,0 +1,495 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Seedable pseudo-random number generators.
+
+  random_xoshiro256 is xoshiro256** (Blackman and Vigna), the default
+  choice: 256 bits of state, 64 bit outputs, and jump functions that carve
+  the period into 2^128 non-overlapping streams. random_pcg32 is
+  PCG-XSH-RR (O'Neill): 128 bits of state, 32 bit outputs, and 2^63
+  selectable streams. Neither is cryptographically secure. A generator
+  must not be shared between threads, give each thread its own with
+  random_xoshiro256_split() or a distinct PCG stream.
+
+  The random_fill_* functions produce large batches in parallel. Their
+  output depends only on the generator state and the element count, never
+  on the thread pool size or on whether the AVX2 path ran.*/
+
+#ifndef BLIB_RANDOM_H
+#define BLIB_RANDOM_H
+
+#include <math.h>
+#include <stdint.h>
+#include "blib.h"
+#include "blib_math3d.h"
+#include "blib_thread.h"
+#include "blib_fast_math.h"
+
+/*Elements generated from one set of lane streams by random_fill_*. Also
+  the unit of work handed to the thread pool.*/
+#define BLIB_RANDOM_BLOCK_SIZE (16384 /* elements */)
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct {
+	uint64_t s[4];
+} random_xoshiro256;
+
+typedef struct {
+	uint64_t state;
+	uint64_t increment;
+} random_pcg32;
+
+/*One step of splitmix64, used to expand seeds*/
+static inline uint64_t random_splitmix64(uint64_t *state) {
+	uint64_t z = (*state += 0x9e3779b97f4a7c15u);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9u;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebu;
+	return z ^ (z >> 31);
+}
+
+static inline uint64_t random_rotl64(uint64_t x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+static inline random_xoshiro256 random_xoshiro256_seed(uint64_t seed) {
+	random_xoshiro256 rng;
+	for (int i = 0; i < 4; i++)
+		rng.s[i] = random_splitmix64(&seed);
+	return rng;
+}
+
+static inline uint64_t random_xoshiro256_next(random_xoshiro256 *rng) {
+	uint64_t *s = rng->s;
+	uint64_t result = random_rotl64(s[1] * 5, 7) * 9;
+	uint64_t t = s[1] << 17;
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = random_rotl64(s[3], 45);
+	return result;
+}
+
+/*Advances the generator by 2^128 steps*/
+void random_xoshiro256_jump(random_xoshiro256 *rng);
+
+/*Advances the generator by 2^192 steps, for handing out 2^64 groups of
+  jump() streams*/
+void random_xoshiro256_long_jump(random_xoshiro256 *rng);
+
+/*Returns a generator for the next 2^128 outputs of "rng" and moves "rng"
+  past them. Splitting repeatedly yields non-overlapping streams, one per
+  thread or task.*/
+static inline random_xoshiro256 random_xoshiro256_split(random_xoshiro256 *rng) {
+	random_xoshiro256 child = *rng;
+	random_xoshiro256_jump(rng);
+	return child;
+}
+
+/*Seeds stream "stream" of the generator. Distinct streams with the same
+  seed produce unrelated sequences.*/
+static inline random_pcg32 random_pcg32_seed(uint64_t seed, uint64_t stream) {
+	random_pcg32 rng;
+	rng.state = 0;
+	rng.increment = (stream << 1) | 1;
+	rng.state = rng.state * 6364136223846793005u + rng.increment;
+	rng.state += seed;
+	rng.state = rng.state * 6364136223846793005u + rng.increment;
+	return rng;
+}
+
+static inline uint32_t random_pcg32_next(random_pcg32 *rng) {
+	uint64_t old = rng->state;
+	rng->state = old * 6364136223846793005u + rng->increment;
+	uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+	uint32_t rot = (uint32_t)(old >> 59);
+	return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+/*Skips "delta" outputs in O(log delta) steps*/
+static inline void random_pcg32_advance(random_pcg32 *rng, uint64_t delta) {
+	uint64_t multiplier = 6364136223846793005u, increment = rng->increment;
+	uint64_t total_multiplier = 1, total_increment = 0;
+	while (delta) {
+		if (delta & 1) {
+			total_multiplier *= multiplier;
+			total_increment = total_increment * multiplier + increment;
+		}
+		increment = (multiplier + 1) * increment;
+		multiplier *= multiplier;
+		delta >>= 1;
+	}
+	rng->state = total_multiplier * rng->state + total_increment;
+}
+
+/*Returns a generator on a stream picked by "rng", the PCG equivalent of
+  random_xoshiro256_split()*/
+static inline random_pcg32 random_pcg32_split(random_pcg32 *rng) {
+	uint64_t seed = ((uint64_t)random_pcg32_next(rng) << 32) | random_pcg32_next(rng);
+	uint64_t stream = ((uint64_t)random_pcg32_next(rng) << 32) | random_pcg32_next(rng);
+	return random_pcg32_seed(seed, stream);
+}
+
+/*The conversions below are shared by the scalar functions and the batch
+  fills. "bits" is one 64 bit output.*/
+
+/*[0, 1) with 24 bits of resolution*/
+static inline float random_bits_float(uint64_t bits) {
+	return (float)(uint32_t)(bits >> 40) * (1.0f / 16777216.0f);
+}
+
+/*A standard normal sample by Box-Muller, using the fast_math functions so
+  the batch fills can vectorize it. The 24 bit uniform input limits the
+  tails to about 5.8 standard deviations.*/
+static inline float random_bits_normal(uint64_t bits) {
+	float u1 = (float)((uint32_t)(bits >> 40) + 1) * (1.0f / 16777216.0f);
+	float u2 = (float)(uint32_t)((bits >> 16) & 0xffffff) * (1.0f / 16777216.0f);
+	return sqrtf(-2.0f * fast_logf(u1)) * fast_cosf(6.28318530717958648f * u2);
+}
+
+/*A point on the unit sphere, uniformly distributed by area*/
+static inline vector3_t random_bits_sphere(uint64_t bits) {
+	float z = (float)(uint32_t)(bits >> 40) * (2.0f / 16777216.0f) - 1.0f;
+	float phi = (float)(uint32_t)((bits >> 16) & 0xffffff) * (6.28318530717958648f / 16777216.0f);
+	float r = sqrtf(fast_maxf(1.0f - z * z, 0.0f));
+	return (vector3_t){ r * fast_cosf(phi), r * fast_sinf(phi), z };
+}
+
+static inline float random_xoshiro256_float(random_xoshiro256 *rng) {
+	return random_bits_float(random_xoshiro256_next(rng));
+}
+
+/*[min, max)*/
+static inline float random_xoshiro256_range(random_xoshiro256 *rng, float min, float max) {
+	return min + (max - min) * random_xoshiro256_float(rng);
+}
+
+/*[0, bound) without modulo bias*/
+static inline uint32_t random_xoshiro256_below(random_xoshiro256 *rng, uint32_t bound) {
+	uint64_t m = (random_xoshiro256_next(rng) >> 32) * bound;
+	if ((uint32_t)m < bound) {
+		uint32_t threshold = (uint32_t)-bound % bound;
+		while ((uint32_t)m < threshold)
+			m = (random_xoshiro256_next(rng) >> 32) * bound;
+	}
+	return (uint32_t)(m >> 32);
+}
+
+static inline float random_xoshiro256_normal(random_xoshiro256 *rng) {
+	return random_bits_normal(random_xoshiro256_next(rng));
+}
+
+static inline vector3_t random_xoshiro256_sphere(random_xoshiro256 *rng) {
+	return random_bits_sphere(random_xoshiro256_next(rng));
+}
+
+/*[0, 1) with 24 bits of resolution*/
+static inline float random_pcg32_float(random_pcg32 *rng) {
+	return (float)(random_pcg32_next(rng) >> 8) * (1.0f / 16777216.0f);
+}
+
+static inline float random_pcg32_range(random_pcg32 *rng, float min, float max) {
+	return min + (max - min) * random_pcg32_float(rng);
+}
+
+/*Batch fills. Each replaces the contents of "list" with "count" samples,
+  growing it as needed, and advances "rng" by one output. A NULL pool runs
+  on the calling thread.*/
+void random_fill_uint32(random_xoshiro256 *rng, thread_pool *pool, list_uint32_t *list, size_t count);
+void random_fill_uniform(random_xoshiro256 *rng, thread_pool *pool, list_float *list, size_t count,
+		float min, float max);
+void random_fill_normal(random_xoshiro256 *rng, thread_pool *pool, list_float *list, size_t count,
+		float mean, float deviation);
+void random_fill_sphere(random_xoshiro256 *rng, thread_pool *pool, list_vector3_t *list, size_t count);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_RANDOM_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_RANDOM_IMPLEMENTATION_H
+#define BLIB_RANDOM_IMPLEMENTATION_H
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BLIB_RANDOM_X86 1
+#include <immintrin.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+static void random_xoshiro256_jump_by(random_xoshiro256 *rng, const uint64_t polynomial[4]) {
+	uint64_t s[4] = { 0, 0, 0, 0 };
+	for (int i = 0; i < 4; i++) {
+		for (int b = 0; b < 64; b++) {
+			if (polynomial[i] & ((uint64_t)1 << b)) {
+				s[0] ^= rng->s[0];
+				s[1] ^= rng->s[1];
+				s[2] ^= rng->s[2];
+				s[3] ^= rng->s[3];
+			}
+			random_xoshiro256_next(rng);
+		}
+	}
+	memcpy(rng->s, s, sizeof(s));
+}
+
+void random_xoshiro256_jump(random_xoshiro256 *rng) {
+	static const uint64_t polynomial[4] = {
+		0x180ec6d33cfd0abau, 0xd5a61266f0c9392cu, 0xa9582618e03fc9aau, 0x39abdc4529b1661cu
+	};
+	random_xoshiro256_jump_by(rng, polynomial);
+}
+
+void random_xoshiro256_long_jump(random_xoshiro256 *rng) {
+	static const uint64_t polynomial[4] = {
+		0x76e15d3efefdcbbfu, 0xc5004e441c522fb3u, 0x77710069854ee241u, 0x39109bb02acbe635u
+	};
+	random_xoshiro256_jump_by(rng, polynomial);
+}
+
+/*Block "block" of a fill draws element i from lane i % 8, where each lane
+  is its own xoshiro256** stream seeded from the fill key. Eight lanes
+  match two AVX2 registers of four 64 bit states.*/
+enum { RANDOM_LANES = 8 };
+
+enum { RANDOM_FILL_UINT32, RANDOM_FILL_UNIFORM, RANDOM_FILL_NORMAL, RANDOM_FILL_SPHERE };
+
+typedef struct {
+	uint64_t key;
+	int kind;
+	void *out;
+	size_t count;
+	float a, b;
+} random_fill_job;
+
+static void random_fill_lanes(uint64_t key, size_t block, random_xoshiro256 lanes[RANDOM_LANES]) {
+	for (int lane = 0; lane < RANDOM_LANES; lane++) {
+		uint64_t seed = key + ((uint64_t)block * RANDOM_LANES + (uint64_t)lane) * 4 * 0x9e3779b97f4a7c15u;
+		lanes[lane] = random_xoshiro256_seed(seed);
+	}
+}
+
+static void random_fill_store(const random_fill_job *job, size_t i, uint64_t bits) {
+	switch (job->kind) {
+		case RANDOM_FILL_UINT32: ((uint32_t *)job->out)[i] = (uint32_t)(bits >> 32); break;
+		case RANDOM_FILL_UNIFORM: ((float *)job->out)[i] = job->a + job->b * random_bits_float(bits); break;
+		case RANDOM_FILL_NORMAL: ((float *)job->out)[i] = job->a + job->b * random_bits_normal(bits); break;
+		case RANDOM_FILL_SPHERE: ((vector3_t *)job->out)[i] = random_bits_sphere(bits); break;
+	}
+}
+
+#ifdef BLIB_RANDOM_X86
+
+/*Four xoshiro256** lanes per register, the same steps as
+  random_xoshiro256_next(). Multiplying by 5 and 9 is done with shifts
+  because AVX2 has no 64 bit multiply.*/
+typedef struct {
+	__m256i s0, s1, s2, s3;
+} random_xoshiro256x4;
+
+__attribute__((target("avx2")))
+static inline __m256i random_rotl64x4(__m256i x, int k) {
+	return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i random_xoshiro256x4_next(random_xoshiro256x4 *r) {
+	__m256i times5 = _mm256_add_epi64(_mm256_slli_epi64(r->s1, 2), r->s1);
+	__m256i rotated = random_rotl64x4(times5, 7);
+	__m256i result = _mm256_add_epi64(_mm256_slli_epi64(rotated, 3), rotated);
+	__m256i t = _mm256_slli_epi64(r->s1, 17);
+	r->s2 = _mm256_xor_si256(r->s2, r->s0);
+	r->s3 = _mm256_xor_si256(r->s3, r->s1);
+	r->s1 = _mm256_xor_si256(r->s1, r->s2);
+	r->s0 = _mm256_xor_si256(r->s0, r->s3);
+	r->s2 = _mm256_xor_si256(r->s2, t);
+	r->s3 = random_rotl64x4(r->s3, 45);
+	return result;
+}
+
+__attribute__((target("avx2")))
+static inline void random_xoshiro256x4_load(random_xoshiro256x4 *r, const random_xoshiro256 *lanes) {
+	r->s0 = _mm256_set_epi64x((int64_t)lanes[3].s[0], (int64_t)lanes[2].s[0], (int64_t)lanes[1].s[0], (int64_t)lanes[0].s[0]);
+	r->s1 = _mm256_set_epi64x((int64_t)lanes[3].s[1], (int64_t)lanes[2].s[1], (int64_t)lanes[1].s[1], (int64_t)lanes[0].s[1]);
+	r->s2 = _mm256_set_epi64x((int64_t)lanes[3].s[2], (int64_t)lanes[2].s[2], (int64_t)lanes[1].s[2], (int64_t)lanes[0].s[2]);
+	r->s3 = _mm256_set_epi64x((int64_t)lanes[3].s[3], (int64_t)lanes[2].s[3], (int64_t)lanes[1].s[3], (int64_t)lanes[0].s[3]);
+}
+
+__attribute__((target("avx2")))
+static inline void random_xoshiro256x4_store(const random_xoshiro256x4 *r, random_xoshiro256 *lanes) {
+	uint64_t s[4][4];
+	_mm256_storeu_si256((__m256i *)s[0], r->s0);
+	_mm256_storeu_si256((__m256i *)s[1], r->s1);
+	_mm256_storeu_si256((__m256i *)s[2], r->s2);
+	_mm256_storeu_si256((__m256i *)s[3], r->s3);
+	for (int lane = 0; lane < 4; lane++)
+		for (int i = 0; i < 4; i++)
+			lanes[lane].s[i] = s[i][lane];
+}
+
+/*The low 32 bits of each 64 bit lane of "lo" then "hi", as 8 x 32 bits*/
+__attribute__((target("avx2")))
+static inline __m256i random_pack8(__m256i lo, __m256i hi) {
+	const __m256i even = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+	return _mm256_permute2x128_si256(_mm256_permutevar8x32_epi32(lo, even),
+			_mm256_permutevar8x32_epi32(hi, even), 0x20);
+}
+
+__attribute__((target("avx2")))
+static inline __m256 random_u24_float8(__m256i v, float scale) {
+	return _mm256_mul_ps(_mm256_cvtepi32_ps(v), _mm256_set1_ps(scale));
+}
+
+/*Fills [begin, begin + count) of the job, count a multiple of 8, by
+  running "lanes" forward. Returns nothing, the lanes are updated.*/
+__attribute__((target("avx2")))
+static void random_fill_avx2(const random_fill_job *job, size_t begin, size_t count, random_xoshiro256 lanes[RANDOM_LANES]) {
+	random_xoshiro256x4 a, b;
+	random_xoshiro256x4_load(&a, lanes);
+	random_xoshiro256x4_load(&b, lanes + 4);
+	const __m256i mask24 = _mm256_set1_epi64x(0xffffff);
+	const float scale = 1.0f / 16777216.0f;
+	const float two_pi = 6.28318530717958648f;
+	for (size_t i = begin; i < begin + count; i += RANDOM_LANES) {
+		__m256i ra = random_xoshiro256x4_next(&a), rb = random_xoshiro256x4_next(&b);
+		if (job->kind == RANDOM_FILL_UINT32) {
+			__m256i v = random_pack8(_mm256_srli_epi64(ra, 32), _mm256_srli_epi64(rb, 32));
+			_mm256_storeu_si256((__m256i *)((uint32_t *)job->out + i), v);
+			continue;
+		}
+		__m256i top = random_pack8(_mm256_srli_epi64(ra, 40), _mm256_srli_epi64(rb, 40));
+		__m256i middle = random_pack8(_mm256_and_si256(_mm256_srli_epi64(ra, 16), mask24),
+				_mm256_and_si256(_mm256_srli_epi64(rb, 16), mask24));
+		if (job->kind == RANDOM_FILL_UNIFORM) {
+			__m256 u = random_u24_float8(top, scale);
+			__m256 v = _mm256_add_ps(_mm256_set1_ps(job->a), _mm256_mul_ps(_mm256_set1_ps(job->b), u));
+			_mm256_storeu_ps((float *)job->out + i, v);
+		} else if (job->kind == RANDOM_FILL_NORMAL) {
+			__m256 u1 = random_u24_float8(_mm256_add_epi32(top, _mm256_set1_epi32(1)), scale);
+			__m256 u2 = random_u24_float8(middle, scale);
+			__m256 radius = _mm256_sqrt_ps(_mm256_mul_ps(_mm256_set1_ps(-2.0f), fast_log8(u1)));
+			__m256 n = _mm256_mul_ps(radius, fast_sin_quadrant8(_mm256_mul_ps(_mm256_set1_ps(two_pi), u2), 1));
+			__m256 v = _mm256_add_ps(_mm256_set1_ps(job->a), _mm256_mul_ps(_mm256_set1_ps(job->b), n));
+			_mm256_storeu_ps((float *)job->out + i, v);
+		} else {
+			__m256 z = _mm256_sub_ps(random_u24_float8(top, 2.0f / 16777216.0f), _mm256_set1_ps(1.0f));
+			__m256 phi = random_u24_float8(middle, two_pi / 16777216.0f);
+			__m256 r = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(z, z)),
+						_mm256_setzero_ps()));
+			float x[8], y[8], zs[8];
+			_mm256_storeu_ps(x, _mm256_mul_ps(r, fast_sin_quadrant8(phi, 1)));
+			_mm256_storeu_ps(y, _mm256_mul_ps(r, fast_sin_quadrant8(phi, 0)));
+			_mm256_storeu_ps(zs, z);
+			vector3_t *out = (vector3_t *)job->out + i;
+			for (int lane = 0; lane < RANDOM_LANES; lane++)
+				out[lane] = (vector3_t){ x[lane], y[lane], zs[lane] };
+		}
+	}
+	random_xoshiro256x4_store(&a, lanes);
+	random_xoshiro256x4_store(&b, lanes + 4);
+}
+
+#endif // BLIB_RANDOM_X86
+
+static void random_fill_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	const random_fill_job *job = (const random_fill_job *)context;
+	(void)thread_index;
+	for (size_t block = begin; block < end; block++) {
+		random_xoshiro256 lanes[RANDOM_LANES];
+		random_fill_lanes(job->key, block, lanes);
+		size_t first = block * BLIB_RANDOM_BLOCK_SIZE;
+		size_t count = job->count - first < BLIB_RANDOM_BLOCK_SIZE ? job->count - first : BLIB_RANDOM_BLOCK_SIZE;
+		size_t i = 0;
+#ifdef BLIB_RANDOM_X86
+		if (fast_math_has_avx2()) {
+			i = count & ~(size_t)(RANDOM_LANES - 1);
+			random_fill_avx2(job, first, i, lanes);
+		}
+#endif
+		for (; i < count; i++)
+			random_fill_store(job, first + i, random_xoshiro256_next(&lanes[i % RANDOM_LANES]));
+	}
+}
+
+static void *random_fill_reserve(void **array, size_t *capacity, size_t count, size_t element_size) {
+	if (*capacity < count) {
+		*array = realloc(*array, element_size * count);
+		*capacity = count;
+		BLIB_METRIC_ADD(metrics_list_reallocs, 1);
+	}
+	return *array;
+}
+
+static void random_fill(random_xoshiro256 *rng, thread_pool *pool, random_fill_job *job) {
+	job->key = random_xoshiro256_next(rng);
+	size_t blocks = (job->count + BLIB_RANDOM_BLOCK_SIZE - 1) / BLIB_RANDOM_BLOCK_SIZE;
+	thread_pool_run(pool, blocks, 1, random_fill_task, job);
+}
+
+void random_fill_uint32(random_xoshiro256 *rng, thread_pool *pool, list_uint32_t *list, size_t count) {
+	random_fill_job job = { 0, RANDOM_FILL_UINT32, NULL, count, 0.0f, 0.0f };
+	job.out = random_fill_reserve((void **)&list->array, &list->capacity, count, sizeof(uint32_t));
+	random_fill(rng, pool, &job);
+	list->length = count;
+}
+
+void random_fill_uniform(random_xoshiro256 *rng, thread_pool *pool, list_float *list, size_t count,
+		float min, float max) {
+	random_fill_job job = { 0, RANDOM_FILL_UNIFORM, NULL, count, min, max - min };
+	job.out = random_fill_reserve((void **)&list->array, &list->capacity, count, sizeof(float));
+	random_fill(rng, pool, &job);
+	list->length = count;
+}
+
+void random_fill_normal(random_xoshiro256 *rng, thread_pool *pool, list_float *list, size_t count,
+		float mean, float deviation) {
+	random_fill_job job = { 0, RANDOM_FILL_NORMAL, NULL, count, mean, deviation };
+	job.out = random_fill_reserve((void **)&list->array, &list->capacity, count, sizeof(float));
+	random_fill(rng, pool, &job);
+	list->length = count;
+}
+
+void random_fill_sphere(random_xoshiro256 *rng, thread_pool *pool, list_vector3_t *list, size_t count) {
+	random_fill_job job = { 0, RANDOM_FILL_SPHERE, NULL, count, 0.0f, 0.0f };
+	job.out = random_fill_reserve((void **)&list->array, &list->capacity, count, sizeof(vector3_t));
+	random_fill(rng, pool, &job);
+	list->length = count;
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_RANDOM_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
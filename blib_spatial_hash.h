@@ -0,0 +1,900 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+/*Uniform spatial hash grid for neighbour queries over point sets.
+
+  Space is cut into cubes of "cell_size" and every cell gets a bucket
+  out of a table with at least twice as many buckets as there are
+  points. spatial_hash_build() counts the points per bucket and scatters
+  them into contiguous arrays in O(n), so the points of a cell are read
+  in one run.
+
+  When the box of occupied cells fits in the table the buckets are a
+  dense grid, x major, and neighbouring cells are neighbouring memory.
+  Otherwise columns of cells along z are hashed, so a column is still a
+  run of buckets. Cells that share a bucket are told apart by their
+  packed coordinates, which keeps query results free of duplicates.
+
+  spatial_hash_update() is the per frame call for points that move: it
+  walks the points in their current order, and only re-sorts when some
+  point changed cell. When few did, only those are sorted and merged
+  back in, the rest are still in order.
+
+  spatial_hash_neighbors() and spatial_hash_nearest_all() query every
+  point at once, in cell order for locality and across the thread pool.
+  All results are the same for any thread count.
+
+  Cell coordinates are limited to 21 bits per axis, the points must be
+  finite and span fewer than 2^21 cells along each axis. A cell size
+  around the query radius is a good start.*/
+
+#ifndef BLIB_SPATIAL_HASH_H
+#define BLIB_SPATIAL_HASH_H
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "blib.h"
+#include "blib_math3d.h"
+#include "blib_thread.h"
+
+/*Points per thread pool task*/
+#define BLIB_SPATIAL_HASH_GRAIN (16384 /* points */)
+
+#define SPATIAL_HASH_NONE UINT32_MAX
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct {
+	float cell_size;
+	float inverse_cell_size;
+
+	// Per point, sorted by bucket and within a bucket by index.
+	size_t length;
+	size_t capacity;
+	vector3_t *points;
+	uint64_t *keys;            // packed cell coordinates
+	uint32_t *indices;         // index in the list the points came from
+
+	// Bucket b holds the points [start[b], start[b + 1]).
+	uint32_t *start;
+	size_t bucket_count;       // in use, up to 2^bucket_bits
+	unsigned bucket_bits;
+	bool dense;
+	uint32_t extent[3];        // cells along each axis
+
+	// Cells that hold points, queries never look outside.
+	int32_t cell_min[3];
+	int32_t cell_max[3];
+
+	// Scratch for building and for spatial_hash_neighbors().
+	vector3_t *stage_points;
+	uint64_t *stage_keys;
+	uint32_t *stage_indices;
+	uint32_t *stage_buckets;
+	int32_t *thread_cells;
+	size_t thread_capacity;
+	list_uint32_t *chunk_neighbors;
+	size_t chunk_count;
+} spatial_hash;
+
+spatial_hash spatial_hash_alloc(float cell_size);
+void spatial_hash_free(spatial_hash *h);
+
+/*Replaces the contents with "points". "pool" may be NULL.*/
+void spatial_hash_build(spatial_hash *h, const list_vector3_t *points, thread_pool *pool);
+
+/*"points" are the points of the last build, moved. Returns how many
+  changed cell. Rebuilds if the number of points changed.*/
+size_t spatial_hash_update(spatial_hash *h, const list_vector3_t *points, thread_pool *pool);
+
+/*Indices of the points within "radius" of "point". Replaces the contents
+  of "out" and returns its length.*/
+size_t spatial_hash_query_radius(const spatial_hash *h, vector3_t point, float radius, list_uint32_t *out);
+
+/*Indices of the "k" points nearest to "point" and at most "max_distance"
+  away, nearest first. Use INFINITY for no limit. Replaces the contents
+  of "out" and returns its length.*/
+size_t spatial_hash_query_nearest(const spatial_hash *h, vector3_t point, size_t k, float max_distance,
+		list_uint32_t *out);
+
+/*For every point the other points within "radius": the neighbours of
+  point i are neighbors[offsets[i], offsets[i + 1]). Returns the length of
+  "neighbors", which counts every pair twice.*/
+size_t spatial_hash_neighbors(spatial_hash *h, float radius, list_uint32_t *offsets,
+		list_uint32_t *neighbors, thread_pool *pool);
+
+/*For every point its "k" nearest other points within "max_distance",
+  nearest first, at nearest[i * k] and padded with SPATIAL_HASH_NONE.
+  Returns how many were found.*/
+size_t spatial_hash_nearest_all(const spatial_hash *h, size_t k, float max_distance, list_uint32_t *nearest,
+		thread_pool *pool);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_SPATIAL_HASH_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_SPATIAL_HASH_IMPLEMENTATION_H
+#define BLIB_SPATIAL_HASH_IMPLEMENTATION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+#define SPATIAL_HASH_AXIS_BITS 21
+#define SPATIAL_HASH_AXIS_MASK ((1u << SPATIAL_HASH_AXIS_BITS) - 1)
+
+/*Updates sort everything again once more than one point in this many
+  changed cell*/
+#define SPATIAL_HASH_INSERT_SHARE 8
+
+/*Nearest point queries keep up to this many candidates on the stack*/
+#define SPATIAL_HASH_STACK_HEAP 64
+
+/*Points a nearest point query can test in the time it looks up one
+  column of cells*/
+#define SPATIAL_HASH_COLUMN_COST 16
+
+static void *spatial_hash_grow(void *array, size_t size, size_t capacity) {
+	array = realloc(array, size * capacity);
+	BLIB_METRIC_ADD(metrics_list_reallocs, 1);
+	return array;
+}
+
+/*Clamped to [-2^30, 2^30) so the conversion is defined for any input,
+  NaN lands in the lowest cell*/
+static inline int32_t spatial_hash_cell(float x, float inverse_cell_size) {
+	float f = x * inverse_cell_size;
+	f = f > -1073741824.0f ? f : -1073741824.0f;
+	f = f < 1073741696.0f ? f : 1073741696.0f; // largest float below 2^30
+	int32_t i = (int32_t)f;
+	return i - (f < (float)i);
+}
+
+static inline uint64_t spatial_hash_key(int32_t x, int32_t y, int32_t z) {
+	return (uint64_t)((uint32_t)x & SPATIAL_HASH_AXIS_MASK) << (2 * SPATIAL_HASH_AXIS_BITS) |
+		(uint64_t)((uint32_t)y & SPATIAL_HASH_AXIS_MASK) << SPATIAL_HASH_AXIS_BITS |
+		(uint64_t)((uint32_t)z & SPATIAL_HASH_AXIS_MASK);
+}
+
+/*The grid position of the cell or Fibonacci hashing of its column plus
+  z. Either way the cells of a column are consecutive buckets, and a
+  query reads a few runs of memory instead of a bucket per cell.*/
+static inline uint32_t spatial_hash_bucket(const spatial_hash *h, uint64_t key) {
+	uint32_t x = (uint32_t)(key >> (2 * SPATIAL_HASH_AXIS_BITS));
+	uint32_t y = (uint32_t)(key >> SPATIAL_HASH_AXIS_BITS) & SPATIAL_HASH_AXIS_MASK;
+	uint32_t z = (uint32_t)key & SPATIAL_HASH_AXIS_MASK;
+	if (h->dense) {
+		// Masking the differences undoes the masking of negative cells.
+		x = (x - (uint32_t)h->cell_min[0]) & SPATIAL_HASH_AXIS_MASK;
+		y = (y - (uint32_t)h->cell_min[1]) & SPATIAL_HASH_AXIS_MASK;
+		z = (z - (uint32_t)h->cell_min[2]) & SPATIAL_HASH_AXIS_MASK;
+		return (x * h->extent[1] + y) * h->extent[2] + z;
+	}
+	uint32_t b = (uint32_t)(((key >> SPATIAL_HASH_AXIS_BITS) * 0x9E3779B97F4A7C15ull) >> (64 - h->bucket_bits));
+	return (b + z) & (uint32_t)(h->bucket_count - 1);
+}
+
+spatial_hash spatial_hash_alloc(float cell_size) {
+	assert(cell_size > 0.0f);
+	spatial_hash h;
+	memset(&h, 0, sizeof(h));
+	h.cell_size = cell_size;
+	h.inverse_cell_size = 1.0f / cell_size;
+	return h;
+}
+
+void spatial_hash_free(spatial_hash *h) {
+	free(h->points);
+	free(h->keys);
+	free(h->indices);
+	free(h->start);
+	free(h->stage_points);
+	free(h->stage_keys);
+	free(h->stage_indices);
+	free(h->stage_buckets);
+	free(h->thread_cells);
+	for (size_t c = 0; c < h->chunk_count; c++)
+		list_uint32_t_free(&h->chunk_neighbors[c]);
+	free(h->chunk_neighbors);
+	memset(h, 0, sizeof(*h));
+}
+
+/*-------------------------------- build ----------------------------------*/
+
+typedef struct {
+	spatial_hash *h;
+	const vector3_t *points;
+	bool from_sorted;      // stage in the current order instead of by index
+	bool atomic;
+	uint32_t *cursor;
+	size_t *moved;         // per chunk
+} spatial_hash_job;
+
+/*Cell and key of every point, in index order for a build or in
+  the current order for an update, and the cell bounds per thread*/
+static void spatial_hash_stage_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	spatial_hash_job *job = (spatial_hash_job *)context;
+	spatial_hash *h = job->h;
+	int32_t *cells = h->thread_cells + 6 * thread_index;
+	size_t moved = 0;
+	for (size_t s = begin; s < end; s++) {
+		uint32_t i = job->from_sorted ? h->indices[s] : (uint32_t)s;
+		if (job->from_sorted && s + 16 < end)
+			__builtin_prefetch(&job->points[h->indices[s + 16]]);
+		vector3_t p = job->points[i];
+		int32_t x = spatial_hash_cell(p.x, h->inverse_cell_size);
+		int32_t y = spatial_hash_cell(p.y, h->inverse_cell_size);
+		int32_t z = spatial_hash_cell(p.z, h->inverse_cell_size);
+		cells[0] = x < cells[0] ? x : cells[0];
+		cells[1] = y < cells[1] ? y : cells[1];
+		cells[2] = z < cells[2] ? z : cells[2];
+		cells[3] = x > cells[3] ? x : cells[3];
+		cells[4] = y > cells[4] ? y : cells[4];
+		cells[5] = z > cells[5] ? z : cells[5];
+		uint64_t key = spatial_hash_key(x, y, z);
+		if (job->from_sorted)
+			moved += key != h->keys[s];
+		h->stage_points[s] = p;
+		h->stage_keys[s] = key;
+		h->stage_indices[s] = i;
+	}
+	if (job->from_sorted)
+		job->moved[begin / BLIB_SPATIAL_HASH_GRAIN] = moved;
+}
+
+/*Buckets once the cell bounds are known, and their counts*/
+static void spatial_hash_count_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	(void)thread_index;
+	spatial_hash_job *job = (spatial_hash_job *)context;
+	spatial_hash *h = job->h;
+	for (size_t s = begin; s < end; s++) {
+		uint32_t b = spatial_hash_bucket(h, h->stage_keys[s]);
+		h->stage_buckets[s] = b;
+		if (job->atomic)
+			__atomic_fetch_add(&h->start[b], 1, __ATOMIC_RELAXED);
+		else
+			h->start[b]++;
+	}
+}
+
+static void spatial_hash_scatter_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	(void)thread_index;
+	spatial_hash_job *job = (spatial_hash_job *)context;
+	spatial_hash *h = job->h;
+	for (size_t s = begin; s < end; s++) {
+		uint32_t b = h->stage_buckets[s];
+		uint32_t d = job->atomic ? __atomic_fetch_add(&job->cursor[b], 1, __ATOMIC_RELAXED) : job->cursor[b]++;
+		h->points[d] = h->stage_points[s];
+		h->keys[d] = h->stage_keys[s];
+		h->indices[d] = h->stage_indices[s];
+	}
+}
+
+/*Puts every bucket back in index order, buckets hold one or two points
+  on average so insertion sort it is*/
+static void spatial_hash_order_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	(void)thread_index;
+	spatial_hash_job *job = (spatial_hash_job *)context;
+	spatial_hash *h = job->h;
+	for (size_t b = begin; b < end; b++) {
+		for (uint32_t s = h->start[b] + 1; s < h->start[b + 1]; s++) {
+			uint32_t index = h->indices[s];
+			if (index > h->indices[s - 1])
+				continue;
+			vector3_t p = h->points[s];
+			uint64_t key = h->keys[s];
+			uint32_t d = s;
+			for (; d > h->start[b] && h->indices[d - 1] > index; d--) {
+				h->points[d] = h->points[d - 1];
+				h->keys[d] = h->keys[d - 1];
+				h->indices[d] = h->indices[d - 1];
+			}
+			h->points[d] = p;
+			h->keys[d] = key;
+			h->indices[d] = index;
+		}
+	}
+}
+
+static void spatial_hash_reserve(spatial_hash *h, size_t length, size_t threads) {
+	if (h->capacity < length) {
+		h->capacity = length;
+		h->points = spatial_hash_grow(h->points, sizeof(vector3_t), length);
+		h->keys = spatial_hash_grow(h->keys, sizeof(uint64_t), length);
+		h->indices = spatial_hash_grow(h->indices, sizeof(uint32_t), length);
+		h->stage_points = spatial_hash_grow(h->stage_points, sizeof(vector3_t), length);
+		h->stage_keys = spatial_hash_grow(h->stage_keys, sizeof(uint64_t), length);
+		h->stage_indices = spatial_hash_grow(h->stage_indices, sizeof(uint32_t), length);
+		h->stage_buckets = spatial_hash_grow(h->stage_buckets, sizeof(uint32_t), length);
+	}
+	// At least twice as many buckets as points, a power of two.
+	unsigned bits = 6;
+	while (((size_t)1 << bits) < 2 * length)
+		bits++;
+	if (h->bucket_bits != bits) {
+		h->bucket_bits = bits;
+		h->start = spatial_hash_grow(h->start, sizeof(uint32_t), ((size_t)1 << bits) + 1);
+	}
+	if (h->thread_capacity < threads) {
+		h->thread_capacity = threads;
+		h->thread_cells = spatial_hash_grow(h->thread_cells, sizeof(int32_t), 6 * threads);
+	}
+	for (size_t t = 0; t < threads; t++) {
+		for (int a = 0; a < 3; a++) {
+			h->thread_cells[6 * t + a] = INT32_MAX;
+			h->thread_cells[6 * t + 3 + a] = INT32_MIN;
+		}
+	}
+}
+
+/*Buckets of the staged points and the start of every bucket*/
+static void spatial_hash_count(spatial_hash *h, thread_pool *pool, spatial_hash_job *job) {
+	memset(job, 0, sizeof(*job));
+	job->h = h;
+	job->atomic = thread_pool_thread_count(pool) > 1 && h->length > BLIB_SPATIAL_HASH_GRAIN;
+	memset(h->start, 0, sizeof(uint32_t) * (h->bucket_count + 1));
+	thread_pool_run(pool, h->length, BLIB_SPATIAL_HASH_GRAIN, spatial_hash_count_task, job);
+
+	// Exclusive prefix sums, start[b + 1] ends up at the end of bucket b
+	// once the points are in place.
+	uint32_t sum = 0;
+	for (size_t b = 0; b < h->bucket_count; b++) {
+		uint32_t count = h->start[b];
+		h->start[b] = sum;
+		sum += count;
+	}
+	h->start[h->bucket_count] = sum;
+}
+
+/*Counting sort of the staged points into the sorted arrays*/
+static void spatial_hash_sort(spatial_hash *h, thread_pool *pool) {
+	size_t n = h->length;
+	spatial_hash_job job;
+	spatial_hash_count(h, pool, &job);
+	job.cursor = (uint32_t *)malloc(sizeof(uint32_t) * h->bucket_count);
+	memcpy(job.cursor, h->start, sizeof(uint32_t) * h->bucket_count);
+	thread_pool_run(pool, n, BLIB_SPATIAL_HASH_GRAIN, spatial_hash_scatter_task, &job);
+	free(job.cursor);
+	thread_pool_run(pool, h->bucket_count, BLIB_SPATIAL_HASH_GRAIN, spatial_hash_order_task, &job);
+}
+
+typedef struct {
+	uint64_t order;        // bucket, then index
+	uint32_t slot;         // in the staged arrays
+} spatial_hash_entry;
+
+static int spatial_hash_entry_compare(const void *a, const void *b) {
+	uint64_t x = ((const spatial_hash_entry *)a)->order, y = ((const spatial_hash_entry *)b)->order;
+	return x < y ? -1 : x > y;
+}
+
+static inline void spatial_hash_place(spatial_hash *h, size_t d, size_t s) {
+	h->points[d] = h->stage_points[s];
+	h->keys[d] = h->stage_keys[s];
+	h->indices[d] = h->stage_indices[s];
+}
+
+/*Staged in the last order, the points that kept their cell are still
+  sorted. Only the "moved" others are sorted, then merged back in.*/
+static void spatial_hash_insert(spatial_hash *h, thread_pool *pool, size_t moved) {
+	size_t n = h->length;
+	spatial_hash_job job;
+	spatial_hash_count(h, pool, &job);
+	spatial_hash_entry *entries = (spatial_hash_entry *)malloc(sizeof(spatial_hash_entry) * moved);
+	uint32_t *slots = (uint32_t *)malloc(sizeof(uint32_t) * (moved + 1));
+	size_t m = 0;
+	for (size_t s = 0; s < n; s++) {
+		if (h->stage_keys[s] == h->keys[s])
+			continue;
+		entries[m].order = (uint64_t)h->stage_buckets[s] << 32 | h->stage_indices[s];
+		entries[m].slot = (uint32_t)s;
+		slots[m++] = (uint32_t)s;
+	}
+	slots[m] = (uint32_t)n;
+	qsort(entries, m, sizeof(spatial_hash_entry), spatial_hash_entry_compare);
+
+	size_t d = 0, e = 0, skip = 0;
+	for (size_t s = 0; s < n; s++) {
+		if (s == slots[skip]) {
+			skip++;
+			continue;
+		}
+		uint64_t order = (uint64_t)h->stage_buckets[s] << 32 | h->stage_indices[s];
+		for (; e < m && entries[e].order < order; e++)
+			spatial_hash_place(h, d++, entries[e].slot);
+		spatial_hash_place(h, d++, s);
+	}
+	for (; e < m; e++)
+		spatial_hash_place(h, d++, entries[e].slot);
+	free(entries);
+	free(slots);
+}
+
+static void spatial_hash_merge_cells(spatial_hash *h, size_t threads) {
+	for (int a = 0; a < 3; a++) {
+		h->cell_min[a] = INT32_MAX;
+		h->cell_max[a] = INT32_MIN;
+		for (size_t t = 0; t < threads; t++) {
+			int32_t lo = h->thread_cells[6 * t + a], hi = h->thread_cells[6 * t + 3 + a];
+			h->cell_min[a] = lo < h->cell_min[a] ? lo : h->cell_min[a];
+			h->cell_max[a] = hi > h->cell_max[a] ? hi : h->cell_max[a];
+		}
+		assert(h->length == 0 || (int64_t)h->cell_max[a] - h->cell_min[a] < (1 << SPATIAL_HASH_AXIS_BITS));
+	}
+	// A dense grid whenever the occupied cells fit in the table.
+	size_t table = (size_t)1 << h->bucket_bits, cells = 1;
+	for (int a = 0; a < 3; a++) {
+		h->extent[a] = h->length ? (uint32_t)(h->cell_max[a] - h->cell_min[a]) + 1 : 1;
+		cells = cells <= table ? cells * h->extent[a] : cells;
+	}
+	h->dense = cells <= table;
+	h->bucket_count = h->dense ? cells : table;
+}
+
+void spatial_hash_build(spatial_hash *h, const list_vector3_t *points, thread_pool *pool) {
+	assert(points->length < UINT32_MAX);
+	size_t threads = thread_pool_thread_count(pool);
+	h->length = points->length;
+	spatial_hash_reserve(h, h->length, threads);
+	spatial_hash_job job;
+	memset(&job, 0, sizeof(job));
+	job.h = h;
+	job.points = points->array;
+	thread_pool_run(pool, h->length, BLIB_SPATIAL_HASH_GRAIN, spatial_hash_stage_task, &job);
+	spatial_hash_merge_cells(h, threads);
+	spatial_hash_sort(h, pool);
+}
+
+size_t spatial_hash_update(spatial_hash *h, const list_vector3_t *points, thread_pool *pool) {
+	if (points->length != h->length) {
+		spatial_hash_build(h, points, pool);
+		return points->length;
+	}
+	size_t threads = thread_pool_thread_count(pool);
+	spatial_hash_reserve(h, h->length, threads);
+	size_t chunks = (h->length + BLIB_SPATIAL_HASH_GRAIN - 1) / BLIB_SPATIAL_HASH_GRAIN;
+	spatial_hash_job job;
+	memset(&job, 0, sizeof(job));
+	job.h = h;
+	job.points = points->array;
+	job.from_sorted = true;
+	job.moved = (size_t *)calloc(chunks ? chunks : 1, sizeof(size_t));
+	thread_pool_run(pool, h->length, BLIB_SPATIAL_HASH_GRAIN, spatial_hash_stage_task, &job);
+	bool dense = h->dense;
+	spatial_hash_merge_cells(h, threads);
+	size_t moved = 0;
+	for (size_t c = 0; c < chunks; c++)
+		moved += job.moved[c];
+	free(job.moved);
+
+	if (moved == 0) {
+		// Same order, the staged points become the sorted ones.
+		vector3_t *swap = h->points;
+		h->points = h->stage_points;
+		h->stage_points = swap;
+		return 0;
+	}
+	// The order of the cells holds while the layout is of the same kind:
+	// a dense grid over other bounds is still x major.
+	if (h->dense == dense && moved <= h->length / SPATIAL_HASH_INSERT_SHARE)
+		spatial_hash_insert(h, pool, moved);
+	else
+		spatial_hash_sort(h, pool);
+	return moved;
+}
+
+/*------------------------------- queries ---------------------------------*/
+
+static inline void spatial_hash_reserve_list(list_uint32_t *list, size_t length) {
+	if (list->capacity < length) {
+		list->capacity = length > 2 * list->capacity ? length : 2 * list->capacity;
+		list->array = realloc(list->array, sizeof(uint32_t) * list->capacity);
+		BLIB_METRIC_ADD(metrics_list_reallocs, 1);
+	}
+}
+
+/*Cell range [lo, hi] of the coordinates [a, b] clipped to the occupied
+  cells, false if nothing is left. Compares the same products
+  spatial_hash_cell() rounds, so no point on the edge is lost.*/
+static inline bool spatial_hash_range(const spatial_hash *h, int axis, float a, float b, int32_t *lo,
+		int32_t *hi) {
+	double fa = a * h->inverse_cell_size, fb = b * h->inverse_cell_size;
+	double min = h->cell_min[axis], max = h->cell_max[axis];
+	if (!(fb >= min && fa < max + 1.0))
+		return false;
+	*lo = fa <= min ? h->cell_min[axis] : spatial_hash_cell(a, h->inverse_cell_size);
+	*hi = fb >= max ? h->cell_max[axis] : spatial_hash_cell(b, h->inverse_cell_size);
+	return *lo <= *hi;
+}
+
+/*The slots of the cells [z, z + depth] of column (x, y) are one run of
+  buckets, two when it wraps around the end of the table, or all of them
+  when the column is longer than the table. Returns the key of cell z.*/
+static inline uint64_t spatial_hash_column(const spatial_hash *h, int32_t x, int32_t y, int32_t z, uint32_t depth,
+		uint32_t runs[4]) {
+	uint64_t first = spatial_hash_key(x, y, z);
+	uint32_t b = spatial_hash_bucket(h, first);
+	runs[0] = h->start[b];
+	if (depth >= h->bucket_count) {
+		runs[0] = 0;
+		runs[1] = h->start[h->bucket_count];
+		runs[2] = runs[3] = 0;
+	} else if (b + depth < h->bucket_count) {
+		runs[1] = h->start[b + depth + 1];
+		runs[2] = runs[3] = 0;
+	} else {
+		runs[1] = h->start[h->bucket_count];
+		runs[2] = h->start[0];
+		runs[3] = h->start[b + depth + 1 - h->bucket_count];
+	}
+	return first;
+}
+
+/*Whether "key" is one of the cells spatial_hash_column() was asked for,
+  other cells share its buckets*/
+static inline bool spatial_hash_in_column(uint64_t key, uint64_t first, uint32_t depth) {
+	return ((key >> SPATIAL_HASH_AXIS_BITS) == (first >> SPATIAL_HASH_AXIS_BITS)) &
+		(((key - first) & SPATIAL_HASH_AXIS_MASK) <= depth);
+}
+
+/*Appends to "out" from out->length on, skipping "exclude"*/
+static void spatial_hash_radius(const spatial_hash *h, vector3_t p, float radius, uint32_t exclude,
+		list_uint32_t *out) {
+	int32_t lo[3], hi[3];
+	if (h->length == 0 || !(radius >= 0.0f) ||
+			!spatial_hash_range(h, 0, p.x - radius, p.x + radius, &lo[0], &hi[0]) ||
+			!spatial_hash_range(h, 1, p.y - radius, p.y + radius, &lo[1], &hi[1]) ||
+			!spatial_hash_range(h, 2, p.z - radius, p.z + radius, &lo[2], &hi[2]))
+		return;
+	float r2 = radius * radius;
+	uint32_t depth = (uint32_t)(hi[2] - lo[2]);
+	for (int32_t x = lo[0]; x <= hi[0]; x++) {
+		for (int32_t y = lo[1]; y <= hi[1]; y++) {
+			uint32_t runs[4];
+			uint64_t first = spatial_hash_column(h, x, y, lo[2], depth, runs);
+			for (int r = 0; r < 4; r += 2) {
+				// Branch free, every candidate is written and kept only if it
+				// matches, since most do not.
+				spatial_hash_reserve_list(out, out->length + runs[r + 1] - runs[r]);
+				uint32_t *array = out->array;
+				size_t length = out->length;
+				for (uint32_t s = runs[r]; s < runs[r + 1]; s++) {
+					uint32_t index = h->indices[s];
+					array[length] = index;
+					length += spatial_hash_in_column(h->keys[s], first, depth) & (index != exclude) &
+						(vector3_square_distance(h->points[s], p) <= r2);
+				}
+				out->length = length;
+			}
+		}
+	}
+}
+
+/*Candidates are distance squared bits over the slot, which orders them
+  by distance and then slot since distances are never negative*/
+static inline void spatial_hash_heap_push(uint64_t *heap, size_t *count, size_t k, uint64_t entry) {
+	size_t i;
+	if (*count < k) {
+		i = (*count)++;
+		while (i > 0 && heap[(i - 1) / 2] < entry) {
+			heap[i] = heap[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+	} else {
+		if (entry >= heap[0])
+			return;
+		i = 0;
+		for (;;) {
+			size_t child = 2 * i + 1;
+			if (child >= k)
+				break;
+			if (child + 1 < k && heap[child + 1] > heap[child])
+				child++;
+			if (heap[child] <= entry)
+				break;
+			heap[i] = heap[child];
+			i = child;
+		}
+	}
+	heap[i] = entry;
+}
+
+/*Offers the points of the cells [z, z + depth] of column (x, y)*/
+static inline void spatial_hash_nearest_column(const spatial_hash *h, vector3_t p, int32_t x, int32_t y, int32_t z,
+		uint32_t depth, uint32_t exclude, float max2, uint64_t *heap, size_t *count, size_t k) {
+	uint32_t runs[4];
+	uint64_t first = spatial_hash_column(h, x, y, z, depth, runs);
+	for (int r = 0; r < 4; r += 2) {
+		for (uint32_t s = runs[r]; s < runs[r + 1]; s++) {
+			float d2 = vector3_square_distance(h->points[s], p);
+			if (!(spatial_hash_in_column(h->keys[s], first, depth) & (h->indices[s] != exclude) & (d2 <= max2)))
+				continue;
+			uint32_t bits;
+			memcpy(&bits, &d2, sizeof(bits));
+			spatial_hash_heap_push(heap, count, k, (uint64_t)bits << 32 | s);
+		}
+	}
+}
+
+/*Offers every point, for when the shells would visit more cells than
+  there are points*/
+static size_t spatial_hash_nearest_scan(const spatial_hash *h, vector3_t p, uint32_t exclude, float max2,
+		uint64_t *heap, size_t k) {
+	size_t count = 0;
+	for (size_t s = 0; s < h->length; s++) {
+		float d2 = vector3_square_distance(h->points[s], p);
+		if (!((h->indices[s] != exclude) & (d2 <= max2)))
+			continue;
+		uint32_t bits;
+		memcpy(&bits, &d2, sizeof(bits));
+		spatial_hash_heap_push(heap, &count, k, (uint64_t)bits << 32 | s);
+	}
+	return count;
+}
+
+/*Searches shells of cells around the point's cell, outwards, until the
+  k-th candidate is closer than anything outside the shells. Leaves the
+  candidates in "heap" sorted nearest first and returns their count.*/
+static size_t spatial_hash_nearest(const spatial_hash *h, vector3_t p, size_t k, float max_distance,
+		uint32_t exclude, uint64_t *heap) {
+	if (h->length == 0 || k == 0 || !(max_distance >= 0.0f))
+		return 0;
+	float max2 = max_distance * max_distance;
+	int32_t q[3] = {
+		spatial_hash_cell(p.x, h->inverse_cell_size),
+		spatial_hash_cell(p.y, h->inverse_cell_size),
+		spatial_hash_cell(p.z, h->inverse_cell_size),
+	};
+	// Start with the first shell that reaches an occupied cell, stop
+	// once the shells cover them all.
+	int64_t first = 0, last = 0;
+	for (int a = 0; a < 3; a++) {
+		int64_t below = (int64_t)h->cell_min[a] - q[a], above = (int64_t)q[a] - h->cell_max[a];
+		first = below > first ? below : first;
+		first = above > first ? above : first;
+		last = -below > last ? -below : last;
+		last = -above > last ? -above : last;
+	}
+	// Rounding of cell coordinates is covered by shrinking the distance
+	// the shells are known to cover a little.
+	float slack = (fabsf(p.x) + fabsf(p.y) + fabsf(p.z) + h->cell_size) * 1e-5f;
+
+	// A shell costs one column per cell of its x-y square. Around an
+	// isolated point in a large box the shells add up to r^3 cells, once
+	// they cost more than testing every point a scan takes over.
+	size_t count = 0, columns = 0;
+	for (int64_t r = first; r <= last; r++) {
+		// Points in shell r are at least r - 1 cells away.
+		if ((float)(r - 1) * h->cell_size - slack > max_distance)
+			break;
+		int64_t lo[3], hi[3];
+		for (int a = 0; a < 3; a++) {
+			lo[a] = (int64_t)q[a] - r < h->cell_min[a] ? h->cell_min[a] : (int64_t)q[a] - r;
+			hi[a] = (int64_t)q[a] + r > h->cell_max[a] ? h->cell_max[a] : (int64_t)q[a] + r;
+		}
+		columns += (size_t)((hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1));
+		if (columns * SPATIAL_HASH_COLUMN_COST > h->length) {
+			count = spatial_hash_nearest_scan(h, p, exclude, max2, heap, k);
+			break;
+		}
+		for (int64_t x = lo[0]; x <= hi[0]; x++) {
+			for (int64_t y = lo[1]; y <= hi[1]; y++) {
+				// Inside the shell only the two z faces are new.
+				if (x == (int64_t)q[0] - r || x == (int64_t)q[0] + r || y == (int64_t)q[1] - r ||
+						y == (int64_t)q[1] + r) {
+					spatial_hash_nearest_column(h, p, (int32_t)x, (int32_t)y, (int32_t)lo[2],
+						(uint32_t)(hi[2] - lo[2]), exclude, max2, heap, &count, k);
+					continue;
+				}
+				if (lo[2] == (int64_t)q[2] - r)
+					spatial_hash_nearest_column(h, p, (int32_t)x, (int32_t)y, (int32_t)lo[2], 0, exclude, max2,
+						heap, &count, k);
+				if (hi[2] == (int64_t)q[2] + r)
+					spatial_hash_nearest_column(h, p, (int32_t)x, (int32_t)y, (int32_t)hi[2], 0, exclude, max2,
+						heap, &count, k);
+			}
+		}
+		float reach = (float)r * h->cell_size - slack;
+		if (count == k && reach > 0.0f) {
+			float worst;
+			uint32_t bits = (uint32_t)(heap[0] >> 32);
+			memcpy(&worst, &bits, sizeof(worst));
+			if (worst <= reach * reach)
+				break;
+		}
+	}
+
+	// Heap sort, nearest first.
+	for (size_t n = count; n > 1; n--) {
+		uint64_t top = heap[0];
+		size_t length = n - 1;
+		uint64_t last_entry = heap[length];
+		size_t i = 0;
+		for (;;) {
+			size_t child = 2 * i + 1;
+			if (child >= length)
+				break;
+			if (child + 1 < length && heap[child + 1] > heap[child])
+				child++;
+			if (heap[child] <= last_entry)
+				break;
+			heap[i] = heap[child];
+			i = child;
+		}
+		heap[i] = last_entry;
+		heap[length] = top;
+	}
+	return count;
+}
+
+size_t spatial_hash_query_radius(const spatial_hash *h, vector3_t point, float radius, list_uint32_t *out) {
+	out->length = 0;
+	spatial_hash_radius(h, point, radius, SPATIAL_HASH_NONE, out);
+	return out->length;
+}
+
+size_t spatial_hash_query_nearest(const spatial_hash *h, vector3_t point, size_t k, float max_distance,
+		list_uint32_t *out) {
+	k = k < h->length ? k : h->length;
+	uint64_t stack_heap[SPATIAL_HASH_STACK_HEAP];
+	uint64_t *heap = k <= SPATIAL_HASH_STACK_HEAP ? stack_heap : (uint64_t *)malloc(sizeof(uint64_t) * k);
+	size_t count = spatial_hash_nearest(h, point, k, max_distance, SPATIAL_HASH_NONE, heap);
+	spatial_hash_reserve_list(out, count);
+	for (size_t i = 0; i < count; i++)
+		out->array[i] = h->indices[(uint32_t)heap[i]];
+	out->length = count;
+	if (heap != stack_heap)
+		free(heap);
+	return count;
+}
+
+typedef struct {
+	spatial_hash *h;
+	float radius;
+	uint32_t *offsets;
+	uint32_t *neighbors;
+	uint32_t *local;       // per sorted point, where its run starts in its chunk
+	size_t k;
+	float max_distance;
+	uint32_t *nearest;
+	uint64_t *heaps;       // k per thread
+	size_t *found;         // per chunk
+} spatial_hash_query_job;
+
+/*Each chunk of sorted points collects its neighbours in its own list,
+  the counts go to offsets[index + 1]*/
+static void spatial_hash_neighbors_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	(void)thread_index;
+	spatial_hash_query_job *job = (spatial_hash_query_job *)context;
+	spatial_hash *h = job->h;
+	list_uint32_t *list = &h->chunk_neighbors[begin / BLIB_SPATIAL_HASH_GRAIN];
+	list->length = 0;
+	for (size_t s = begin; s < end; s++) {
+		size_t before = list->length;
+		job->local[s] = (uint32_t)before;
+		spatial_hash_radius(h, h->points[s], job->radius, h->indices[s], list);
+		job->offsets[h->indices[s] + 1] = (uint32_t)(list->length - before);
+	}
+}
+
+static void spatial_hash_gather_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	(void)thread_index;
+	spatial_hash_query_job *job = (spatial_hash_query_job *)context;
+	spatial_hash *h = job->h;
+	const list_uint32_t *list = &h->chunk_neighbors[begin / BLIB_SPATIAL_HASH_GRAIN];
+	for (size_t s = begin; s < end; s++) {
+		uint32_t i = h->indices[s];
+		memcpy(job->neighbors + job->offsets[i], list->array + job->local[s],
+			sizeof(uint32_t) * (job->offsets[i + 1] - job->offsets[i]));
+	}
+}
+
+size_t spatial_hash_neighbors(spatial_hash *h, float radius, list_uint32_t *offsets,
+		list_uint32_t *neighbors, thread_pool *pool) {
+	size_t n = h->length;
+	size_t chunks = (n + BLIB_SPATIAL_HASH_GRAIN - 1) / BLIB_SPATIAL_HASH_GRAIN;
+	if (h->chunk_count < chunks) {
+		h->chunk_neighbors = spatial_hash_grow(h->chunk_neighbors, sizeof(list_uint32_t), chunks);
+		for (size_t c = h->chunk_count; c < chunks; c++)
+			h->chunk_neighbors[c] = list_uint32_t_alloc();
+		h->chunk_count = chunks;
+	}
+	spatial_hash_reserve_list(offsets, n + 1);
+	offsets->length = n + 1;
+	offsets->array[0] = 0;
+
+	spatial_hash_query_job job;
+	memset(&job, 0, sizeof(job));
+	job.h = h;
+	job.radius = radius;
+	job.offsets = offsets->array;
+	job.local = h->stage_buckets;
+	thread_pool_run(pool, n, BLIB_SPATIAL_HASH_GRAIN, spatial_hash_neighbors_task, &job);
+	for (size_t i = 0; i < n; i++)
+		offsets->array[i + 1] += offsets->array[i];
+
+	spatial_hash_reserve_list(neighbors, offsets->array[n]);
+	neighbors->length = offsets->array[n];
+	job.neighbors = neighbors->array;
+	thread_pool_run(pool, n, BLIB_SPATIAL_HASH_GRAIN, spatial_hash_gather_task, &job);
+	return neighbors->length;
+}
+
+static void spatial_hash_nearest_task(void *context, size_t begin, size_t end, size_t thread_index) {
+	spatial_hash_query_job *job = (spatial_hash_query_job *)context;
+	const spatial_hash *h = job->h;
+	uint64_t *heap = job->heaps + thread_index * job->k;
+	size_t found = 0;
+	for (size_t s = begin; s < end; s++) {
+		uint32_t *out = job->nearest + (size_t)h->indices[s] * job->k;
+		size_t count = spatial_hash_nearest(h, h->points[s], job->k, job->max_distance, h->indices[s], heap);
+		for (size_t i = 0; i < job->k; i++)
+			out[i] = i < count ? h->indices[(uint32_t)heap[i]] : SPATIAL_HASH_NONE;
+		found += count;
+	}
+	job->found[begin / BLIB_SPATIAL_HASH_GRAIN] = found;
+}
+
+size_t spatial_hash_nearest_all(const spatial_hash *h, size_t k, float max_distance, list_uint32_t *nearest,
+		thread_pool *pool) {
+	size_t n = h->length;
+	size_t chunks = (n + BLIB_SPATIAL_HASH_GRAIN - 1) / BLIB_SPATIAL_HASH_GRAIN;
+	spatial_hash_reserve_list(nearest, n * k);
+	nearest->length = n * k;
+	if (n == 0 || k == 0)
+		return 0;
+
+	spatial_hash_query_job job;
+	memset(&job, 0, sizeof(job));
+	job.h = (spatial_hash *)h;
+	job.k = k;
+	job.max_distance = max_distance;
+	job.nearest = nearest->array;
+	job.heaps = (uint64_t *)malloc(sizeof(uint64_t) * k * thread_pool_thread_count(pool));
+	job.found = (size_t *)malloc(sizeof(size_t) * chunks);
+	thread_pool_run(pool, n, BLIB_SPATIAL_HASH_GRAIN, spatial_hash_nearest_task, &job);
+	size_t found = 0;
+	for (size_t c = 0; c < chunks; c++)
+		found += job.found[c];
+	free(job.heaps);
+	free(job.found);
+	return found;
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_SPATIAL_HASH_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
@@ -0,0 +1,215 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+#ifndef BLIB_THREAD_H
+#define BLIB_THREAD_H
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "blib.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/*Called by thread_pool_run() for every chunk [begin, end) of the range.
+  "thread_index" is stable for the duration of the call and lies in
+  [0, thread_pool_thread_count(pool)), which makes it usable as an index
+  into per-thread scratch memory.*/
+typedef void (*thread_pool_task)(void *context, size_t begin, size_t end,
+		size_t thread_index);
+
+typedef struct thread_pool thread_pool;
+
+/*Starts "worker_count" threads. The thread calling thread_pool_run() always
+  helps out, so a pool with N workers runs tasks on N + 1 threads.*/
+thread_pool *thread_pool_alloc(size_t worker_count);
+void thread_pool_free(thread_pool *pool);
+
+/*Number of distinct thread indices a task can see. A NULL pool is valid
+  everywhere a pool is accepted and means "run on the calling thread".*/
+size_t thread_pool_thread_count(const thread_pool *pool);
+
+/*Splits [0, count) into chunks of "grain" items (0 picks a grain for you)
+  and blocks until every chunk has been processed. Tasks must not call
+  thread_pool_run() on the same pool.*/
+void thread_pool_run(thread_pool *pool, size_t count, size_t grain,
+		thread_pool_task task, void *context);
+
+#ifdef __cplusplus
+} //extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_THREAD_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_THREAD_IMPLEMENTATION_H
+#define BLIB_THREAD_IMPLEMENTATION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+typedef struct {
+	thread_pool *pool;
+	size_t index;
+} thread_pool_worker;
+
+struct thread_pool {
+	pthread_mutex_t run_mutex;
+	pthread_mutex_t mutex;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	pthread_t *threads;
+	thread_pool_worker *workers;
+	size_t worker_count;
+	size_t generation;
+	size_t busy;
+	bool stop;
+
+	thread_pool_task task;
+	void *context;
+	size_t count;
+	size_t grain;
+	size_t next;
+};
+
+static void thread_pool_drain(thread_pool *pool, size_t thread_index) {
+	for (;;) {
+		size_t begin = __atomic_fetch_add(&pool->next, pool->grain, __ATOMIC_RELAXED);
+		if (begin >= pool->count)
+			break;
+		size_t end = begin + pool->grain;
+		if (end > pool->count)
+			end = pool->count;
+		pool->task(pool->context, begin, end, thread_index);
+	}
+}
+
+static void *thread_pool_worker_main(void *arg) {
+	thread_pool_worker *worker = (thread_pool_worker *)arg;
+	thread_pool *pool = worker->pool;
+	size_t seen = 0;
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		while (!pool->stop && pool->generation == seen)
+			pthread_cond_wait(&pool->wake, &pool->mutex);
+		if (pool->stop)
+			break;
+		seen = pool->generation;
+		pthread_mutex_unlock(&pool->mutex);
+
+		thread_pool_drain(pool, worker->index);
+
+		pthread_mutex_lock(&pool->mutex);
+		if (--pool->busy == 0)
+			pthread_cond_signal(&pool->done);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+thread_pool *thread_pool_alloc(size_t worker_count) {
+	thread_pool *pool = (thread_pool *)calloc(1, sizeof(thread_pool));
+	pthread_mutex_init(&pool->run_mutex, NULL);
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->wake, NULL);
+	pthread_cond_init(&pool->done, NULL);
+	pool->threads = (pthread_t *)malloc(sizeof(pthread_t) * (worker_count + 1));
+	pool->workers = (thread_pool_worker *)malloc(sizeof(thread_pool_worker) * (worker_count + 1));
+	for (size_t i = 0; i < worker_count; i++) {
+		pool->workers[i].pool = pool;
+		pool->workers[i].index = i;
+		if (pthread_create(&pool->threads[i], NULL, thread_pool_worker_main, &pool->workers[i]))
+			break;
+		pool->worker_count++;
+	}
+	return pool;
+}
+
+void thread_pool_free(thread_pool *pool) {
+	if (pool == NULL)
+		return;
+	pthread_mutex_lock(&pool->mutex);
+	pool->stop = true;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->mutex);
+	for (size_t i = 0; i < pool->worker_count; i++)
+		pthread_join(pool->threads[i], NULL);
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->mutex);
+	pthread_mutex_destroy(&pool->run_mutex);
+	free(pool->workers);
+	free(pool->threads);
+	free(pool);
+}
+
+size_t thread_pool_thread_count(const thread_pool *pool) {
+	return pool ? pool->worker_count + 1 : 1;
+}
+
+void thread_pool_run(thread_pool *pool, size_t count, size_t grain,
+		thread_pool_task task, void *context) {
+	if (count == 0)
+		return;
+	size_t threads = thread_pool_thread_count(pool);
+	if (grain == 0) {
+		grain = count / (threads * 8);
+		grain = grain ? grain : 1;
+	}
+	if (pool == NULL || pool->worker_count == 0 || count <= grain) {
+		task(context, 0, count, threads - 1);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->run_mutex);
+	pthread_mutex_lock(&pool->mutex);
+	pool->task = task;
+	pool->context = context;
+	pool->count = count;
+	pool->grain = grain;
+	pool->next = 0;
+	pool->busy = pool->worker_count;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->mutex);
+
+	thread_pool_drain(pool, pool->worker_count);
+
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->busy)
+		pthread_cond_wait(&pool->done, &pool->mutex);
+	pthread_mutex_unlock(&pool->mutex);
+	pthread_mutex_unlock(&pool->run_mutex);
+}
+
+#ifdef __cplusplus
+} //extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_THREAD_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
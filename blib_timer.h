@@ -0,0 +1,109 @@
+/*----------------------------------LEGAL--------------------------------------
+
+  MIT License
+
+  Copyright (c) 2023 Benjamin Joseph Brooks
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy
+  of this software and associated documentation files (the "Software"), to deal
+  in the Software without restriction, including without limitation the rights
+  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+  copies of the Software, and to permit persons to whom the Software is
+  furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+
+  -----------------------------------------------------------------------------*/
+
+#ifndef BLIB_TIMER_H
+#define BLIB_TIMER_H
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/time.h>
+
+/*How long timer_ticks_per_second() spends measuring the tick rate*/
+#define BLIB_TIMER_CALIBRATION_NS (10 * 1000 * 1000 /* nanoseconds */)
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/*Nanoseconds from an arbitrary starting point. Uses the monotonic clock
+  when the POSIX clock API is visible (-D_POSIX_C_SOURCE=199309L or newer,
+  or -std=gnu99) and falls back to gettimeofday() under plain -std=c99.*/
+static inline uint64_t timer_now_ns(void) {
+#if defined(CLOCK_MONOTONIC)
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_nsec;
+#else
+	struct timeval t;
+	gettimeofday(&t, NULL);
+	return (uint64_t)t.tv_sec * 1000000000u + (uint64_t)t.tv_usec * 1000u;
+#endif
+}
+
+/*The cheapest timestamp available: the time stamp counter on x86, the
+  nanosecond clock elsewhere. Convert with timer_ticks_per_second().*/
+static inline uint64_t timer_ticks(void) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	return __builtin_ia32_rdtsc();
+#else
+	return timer_now_ns();
+#endif
+}
+
+/*Measured once per process (the first call takes about
+  BLIB_TIMER_CALIBRATION_NS), cached afterwards.*/
+uint64_t timer_ticks_per_second(void);
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_TIMER_H
+
+#ifdef BLIB_IMPLEMENTATION
+#ifndef BLIB_TIMER_IMPLEMENTATION_H
+#define BLIB_TIMER_IMPLEMENTATION_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+uint64_t timer_ticks_per_second(void) {
+	static uint64_t cached = 0;
+	uint64_t rate = __atomic_load_n(&cached, __ATOMIC_RELAXED);
+	if (rate)
+		return rate;
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	uint64_t ns0 = timer_now_ns();
+	uint64_t ticks0 = timer_ticks();
+	uint64_t ns1 = ns0;
+	while (ns1 - ns0 < BLIB_TIMER_CALIBRATION_NS)
+		ns1 = timer_now_ns();
+	uint64_t ticks1 = timer_ticks();
+	rate = (uint64_t)((double)(ticks1 - ticks0) * 1e9 / (double)(ns1 - ns0));
+#else
+	rate = 1000000000u;
+#endif
+	__atomic_store_n(&cached, rate, __ATOMIC_RELAXED);
+	return rate;
+}
+
+#ifdef __cplusplus
+} // extern "C" {
+#endif // __cplusplus
+
+#endif // BLIB_TIMER_IMPLEMENTATION_H
+#endif // BLIB_IMPLEMENTATION
@@ -0,0 +1,26 @@
+/*Turns a file written by blib_log_binary.h back into text.
+
+  usage: log_decode <file.blog> [output.txt]*/
+
+#define BLIB_IMPLEMENTATION
+#include "../blib_log_binary.h"
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <file.blog> [output.txt]\n", argv[0]);
+		return 1;
+	}
+	FILE *out = stdout;
+	if (argc > 2 && (out = fopen(argv[2], "w")) == NULL) {
+		fprintf(stderr, "could not open %s\n", argv[2]);
+		return 1;
+	}
+	int ok = log_binary_decode(argv[1], out);
+	if (out != stdout)
+		fclose(out);
+	if (!ok) {
+		fprintf(stderr, "could not decode %s\n", argv[1]);
+		return 1;
+	}
+	return 0;
+}